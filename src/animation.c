@@ -0,0 +1,262 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+#include <gtk/gtk.h>
+
+#include "gamedata.h"
+#include "animation.h"
+#include "view.h"
+
+
+/*
+ * Animation scheduler.
+ * Lines with an active FX are kept in a list. A single timer, ticking at
+ * the display refresh rate, advances their frames and queues a redraw of
+ * the area they cover (and nothing else). The timer is only running while
+ * there's something to animate.
+ */
+
+/* time between timer ticks (ms): about one display refresh */
+#define ANIMATION_TICK_MS	16
+
+/* duration of one FX frame (seconds) */
+#define FX_FRAME_TIME		0.05
+
+
+/*
+ * Stores animation data
+ */
+struct animation {
+	struct game *game;		// game whose lines are animated
+	GArray *lines;			// ids of lines being animated
+	guint timeout_id;		// id of timer source (0 if stopped)
+	GTimer *timer;			// time since timer was started
+	gulong frames_done;		// frames advanced since timer was started
+};
+
+
+/*
+ * Create new variable to store animation data
+ */
+struct animation*
+animation_create(void)
+{
+	struct animation *anim;
+
+	anim= (struct animation*)g_malloc(sizeof(struct animation));
+	anim->game= NULL;
+	anim->lines= g_array_new(FALSE, FALSE, sizeof(int));
+	anim->timeout_id= 0;
+	anim->timer= g_timer_new();
+	anim->frames_done= 0;
+	return anim;
+}
+
+
+/*
+ * Free animation data
+ */
+void
+animation_destroy(struct animation *anim)
+{
+	if (anim->timeout_id != 0)
+		g_source_remove(anim->timeout_id);
+	g_array_free(anim->lines, TRUE);
+	g_timer_destroy(anim->timer);
+	g_free(anim);
+}
+
+
+/*
+ * Is any line being animated?
+ */
+gboolean
+animation_is_running(struct animation *anim)
+{
+	return anim->lines->len > 0;
+}
+
+
+/*
+ * Queue redraw of the area covered by the given lines
+ */
+static void
+animation_queue_draw(struct board *board, const int *ids, int n)
+{
+	struct clipbox clip;
+	int i;
+
+	if (n == 0) return;
+	clip= board->geo->lines[ids[0]].clip;
+	for(i=1; i < n; ++i)
+		geometry_clip_union(&clip, &board->geo->lines[ids[i]].clip);
+	view_queue_draw_clip(board, &clip);
+}
+
+
+/*
+ * Advance frame of an FX animation
+ */
+static void
+animation_advance_fx(struct fx *fx, int nframes)
+{
+	switch(fx->status) {
+		case FX_LOOP:
+			fx->frame= (fx->frame + nframes)%FX_LOOP_FRAMES;
+		break;
+		default:
+			g_debug("unknown FX: %d", fx->status);
+	}
+}
+
+
+/*
+ * Forget lines animated in a game that is no longer on the board
+ */
+static void
+animation_check_game(struct board *board, struct animation *anim)
+{
+	if (anim->game != board->game) {
+		g_array_set_size(anim->lines, 0);
+		anim->game= board->game;
+	}
+}
+
+
+/*
+ * Timer tick: advance frames of animated lines (as many as the elapsed
+ * time requires) and redraw them.
+ * Lines whose FX has been switched off elsewhere are dropped from the
+ * list. Timer stops when there's nothing left to animate.
+ */
+static gboolean
+animation_tick(gpointer data)
+{
+	struct board *board=(struct board*)data;
+	struct animation *anim=board->animation;
+	struct fx *fx;
+	gulong frames;
+	int *ids;
+	int i, n;
+
+	gdk_threads_enter();
+	animation_check_game(board, anim);
+
+	frames= (gulong)(g_timer_elapsed(anim->timer, NULL)/FX_FRAME_TIME);
+	if (frames != anim->frames_done) {
+		ids= (int*)anim->lines->data;
+		n= 0;
+		for(i=0; i < anim->lines->len; ++i) {
+			fx= board->game->line_fx + ids[i];
+			if (fx->status == FX_OFF) continue;
+			animation_advance_fx(fx, frames - anim->frames_done);
+			ids[n++]= ids[i];
+		}
+		g_array_set_size(anim->lines, n);
+		anim->frames_done= frames;
+		animation_queue_draw(board, ids, n);
+	}
+
+	if (anim->lines->len == 0) {
+		anim->timeout_id= 0;
+		gdk_threads_leave();
+		return FALSE;
+	}
+	gdk_threads_leave();
+	return TRUE;
+}
+
+
+/*
+ * Start FX animation of a line (from given frame)
+ */
+void
+animation_start_line(struct board *board, int id, int status, int frame)
+{
+	struct animation *anim=board->animation;
+	struct fx *fx=board->game->line_fx + id;
+
+	g_assert(status != FX_OFF);
+	animation_check_game(board, anim);
+	if (fx->status == FX_OFF)
+		g_array_append_val(anim->lines, id);
+	fx->status= status;
+	fx->frame= frame;
+	animation_queue_draw(board, &id, 1);
+
+	/* nothing to animate without a window */
+	if (anim->timeout_id == 0 && board->drawarea != NULL) {
+		g_timer_start(anim->timer);
+		anim->frames_done= 0;
+		anim->timeout_id= g_timeout_add(ANIMATION_TICK_MS, animation_tick,
+										board);
+	}
+}
+
+
+/*
+ * Stop FX animation of a line
+ */
+void
+animation_stop_line(struct board *board, int id)
+{
+	struct animation *anim=board->animation;
+	int *ids;
+	int i;
+
+	animation_check_game(board, anim);
+	board->game->line_fx[id].status= FX_OFF;
+	board->game->line_fx[id].frame= 0;
+	ids= (int*)anim->lines->data;
+	for(i=0; i < anim->lines->len; ++i) {
+		if (ids[i] == id) {
+			g_array_remove_index_fast(anim->lines, i);
+			break;
+		}
+	}
+	animation_queue_draw(board, &id, 1);
+	if (anim->lines->len == 0 && anim->timeout_id != 0) {
+		g_source_remove(anim->timeout_id);
+		anim->timeout_id= 0;
+	}
+}
+
+
+/*
+ * Stop all animations
+ */
+void
+animation_stop_all(struct board *board)
+{
+	struct animation *anim=board->animation;
+	struct fx *fx;
+	int *ids;
+	int i;
+
+	animation_check_game(board, anim);
+	ids= (int*)anim->lines->data;
+	for(i=0; i < anim->lines->len; ++i) {
+		fx= board->game->line_fx + ids[i];
+		fx->status= FX_OFF;
+		fx->frame= 0;
+	}
+	animation_queue_draw(board, ids, anim->lines->len);
+	g_array_set_size(anim->lines, 0);
+	if (anim->timeout_id != 0) {
+		g_source_remove(anim->timeout_id);
+		anim->timeout_id= 0;
+	}
+}
@@ -0,0 +1,32 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+#ifndef __INCLUDED_ANIMATION_H__
+#define __INCLUDED_ANIMATION_H__
+
+
+/*
+ * Functions
+ */
+struct animation *animation_create(void);
+void animation_destroy(struct animation *anim);
+void animation_start_line(struct board *board, int id, int status, int frame);
+void animation_stop_line(struct board *board, int id);
+void animation_stop_all(struct board *board);
+gboolean animation_is_running(struct animation *anim);
+
+
+#endif
@@ -14,38 +14,321 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
  */
 
-#include <sys/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <glib.h>
 
-/* global variables to keep track of benchmarks */
-static gboolean started=FALSE;
-static struct timeval start_time;
+#include "benchmark.h"
 
 
+/*
+ * Timers.
+ * A timed scope starts with fences_benchmark_enter and finishes with
+ * fences_benchmark_leave. Scopes nest: a scope started inside another is
+ * named after both (e.g. "generate/solve").
+ * When FENCES_BENCHMARK is set in the environment, the time of every scope
+ * is recorded and a report of all timers (number of times run, total,
+ * min, median, 99th percentile and max) is written to stderr on exit.
+ * Each thread keeps its own scopes and a buffer of recorded times, which
+ * is moved to the timers every BENCHMARK_BUFFER_SIZE times and when the
+ * thread finishes, so threads don't wait on each other while timing.
+ */
+
+
+/* maximum depth of nested scopes */
+#define BENCHMARK_MAX_DEPTH		16
+
+/* maximum length of a scope name (with names of scopes around it) */
+#define BENCHMARK_MAX_PATH		128
+
+/* times buffered in a thread before moving them to the timers */
+#define BENCHMARK_BUFFER_SIZE	256
+
+
+/*
+ * Timer: all recorded times of a scope
+ */
+struct benchmark_timer {
+	gchar *path;			// name of scope (with scopes around it)
+	GArray *times;			// recorded times (ms)
+};
+
+
+/*
+ * Scope running in a thread
+ */
+struct benchmark_scope {
+	char path[BENCHMARK_MAX_PATH];	// name, with scopes around it
+	struct timespec start;			// time scope started
+};
+
+
+/*
+ * Time recorded in a thread, not yet moved to its timer
+ */
+struct benchmark_sample {
+	struct benchmark_timer *timer;
+	double ms;
+};
+
+
+/*
+ * Scopes and recorded times of a thread
+ */
+struct benchmark_thread {
+	struct benchmark_scope scope[BENCHMARK_MAX_DEPTH];
+	int depth;				// number of scopes running
+	GHashTable *timers;		// timers used by thread (by path)
+	struct benchmark_sample buffer[BENCHMARK_BUFFER_SIZE];
+	int nbuffer;			// number of times in buffer
+};
+
+
+/* are times recorded? (set once at start) */
+static gboolean enabled=FALSE;
+
+/* all timers (by path) */
+static GHashTable *timers=NULL;
+static GStaticMutex timers_mutex=G_STATIC_MUTEX_INIT;
+
+/* scopes of current thread */
+static GStaticPrivate thread_key=G_STATIC_PRIVATE_INIT;
+
+
+
+/*
+ * Move times recorded in thread to their timers
+ */
+static void
+benchmark_flush(struct benchmark_thread *thread)
+{
+	struct benchmark_sample *sample;
+	int i;
+
+	if (thread->nbuffer == 0) return;
+	g_static_mutex_lock(&timers_mutex);
+	for(i=0; i < thread->nbuffer; ++i) {
+		sample= thread->buffer + i;
+		g_array_append_val(sample->timer->times, sample->ms);
+	}
+	g_static_mutex_unlock(&timers_mutex);
+	thread->nbuffer= 0;
+}
+
+
+/*
+ * Thread finished: keep its times and free its data
+ */
+static void
+benchmark_thread_free(gpointer data)
+{
+	struct benchmark_thread *thread=(struct benchmark_thread*)data;
+
+	benchmark_flush(thread);
+	g_hash_table_destroy(thread->timers);
+	g_free(thread);
+}
+
+
+/*
+ * Scopes of current thread (created on first use)
+ */
+static struct benchmark_thread*
+benchmark_get_thread(void)
+{
+	struct benchmark_thread *thread;
+
+	thread= (struct benchmark_thread*)g_static_private_get(&thread_key);
+	if (thread != NULL) return thread;
+
+	thread= (struct benchmark_thread*)
+		g_malloc0(sizeof(struct benchmark_thread));
+	thread->timers= g_hash_table_new(g_str_hash, g_str_equal);
+	g_static_private_set(&thread_key, thread, benchmark_thread_free);
+	return thread;
+}
+
 
 /*
- * Start benchmark
+ * Timer of a scope, created if needed
  */
-inline void
-fences_benchmark_start(void)
+static struct benchmark_timer*
+benchmark_get_timer(struct benchmark_thread *thread, const char *path)
 {
-	started= TRUE;
-	gettimeofday (&start_time, NULL);
+	struct benchmark_timer *timer;
+
+	timer= (struct benchmark_timer*)g_hash_table_lookup(thread->timers, path);
+	if (timer != NULL) return timer;
+
+	g_static_mutex_lock(&timers_mutex);
+	timer= (struct benchmark_timer*)g_hash_table_lookup(timers, path);
+	if (timer == NULL) {
+		timer= (struct benchmark_timer*)
+			g_malloc(sizeof(struct benchmark_timer));
+		timer->path= g_strdup(path);
+		timer->times= g_array_new(FALSE, FALSE, sizeof(double));
+		g_hash_table_insert(timers, timer->path, timer);
+	}
+	g_static_mutex_unlock(&timers_mutex);
+	g_hash_table_insert(thread->timers, timer->path, timer);
+	return timer;
+}
+
+
+/*
+ * Write report of timers on exit
+ */
+static void
+benchmark_exit_report(void)
+{
+	fences_benchmark_report(stderr);
+}
+
+
+/*
+ * Start recording times if FENCES_BENCHMARK is set in the environment.
+ * Must be called once, before any thread is created.
+ */
+void
+fences_benchmark_init(void)
+{
+	if (enabled || g_getenv("FENCES_BENCHMARK") == NULL) return;
+	enabled= TRUE;
+	timers= g_hash_table_new(g_str_hash, g_str_equal);
+	atexit(benchmark_exit_report);
+}
+
+
+/*
+ * Start timed scope. Name must be a string constant.
+ */
+void
+fences_benchmark_enter(const char *name)
+{
+	struct benchmark_thread *thread=benchmark_get_thread();
+	struct benchmark_scope *scope;
+
+	++thread->depth;
+	if (thread->depth > BENCHMARK_MAX_DEPTH) return;
+	scope= thread->scope + thread->depth - 1;
+	if (enabled) {
+		if (thread->depth > 1)
+			g_snprintf(scope->path, BENCHMARK_MAX_PATH, "%s/%s",
+					   scope[-1].path, name);
+		else
+			g_snprintf(scope->path, BENCHMARK_MAX_PATH, "%s", name);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &scope->start);
+}
+
+
+/*
+ * Finish last scope started in this thread
+ * Returns time spent in scope (ms)
+ */
+double
+fences_benchmark_leave(void)
+{
+	struct benchmark_thread *thread=benchmark_get_thread();
+	struct benchmark_scope *scope;
+	struct benchmark_sample *sample;
+	struct timespec end;
+	double ms;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	g_return_val_if_fail(thread->depth > 0, 0.);
+	--thread->depth;
+	if (thread->depth >= BENCHMARK_MAX_DEPTH) return 0.;
+	scope= thread->scope + thread->depth;
+	ms= (end.tv_sec - scope->start.tv_sec)*1000. +
+		(end.tv_nsec - scope->start.tv_nsec)/1000000.;
+
+	if (enabled) {
+		sample= thread->buffer + thread->nbuffer;
+		sample->timer= benchmark_get_timer(thread, scope->path);
+		sample->ms= ms;
+		++thread->nbuffer;
+		if (thread->nbuffer == BENCHMARK_BUFFER_SIZE)
+			benchmark_flush(thread);
+	}
+	return ms;
 }
 
 
 /*
- * Stop benchmark and return time
+ * Compare doubles (for qsort)
  */
-inline double
-fences_benchmark_stop(void)
+static int
+benchmark_double_cmp(const void *a, const void *b)
 {
-	struct timeval end_time;
+	double x=*(const double*)a;
+	double y=*(const double*)b;
+
+	return (x > y) - (x < y);
+}
+
+
+/*
+ * Compare timers by path (for qsort)
+ */
+static int
+benchmark_timer_cmp(const void *a, const void *b)
+{
+	const struct benchmark_timer *t1=*(struct benchmark_timer* const*)a;
+	const struct benchmark_timer *t2=*(struct benchmark_timer* const*)b;
+
+	return strcmp(t1->path, t2->path);
+}
+
+
+/*
+ * Add timer to list (for g_hash_table_foreach)
+ */
+static void
+benchmark_list_timer(gpointer key, gpointer value, gpointer data)
+{
+	g_ptr_array_add((GPtrArray*)data, value);
+}
+
+
+/*
+ * Write statistics of all timers as JSON objects (one per line).
+ * Times recorded by other threads still running may be missing.
+ */
+void
+fences_benchmark_report(FILE *file)
+{
+	struct benchmark_timer *timer;
+	GPtrArray *list;
+	double *times;
+	double total;
+	int n, i, j;
+
+	if (!enabled) return;
+	benchmark_flush(benchmark_get_thread());
 
-	gettimeofday (&end_time, NULL);
-	if (!started)
-		return 0.0;
-	started= FALSE;
-	return ((double)(end_time.tv_sec - start_time.tv_sec))*1000000. \
-		+ ((double)(end_time.tv_usec - start_time.tv_usec));
+	g_static_mutex_lock(&timers_mutex);
+	list= g_ptr_array_new();
+	g_hash_table_foreach(timers, benchmark_list_timer, list);
+	qsort(list->pdata, list->len, sizeof(gpointer), benchmark_timer_cmp);
+	for(i=0; i < list->len; ++i) {
+		timer= (struct benchmark_timer*)g_ptr_array_index(list, i);
+		n= timer->times->len;
+		if (n == 0) continue;
+		times= (double*)timer->times->data;
+		qsort(times, n, sizeof(double), benchmark_double_cmp);
+		total= 0.;
+		for(j=0; j < n; ++j)
+			total+= times[j];
+		fprintf(file, "{\"timer\": \"%s\", \"count\": %d, "
+				"\"total_ms\": %.4f, \"min_ms\": %.4f, \"p50_ms\": %.4f, "
+				"\"p99_ms\": %.4f, \"max_ms\": %.4f}\n",
+				timer->path, n, total, times[0], times[n/2],
+				times[(n*99)/100], times[n - 1]);
+	}
+	g_static_mutex_unlock(&timers_mutex);
+	g_ptr_array_free(list, TRUE);
+	fflush(file);
 }
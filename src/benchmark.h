@@ -1,4 +1,3 @@
-
 /*
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -18,9 +17,13 @@
 #ifndef __INCLUDED_BENCHMARK_H__
 #define __INCLUDED_BENCHMARK_H__
 
+#include <stdio.h>
+
 
-inline void fences_benchmark_start(void);
-inline double fences_benchmark_stop(void);
+void fences_benchmark_init(void);
+void fences_benchmark_enter(const char *name);
+double fences_benchmark_leave(void);
+void fences_benchmark_report(FILE *file);
 
 
 #endif
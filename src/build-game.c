@@ -20,6 +20,8 @@
 #include "gamedata.h"
 #include "game-solver.h"
 #include "brute-force.h"
+#include "loop-tracker.h"
+#include "benchmark.h"
 
 #include <stdio.h>
 
@@ -100,7 +102,7 @@ newgame_trim_game(struct newgame *newgame, struct geometry *geo)
 			if (newgame->sol->solved && newgame->sol->difficulty > prev_difficulty) {
 				--newgame->nvisible;
 				++newgame->nhidden;
-				printf("**eliminated one number\n");
+				g_debug("**eliminated one number");
 				prev_difficulty= newgame->sol->difficulty;
 			} else {
 				/* restore tile */
@@ -126,6 +128,7 @@ build_new_game(struct geometry *geo, double difficulty)
 	gboolean found=FALSE;
 	struct solution *sol;
 
+	fences_benchmark_enter("generate");
 	/* create new game structure */
 	newgame= (struct newgame*)g_malloc(sizeof(struct newgame));
 
@@ -172,7 +175,7 @@ build_new_game(struct geometry *geo, double difficulty)
 	/* main loop */
 	while(1) {
 		if (newgame->nhidden == 0) {
-			printf("nhidden = 0. Stop.\n");
+			g_debug("nhidden = 0. Stop.");
 			break;
 		}
 		/* pick a random tile to show */
@@ -242,7 +245,7 @@ build_new_game(struct geometry *geo, double difficulty)
 	solve_game_solution(sol, -1);
 
 	if (found) {
-		printf("YAY. Found a solution! (%6.4lf)\n", sol->difficulty);
+		g_debug("YAY. Found a solution! (%6.4lf)", sol->difficulty);
 	}
 
 	struct game *game;
@@ -257,6 +260,8 @@ build_new_game(struct geometry *geo, double difficulty)
 		if (game->solution[i] == LINE_ON)
 			++game->solution_nlines_on;
 	}
+	game->nmismatch= game->solution_nlines_on;
+	loop_tracker_clear(game->loops);
 	/* free solution */
 	solve_free_solution_data(sol);
 
@@ -267,5 +272,6 @@ build_new_game(struct geometry *geo, double difficulty)
 	//g_free(newgame->zero_pos);
 	g_free(newgame);
 
+	fences_benchmark_leave();
 	return game;
 }
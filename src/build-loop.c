@@ -19,6 +19,7 @@
 #include <stdio.h>
 
 #include "gamedata.h"
+#include "benchmark.h"
 
 
 
@@ -441,6 +442,7 @@ build_new_loop(struct geometry *geo, struct game *game, gboolean trace)
 	static struct loop *loop;
 	static gboolean first_time=TRUE;
 
+	fences_benchmark_enter("loop");
 	if (first_time || trace == FALSE) {
 		loop= allocate_loop(geo);
 		initialize_loop(loop);
@@ -463,4 +465,5 @@ build_new_loop(struct geometry *geo, struct game *game, gboolean trace)
 	if (!trace) {
 		destroy_loop(loop);
 	}
+	fences_benchmark_leave();
 }
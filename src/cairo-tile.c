@@ -19,6 +19,7 @@
 
 #include "geometry.h"
 #include "tiles.h"
+#include "lattice.h"
 
 
 
@@ -40,7 +41,7 @@
  * TRUE: rhomb is fully inside game area
  */
 static gboolean
-cairotile_is_tile_inside(struct point *vertex, int nvertex)
+cairotile_is_tile_inside(const struct point *vertex, int nvertex)
 {
 	int i;
 
@@ -54,19 +55,19 @@ cairotile_is_tile_inside(struct point *vertex, int nvertex)
 
 
 /*
- * Set vertex coordinates of rhombs in a unit
+ * Set vertex coordinates of pentagons in a unit (relative to unit position)
  */
 static void
-cairotile_fill_unit_with_tiles(struct geometry *geo, struct point *pos, double side)
+cairotile_fill_unit_with_tiles(struct lattice_face *faces, double side)
 {
-	struct point pts[5];
+	struct point *pts;
 	double half_side;
 	double height;
 	double shoulder_h;
 	double shoulder_w;
 	double lside;
 
-	/* pos is point on the x left and y middle of eye unit */
+	/* unit position is point on the x left and y middle of unit */
 	/* precalc some stuff */
 	lside= side/(sqrt(3.0) - 1.0);
 	shoulder_h= lside * sqrt(3.0)/2.0;
@@ -75,60 +76,84 @@ cairotile_fill_unit_with_tiles(struct geometry *geo, struct point *pos, double s
 	height= shoulder_h + lside/2.0;
 
 	/* left pentagon */
-	pts[0].x= pos->x;
-	pts[0].y= pos->y;
-	pts[1].x= pos->x;
-	pts[1].y= pos->y - side;
-	pts[2].x= pos->x + shoulder_h;
-	pts[2].y= pos->y - (shoulder_h + half_side);
-	pts[3].x= pos->x + height;
-	pts[3].y= pos->y - half_side;
-	pts[4].x= pos->x + shoulder_h;
-	pts[4].y= pos->y + lside/2.0;
-	if (cairotile_is_tile_inside(pts, 5))
-		geometry_add_tile(geo, pts, 5, NULL);
+	faces[0].nsides= 5;
+	pts= faces[0].pts;
+	pts[0].x= 0.;
+	pts[0].y= 0.;
+	pts[1].x= 0.;
+	pts[1].y= -side;
+	pts[2].x= shoulder_h;
+	pts[2].y= -(shoulder_h + half_side);
+	pts[3].x= height;
+	pts[3].y= -half_side;
+	pts[4].x= shoulder_h;
+	pts[4].y= lside/2.0;
 
 	/* top pentagon */
-	pts[0].x= pos->x + height;
-	pts[0].y= pos->y - half_side;
-	pts[1].x= pos->x + shoulder_h;
-	pts[1].y= pos->y - (shoulder_h + half_side);
-	pts[2].x= pos->x + (height + half_side);
-	pts[2].y= pos->y - (height + half_side);
-	pts[3].x= pos->x + (height + side + lside/2.0);
-	pts[3].y= pos->y - (shoulder_h + half_side);
-	pts[4].x= pos->x + (height + side);
-	pts[4].y= pos->y - half_side;
-	if (cairotile_is_tile_inside(pts, 5))
-		geometry_add_tile(geo, pts, 5, NULL);
+	faces[1].nsides= 5;
+	pts= faces[1].pts;
+	pts[0].x= height;
+	pts[0].y= -half_side;
+	pts[1].x= shoulder_h;
+	pts[1].y= -(shoulder_h + half_side);
+	pts[2].x= height + half_side;
+	pts[2].y= -(height + half_side);
+	pts[3].x= height + side + lside/2.0;
+	pts[3].y= -(shoulder_h + half_side);
+	pts[4].x= height + side;
+	pts[4].y= -half_side;
 
 	/* right pentagon */
-	pts[0].x= pos->x + (height + side);
-	pts[0].y= pos->y - half_side;
-	pts[1].x= pos->x + (height + side + lside/2.0);
-	pts[1].y= pos->y - (half_side + shoulder_h);
-	pts[2].x= pos->x + (2*height + side);
-	pts[2].y= pos->y - side;
-	pts[3].x= pos->x + (2*height + side);
-	pts[3].y= pos->y;
-	pts[4].x= pos->x + (shoulder_w + shoulder_h);
-	pts[4].y= pos->y + lside/2.0;
-	if (cairotile_is_tile_inside(pts, 5))
-		geometry_add_tile(geo, pts, 5, NULL);
+	faces[2].nsides= 5;
+	pts= faces[2].pts;
+	pts[0].x= height + side;
+	pts[0].y= -half_side;
+	pts[1].x= height + side + lside/2.0;
+	pts[1].y= -(half_side + shoulder_h);
+	pts[2].x= 2*height + side;
+	pts[2].y= -side;
+	pts[3].x= 2*height + side;
+	pts[3].y= 0.;
+	pts[4].x= shoulder_w + shoulder_h;
+	pts[4].y= lside/2.0;
 
 	/* bottom pentagon */
-	pts[0].x= pos->x + height;
-	pts[0].y= pos->y - half_side;
-	pts[1].x= pos->x + (height + side);
-	pts[1].y= pos->y - half_side;
-	pts[2].x= pos->x + (shoulder_w + shoulder_h);
-	pts[2].y= pos->y + lside/2.0;
-	pts[3].x= pos->x + (height + half_side);
-	pts[3].y= pos->y + lside;
-	pts[4].x= pos->x + shoulder_h;
-	pts[4].y= pos->y + lside/2.0;
-	if (cairotile_is_tile_inside(pts, 5))
-		geometry_add_tile(geo, pts, 5, NULL);
+	faces[3].nsides= 5;
+	pts= faces[3].pts;
+	pts[0].x= height;
+	pts[0].y= -half_side;
+	pts[1].x= height + side;
+	pts[1].y= -half_side;
+	pts[2].x= shoulder_w + shoulder_h;
+	pts[2].y= lside/2.0;
+	pts[3].x= height + half_side;
+	pts[3].y= lside;
+	pts[4].x= shoulder_h;
+	pts[4].y= lside/2.0;
+}
+
+
+/*
+ * Keep tiles of units in the board that are inside game area.
+ * Unit (i,j) is unit i + j/2 of row j.
+ */
+static gboolean
+cairotile_clip(int i, int j, int face, const struct point *pts, int npts,
+			   gpointer data)
+{
+	int *range=(int*)data;
+	int dimy=range[0];
+	int num_hex=range[1];
+	int col;
+
+	if (j < 0 || j > dimy) return FALSE;
+	col= i + j/2;
+	if (j == 0 || j == dimy) {
+		if (col < 1 || col > num_hex - 1) return FALSE;
+	} else {
+		if (col < 0 || col > num_hex) return FALSE;
+	}
+	return cairotile_is_tile_inside(pts, npts);
 }
 
 
@@ -155,22 +180,16 @@ struct geometry*
 build_cairo_tile_skeleton(const struct gameinfo *info)
 {
 	struct geometry *geo;
-	int i, j;
-	int i1, i2;
+	struct lattice lat;
+	struct lattice_face faces[4];
+	int range[2];
 	int num_hex;
 	int dimy;
 	double hex_size;
 	double side;
 	double lside;
 	double shift;
-	double xoffset;
 	double height;
-	int ntiles;
-	int nvertex;
-	int nlines;
-	double x0;
-	double y0;
-	struct point pos;
 	const int geo_params[5][3]= {	/* num of tiles, vertex, lines for all sizes */
 		{ 24,  52,  75},
 		{ 60, 116, 175},
@@ -190,44 +209,35 @@ build_cairo_tile_skeleton(const struct gameinfo *info)
 	height= lside*(sqrt(3.0) + 1.0)/2.0;
 	shift= height + side/2.0;
 
-	/* coordinates of unit on top left (center of unit coords) */
-	x0= CAIRO_BOARD_MARGIN - shift;
-	y0= CAIRO_BOARD_MARGIN + side/2.0;
-
-	/* create geometry with plenty of space for lines and vertex */
-	ntiles= geo_params[info->size][0];
-	nvertex= geo_params[info->size][1];
-	nlines= geo_params[info->size][2];
-	geo= geometry_create_new(ntiles, nvertex, nlines, 5);
+	/* 4 pentagons in each unit, odd rows shifted half a unit right */
+	cairotile_fill_unit_with_tiles(faces, side);
+	lat.origin.x= CAIRO_BOARD_MARGIN - shift;
+	lat.origin.y= CAIRO_BOARD_MARGIN + side/2.0;
+	lat.a.x= shift*2;
+	lat.a.y= 0.;
+	lat.b.x= shift;
+	lat.b.y= shift;
+	lat.nfaces= 4;
+	lat.faces= faces;
+	lat.imin= -dimy/2;
+	lat.imax= num_hex;
+	lat.jmin= 0;
+	lat.jmax= dimy;
+	range[0]= dimy;
+	range[1]= num_hex;
+	lat.clip= cairotile_clip;
+	lat.clip_data= range;
+	lat.max_numlines= 5;
+
+	geo= lattice_build_skeleton(&lat);
 	geo->board_size= CAIRO_BOARD_SIZE;
 	geo->board_margin= CAIRO_BOARD_MARGIN;
 	geo->game_size= CAIRO_BOARD_SIZE - 2*CAIRO_BOARD_MARGIN;
-	geometry_set_distance_resolution(side/10.0);
-
-	/* create rhombs (3 rhombs in each unit) */
-	geo->ntiles= 0;
-	geo->nlines= 0;
-	geo->nvertex= 0;
-	for(j=0; j <= dimy; ++j) {
-		pos.y= y0 + j * shift;
-		xoffset= (j % 2) * shift;
-		if (j == 0 || j == dimy) {
-			i1= 1;
-			i2= num_hex - 1;
-		} else {
-			i1= 0;
-			i2= num_hex;
-		}
-		for(i=i1; i <= i2; ++i) {
-			pos.x= x0 + xoffset + i * shift*2;
-			cairotile_fill_unit_with_tiles(geo, &pos, side);
-		}
-	}
 
-	/* make sure we didn't underestimate max numbers */
-	g_assert(geo->ntiles == ntiles);
-	g_assert(geo->nvertex == nvertex);
-	g_assert(geo->nlines == nlines);
+	/* sanity check: see if we got the numbers we expected */
+	g_assert(geo->ntiles == geo_params[info->size][0]);
+	g_assert(geo->nvertex == geo_params[info->size][1]);
+	g_assert(geo->nlines == geo_params[info->size][2]);
 
 	return geo;
 }
@@ -20,28 +20,151 @@
 
 #include <gtk/gtk.h>
 #include <gdk/gdkkeysyms.h>
+#include <math.h>
 
 #include "callbacks.h"
 #include "gamedata.h"
 #include "draw.h"
 #include "history.h"
+#include "hint.h"
+#include "checker.h"
 #include "gui.h"
+#include "view.h"
 
 
 
 /*
- * Callback when mouse is clicked on the board
+ * New state of a line with state 'state' when clicked with 'button'
+ * (-1 if button doesn't change lines)
  */
-gboolean
-drawarea_mouseclicked(GtkWidget *widget, GdkEventButton *event, gpointer user_data)
+static int
+line_clicked_state(int button, int state)
+{
+	switch(button) {
+		/* left button */
+		case 1:
+			return (state == LINE_ON) ? LINE_OFF : LINE_ON;
+		/* right button */
+		case 3:
+			return (state == LINE_CROSSED) ? LINE_OFF : LINE_CROSSED;
+	}
+	return -1;
+}
+
+
+/*
+ * Start a new stroke: forget lines changed by the last one and make room
+ * to mark every line of the board
+ */
+static void
+stroke_reset(struct line_stroke *stroke, int nlines)
 {
+	int id;
+	int i;
+
+	for(i=0; i < stroke->lines->len; ++i) {
+		id= g_array_index(stroke->lines, int, i);
+		stroke->changed[id/8]&= ~(1 << (id % 8));
+	}
+	g_array_set_size(stroke->lines, 0);
+
+	if (stroke->nlines < nlines) {
+		g_free(stroke->changed);
+		stroke->changed= (guint8*)g_malloc0((nlines + 7)/8);
+		stroke->nlines= nlines;
+	}
+}
+
+
+/*
+ * Change lines the pointer went through from p0 to p1 (board coords) that
+ * haven't been changed yet in current stroke.
+ * Changes are made as a single batch (one check of the neighbourhood, one
+ * redraw). In history, the whole stroke is a single group.
+ */
+static void
+stroke_change_lines(struct board *board, struct point *p0, struct point *p1)
+{
+	struct line_stroke *stroke=&board->stroke;
+	struct line_change change;
+	GArray *batch;
 	struct point point;
-	int tile;
-	GSList *list;
 	struct line *lin;
-	gboolean inside;
+	double step;
+	int nsteps;
+	int i;
+
+	/* sample segment at steps shorter than any line */
+	step= MIN(board->geo->tile_width, board->geo->tile_height)/4.;
+	nsteps= (int)ceil(sqrt((p1->x - p0->x)*(p1->x - p0->x) +
+						   (p1->y - p0->y)*(p1->y - p0->y))/step);
+
+	batch= g_array_new(FALSE, FALSE, sizeof(struct line_change));
+	for(i=0; i <= nsteps; ++i) {
+		point.x= p0->x + (nsteps ? (p1->x - p0->x)*i/nsteps : 0.);
+		point.y= p0->y + (nsteps ? (p1->y - p0->y)*i/nsteps : 0.);
+		lin= click_mesh_find_line(board->click_mesh, &point);
+		if (lin == NULL) continue;
+		/* each line changes only once in a stroke */
+		if (stroke->changed[lin->id/8] & (1 << (lin->id % 8))) continue;
+		stroke->changed[lin->id/8]|= 1 << (lin->id % 8);
+		g_array_append_val(stroke->lines, lin->id);
+
+		change.id= lin->id;
+		change.old_state= board->game->states[lin->id];
+		change.new_state= line_clicked_state(stroke->button, change.old_state);
+		change.group= (stroke->lines->len > 1);
+		/* record change in history */
+		history_record_change(board, &change);
+		g_array_append_val(batch, change);
+	}
+
+	if (batch->len > 0) {
+		/* make changes to lines */
+		make_line_changes(board, (struct line_change*)batch->data,
+						  batch->len);
+		/* schedule redraw of box containing lines */
+		view_queue_draw_clip(board, &board->game->clip);
+	}
+	g_array_free(batch, TRUE);
+}
+
+
+/*
+ * Callback when mouse button is released on the board: end of stroke or
+ * board drag
+ */
+gboolean
+drawarea_mouseclicked(GtkWidget *widget, GdkEventButton *event, gpointer user_data)
+{
 	struct board *board=(struct board*)user_data;
-	struct line_change change;
+
+	/* end of board drag */
+	if (event->button == 2) {
+		board->view.dragging= FALSE;
+		return TRUE;
+	}
+
+	/* end of stroke */
+	if (event->button == board->stroke.button)
+		board->stroke.button= 0;
+
+	return TRUE;
+}
+
+
+/*
+ * Callback when mouse button is pressed on the board: middle button
+ * starts dragging (panning) the board, left & right buttons start a
+ * stroke changing the line clicked and any other line the pointer goes
+ * through until the button is released.
+ */
+gboolean
+drawarea_mousepressed(GtkWidget *widget, GdkEventButton *event,
+					  gpointer user_data)
+{
+	struct board *board=(struct board*)user_data;
+	struct point point;
 
 	/* check game state to decide what to do */
 	if (board->game_state == GAMESTATE_FINISHED ||
@@ -49,60 +172,70 @@ drawarea_mouseclicked(GtkWidget *widget, GdkEventButton *event, gpointer user_da
 		//return TRUE;
 	}
 
-	/* Translate pixel coords to board coords */
-	point.x= event->x/board->width_pxscale;
-	point.y= event->y/board->height_pxscale;
-
-	/* Find in which tile the point falls */
-	tile= point.x / board->click_mesh->tile_size;
-	tile+= board->click_mesh->ntiles_side*(int)(point.y/board->click_mesh->tile_size);
-	//printf("mouse: Tile clicked %d\n", tile);
-	list= board->click_mesh->tiles[tile];
-
-	/* Find in which line's area of influence the point falls */
-	while(list != NULL) {
-		lin= (struct line *)list->data;
-		inside= is_point_inside_area(&point, lin->inf);
-		if (inside)
-			break;
-		list= g_slist_next(list);
+	if (event->button == 2) {
+		board->view.dragging= TRUE;
+		board->view.drag_x= event->x;
+		board->view.drag_y= event->y;
+		return TRUE;
 	}
 
-	/* check if a line was found */
-	if (list != NULL) {
-		//printf("mouse: - Line %d\n", lin->id);
-		change.id= lin->id;
-		change.old_state= board->game->states[lin->id];
-		switch(event->button) {
-			/* left button */
-			case 1:
-				change.new_state= (change.old_state == LINE_ON) ?
-					LINE_OFF : LINE_ON;
-				break;
-			/* right button */
-			case 3:
-				change.new_state= (change.old_state == LINE_CROSSED) ?
-					LINE_OFF : LINE_CROSSED;
-				break;
-		    default:
-				return TRUE;
-		}
+	/* ignore other buttons, double clicks and new strokes during a stroke */
+	if (event->type != GDK_BUTTON_PRESS || board->stroke.button != 0 ||
+		line_clicked_state(event->button, LINE_OFF) == -1)
+		return TRUE;
 
-		/* record change in history */
-		history_record_change(board, &change);
+	/* Translate pixel coords to board coords (through zoom & pan) */
+	view_pixel_to_board(board, event->x, event->y, &point);
+	board->stroke.button= event->button;
+	board->stroke.last= point;
+	stroke_reset(&board->stroke, board->geo->nlines);
+	stroke_change_lines(board, &point, &point);
+
+	return TRUE;
+}
 
-		/* make change to line */
-		make_line_change(board, &change);
 
-		/* schedule redraw of box containing line */
-		gtk_widget_queue_draw_area
-			(GTK_WIDGET(board->drawarea),
-			 (gint)(board->geo->clip.x*board->width_pxscale),
-			 (gint)(board->geo->clip.y*board->height_pxscale),
-			 (gint)(board->geo->clip.w*board->width_pxscale),
-			 (gint)(board->geo->clip.h*board->height_pxscale));
+/*
+ * Callback when mouse moves over the board: pan board if it's being
+ * dragged, or change lines crossed by stroke
+ */
+gboolean
+drawarea_mousemoved(GtkWidget *widget, GdkEventMotion *event,
+					gpointer user_data)
+{
+	struct board *board=(struct board*)user_data;
+	struct point point;
+
+	if (board->view.dragging) {
+		view_pan(board, event->x - board->view.drag_x,
+				 event->y - board->view.drag_y);
+		board->view.drag_x= event->x;
+		board->view.drag_y= event->y;
+		return TRUE;
+	}
+	if (board->stroke.button != 0) {
+		view_pixel_to_board(board, event->x, event->y, &point);
+		stroke_change_lines(board, &board->stroke.last, &point);
+		board->stroke.last= point;
+		return TRUE;
 	}
+	return FALSE;
+}
+
 
+/*
+ * Callback when mouse wheel is turned over the board: zoom at pointer
+ */
+gboolean
+drawarea_scrolled(GtkWidget *widget, GdkEventScroll *event,
+				  gpointer user_data)
+{
+	struct board *board=(struct board*)user_data;
+
+	if (event->direction == GDK_SCROLL_UP)
+		view_zoom_at(board, VIEW_ZOOM_STEP, event->x, event->y);
+	else if (event->direction == GDK_SCROLL_DOWN)
+		view_zoom_at(board, 1./VIEW_ZOOM_STEP, event->x, event->y);
 	return TRUE;
 }
 
@@ -124,23 +257,36 @@ window_keypressed(GtkWidget *widget, GdkEventKey *event, gpointer user_data)
 	}
 	if (event->keyval == GDK_l) {
 		build_new_loop(board->geo, board->game, TRUE);
+		gamedata_count_lines(board->geo, board->game);
+		history_save_snapshot(board);
+		checker_reset(board);
 		gtk_widget_queue_draw(drawarea);
 	}
 	if (event->keyval == GDK_S) {
 		test_solve_game(board->geo, board->game);
+		gamedata_count_lines(board->geo, board->game);
+		history_save_snapshot(board);
 		gtk_widget_queue_draw(drawarea);
 	}
 	if (event->keyval == GDK_s) {
 		test_solve_game_trace(board->geo, board->game);
+		gamedata_count_lines(board->geo, board->game);
+		history_save_snapshot(board);
 		gtk_widget_queue_draw(drawarea);
 	}
 	if (event->keyval == GDK_f) {
 		brute_force_test(board->geo, board->game);
+		gamedata_count_lines(board->geo, board->game);
+		history_save_snapshot(board);
 		gtk_widget_queue_draw(drawarea);
 	}
 	if (event->keyval == GDK_n) {
 		free_gamedata(board->game);
 		board->game= build_new_game(board->geo, 0);
+		history_clear(board->history);
+		history_start_journal(board);
+		checker_reset(board);
+		draw_invalidate_background();
 
 		gtk_widget_queue_draw(drawarea);
 	}
@@ -149,6 +295,36 @@ window_keypressed(GtkWidget *widget, GdkEventKey *event, gpointer user_data)
 		int i;
 		for(i=0; i < board->geo->nlines; ++i)
 			board->game->states[i]= LINE_OFF;
+		gamedata_count_lines(board->geo, board->game);
+		history_save_snapshot(board);
+		gtk_widget_queue_draw(drawarea);
+	}
+	/* travel in history: page steps, start, end, first wrong move, a
+	   while ago */
+	if (event->keyval == GDK_Page_Up)
+		history_travel_history(board, -HISTORY_PAGE_STEPS);
+	if (event->keyval == GDK_Page_Down)
+		history_travel_history(board, HISTORY_PAGE_STEPS);
+	if (event->keyval == GDK_Home)
+		history_jump_to_start(board);
+	if (event->keyval == GDK_End)
+		history_jump_to_end(board);
+	if (event->keyval == GDK_e)
+		history_jump_to_first_error(board);
+	if (event->keyval == GDK_t)
+		history_jump_to_time(board, time(NULL) - HISTORY_TIME_STEP);
+	/* zoom in/out at center of board, show whole board */
+	if (event->keyval == GDK_plus || event->keyval == GDK_KP_Add) {
+		view_zoom_at(board, VIEW_ZOOM_STEP, drawarea->allocation.width/2.,
+					 drawarea->allocation.height/2.);
+	}
+	if (event->keyval == GDK_minus || event->keyval == GDK_KP_Subtract) {
+		view_zoom_at(board, 1./VIEW_ZOOM_STEP,
+					 drawarea->allocation.width/2.,
+					 drawarea->allocation.height/2.);
+	}
+	if (event->keyval == GDK_0) {
+		view_reset(&board->view);
 		gtk_widget_queue_draw(drawarea);
 	}
 	if (event->keyval == GDK_D) {
@@ -184,7 +360,9 @@ drawarea_configure(GtkWidget *drawarea, GdkEventConfigure *event, gpointer user_
 	 * This has to be done after every window resize because the
 	 * accuracy of the measurements depends on the pixel size.
 	 */
-	draw_measure_font(drawarea, event->width, event->height, board->geo);
+	draw_measure_font(drawarea, event->width, event->height, board->geo,
+					  &board->metrics);
+	draw_invalidate_background();
 
 	return TRUE;
 }
@@ -217,12 +395,10 @@ board_expose(GtkWidget *drawarea, GdkEventExpose *event, gpointer data)
 					 event->area.width, event->area.height);
 	cairo_clip (cr);
 
-	/* set scale so we draw in board_size space */
-	cairo_scale (cr,
-				 drawarea->allocation.width/(double)board->geo->board_size,
-				 drawarea->allocation.height/(double)board->geo->board_size);
-
-	draw_board (cr, board->geo, board->game);
+	/* static layer comes from offscreen surface, rest is drawn on top */
+	draw_board_cached(cr, drawarea->allocation.width,
+					  drawarea->allocation.height, board->geo, board->game,
+					  board->spatial_index, &board->metrics, &board->view);
 
 	cairo_destroy (cr);
 
@@ -270,7 +446,9 @@ action_new_cb(GtkAction *action, gpointer data)
 	fencesgui_set_undoredo_state(board);
 	draw_measure_font(drawarea,
 					  drawarea->allocation.width,
-					  drawarea->allocation.height, board->geo);
+					  drawarea->allocation.height, board->geo,
+					  &board->metrics);
+	draw_invalidate_background();
 	gtk_widget_queue_draw(GTK_WIDGET(board->drawarea));
 }
 
@@ -297,7 +475,28 @@ action_clear_cb(GtkAction *action, gpointer data)
 void
 action_hint_cb(GtkAction *action, gpointer data)
 {
-	g_debug("hint action");
+	struct board *board=(struct board*)data;
+	struct hint *hint;
+
+	if (board->game == NULL) return;
+	/* solver context is built on first hint, then follows the game */
+	if (board->game->hints == NULL)
+		board->game->hints= hint_engine_new(board->geo, board->game);
+	/* previous hint goes away before its arrays are reused */
+	linechange_show_hint(board, NULL);
+	hint= hint_engine_find(board->game->hints);
+	linechange_show_hint(board, hint);
+}
+
+
+/*
+ * Menuitem 'Check Moves' toggled
+ */
+void
+action_check_cb(GtkAction *action, gpointer data)
+{
+	checker_set_enabled((struct board*)data,
+						gtk_toggle_action_get_active(GTK_TOGGLE_ACTION(action)));
 }
 
 
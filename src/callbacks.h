@@ -22,6 +22,12 @@
 
 gboolean drawarea_mouseclicked(GtkWidget *widget, GdkEventButton *event,
 			       gpointer drawarea);
+gboolean drawarea_mousepressed(GtkWidget *widget, GdkEventButton *event,
+							   gpointer user_data);
+gboolean drawarea_mousemoved(GtkWidget *widget, GdkEventMotion *event,
+							 gpointer user_data);
+gboolean drawarea_scrolled(GtkWidget *widget, GdkEventScroll *event,
+						   gpointer user_data);
 gboolean window_keypressed(GtkWidget *widget, GdkEventKey *event, gpointer user_data);
 gboolean drawarea_configure(GtkWidget *widget, GdkEventConfigure *event,
 			    gpointer user_data);
@@ -32,6 +38,7 @@ void action_redo_cb(GtkAction *action, gpointer data);
 void action_new_cb(GtkAction *action, gpointer data);
 void action_clear_cb(GtkAction *action, gpointer data);
 void action_hint_cb(GtkAction *action, gpointer data);
+void action_check_cb(GtkAction *action, gpointer data);
 void action_about_cb(GtkAction *action, gpointer data);
 
 
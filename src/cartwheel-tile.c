@@ -22,6 +22,7 @@
 
 #include "geometry.h"
 #include "tiles.h"
+#include "cyclotomic.h"
 
 
 /* prefered board dimensions for cartwheel tile */
@@ -39,35 +40,48 @@ enum {
 // angle increases clockwise
 struct kite {
 	int type;			// kite or dart
-	struct point pos;	// coords of kite/dart tip
-	double side;		// length of side
-	double angle;		// angle of kite (0=horizontal/right; pi/2: down)
-	struct point center;
+	struct cyclo pos;	// exact coords of kite/dart tip
+	int scale;			// length of side is RATIO^scale (in units of final side)
+	int angle;			// angle of kite in 18 degree steps (0=horizontal/right; 5: down)
+	struct cyclo key;	// sum of the 4 vertices (identifies kite)
 };
 
 // store parameters to be used to generate puzzle tile
 struct puzzle_params {
 	double side;
-	double seed_side;
 	int nfolds;
 	int seed_type;
-	struct point pos;
+	int parity;			// parity of directions of sides (see cyclotomic.h)
 };
 
 
 #define RATIO		1.6180339887
 #define D2R(x)		((x)/180.0*M_PI)
-#define WRAP(x)		x= ((x) > 2.*M_PI) ? (x) -  2.*M_PI : (x)
 
 
 
-static void draw_cartwheel_tile(GSList *cartwheel);
-static void get_kite_vertices(struct kite *kite, struct point *vertex);
+static void draw_cartwheel_tile(GSList *cartwheel, struct cyclo_frame *frame);
+static void get_kite_vertices(struct kite *kite, struct cyclo_frame *frame,
+							  struct point *vertex);
 
 
-/* contains minimum distance required to consider two vertices different */
-static double separate_distance=0.;
 
+/*
+ * Add new kite or dart to list and return list
+ */
+static GSList*
+cartwheel_add_kite(GSList *newcartwheel, int type, struct cyclo *pos,
+				   int scale, int angle)
+{
+	struct kite *nkite;
+
+	nkite= (struct kite *)g_malloc(sizeof(struct kite));
+	nkite->type= type;
+	nkite->pos= *pos;
+	nkite->scale= scale;
+	nkite->angle= (angle % CYCLO_NUM_DIRS + CYCLO_NUM_DIRS) % CYCLO_NUM_DIRS;
+	return g_slist_prepend(newcartwheel, nkite);
+}
 
 
 /*
@@ -75,85 +89,35 @@ static double separate_distance=0.;
  * Add new kites & darts to list newcartwheel and return it
  */
 static GSList*
-cartwheel_unfold_kite(GSList *newcartwheel, struct kite *kite)
+cartwheel_unfold_kite(GSList *newcartwheel, struct kite *kite, int parity)
 {
-	struct kite *nkite;
-	double nside=kite->side/RATIO;
-	double middle=nside*cos(D2R(36));
+	struct cyclo pos;
+	int a=kite->angle;
+	int s=kite->scale;
 
 	g_assert(kite->type == KITE);
 
 	/* create new dart 1/6 (at tip) */
-	nkite= (struct kite *)g_malloc(sizeof(struct kite));
-	nkite->type= DART;
-	nkite->pos.x= kite->pos.x;
-	nkite->pos.y= kite->pos.y;
-	nkite->side= nside;
-	nkite->angle= kite->angle - D2R(36);
-	WRAP(nkite->angle);
-	nkite->center.x= nkite->pos.x + middle/2.0 * cos(nkite->angle);
-	nkite->center.y= nkite->pos.y + middle/2.0 * sin(nkite->angle);
-	newcartwheel= g_slist_prepend(newcartwheel, nkite);
+	newcartwheel= cartwheel_add_kite(newcartwheel, DART, &kite->pos, s - 1, a - 2);
 
 	/* next dart kite 2/6 (at tip) */
-	nkite= (struct kite *)g_malloc(sizeof(struct kite));
-	nkite->type= DART;
-	nkite->pos.x= kite->pos.x;
-	nkite->pos.y= kite->pos.y;
-	nkite->side= nside;
-	nkite->angle= kite->angle + D2R(36);
-	WRAP(nkite->angle);
-	nkite->center.x= nkite->pos.x + middle/2.0 * cos(nkite->angle);
-	nkite->center.y= nkite->pos.y + middle/2.0 * sin(nkite->angle);
-	newcartwheel= g_slist_prepend(newcartwheel, nkite);
+	newcartwheel= cartwheel_add_kite(newcartwheel, DART, &kite->pos, s - 1, a + 2);
 
 	/* next kite (top) 3/6 */
-	nkite= (struct kite *)g_malloc(sizeof(struct kite));
-	nkite->type= KITE;
-	nkite->pos.x= kite->pos.x + kite->side * cos(kite->angle - D2R(36));
-	nkite->pos.y= kite->pos.y + kite->side * sin(kite->angle - D2R(36));
-	nkite->side= nside;
-	nkite->angle= kite->angle + D2R(90 + (90 - 72));
-	WRAP(nkite->angle);
-	nkite->center.x= nkite->pos.x + middle*3.0/4.0 * cos(nkite->angle);
-	nkite->center.y= nkite->pos.y + middle*3.0/4.0 * sin(nkite->angle);
-	newcartwheel= g_slist_prepend(newcartwheel, nkite);
+	pos= kite->pos;
+	cyclo_step(&pos, a - 2, parity, s);
+	newcartwheel= cartwheel_add_kite(newcartwheel, KITE, &pos, s - 1, a + 6);
 
 	/* next kite (top) 4/6 */
-	nkite= (struct kite *)g_malloc(sizeof(struct kite));
-	nkite->type= KITE;
-	nkite->pos.x= kite->pos.x + kite->side * cos(kite->angle - D2R(36));
-	nkite->pos.y= kite->pos.y + kite->side * sin(kite->angle - D2R(36));
-	nkite->side= nside;
-	nkite->angle= kite->angle + D2R(180);
-	WRAP(nkite->angle);
-	nkite->center.x= nkite->pos.x + middle*3.0/4.0 * cos(nkite->angle);
-	nkite->center.y= nkite->pos.y + middle*3.0/4.0 * sin(nkite->angle);
-	newcartwheel= g_slist_prepend(newcartwheel, nkite);
+	newcartwheel= cartwheel_add_kite(newcartwheel, KITE, &pos, s - 1, a + 10);
 
 	/* next kite (bottom) 5/6 */
-	nkite= (struct kite *)g_malloc(sizeof(struct kite));
-	nkite->type= KITE;
-	nkite->pos.x= kite->pos.x + kite->side * cos(kite->angle + D2R(36));
-	nkite->pos.y= kite->pos.y + kite->side * sin(kite->angle + D2R(36));
-	nkite->side= nside;
-	nkite->angle= kite->angle - D2R(90 + (90 - 72));
-	WRAP(nkite->angle);
-	nkite->center.x= nkite->pos.x + middle*3.0/4.0 * cos(nkite->angle);
-	nkite->center.y= nkite->pos.y + middle*3.0/4.0 * sin(nkite->angle);
-	newcartwheel= g_slist_prepend(newcartwheel, nkite);
+	pos= kite->pos;
+	cyclo_step(&pos, a + 2, parity, s);
+	newcartwheel= cartwheel_add_kite(newcartwheel, KITE, &pos, s - 1, a - 6);
 
 	/* next kite (bottom) 6/6 */
-	nkite= (struct kite *)g_malloc(sizeof(struct kite));
-	nkite->type= KITE;
-	nkite->pos.x= kite->pos.x + kite->side * cos(kite->angle + D2R(36));
-	nkite->pos.y= kite->pos.y + kite->side * sin(kite->angle + D2R(36));
-	nkite->side= nside;
-	nkite->angle= kite->angle - D2R(180);
-	WRAP(nkite->angle);
-	nkite->center.x= nkite->pos.x + middle*3.0/4.0 * cos(nkite->angle);
-	nkite->center.y= nkite->pos.y + middle*3.0/4.0 * sin(nkite->angle);
-	newcartwheel= g_slist_prepend(newcartwheel, nkite);
+	newcartwheel= cartwheel_add_kite(newcartwheel, KITE, &pos, s - 1, a - 10);
 
 	return newcartwheel;
 }
@@ -164,127 +128,131 @@ cartwheel_unfold_kite(GSList *newcartwheel, struct kite *kite)
  * Add new kites &darts to list newcartwheel and return it
  */
 static GSList*
-cartwheel_unfold_dart(GSList *newcartwheel, struct kite *dart)
+cartwheel_unfold_dart(GSList *newcartwheel, struct kite *dart, int parity)
 {
-	struct kite *nkite;
-	double nside=dart->side/RATIO;
-	double middle=nside*cos(D2R(36));
+	struct cyclo pos;
+	int a=dart->angle;
+	int s=dart->scale;
 
 	g_assert(dart->type == DART);
 
 	/* create new kite 1/5 (at tip) */
-	nkite= (struct kite *)g_malloc(sizeof(struct kite));
-	nkite->type= KITE;
-	nkite->pos.x= dart->pos.x;
-	nkite->pos.y= dart->pos.y;
-	nkite->side= nside;
-	nkite->angle= dart->angle;
-	//WRAP(nkite->angle);
-	nkite->center.x= nkite->pos.x + middle*3.0/4.0 * cos(nkite->angle);
-	nkite->center.y= nkite->pos.y + middle*3.0/4.0 * sin(nkite->angle);
-	newcartwheel= g_slist_prepend(newcartwheel, nkite);
+	newcartwheel= cartwheel_add_kite(newcartwheel, KITE, &dart->pos, s - 1, a);
 
 	/* create new kite 2/5 (at tip) */
-	nkite= (struct kite *)g_malloc(sizeof(struct kite));
-	nkite->type= KITE;
-	nkite->pos.x= dart->pos.x;
-	nkite->pos.y= dart->pos.y;
-	nkite->side= nside;
-	nkite->angle= dart->angle - D2R(72);
-	WRAP(nkite->angle);
-	nkite->center.x= nkite->pos.x + middle*3.0/4.0 * cos(nkite->angle);
-	nkite->center.y= nkite->pos.y + middle*3.0/4.0 * sin(nkite->angle);
-	newcartwheel= g_slist_prepend(newcartwheel, nkite);
+	newcartwheel= cartwheel_add_kite(newcartwheel, KITE, &dart->pos, s - 1, a - 4);
 
 	/* create new kite 3/5 (at tip) */
-	nkite= (struct kite *)g_malloc(sizeof(struct kite));
-	nkite->type= KITE;
-	nkite->pos.x= dart->pos.x;
-	nkite->pos.y= dart->pos.y;
-	nkite->side= nside;
-	nkite->angle= dart->angle + D2R(72);
-	WRAP(nkite->angle);
-	nkite->center.x= nkite->pos.x + middle*3.0/4.0 * cos(nkite->angle);
-	nkite->center.y= nkite->pos.y + middle*3.0/4.0 * sin(nkite->angle);
-	newcartwheel= g_slist_prepend(newcartwheel, nkite);
+	newcartwheel= cartwheel_add_kite(newcartwheel, KITE, &dart->pos, s - 1, a + 4);
 
 	/* next dart 4/5 */
-	nkite= (struct kite *)g_malloc(sizeof(struct kite));
-	nkite->type= DART;
-	nkite->pos.x= dart->pos.x + dart->side * cos(dart->angle - D2R(36));
-	nkite->pos.y= dart->pos.y + dart->side * sin(dart->angle - D2R(36));
-	nkite->side= nside;
-	nkite->angle= dart->angle + D2R(90 + (90 - 36));
-	WRAP(nkite->angle);
-	nkite->center.x= nkite->pos.x + middle/2.0 * cos(nkite->angle);
-	nkite->center.y= nkite->pos.y + middle/2.0 * sin(nkite->angle);
-	newcartwheel= g_slist_prepend(newcartwheel, nkite);
+	pos= dart->pos;
+	cyclo_step(&pos, a - 2, parity, s);
+	newcartwheel= cartwheel_add_kite(newcartwheel, DART, &pos, s - 1, a + 8);
 
 	/* next dart 5/5 */
-	nkite= (struct kite *)g_malloc(sizeof(struct kite));
-	nkite->type= DART;
-	nkite->pos.x= dart->pos.x + dart->side * cos(dart->angle + D2R(36));
-	nkite->pos.y= dart->pos.y + dart->side * sin(dart->angle + D2R(36));
-	nkite->side= nside;
-	nkite->angle= dart->angle - D2R(90 + (90 - 36));
-	WRAP(nkite->angle);
-	nkite->center.x= nkite->pos.x + middle/2.0 * cos(nkite->angle);
-	nkite->center.y= nkite->pos.y + middle/2.0 * sin(nkite->angle);
-	newcartwheel= g_slist_prepend(newcartwheel, nkite);
+	pos= dart->pos;
+	cyclo_step(&pos, a + 2, parity, s);
+	newcartwheel= cartwheel_add_kite(newcartwheel, DART, &pos, s - 1, a - 8);
 
 	return newcartwheel;
 }
 
 
+/*
+ * Return exact coordinates of vertices of kite
+ * Opposite vertex to tip is at distance side (kite) or side/RATIO (dart)
+ */
+static void
+get_kite_exact_vertices(struct kite *kite, int parity, struct cyclo *vertex)
+{
+	int a=kite->angle;
+
+	vertex[0]= kite->pos;
+	vertex[1]= kite->pos;
+	cyclo_step(vertex + 1, a - 2, parity, kite->scale);
+	vertex[2]= kite->pos;
+	if (kite->type == KITE) {
+		cyclo_step(vertex + 2, a, parity, kite->scale);
+	} else {		// DART
+		cyclo_step(vertex + 2, a, parity, kite->scale - 1);
+	}
+	vertex[3]= kite->pos;
+	cyclo_step(vertex + 3, a + 2, parity, kite->scale);
+}
+
+
+/*
+ * Hash and compare functions for kites: two kites of the same type are
+ * the same if the sum of their vertices is the same.
+ */
+static guint
+kite_hash(gconstpointer kite)
+{
+	const struct kite *k=(const struct kite*)kite;
+
+	return cyclo_hash(&k->key)*2 + k->type;
+}
+
+static gboolean
+kite_equal(gconstpointer kite1, gconstpointer kite2)
+{
+	const struct kite *k1=(const struct kite*)kite1;
+	const struct kite *k2=(const struct kite*)kite2;
+
+	return k1->type == k2->type && cyclo_equal(&k1->key, &k2->key);
+}
+
+
 /*
  * Eliminate repeated kites & darts in the list
+ * Kites are identified exactly by the sum of their vertices, so a hash
+ * table finds repetitions in one pass.
  * Returns new trimmed list
  */
-GSList *
-trim_repeated_kites(GSList *cartwheel)
+static GSList *
+trim_repeated_kites(GSList *cartwheel, int parity)
 {
+	GHashTable *table;
 	GSList *current;
 	GSList *next;
-	GSList *p;
-	struct kite *r1, *r2;
-	struct point c;
+	struct kite *kite;
+	struct cyclo vertex[4];
+	int i;
 
+	table= g_hash_table_new(kite_hash, kite_equal);
 	current= cartwheel;
 	while(current != NULL) {
-		p= g_slist_next(current);
-		r1= (struct kite*)current->data;
-		/* iterate over rest of kites */
-		while(p != NULL) {
-			r2= (struct kite*)p->data;
-			if (r1->type != r2->type) { // not same type, next
-				p= g_slist_next(p);
-				continue;
-			}
-			/* calculate dist between centers of both kites */
-			c.x= r2->center.x - r1->center.x;
-			c.y= r2->center.y - r1->center.y;
-			if ((c.x*c.x + c.y*c.y) < separate_distance ) { // same kite
-				//g_debug("delete kite, dist: %lf < %lf", dist, r1->side/10.);
-				g_free(p->data);
-				next= g_slist_next(p);
-				cartwheel= g_slist_delete_link(cartwheel, p);
-				p= next;
-			} else {
-				p= g_slist_next(p);
-			}
+		kite= (struct kite*)current->data;
+		next= g_slist_next(current);
+
+		get_kite_exact_vertices(kite, parity, vertex);
+		kite->key= vertex[0];
+		for(i=1; i < 4; ++i)
+			cyclo_add(&kite->key, vertex + i);
+
+		if (g_hash_table_lookup(table, kite) != NULL) { // same kite
+			g_free(kite);
+			cartwheel= g_slist_delete_link(cartwheel, current);
+		} else {
+			g_hash_table_insert(table, kite, kite);
 		}
-		current= g_slist_next(current);
+		current= next;
 	}
+	g_hash_table_destroy(table);
+
 	return cartwheel;
 }
 
 
 /*
  * Eliminate kites outside a certain radius
+ * Vertices are placed exactly on the radius by design, so allow for the
+ * rounding of converting exact points to board coordinates.
  * Returns new trimmed list
  */
 static GSList *
-trim_outside_kites(GSList *cartwheel, double radius)
+trim_outside_kites(GSList *cartwheel, struct cyclo_frame *frame, double radius)
 {
 	GSList *current;
 	GSList *next;
@@ -298,13 +266,13 @@ trim_outside_kites(GSList *cartwheel, double radius)
 	while(current != NULL) {
 		kite= (struct kite*) current->data;
 
-		get_kite_vertices(kite, vertex);
+		get_kite_vertices(kite, frame, vertex);
 		next= g_slist_next(current);
 		for(i=0; i < 4; ++i) {
 			vertex[i].x-= center;
 			vertex[i].y-= center;
 			dist= sqrt(vertex[i].x*vertex[i].x + vertex[i].y*vertex[i].y);
-			if (dist > radius) {
+			if (dist > radius + frame->unit/1000.) {
 				g_free(current->data);
 				cartwheel= g_slist_delete_link(cartwheel, current);
 				break;
@@ -320,7 +288,7 @@ trim_outside_kites(GSList *cartwheel, double radius)
  * Unfold current list of darts
  */
 static GSList*
-cartwheel_unfold(GSList* cartwheel, double edge)
+cartwheel_unfold(GSList* cartwheel, struct cyclo_frame *frame, double edge)
 {
 	GSList *newcartwheel=NULL;
 	struct kite *kite;
@@ -329,10 +297,12 @@ cartwheel_unfold(GSList* cartwheel, double edge)
 		kite= (struct kite*)cartwheel->data;
 		switch(kite->type) {
 		case KITE:
-			newcartwheel= cartwheel_unfold_kite(newcartwheel, kite);
+			newcartwheel= cartwheel_unfold_kite(newcartwheel, kite,
+												frame->parity);
 			break;
 		case DART:
-			newcartwheel= cartwheel_unfold_dart(newcartwheel, kite);
+			newcartwheel= cartwheel_unfold_dart(newcartwheel, kite,
+												frame->parity);
 			break;
 		default:
 			g_debug("cartwheel_unfold: unknown kite type: %d", kite->type);
@@ -342,13 +312,11 @@ cartwheel_unfold(GSList* cartwheel, double edge)
 	}
 
 	/* get rid of repeated kites */
-	separate_distance= ((struct kite*)newcartwheel->data)->side/10.;
-	separate_distance*= separate_distance;
-	newcartwheel= trim_repeated_kites(newcartwheel);
+	newcartwheel= trim_repeated_kites(newcartwheel, frame->parity);
 
 	/* get rid of kites outside a certain radius */
 	if (edge > 0)
-		newcartwheel= trim_outside_kites(newcartwheel, edge);
+		newcartwheel= trim_outside_kites(newcartwheel, frame, edge);
 
 	/* debug: count number of kites in list */
 	g_debug("kites in list: %d", g_slist_length(newcartwheel));
@@ -361,23 +329,33 @@ cartwheel_unfold(GSList* cartwheel, double edge)
  * Return coordinates of vertices of kite
  */
 static void
-get_kite_vertices(struct kite *kite, struct point *vertex)
+get_kite_vertices(struct kite *kite, struct cyclo_frame *frame,
+				  struct point *vertex)
 {
-	double length;
-
-	vertex[0].x= kite->pos.x;
-	vertex[0].y= kite->pos.y;
-	vertex[1].x= kite->pos.x + kite->side*cos(kite->angle - D2R(36));
-	vertex[1].y= kite->pos.y + kite->side*sin(kite->angle - D2R(36));
-	vertex[3].x= kite->pos.x + kite->side*cos(kite->angle + D2R(36));
-	vertex[3].y= kite->pos.y + kite->side*sin(kite->angle + D2R(36));
-	if (kite->type == KITE) {
-		length= kite->side*cos(D2R(36)) + kite->side/RATIO*sin(D2R(18));
-	} else {		// DART
-		length= kite->side*cos(D2R(36)) - kite->side/RATIO*sin(D2R(18));
-	}
-	vertex[2].x= kite->pos.x + length * cos(kite->angle);
-	vertex[2].y= kite->pos.y + length * sin(kite->angle);
+	struct cyclo exact[4];
+	int i;
+
+	get_kite_exact_vertices(kite, frame->parity, exact);
+	for(i=0; i < 4; ++i)
+		cyclo_to_point(frame, exact + i, vertex + i);
+}
+
+
+/*
+ * Return center of kite (where number is drawn)
+ */
+static void
+get_kite_center(struct kite *kite, struct cyclo_frame *frame,
+				struct point *center)
+{
+	double middle;
+
+	middle= frame->unit*pow(RATIO, kite->scale)*cos(D2R(36));
+	if (kite->type == KITE) middle*= 3.0/4.0;
+	else middle/= 2.0;
+	cyclo_to_point(frame, &kite->pos, center);
+	center->x+= middle*cos(D2R(18*kite->angle));
+	center->y+= middle*sin(D2R(18*kite->angle));
 }
 
 
@@ -397,102 +375,121 @@ cartwheel_calculate_sizes(struct geometry *geo, int size_index)
 }
 
 
+/*
+ * Hash and compare functions for exact vertex positions
+ */
+static guint
+vertex_hash(gconstpointer pos)
+{
+	return cyclo_hash((const struct cyclo*)pos);
+}
+
+static gboolean
+vertex_equal(gconstpointer pos1, gconstpointer pos2)
+{
+	return cyclo_equal((const struct cyclo*)pos1, (const struct cyclo*)pos2);
+}
+
+
 /*
  * Transform list of darts to geometry data
+ * Shared vertices are found by exact position, so the number of vertices
+ * is known before the geometry is created.
  */
 static struct geometry*
-cartwheel_tile_to_skeleton(GSList *cartwheel, double side)
+cartwheel_tile_to_skeleton(GSList *cartwheel, struct cyclo_frame *frame)
 {
 	struct geometry *geo;
 	GSList *list;
-	struct point pts[4];
-	int i;
+	GHashTable *table;
+	struct cyclo *cvertex;
+	struct cyclo exact[4];
+	int *vids;
+	gpointer id;
+	struct point pos;
+	int i, j;
 	int ntiles;
-	int nvertex;
+	int nvertex=0;
 	int nlines;
-	struct kite *kite;
 
-	/* create new geometry (ntiles, nvertex, nlines) */
-	/* NOTE: oversize nvertex and nlines. Will adjust below
-	   Oversize factors determined by trial and error. */
+	/* find unique vertices (exact positions) */
 	ntiles= g_slist_length(cartwheel);
-	nvertex= ntiles*4;//(int)(ntiles*1.5);
-	nlines= ntiles*4;//(int)(ntiles*2.5);
+	cvertex= (struct cyclo*)g_malloc(4*ntiles*sizeof(struct cyclo));
+	vids= (int*)g_malloc(4*ntiles*sizeof(int));
+	table= g_hash_table_new(vertex_hash, vertex_equal);
+	list= cartwheel;
+	for(i=0; i < ntiles; ++i) {
+		get_kite_exact_vertices((struct kite*)list->data, frame->parity, exact);
+		for(j=0; j < 4; ++j) {
+			if (g_hash_table_lookup_extended(table, exact + j, NULL, &id)) {
+				vids[4*i + j]= GPOINTER_TO_INT(id);
+			} else {
+				cvertex[nvertex]= exact[j];
+				vids[4*i + j]= nvertex;
+				g_hash_table_insert(table, cvertex + nvertex,
+									GINT_TO_POINTER(nvertex));
+				++nvertex;
+			}
+		}
+		list= g_slist_next(list);
+	}
+	g_hash_table_destroy(table);
+
+	/* create new geometry (ntiles, nvertex, nlines) */
+	/* NOTE: oversize nlines (each line touches at least one tile).
+	   Will adjust below */
+	nlines= ntiles*4;
 	geo= geometry_create_new(ntiles, nvertex, nlines, 4);
 	geo->board_size= CARTWHEEL_BOARD_SIZE;
 	geo->board_margin= CARTWHEEL_BOARD_MARGIN;
 	geo->game_size= geo->board_size - 2*geo->board_margin;
-	geometry_set_distance_resolution(side/10.0);
-
 
 	/* iterate through tiles creating skeleton geometry
 	   (skeleton geometry: lines hold all the topology info) */
 	geo->ntiles= 0;
 	geo->nlines= 0;
 	geo->nvertex= 0;
+	for(i=0; i < nvertex; ++i) {
+		cyclo_to_point(frame, cvertex + i, &pos);
+		geometry_new_vertex(geo, &pos);
+	}
 	list= cartwheel;
 	for(i=0; i < ntiles; ++i) {
-		/* get vertices of tile (rhomb) and add it to skeleton geometry */
-		kite= (struct kite*)list->data;
-		get_kite_vertices((struct kite*)list->data, pts);
-		geometry_add_tile(geo, pts, 4, &kite->center);
-
+		get_kite_center((struct kite*)list->data, frame, &pos);
+		geometry_add_tile_indexed(geo, vids + 4*i, 4, &pos);
 		list= g_slist_next(list);
 	}
+	g_free(cvertex);
+	g_free(vids);
 
 	/* make sure we didn't underestimate max numbers */
-	g_assert(geo->ntiles <= ntiles);
-	g_assert(geo->nvertex <= nvertex);
 	g_assert(geo->nlines <= nlines);
 
-	/* realloc to actual number of vertices and lines */
-	geo->vertex= g_realloc(geo->vertex, geo->nvertex*sizeof(struct vertex));
+	/* realloc to actual number of lines */
 	geo->lines= g_realloc(geo->lines, geo->nlines*sizeof(struct line));
 
-	/*printf("ntiles: %d (%d) %d\n", geo->ntiles, ntiles);
-	printf("nvertex: %d (%d) %d\n", geo->nvertex, nvertex);
-	printf("nlines: %d (%d) %d\n", geo->nlines, nlines);*/
-
 	return geo;
 }
 
 
 /*
- * Create arrow seed.
- * at POS, with SIDE and at ANGLE.
+ * Create arrow seed at exact position POS, with side RATIO^SCALE and
+ * at ANGLE (in 18 degree steps).
  */
 static GSList*
-create_arrow_seed(struct point *pos, double angle, double side)
+create_arrow_seed(struct cyclo *pos, int angle, int scale, int parity)
 {
 	GSList *cartwheel=NULL;
-	struct kite *kite;
+	struct cyclo kpos;
 
 	/* dart on tip */
-	kite= (struct kite*)g_malloc(sizeof(struct kite));
-	kite->type= DART;
-	kite->side= side;
-	kite->angle= D2R(angle);
-	kite->pos.x= pos->x;
-	kite->pos.y= pos->y;
-	cartwheel= g_slist_prepend(cartwheel, kite);
-
-	/* top kite */
-	kite= (struct kite*)g_malloc(sizeof(struct kite));
-	kite->type= KITE;
-	kite->side= side;
-	kite->angle= D2R(angle + 180 + 36);
-	kite->pos.x= pos->x + (side + side/RATIO);
-	kite->pos.y= pos->y;
-	cartwheel= g_slist_prepend(cartwheel, kite);
-
-	/* bottom kite */
-	kite= (struct kite*)g_malloc(sizeof(struct kite));
-	kite->type= KITE;
-	kite->side= side;
-	kite->angle= D2R(angle + 180 - 36);
-	kite->pos.x= pos->x + (side + side/RATIO);
-	kite->pos.y= pos->y;
-	cartwheel= g_slist_prepend(cartwheel, kite);
+	cartwheel= cartwheel_add_kite(cartwheel, DART, pos, scale, angle);
+
+	/* top and bottom kites: tip is at (side + side/RATIO) = side*RATIO */
+	kpos= *pos;
+	cyclo_step(&kpos, angle, parity, scale + 1);
+	cartwheel= cartwheel_add_kite(cartwheel, KITE, &kpos, scale, angle + 12);
+	cartwheel= cartwheel_add_kite(cartwheel, KITE, &kpos, scale, angle + 8);
 
 	return cartwheel;
 }
@@ -500,35 +497,29 @@ create_arrow_seed(struct point *pos, double angle, double side)
 
 /*
  * Define seed to generate cartwheel tile
- * Input 'side' is size of initial kites and darts size
+ * Seed kites have side RATIO^nfolds so the final kites have side 1.
  */
 static GSList*
 create_tile_seed(struct puzzle_params *params, int size_index)
 {
 	GSList *cartwheel=NULL;
-	struct kite *kite;
-	struct point pos;
+	struct cyclo pos;
 	int i;
 
-	pos.x= params->pos.x;
-	pos.y= params->pos.y;
-
+	cyclo_zero(&pos);
 	switch (size_index) {
 	case 0:
-		cartwheel= create_arrow_seed(&pos, 0.0, params->seed_side);
+		/* arrow is moved left by seed side */
+		cyclo_step(&pos, 10, params->parity, params->nfolds);
+		cartwheel= create_arrow_seed(&pos, 0, params->nfolds, params->parity);
 		break;
 	case 1:
 	case 2:
 	case 3:
 	case 4:
 		for(i=0; i < 5; ++i) {
-			kite= (struct kite*)g_malloc(sizeof(struct kite));
-			kite->type= params->seed_type;
-			kite->side= params->seed_side;
-			kite->angle= D2R(i*72-90);
-			kite->pos.x= pos.x;
-			kite->pos.y= pos.y;
-			cartwheel= g_slist_prepend(cartwheel, kite);
+			cartwheel= cartwheel_add_kite(cartwheel, params->seed_type, &pos,
+										  params->nfolds, i*4 - 5);
 		}
 		break;
 	default:
@@ -558,21 +549,18 @@ cartwheel_calculate_params(int size_index, struct puzzle_params *params)
 	 *   Heigth of kite is == LONG
 	 */
 	params->side= CARTWHEEL_GAME_SIZE/2.0;
-	params->pos.x= CARTWHEEL_BOARD_SIZE/2.;
-	params->pos.y= CARTWHEEL_BOARD_SIZE/2.;
 	params->seed_type= KITE;	// only useful for some sizes
+	params->parity= 1;			// seed at odd multiple of 18 degrees
 	switch(size_index) {
 	case 0:		/* small */
 		params->nfolds= 2;
 		params->side/= (4 + 2.0/RATIO)/2.0;
-		params->pos.x-= params->side*pow(RATIO, params->nfolds);
+		params->parity= 0;		// arrow seed is horizontal
 		break;
 	case 1:		/* medium */
 		params->nfolds= 3;
 		params->side/= 2.0 + 2.0/RATIO;
 		params->seed_type= KITE;
-		//params->pos.x+= 2.5*params->side;
-		//params->pos.y-= params->side*13.0/16.0;
 		break;
 	case 2:		/* normal */
 		params->nfolds= 3;
@@ -592,8 +580,6 @@ cartwheel_calculate_params(int size_index, struct puzzle_params *params)
 	default:
 		g_message("(cartwheel_calculate_params) unknown cartwheel size: %d", size_index);
 	}
-	/* calculate side of big seed */
-	params->seed_side= params->side*pow(RATIO, params->nfolds);
 }
 
 
@@ -605,6 +591,8 @@ build_cartwheel_tile_skeleton(const struct gameinfo *info)
 {
 	GSList *cartwheel=NULL;
 	struct geometry *geo;
+	struct cyclo_frame frame;
+	struct point origin;
 	int i;
 	double edge;
 	int size_index=info->size;
@@ -613,6 +601,11 @@ build_cartwheel_tile_skeleton(const struct gameinfo *info)
 	/* get side size and number of folds */
 	cartwheel_calculate_params(size_index, &params);
 
+	/* exact coordinates are measured in units of final side from center */
+	origin.x= CARTWHEEL_BOARD_SIZE/2.;
+	origin.y= CARTWHEEL_BOARD_SIZE/2.;
+	cyclo_frame_init(&frame, params.parity, params.side, &origin);
+
 	/* Create the seed (increase size to account for foldings) */
 	cartwheel= create_tile_seed(&params, size_index);
 
@@ -621,14 +614,14 @@ build_cartwheel_tile_skeleton(const struct gameinfo *info)
 		if (i == params.nfolds - 1) edge= CARTWHEEL_GAME_SIZE/2.0;
 		else if (i > 1 && i == params.nfolds - 2) edge= CARTWHEEL_GAME_SIZE/1.5;
 		else edge= CARTWHEEL_GAME_SIZE;
-		cartwheel= cartwheel_unfold(cartwheel, edge);
+		cartwheel= cartwheel_unfold(cartwheel, &frame, edge);
 	}
 
 	/* draw to file */
-	//draw_cartwheel_tile(cartwheel);
+	//draw_cartwheel_tile(cartwheel, &frame);
 
 	/* transform tile into geometry data (points, lines & tiles) */
-	geo= cartwheel_tile_to_skeleton(cartwheel, params.side);
+	geo= cartwheel_tile_to_skeleton(cartwheel, &frame);
 
 	/* free dart and kites data */
 	while (cartwheel != NULL) {
@@ -665,7 +658,7 @@ build_cartwheel_tile_geometry(const struct gameinfo *info)
  * Draw tile to png file (for debug purposes only)
  */
 static void
-draw_cartwheel_tile(GSList *cartwheel)
+draw_cartwheel_tile(GSList *cartwheel, struct cyclo_frame *frame)
 {
 	const char filename[]="cartwheel.png";
 	const int width=500;
@@ -688,7 +681,7 @@ draw_cartwheel_tile(GSList *cartwheel)
 
 	while(cartwheel != NULL) {
 		kite= (struct kite*)cartwheel->data;
-		get_kite_vertices(kite, pts);
+		get_kite_vertices(kite, frame, pts);
 		cairo_move_to(cr, pts[0].x, pts[0].y);
 		for(i= 1; i < 4 ; ++i) {
 			cairo_line_to(cr, pts[i].x, pts[i].y);
@@ -0,0 +1,614 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+#include <string.h>
+#include <gtk/gtk.h>
+
+#include "i18n.h"
+#include "gamedata.h"
+#include "game-solver.h"
+#include "loop-tracker.h"
+#include "checker.h"
+#include "gui.h"
+
+
+/*
+ * Background move checker.
+ * Player's moves are sent (copied) to a low priority worker thread through
+ * a queue, so the main thread never waits for it. The worker takes all the
+ * moves queued at once and checks only the resulting board: a burst of
+ * moves costs a single check.
+ * A board is inconsistent when cheap propagation (solver rules that set
+ * forced lines) leads to an invalid game (solve_check_valid_game) or to a
+ * closed loop that can't be the solution.
+ * The worker keeps the last board known to be consistent and the moves
+ * made after it. When the board becomes inconsistent, the boards in
+ * between are checked by bisection to find the move that broke it. Result
+ * is passed to the main thread in an idle callback.
+ */
+
+/* maximum propagation rounds in a check */
+#define CHECKER_MAX_ROUNDS	256
+
+
+/* Kinds of message sent to worker */
+enum {
+	CHECKER_MSG_RESET,		/* new board to check (or none) */
+	CHECKER_MSG_MOVE,		/* player's move */
+	CHECKER_MSG_QUIT		/* worker must finish */
+};
+
+
+/*
+ * Message sent to worker
+ */
+struct checker_msg {
+	int kind;				// kind of message
+	guint generation;		// board the message belongs to (RESET)
+	struct geometry *geo;	// geometry (reference from cache) (RESET)
+	int *numbers;			// tile numbers (RESET)
+	int *states;			// line states (RESET)
+	int nchanges;			// number of line changes (MOVE)
+	struct line_change *changes;	// line changes (MOVE)
+};
+
+
+/*
+ * Line change in a move checked by worker
+ */
+struct checker_change {
+	guint move;				// move number (first move after reset is 1)
+	int id;					// line changed
+	int state;				// new state of line
+};
+
+
+/*
+ * Stores checker data.
+ * Fields are used by the main thread or the worker only, except for
+ * those under 'lock'.
+ */
+struct checker {
+	/* main thread */
+	struct board *board;	// board whose moves are checked
+	gboolean enabled;		// are moves being checked?
+	struct game *game;		// game sent to worker in last reset
+	guint generation;		// number of resets sent
+	GThread *thread;		// worker thread (NULL if not started)
+	GAsyncQueue *queue;		// messages to worker
+
+	/* worker */
+	struct geometry *geo;	// geometry of board checked (NULL: none)
+	guint worker_generation;	// board being checked
+	int *numbers;			// tile numbers
+	struct solution *sol;	// solver context used in checks
+	struct loop_tracker *loops;	// loops formed after propagation
+	int *current;			// line states after last move
+	int *good;				// line states after last consistent move
+	int *states;			// line states being checked
+	gboolean good_known;	// has a consistent board been seen?
+	guint good_move;		// move of last consistent board
+	guint last_move;		// last move received
+	GArray *log;			// changes made after last consistent board
+	guint reported_move;	// move in last published result
+
+	/* shared */
+	GMutex *lock;			// protects fields below
+	guint result_generation;	// board the result belongs to
+	guint result_move;		// inconsistent move (G_MAXUINT: none)
+	GArray *result_lines;	// lines changed by inconsistent move
+	GSList *release;		// geometries to release in main thread
+	guint report_id;		// idle source reporting result (0: none)
+};
+
+
+
+/*
+ * Free message sent to worker
+ */
+static void
+checker_free_msg(struct checker_msg *msg)
+{
+	g_free(msg->numbers);
+	g_free(msg->states);
+	g_free(msg->changes);
+	g_free(msg);
+}
+
+
+/*
+ * Main thread: show result of worker (idle callback)
+ */
+static gboolean
+checker_report_cb(gpointer data)
+{
+	struct checker *checker=(struct checker*)data;
+	struct board *board=checker->board;
+	GSList *release;
+	GSList *list;
+	GString *text;
+	guint move;
+	int i;
+
+	gdk_threads_enter();
+	g_mutex_lock(checker->lock);
+	release= checker->release;
+	checker->release= NULL;
+	checker->report_id= 0;
+	move= checker->result_move;
+	text= NULL;
+	if (checker->enabled && checker->result_generation == checker->generation &&
+		move != G_MAXUINT) {
+		text= g_string_new(NULL);
+		if (move == 0)
+			g_string_printf(text, _("Board has no solution"));
+		else
+			g_string_printf(text, _("Move %u leaves no solution:"), move);
+		for(i=0; i < checker->result_lines->len; ++i)
+			g_string_append_printf(text, " %d",
+								   g_array_index(checker->result_lines, int, i));
+	}
+	g_mutex_unlock(checker->lock);
+
+	/* geometries the worker is done with */
+	for(list=release; list != NULL; list=g_slist_next(list))
+		geometry_cache_release((struct geometry*)list->data);
+	g_slist_free(release);
+
+	fencesgui_set_status(board, (text != NULL) ? text->str : NULL);
+	if (text != NULL) {
+		g_debug("checker: %s", text->str);
+		g_string_free(text, TRUE);
+	}
+	gdk_threads_leave();
+	return FALSE;
+}
+
+
+/*
+ * Worker: have result (or released geometries) sent to main thread
+ * (must hold lock)
+ */
+static void
+checker_queue_report(struct checker *checker)
+{
+	if (checker->report_id == 0)
+		checker->report_id= g_idle_add(checker_report_cb, checker);
+}
+
+
+/*
+ * Worker: publish inconsistent move (G_MAXUINT: board is fine)
+ */
+static void
+checker_publish(struct checker *checker, guint move)
+{
+	struct checker_change *change;
+	int i;
+
+	if (move == checker->reported_move) return;
+	checker->reported_move= move;
+
+	g_mutex_lock(checker->lock);
+	checker->result_generation= checker->worker_generation;
+	checker->result_move= move;
+	g_array_set_size(checker->result_lines, 0);
+	for(i=0; i < checker->log->len; ++i) {
+		change= &g_array_index(checker->log, struct checker_change, i);
+		if (change->move == move)
+			g_array_append_val(checker->result_lines, change->id);
+	}
+	checker_queue_report(checker);
+	g_mutex_unlock(checker->lock);
+}
+
+
+/*
+ * Worker: forget board being checked (geometry is released by main thread)
+ */
+static void
+checker_drop_board(struct checker *checker)
+{
+	if (checker->geo == NULL) return;
+	g_mutex_lock(checker->lock);
+	checker->release= g_slist_prepend(checker->release, checker->geo);
+	checker_queue_report(checker);
+	g_mutex_unlock(checker->lock);
+
+	solve_free_solution_data(checker->sol);
+	loop_tracker_destroy(checker->loops);
+	g_free(checker->numbers);
+	g_free(checker->current);
+	g_free(checker->good);
+	g_free(checker->states);
+	checker->geo= NULL;
+	checker->sol= NULL;
+	checker->loops= NULL;
+	checker->numbers= NULL;
+	checker->current= checker->good= checker->states= NULL;
+}
+
+
+/*
+ * Worker: start checking a new board
+ */
+static void
+checker_take_board(struct checker *checker, struct checker_msg *msg)
+{
+	struct game numbers;
+	int nlines;
+
+	checker_drop_board(checker);
+	checker->worker_generation= msg->generation;
+	checker->reported_move= G_MAXUINT;
+	g_array_set_size(checker->log, 0);
+	checker->good_known= FALSE;
+	checker->good_move= checker->last_move= 0;
+	if (msg->geo == NULL) return;
+
+	checker->geo= msg->geo;
+	nlines= checker->geo->nlines;
+	checker->numbers= msg->numbers;
+	checker->current= msg->states;
+	msg->numbers= msg->states= NULL;
+	checker->good= (int*)g_malloc(nlines*sizeof(int));
+	checker->states= (int*)g_malloc(nlines*sizeof(int));
+	memcpy(checker->good, checker->current, nlines*sizeof(int));
+	/* solver only needs tile numbers from game */
+	numbers.numbers= checker->numbers;
+	checker->sol= solve_create_solution_data(checker->geo, &numbers);
+	checker->sol->game= NULL;
+	checker->loops= loop_tracker_new(checker->geo);
+}
+
+
+/*
+ * Worker: apply move to current board
+ */
+static void
+checker_take_move(struct checker *checker, struct checker_msg *msg)
+{
+	struct checker_change change;
+	int i;
+
+	if (checker->geo == NULL) return;
+	change.move= ++checker->last_move;
+	for(i=0; i < msg->nchanges; ++i) {
+		change.id= msg->changes[i].id;
+		change.state= msg->changes[i].new_state;
+		checker->current[change.id]= change.state;
+		g_array_append_val(checker->log, change);
+	}
+}
+
+
+/*
+ * Worker: does a closed loop rule out every solution?
+ * A closed loop must be the whole solution: no other ON lines and every
+ * number satisfied.
+ */
+static gboolean
+checker_loops_ok(struct checker *checker)
+{
+	struct solution *sol=checker->sol;
+	struct loop_tracker *loops=checker->loops;
+	int i;
+
+	loop_tracker_clear(loops);
+	for(i=0; i < checker->geo->nlines; ++i)
+		if (sol->states[i] == LINE_ON)
+			loop_tracker_set_line(loops, i, TRUE);
+	if (loops->nloops == 0) return TRUE;
+	if (!loop_tracker_is_single_loop(loops)) return FALSE;
+	for(i=0; i < checker->geo->ntiles; ++i)
+		if (sol->numbers[i] != -1 && sol->tile_count[i].on != sol->numbers[i])
+			return FALSE;
+	return TRUE;
+}
+
+
+/*
+ * Worker: can board (line states) still lead to a solution?
+ * Returns FALSE if propagating forced lines shows it can't.
+ */
+static gboolean
+checker_is_consistent(struct checker *checker, const int *states)
+{
+	struct solution *sol=checker->sol;
+	struct geometry *geo=checker->geo;
+	int round;
+	int nchanges;
+	int i;
+
+	/* seed solver context */
+	solve_reset_solution(sol);
+	for(i=0; i < geo->nlines; ++i) {
+		if (states[i] == LINE_ON)
+			solve_set_line_on(sol, geo->lines + i);
+		else if (states[i] == LINE_CROSSED)
+			solve_set_line_cross(sol, geo->lines + i);
+	}
+
+	/* propagate forced lines */
+	for(round=0; round < CHECKER_MAX_ROUNDS; ++round) {
+		if (!solve_check_valid_game(sol)) return FALSE;
+		solve_cross_lines(sol);
+		nchanges= sol->nchanges;
+		solve_trivial_vertex(sol);
+		nchanges+= sol->nchanges;
+		solve_trivial_tiles(sol);
+		nchanges+= sol->nchanges;
+		if (nchanges == 0) break;
+	}
+	if (!solve_check_valid_game(sol)) return FALSE;
+
+	return checker_loops_ok(checker);
+}
+
+
+/*
+ * Worker: line states after given move (move after last consistent one)
+ */
+static void
+checker_states_at(struct checker *checker, guint move)
+{
+	struct checker_change *change;
+	int i;
+
+	memcpy(checker->states, checker->good, checker->geo->nlines*sizeof(int));
+	for(i=0; i < checker->log->len; ++i) {
+		change= &g_array_index(checker->log, struct checker_change, i);
+		if (change->move > move) break;
+		checker->states[change->id]= change->state;
+	}
+}
+
+
+/*
+ * Worker: make given move the last consistent one
+ */
+static void
+checker_advance_good(struct checker *checker, guint move)
+{
+	struct checker_change *change;
+	int i;
+
+	for(i=0; i < checker->log->len; ++i) {
+		change= &g_array_index(checker->log, struct checker_change, i);
+		if (change->move > move) break;
+		checker->good[change->id]= change->state;
+	}
+	g_array_remove_range(checker->log, 0, i);
+	checker->good_move= move;
+	checker->good_known= TRUE;
+}
+
+
+/*
+ * Worker: check current board. If it's inconsistent, find the first move
+ * that made it so (bisecting moves after last consistent board).
+ */
+static void
+checker_check(struct checker *checker)
+{
+	guint lo, hi, mid;
+
+	if (checker_is_consistent(checker, checker->current)) {
+		checker_advance_good(checker, checker->last_move);
+		checker_publish(checker, G_MAXUINT);
+		return;
+	}
+	/* board given at reset is already inconsistent */
+	if (!checker->good_known) {
+		checker_publish(checker, 0);
+		return;
+	}
+
+	/* board after 'lo' is fine, board after 'hi' is not */
+	lo= checker->good_move;
+	hi= checker->last_move;
+	while(hi - lo > 1) {
+		mid= lo + (hi - lo)/2;
+		checker_states_at(checker, mid);
+		if (checker_is_consistent(checker, checker->states))
+			lo= mid;
+		else
+			hi= mid;
+	}
+	checker_advance_good(checker, lo);
+	checker_publish(checker, hi);
+}
+
+
+/*
+ * Worker thread: take every message queued, then check resulting board
+ */
+static gpointer
+checker_worker(gpointer data)
+{
+	struct checker *checker=(struct checker*)data;
+	struct checker_msg *msg;
+	gboolean quit=FALSE;
+
+	while(!quit) {
+		msg= (struct checker_msg*)g_async_queue_pop(checker->queue);
+		while(msg != NULL) {
+			switch(msg->kind) {
+				case CHECKER_MSG_RESET:
+					checker_take_board(checker, msg);
+				break;
+				case CHECKER_MSG_MOVE:
+					checker_take_move(checker, msg);
+				break;
+				case CHECKER_MSG_QUIT:
+					quit= TRUE;
+				break;
+			}
+			checker_free_msg(msg);
+			if (quit) break;
+			msg= (struct checker_msg*)g_async_queue_try_pop(checker->queue);
+		}
+		if (!quit && checker->geo != NULL)
+			checker_check(checker);
+	}
+	checker_drop_board(checker);
+	return NULL;
+}
+
+
+/*
+ * Create checker for board (worker is started when checker is enabled)
+ */
+struct checker*
+checker_create(struct board *board)
+{
+	struct checker *checker;
+
+	checker= (struct checker*)g_malloc0(sizeof(struct checker));
+	checker->board= board;
+	checker->queue= g_async_queue_new();
+	checker->log= g_array_new(FALSE, FALSE, sizeof(struct checker_change));
+	checker->lock= g_mutex_new();
+	checker->result_move= G_MAXUINT;
+	checker->result_lines= g_array_new(FALSE, FALSE, sizeof(int));
+	return checker;
+}
+
+
+/*
+ * Stop worker and free checker
+ */
+void
+checker_destroy(struct checker *checker)
+{
+	struct checker_msg *msg;
+	GSList *list;
+
+	if (checker->thread != NULL) {
+		msg= (struct checker_msg*)g_malloc0(sizeof(struct checker_msg));
+		msg->kind= CHECKER_MSG_QUIT;
+		g_async_queue_push(checker->queue, msg);
+		g_thread_join(checker->thread);
+	}
+	/* messages worker didn't get to */
+	while((msg= (struct checker_msg*)g_async_queue_try_pop(checker->queue))
+		  != NULL) {
+		if (msg->geo != NULL) geometry_cache_release(msg->geo);
+		checker_free_msg(msg);
+	}
+	if (checker->report_id != 0) g_source_remove(checker->report_id);
+	for(list=checker->release; list != NULL; list=g_slist_next(list))
+		geometry_cache_release((struct geometry*)list->data);
+	g_slist_free(checker->release);
+
+	g_async_queue_unref(checker->queue);
+	g_array_free(checker->log, TRUE);
+	g_array_free(checker->result_lines, TRUE);
+	g_mutex_free(checker->lock);
+	g_free(checker);
+}
+
+
+/*
+ * Send board in its current state to worker (or no board at all)
+ */
+static void
+checker_send_board(struct board *board, gboolean empty)
+{
+	struct checker *checker=board->checker;
+	struct checker_msg *msg;
+	struct geometry *geo;
+
+	msg= (struct checker_msg*)g_malloc0(sizeof(struct checker_msg));
+	msg->kind= CHECKER_MSG_RESET;
+	msg->generation= ++checker->generation;
+	checker->game= board->game;
+	if (!empty && board->game != NULL) {
+		/* worker keeps a reference to geometry until it's done with it */
+		geo= geometry_cache_acquire(&board->gameinfo);
+		if (geo == board->geo) {
+			msg->geo= geo;
+			msg->numbers= (int*)g_malloc(geo->ntiles*sizeof(int));
+			memcpy(msg->numbers, board->game->numbers, geo->ntiles*sizeof(int));
+			msg->states= (int*)g_malloc(geo->nlines*sizeof(int));
+			memcpy(msg->states, board->game->states, geo->nlines*sizeof(int));
+		} else if (geo != NULL)
+			geometry_cache_release(geo);
+	}
+	g_async_queue_push(checker->queue, msg);
+	fencesgui_set_status(board, NULL);
+}
+
+
+/*
+ * Board has changed other than by a move (new game, lines set directly,
+ * ...): check it from scratch
+ */
+void
+checker_reset(struct board *board)
+{
+	if (board->checker == NULL || !board->checker->enabled) return;
+	checker_send_board(board, FALSE);
+}
+
+
+/*
+ * Send player's move to worker
+ */
+void
+checker_post_changes(struct board *board,
+					 const struct line_change *changes, int nchanges)
+{
+	struct checker *checker=board->checker;
+	struct checker_msg *msg;
+
+	if (checker == NULL || !checker->enabled || nchanges == 0) return;
+	if (checker->game != board->game) checker_reset(board);
+	msg= (struct checker_msg*)g_malloc0(sizeof(struct checker_msg));
+	msg->kind= CHECKER_MSG_MOVE;
+	msg->nchanges= nchanges;
+	msg->changes= (struct line_change*)
+		g_malloc(nchanges*sizeof(struct line_change));
+	memcpy(msg->changes, changes, nchanges*sizeof(struct line_change));
+	g_async_queue_push(checker->queue, msg);
+}
+
+
+/*
+ * Switch checking of moves on/off. Worker thread is started the first
+ * time checker is switched on.
+ */
+void
+checker_set_enabled(struct board *board, gboolean enabled)
+{
+	struct checker *checker=board->checker;
+	GError *error=NULL;
+
+	if (enabled && checker->thread == NULL) {
+		checker->thread= g_thread_create_full(checker_worker, checker, 0, TRUE,
+											  FALSE, G_THREAD_PRIORITY_LOW,
+											  &error);
+		if (checker->thread == NULL) {
+			g_warning("checker: can't create thread: %s", error->message);
+			g_error_free(error);
+			return;
+		}
+	}
+	if (checker->thread == NULL || checker->enabled == enabled) return;
+	checker->enabled= enabled;
+	/* worker drops board when switched off */
+	checker_send_board(board, !enabled);
+}
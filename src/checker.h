@@ -0,0 +1,32 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+#ifndef __INCLUDED_CHECKER_H__
+#define __INCLUDED_CHECKER_H__
+
+
+/*
+ * Functions
+ */
+struct checker* checker_create(struct board *board);
+void checker_destroy(struct checker *checker);
+void checker_set_enabled(struct board *board, gboolean enabled);
+void checker_reset(struct board *board);
+void checker_post_changes(struct board *board,
+						  const struct line_change *changes, int nchanges);
+
+
+#endif
@@ -15,12 +15,18 @@
  */
 
 #include <glib.h>
+#include <math.h>
 
 #include "gamedata.h"
+#include "benchmark.h"
 
 
-#define WIDTH_MESH	10
-#define SIZE_MESH			WIDTH_MESH*WIDTH_MESH
+/* average number of lines per mesh tile (sets mesh resolution) */
+#define LINES_PER_MESH_TILE		2
+
+/* limits of mesh resolution (tiles per side) */
+#define MIN_MESH_SIDE			1
+#define MAX_MESH_SIDE			1024
 
 
 
@@ -30,61 +36,129 @@
 void
 click_mesh_destroy(struct click_mesh *click_mesh)
 {
-	int i;
-
-	for(i=0; i < click_mesh->ntiles; ++i) {
-		/* free list of lines for tile i */
-		g_slist_free(click_mesh->tiles[i]);
-	}
-	g_free(click_mesh->tiles);
+	g_free(click_mesh->start);
+	g_free(click_mesh->lines);
 	g_free(click_mesh);
 }
 
 
+/*
+ * Range of mesh tiles (columns c0..c1, rows r0..r1) touched by bounding
+ * box of a line's area of influence
+ */
+static void
+click_mesh_tile_range(const struct click_mesh *click_mesh,
+					  const struct line *lin, int *c0, int *r0, int *c1, int *r1)
+{
+	const struct infarea *infarea=&lin->infarea;
+
+	*c0= (int)floor(infarea->tl.x/click_mesh->tile_size);
+	*r0= (int)floor(infarea->tl.y/click_mesh->tile_size);
+	*c1= (int)floor(infarea->br.x/click_mesh->tile_size);
+	*r1= (int)floor(infarea->br.y/click_mesh->tile_size);
+	*c0= CLAMP(*c0, 0, click_mesh->ntiles_side - 1);
+	*r0= CLAMP(*r0, 0, click_mesh->ntiles_side - 1);
+	*c1= CLAMP(*c1, 0, click_mesh->ntiles_side - 1);
+	*r1= CLAMP(*r1, 0, click_mesh->ntiles_side - 1);
+}
+
+
 /*
  * Initialize click mesh (list of lines in each mesh tile):
- * The board is divided in NxN squares
- * on the game board
+ * The board is divided in NxN squares, N chosen so there are about
+ * LINES_PER_MESH_TILE lines in each square.
+ * Each line is only tested against the mesh tiles its area of influence
+ * (bounding box) touches.
  */
 struct click_mesh*
 click_mesh_setup(const struct geometry *geo)
 {
 	int l, b;
+	int c0, r0, c1, r1;
+	int c, r;
 	struct line *lin;
 	struct point edge[2];
-	gboolean inside;
 	struct click_mesh *click_mesh;
-	GSList **tiles;
+	GArray *found;		// pairs (mesh tile, line id) found
+	int *pair;
+	int *pos;
 
+	fences_benchmark_enter("click-mesh");
 	/* new click_mesh */
 	click_mesh= (struct click_mesh*)g_malloc(sizeof(struct click_mesh));
-	click_mesh->ntiles_side= WIDTH_MESH;
+	click_mesh->ntiles_side= (int)ceil(sqrt(geo->nlines/
+											(double)LINES_PER_MESH_TILE));
+	click_mesh->ntiles_side= CLAMP(click_mesh->ntiles_side, MIN_MESH_SIDE,
+								   MAX_MESH_SIDE);
 	click_mesh->ntiles= click_mesh->ntiles_side * click_mesh->ntiles_side;
 	click_mesh->tile_size= geo->board_size / click_mesh->ntiles_side;
 
-	/* Initialize line status vector */
-	tiles= (GSList **) g_malloc0(click_mesh->ntiles * sizeof(GSList *));
-	// **TODO** handle mem error
-	click_mesh->tiles= tiles;
-
-	/* Iterate through the mesh: build list of lines in each tile */
-	for(b=0; b < SIZE_MESH; ++b) {
-		edge[0].x= (b % click_mesh->ntiles_side) * click_mesh->tile_size;
-		edge[0].y= (b / click_mesh->ntiles_side) * click_mesh->tile_size;
-		edge[1].x= edge[0].x + click_mesh->tile_size;
-		edge[1].y= edge[0].y + click_mesh->tile_size;
-		lin= geo->lines;
-		for(l=0; l < geo->nlines; ++l) {
-			/* check if line's area of influence intersects the box */
-			inside= is_area_inside_box(lin->inf, edge);
-			if (inside) {
-				//printf("box %d (%lf,%lf;%lf,%lf): add line %d  (%lf,%lf)\n", b,
-				//	   edge[0].x,edge[0].y, edge[1].x, edge[1].y, l,
-				//	   lin->ends[0]->pos.x, lin->ends[0]->pos.y);
-				tiles[b]= g_slist_prepend(tiles[b], lin);
+	/* find mesh tiles intersected by each line's area of influence */
+	click_mesh->start= (int*)g_malloc0((click_mesh->ntiles + 1)*sizeof(int));
+	found= g_array_sized_new(FALSE, FALSE, 2*sizeof(int), 4*geo->nlines);
+	lin= geo->lines;
+	for(l=0; l < geo->nlines; ++l) {
+		click_mesh_tile_range(click_mesh, lin, &c0, &r0, &c1, &r1);
+		for(r=r0; r <= r1; ++r) {
+			for(c=c0; c <= c1; ++c) {
+				edge[0].x= c * click_mesh->tile_size;
+				edge[0].y= r * click_mesh->tile_size;
+				edge[1].x= edge[0].x + click_mesh->tile_size;
+				edge[1].y= edge[0].y + click_mesh->tile_size;
+				if (!is_area_inside_box(&lin->infarea, edge)) continue;
+				b= r*click_mesh->ntiles_side + c;
+				g_array_set_size(found, found->len + 1);
+				pair= &g_array_index(found, int, 2*(found->len - 1));
+				pair[0]= b;
+				pair[1]= l;
+				/* count (shifted by one, see prefix sum) */
+				++click_mesh->start[b + 1];
 			}
-			++lin;
 		}
+		++lin;
+	}
+
+	/* store lines sorted by mesh tile */
+	for(b=0; b < click_mesh->ntiles; ++b)
+		click_mesh->start[b + 1]+= click_mesh->start[b];
+	click_mesh->lines= (struct line**)
+		g_malloc((found->len + 1)*sizeof(struct line*));
+	pos= (int*)g_malloc(click_mesh->ntiles*sizeof(int));
+	for(b=0; b < click_mesh->ntiles; ++b)
+		pos[b]= click_mesh->start[b];
+	for(l=0; l < found->len; ++l) {
+		pair= &g_array_index(found, int, 2*l);
+		click_mesh->lines[pos[pair[0]]++]= geo->lines + pair[1];
 	}
+	g_free(pos);
+	g_array_free(found, TRUE);
+
+	fences_benchmark_leave();
 	return click_mesh;
 }
+
+
+/*
+ * Find line whose area of influence contains point (board coords).
+ * Returns NULL if point isn't close to any line.
+ */
+struct line*
+click_mesh_find_line(const struct click_mesh *click_mesh, struct point *point)
+{
+	struct line *lin;
+	int c, r, b;
+	int i;
+
+	c= (int)floor(point->x/click_mesh->tile_size);
+	r= (int)floor(point->y/click_mesh->tile_size);
+	if (c < 0 || c >= click_mesh->ntiles_side ||
+		r < 0 || r >= click_mesh->ntiles_side)
+		return NULL;
+	b= r*click_mesh->ntiles_side + c;
+	for(i=click_mesh->start[b]; i < click_mesh->start[b + 1]; ++i) {
+		lin= click_mesh->lines[i];
+		if (is_point_inside_area(point, &lin->infarea, lin->inf))
+			return lin;
+	}
+	return NULL;
+}
@@ -0,0 +1,208 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+#include <glib.h>
+#include <math.h>
+
+#include "geometry.h"
+#include "cyclotomic.h"
+
+
+#define D2R(x)		((x)/180.0*M_PI)
+
+
+/*
+ * Set point to zero
+ */
+void
+cyclo_zero(struct cyclo *z)
+{
+	z->c[0]= z->c[1]= z->c[2]= z->c[3]= 0;
+}
+
+
+/*
+ * Add 'a' to 'z' (z+= a)
+ */
+void
+cyclo_add(struct cyclo *z, const struct cyclo *a)
+{
+	z->c[0]+= a->c[0];
+	z->c[1]+= a->c[1];
+	z->c[2]+= a->c[2];
+	z->c[3]+= a->c[3];
+}
+
+
+/*
+ * Multiply two points: z= a * b
+ * Powers of w above 3 are reduced using the minimal polynomial of w:
+ *  w^4 = w^3 - w^2 + w - 1  ;  w^5 = -1  ;  w^6 = -w
+ * 'z' may be the same as 'a' or 'b'
+ */
+void
+cyclo_mul(struct cyclo *z, const struct cyclo *a, const struct cyclo *b)
+{
+	int p[7];
+	int i, j;
+
+	for(i=0; i < 7; ++i) p[i]= 0;
+	for(i=0; i < 4; ++i) {
+		for(j=0; j < 4; ++j)
+			p[i + j]+= a->c[i] * b->c[j];
+	}
+	z->c[0]= p[0] - p[4] - p[5];
+	z->c[1]= p[1] + p[4] - p[6];
+	z->c[2]= p[2] - p[4];
+	z->c[3]= p[3] + p[4];
+}
+
+
+/*
+ * Set 'z' to the n-th power of the golden ratio (n may be negative)
+ * Uses RATIO^n = F(n+1) + F(n)*RATIO' (Fibonacci numbers), where
+ * RATIO= 1 + w^2 - w^3
+ */
+void
+cyclo_ratio_power(struct cyclo *z, int n)
+{
+	int a=0;	// F(k)
+	int b=1;	// F(k+1)
+	int tmp;
+
+	while (n > 0) {
+		tmp= a + b;
+		a= b;
+		b= tmp;
+		--n;
+	}
+	while (n < 0) {
+		tmp= b - a;
+		b= a;
+		a= tmp;
+		++n;
+	}
+	z->c[0]= b;
+	z->c[1]= 0;
+	z->c[2]= a;
+	z->c[3]= -a;
+}
+
+
+/*
+ * Add to 'z' a vector of length RATIO^scale pointing in direction 'dir'
+ * 'dir' is measured in steps of 18 degrees and must have the same parity
+ * as the frame ('parity').
+ */
+void
+cyclo_step(struct cyclo *z, int dir, int parity, int scale)
+{
+	struct cyclo unit;
+	struct cyclo len;
+	int k;
+
+	g_assert(((dir - parity) & 1) == 0);
+
+	/* unit vector: w^k, with w^5 = -1 */
+	k= (((dir - parity)/2) % 10 + 10) % 10;
+	cyclo_zero(&unit);
+	if (k % 5 == 4) {
+		unit.c[0]= -1;
+		unit.c[1]= 1;
+		unit.c[2]= -1;
+		unit.c[3]= 1;
+	} else {
+		unit.c[k % 5]= 1;
+	}
+	if (k >= 5) {
+		unit.c[0]= -unit.c[0];
+		unit.c[1]= -unit.c[1];
+		unit.c[2]= -unit.c[2];
+		unit.c[3]= -unit.c[3];
+	}
+
+	if (scale != 0) {
+		cyclo_ratio_power(&len, scale);
+		cyclo_mul(&unit, &unit, &len);
+	}
+	cyclo_add(z, &unit);
+}
+
+
+/*
+ * Are both points the same?
+ */
+gboolean
+cyclo_equal(const struct cyclo *a, const struct cyclo *b)
+{
+	return a->c[0] == b->c[0] && a->c[1] == b->c[1] &&
+		a->c[2] == b->c[2] && a->c[3] == b->c[3];
+}
+
+
+/*
+ * Hash value of point (to be used in hash tables)
+ */
+guint
+cyclo_hash(const struct cyclo *z)
+{
+	guint h;
+
+	h= (guint)z->c[0];
+	h= h*31 + (guint)z->c[1];
+	h= h*31 + (guint)z->c[2];
+	h= h*31 + (guint)z->c[3];
+	return h;
+}
+
+
+/*
+ * Initialize frame to convert exact points to board coordinates.
+ * Basis vector w^k points at (36*k + 18*parity) degrees.
+ */
+void
+cyclo_frame_init(struct cyclo_frame *frame, int parity, double unit,
+				 const struct point *origin)
+{
+	int k;
+
+	frame->parity= parity;
+	frame->unit= unit;
+	frame->origin.x= origin->x;
+	frame->origin.y= origin->y;
+	for(k=0; k < 4; ++k) {
+		frame->basis[k].x= unit*cos(D2R(36.*k + 18.*parity));
+		frame->basis[k].y= unit*sin(D2R(36.*k + 18.*parity));
+	}
+}
+
+
+/*
+ * Convert exact point to board coordinates
+ */
+void
+cyclo_to_point(const struct cyclo_frame *frame, const struct cyclo *z,
+			   struct point *pt)
+{
+	int k;
+
+	pt->x= frame->origin.x;
+	pt->y= frame->origin.y;
+	for(k=0; k < 4; ++k) {
+		pt->x+= z->c[k]*frame->basis[k].x;
+		pt->y+= z->c[k]*frame->basis[k].y;
+	}
+}
@@ -0,0 +1,66 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+#ifndef __INCLUDED_CYCLOTOMIC_H__
+#define __INCLUDED_CYCLOTOMIC_H__
+
+#include "geometry.h"
+
+
+/* number of 18 degree steps in a full turn */
+#define CYCLO_NUM_DIRS		20
+
+
+/*
+ * Exact point in the ring Z[w], with w= exp(i*pi/5) (10th root of unity).
+ * Value is c[0] + c[1]*w + c[2]*w^2 + c[3]*w^3
+ * Any unit vector at a multiple of 36 degrees is a power of w, and the
+ * golden ratio is 1 + w^2 - w^3, so penrose-like tilings have integer
+ * coordinates in this basis.
+ */
+struct cyclo {
+	int c[4];
+};
+
+
+/*
+ * Maps exact points to board coordinates.
+ * Directions are given in steps of 18 degrees. All steps used in one frame
+ * must have the same parity, which is kept here as a rotation of 18 degrees
+ * applied to the whole frame.
+ */
+struct cyclo_frame {
+	int parity;				// parity of directions used (0 or 1)
+	double unit;			// length of unit vector in board coordinates
+	struct point origin;	// board position of exact point 0
+	struct point basis[4];	// board vectors for 1, w, w^2, w^3
+};
+
+
+/* cyclotomic.c */
+void cyclo_zero(struct cyclo *z);
+void cyclo_add(struct cyclo *z, const struct cyclo *a);
+void cyclo_mul(struct cyclo *z, const struct cyclo *a, const struct cyclo *b);
+void cyclo_ratio_power(struct cyclo *z, int n);
+void cyclo_step(struct cyclo *z, int dir, int parity, int scale);
+gboolean cyclo_equal(const struct cyclo *a, const struct cyclo *b);
+guint cyclo_hash(const struct cyclo *z);
+void cyclo_frame_init(struct cyclo_frame *frame, int parity, double unit,
+					  const struct point *origin);
+void cyclo_to_point(const struct cyclo_frame *frame, const struct cyclo *z,
+					struct point *pt);
+
+#endif
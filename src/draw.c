@@ -17,9 +17,12 @@
 #include <gtk/gtk.h>
 #include <math.h>
 #include <stdlib.h>
-#include <sys/time.h>
 
 #include "gamedata.h"
+#include "loop-tracker.h"
+#include "hint.h"
+#include "spatial-index.h"
+#include "benchmark.h"
 
 
 /* defined in gamedata.c */
@@ -164,63 +167,267 @@ draw_margin(cairo_t *cr)
 }
 
 
+/*
+ * Mark tiles and lines of hint shown to player (drawn under lines)
+ */
+static void
+draw_hint(cairo_t *cr, struct geometry *geo, const struct hint *hint)
+{
+	struct tile *tile;
+	struct line *line;
+	int i, j;
+
+	cairo_set_source_rgba(cr, 1., 0.85, 0., 0.25);
+	for(i=0; i < hint->ntile_changes; ++i) {
+		tile= geo->tiles + hint->tile_changes[i];
+		cairo_move_to(cr, tile->vertex[0]->pos.x, tile->vertex[0]->pos.y);
+		for(j=1; j < tile->nvertex; ++j)
+			cairo_line_to(cr, tile->vertex[j]->pos.x, tile->vertex[j]->pos.y);
+		cairo_close_path(cr);
+	}
+	cairo_fill(cr);
+
+	cairo_set_source_rgba(cr, 1., 0.85, 0., 0.7);
+	cairo_set_line_width(cr, 3.*geo->on_line_width);
+	for(i=0; i < hint->nchanges; ++i) {
+		line= geo->lines + hint->changes[i];
+		cairo_move_to(cr, line->ends[0]->pos.x, line->ends[0]->pos.y);
+		cairo_line_to(cr, line->ends[1]->pos.x, line->ends[1]->pos.y);
+	}
+	cairo_stroke(cr);
+}
+
+
 /*
  * Select color according to FX status and frame
  */
 static void
-fx_setcolor(cairo_t *cr, struct line *line)
+fx_setcolor(cairo_t *cr, struct game *game, struct line *line)
 {
-	switch(line->fx_status) {
-		case 0: //FX_OFF:
+	struct fx *fx=game->line_fx + line->id;
+
+	switch(fx->status) {
+		case FX_OFF:
 			cairo_set_source_rgb(cr, 0., 0., 1.);
 		break;
-		case 1://FX_LOOP:
+		case FX_LOOP:
 			cairo_set_source_rgb(cr,
-					     0.2 + 0.8*sin(line->fx_frame/20.0*M_PI),
+					     0.2 + 0.8*sin(fx->frame/(double)FX_LOOP_FRAMES*M_PI),
 					     0., 1.);
 		break;
 		default:
-			g_debug("line %d, unknown FX: %d", line->id, line->fx_status);
+			g_debug("line %d, unknown FX: %d", line->id, fx->status);
 	}
 }
 
 
 /*
- * Increase frame number for FX animation
+ * Compare FX of two lines (given by id), so lines drawn with the same
+ * colour can be sorted together
+ */
+static gint
+fx_cmp(gconstpointer a, gconstpointer b, gpointer data)
+{
+	struct game *game=(struct game*)data;
+	struct fx *fx1=game->line_fx + *(const int*)a;
+	struct fx *fx2=game->line_fx + *(const int*)b;
+
+	if (fx1->status != fx2->status) return fx1->status - fx2->status;
+	if (fx1->status == FX_OFF) return 0;
+	return fx1->frame - fx2->frame;
+}
+
+
+/*
+ * Static layer of board (background, lines drawn as OFF, tile numbers).
+ * Kept in an offscreen surface at the size of the drawing area: it's
+ * only drawn again when the game, the window size or the view changes,
+ * or (just the affected area) when the display state of a tile changes.
+ * The whole board (zoom 1) is kept in its own layer, so zooming out again
+ * doesn't redraw it.
+ */
+struct board_layer {
+	cairo_surface_t *surface;	// static layer (NULL: must be drawn)
+	int width, height;			// size of surface in pixels
+	struct view view;			// part of board drawn in surface
+	struct geometry *geo;		// geometry drawn in surface
+	int *tile_display;			// tile display states drawn in surface
+};
+
+static struct board_layer overview={NULL, 0, 0, {1., 0., 0.}, NULL, NULL};
+static struct board_layer zoomed={NULL, 0, 0, {1., 0., 0.}, NULL, NULL};
+
+
+/*
+ * Level of detail: things smaller than this (in pixels) are not drawn
+ */
+#define LOD_MIN_FONT_PIXELS		4.
+#define LOD_MIN_CROSS_PIXELS	1.5
+
+
+/* max number of digit glyphs (tile numbers are a single digit) */
+#define MAX_DIGIT_GLYPHS	10
+
+/*
+ * Tile numbers rendered once as alpha masks (in pixels), so drawing a
+ * number is a masked copy in the current colour instead of text rendering.
+ */
+struct digit_glyphs {
+	double font_size;			// font size of glyphs
+	double sx, sy;				// board-to-pixel scale of glyphs
+	int nglyphs;				// number of glyphs (0: empty)
+	cairo_surface_t *mask[MAX_DIGIT_GLYPHS];
+	int ox[MAX_DIGIT_GLYPHS];	// position of text origin in mask
+	int oy[MAX_DIGIT_GLYPHS];
+};
+
+static struct digit_glyphs digits={0., 0., 0., 0};
+
+
+/*
+ * Free digit glyphs
  */
 static void
-fx_nextframe(struct line *line)
+digit_glyphs_clear(struct digit_glyphs *glyphs)
 {
-	switch(line->fx_status) {
-		case 0: //FX_OFF
-			return;
-		break;
-		case 1://FX_LOOP:
-			gdk_threads_enter();
-			line->fx_frame= (line->fx_frame + 1)%20;
-			gdk_threads_leave();
-		break;
-		default:
-			g_debug("line %d, unknown FX: %d", line->id, line->fx_status);
+	int i;
+
+	for(i=0; i < glyphs->nglyphs; ++i)
+		cairo_surface_destroy(glyphs->mask[i]);
+	glyphs->nglyphs= 0;
+}
+
+
+/*
+ * Make sure digit glyphs match font size of metrics and scale (sx, sy).
+ * Returns NULL if numbers can't be drawn from glyphs.
+ */
+static struct digit_glyphs*
+digit_glyphs_update(struct digit_glyphs *glyphs, struct geometry *geo,
+					const struct number_metrics *metrics, double sx, double sy)
+{
+	cairo_surface_t *surf;
+	cairo_t *cr;
+	cairo_text_extents_t extent;
+	int x0, y0, x1, y1;
+	int i;
+
+	if (geo->max_numlines > MAX_DIGIT_GLYPHS) return NULL;
+	if (glyphs->nglyphs == geo->max_numlines &&
+		glyphs->font_size == metrics->font_size &&
+		glyphs->sx == sx && glyphs->sy == sy)
+		return glyphs;
+
+	digit_glyphs_clear(glyphs);
+	glyphs->font_size= metrics->font_size;
+	glyphs->sx= sx;
+	glyphs->sy= sy;
+
+	/* scratch context to measure numbers */
+	surf= cairo_image_surface_create(CAIRO_FORMAT_A8, 1, 1);
+	cr= cairo_create(surf);
+	cairo_scale(cr, sx, sy);
+	cairo_set_font_size(cr, metrics->font_size);
+	for(i=0; i < geo->max_numlines; ++i) {
+		/* pixel box around number (1 pixel margin for antialiasing) */
+		cairo_text_extents(cr, geo->numbers + 2*i, &extent);
+		x0= (int)floor(extent.x_bearing*sx) - 1;
+		y0= (int)floor(extent.y_bearing*sy) - 1;
+		x1= (int)ceil((extent.x_bearing + extent.width)*sx) + 1;
+		y1= (int)ceil((extent.y_bearing + extent.height)*sy) + 1;
+		glyphs->ox[i]= -x0;
+		glyphs->oy[i]= -y0;
+		glyphs->mask[i]= cairo_image_surface_create(CAIRO_FORMAT_A8,
+													x1 - x0, y1 - y0);
+		++glyphs->nglyphs;
 	}
+	cairo_destroy(cr);
+	cairo_surface_destroy(surf);
+
+	/* render numbers with text origin at (ox, oy) */
+	for(i=0; i < glyphs->nglyphs; ++i) {
+		cr= cairo_create(glyphs->mask[i]);
+		cairo_translate(cr, glyphs->ox[i], glyphs->oy[i]);
+		cairo_scale(cr, sx, sy);
+		cairo_set_font_size(cr, metrics->font_size);
+		cairo_move_to(cr, 0., 0.);
+		cairo_show_text(cr, geo->numbers + 2*i);
+		cairo_destroy(cr);
+	}
+	return glyphs;
 }
 
 
 /*
- * Draw game on board
- * Cairo context is assumed to be properly scaled to board units,
- * i.e., we draw in 'board_size' units.
+ * Draw number from its glyph with text origin at (x, y) (board units),
+ * rounded to whole pixels.
  */
-void
-draw_board(cairo_t *cr, struct geometry *geo, struct game *game)
+static void
+digit_glyphs_draw(cairo_t *cr, struct digit_glyphs *glyphs, int number,
+				  double x, double y)
+{
+	cairo_user_to_device(cr, &x, &y);
+	cairo_save(cr);
+	cairo_identity_matrix(cr);
+	cairo_mask_surface(cr, glyphs->mask[number],
+					   floor(x + 0.5) - glyphs->ox[number],
+					   floor(y + 0.5) - glyphs->oy[number]);
+	cairo_restore(cr);
+}
+
+
+/*
+ * Find elements of given kind inside clip area of cairo context.
+ * Returns number of elements found. If 'ids' is set to NULL, all elements
+ * are to be drawn.
+ */
+static int
+draw_find_elements(cairo_t *cr, struct spatial_index *index, int kind,
+				   int nitems, const int **ids)
+{
+	struct clipbox area;
+
+	*ids= NULL;
+	if (index == NULL) return nitems;
+	cairo_clip_extents(cr, &area.x, &area.y, &area.w, &area.h);
+	area.w-= area.x;
+	area.h-= area.y;
+	return spatial_index_find(index, kind, &area, ids);
+}
+
+
+/*
+ * Size in pixels of a length in board units
+ */
+static double
+draw_pixel_size(cairo_t *cr, double size)
+{
+	double dx=size, dy=0.;
+
+	cairo_user_to_device_distance(cr, &dx, &dy);
+	return sqrt(dx*dx + dy*dy);
+}
+
+
+/*
+ * Draw static part of board: white background, every line as an OFF
+ * line (ON lines are drawn on top), and tile numbers.
+ * Numbers are drawn from glyphs if given (must match scale of 'cr').
+ * Numbers too small to be read, or not measured for this geometry, are
+ * not drawn.
+ */
+static void
+draw_static_layer(cairo_t *cr, struct geometry *geo, struct game *game,
+				  struct spatial_index *index,
+				  const struct number_metrics *metrics,
+				  struct digit_glyphs *glyphs)
 {
-	struct vertex *vertex1, *vertex2;
 	struct line *line;
 	struct tile *tile;
-	int i, j;
-	double x, y;
-	int lines_on;	// how many ON lines a vertex has
+	const int *ids;
+	int nlines, ntiles;
 	int number;
+	int i;
 
 	/* white background */
 	cairo_set_source_rgb(cr, 1, 1, 1);
@@ -234,52 +441,161 @@ draw_board(cairo_t *cr, struct geometry *geo, struct game *game)
 	//draw_bounds(cr);
 	//draw_margin(cr);
 
-	/* Draw OFF lines first */
+	/* Draw OFF lines */
+	nlines= draw_find_elements(cr, index, SPATIAL_LINES, geo->nlines, &ids);
 	cairo_set_source_rgb(cr, 150/256., 150/256., 150/256.);
 	cairo_set_line_width (cr, geo->off_line_width);
-	line= geo->lines;
-	for(i=0; i<geo->nlines; ++i) {
-		vertex1= line->ends[0];
-		vertex2= line->ends[1];
+	for(i=0; i<nlines; ++i) {
+		line= geo->lines + ((ids != NULL) ? ids[i] : i);
+		cairo_move_to(cr, line->ends[0]->pos.x, line->ends[0]->pos.y);
+		cairo_line_to(cr, line->ends[1]->pos.x, line->ends[1]->pos.y);
+	}
+	cairo_stroke(cr);
+
+	/* Text in tiles */
+	if (metrics->geo != geo ||
+		draw_pixel_size(cr, metrics->font_size) < LOD_MIN_FONT_PIXELS) return;
+	ntiles= draw_find_elements(cr, index, SPATIAL_TILES, geo->ntiles, &ids);
+	if (glyphs == NULL) cairo_set_font_size(cr, metrics->font_size);
+	for(i=0; i<ntiles; ++i) {
+		tile= geo->tiles + ((ids != NULL) ? ids[i] : i);
+		number= game->numbers[tile->id];
+		if (number != -1) {	// tile has a number
+			if (game->tile_display[tile->id] == DISPLAY_NORMAL) {
+				cairo_set_source_rgb(cr, 0, 0, 0);
+			} else if (game->tile_display[tile->id] == DISPLAY_HANDLED) {
+				cairo_set_source_rgb(cr, 0, 1, 0);
+			} else {
+				cairo_set_source_rgb(cr, 1, 0, 0);
+			}
+			if (glyphs != NULL) {
+				digit_glyphs_draw(cr, glyphs, number,
+								  tile->center.x - metrics->numpos[number].x,
+								  tile->center.y + metrics->numpos[number].y);
+				continue;
+			}
+			cairo_move_to(cr, tile->center.x - metrics->numpos[number].x,
+				      tile->center.y + metrics->numpos[number].y);
+			cairo_show_text (cr, geo->numbers + 2*number);
+		}
+	}
+}
+
+
+/*
+ * Draw parts of board that change with every move: ON lines, crosses
+ * and vertex errors. Crosses too small to be seen are not drawn.
+ */
+static void
+draw_dynamic_layer(cairo_t *cr, struct geometry *geo, struct game *game,
+				   struct spatial_index *index)
+{
+	struct vertex *vertex1, *vertex2;
+	struct line *line;
+	const int *ids;
+	int *fx_ids;
+	int nlines, nvertex;
+	int nfx;
+	int nloop;
+	int i, j;
+	double x, y;
+	int lines_on;	// how many ON lines a vertex has
+	gboolean premature;
+
+	/* Draw lines: one stroke for each line style */
+	nlines= draw_find_elements(cr, index, SPATIAL_LINES, geo->nlines, &ids);
+	cairo_set_line_cap(cr, CAIRO_LINE_CAP_ROUND);
+	/* closed loop that leaves other lines out is shown as an error */
+	premature= (game->loops != NULL &&
+				loop_tracker_has_premature_loop(game->loops));
+	nloop= 0;
+
+	/* hint shown to player */
+	if (game->hint != NULL) draw_hint(cr, geo, game->hint);
+
+	/* ON lines without FX */
+	cairo_set_source_rgb(cr, 0., 0., 1.);
+	cairo_set_line_width (cr, geo->on_line_width);
+	nfx= 0;
+	for(i=0; i<nlines; ++i) {
+		line= geo->lines + ((ids != NULL) ? ids[i] : i);
 		if (game->states[line->id] != LINE_ON) {
-			cairo_move_to(cr, vertex1->pos.x, vertex1->pos.y);
-			cairo_line_to(cr, vertex2->pos.x, vertex2->pos.y);
+			if (game->states[line->id] != LINE_OFF &&
+				game->states[line->id] != LINE_CROSSED) {
+				g_debug("draw_line: line (%d) state invalid: %d",
+						line->id, game->states[line->id]);
+			}
+			continue;
+		}
+		if (game->line_fx[line->id].status != FX_OFF) {
+			++nfx;
+			continue;
+		}
+		if (premature && loop_tracker_line_in_loop(game->loops, line->id)) {
+			++nloop;
+			continue;
 		}
-		++line;
+		cairo_move_to(cr, line->ends[0]->pos.x, line->ends[0]->pos.y);
+		cairo_line_to(cr, line->ends[1]->pos.x, line->ends[1]->pos.y);
 	}
 	cairo_stroke(cr);
 
-	/* Draw lines */
-	cairo_set_line_cap(cr, CAIRO_LINE_CAP_ROUND);
-	line= geo->lines;
-	for(i=0; i<geo->nlines; ++i) {
-		vertex1= line->ends[0];
-		vertex2= line->ends[1];
-		if (game->states[line->id] == LINE_CROSSED) { // draw cross
-			cairo_set_source_rgb(cr, 1., 0., 0.);
-			cairo_set_line_width (cr, geo->cross_line_width);
+	/* ON lines in a premature loop */
+	if (nloop > 0) {
+		cairo_set_source_rgb(cr, 0.8, 0., 0.);
+		for(i=0; i<nlines; ++i) {
+			line= geo->lines + ((ids != NULL) ? ids[i] : i);
+			if (game->states[line->id] != LINE_ON ||
+				game->line_fx[line->id].status != FX_OFF) continue;
+			if (!loop_tracker_line_in_loop(game->loops, line->id)) continue;
+			cairo_move_to(cr, line->ends[0]->pos.x, line->ends[0]->pos.y);
+			cairo_line_to(cr, line->ends[1]->pos.x, line->ends[1]->pos.y);
+		}
+		cairo_stroke(cr);
+	}
+
+	/* ON lines with FX: sorted by FX status and frame, one stroke per
+	   colour */
+	if (nfx > 0) {
+		fx_ids= (int*)g_malloc(nfx*sizeof(int));
+		nfx= 0;
+		for(i=0; i<nlines; ++i) {
+			line= geo->lines + ((ids != NULL) ? ids[i] : i);
+			if (game->states[line->id] == LINE_ON &&
+				game->line_fx[line->id].status != FX_OFF)
+				fx_ids[nfx++]= line->id;
+		}
+		g_qsort_with_data(fx_ids, nfx, sizeof(int), fx_cmp, game);
+		for(i=0; i < nfx; i=j) {
+			fx_setcolor(cr, game, geo->lines + fx_ids[i]);
+			for(j=i; j < nfx && fx_cmp(fx_ids + i, fx_ids + j, game) == 0; ++j) {
+				line= geo->lines + fx_ids[j];
+				cairo_move_to(cr, line->ends[0]->pos.x, line->ends[0]->pos.y);
+				cairo_line_to(cr, line->ends[1]->pos.x, line->ends[1]->pos.y);
+			}
+			cairo_stroke(cr);
+		}
+		g_free(fx_ids);
+	}
+
+	/* crosses */
+	if (draw_pixel_size(cr, geo->cross_radius) >= LOD_MIN_CROSS_PIXELS) {
+		cairo_set_source_rgb(cr, 1., 0., 0.);
+		cairo_set_line_width (cr, geo->cross_line_width);
+		for(i=0; i<nlines; ++i) {
+			line= geo->lines + ((ids != NULL) ? ids[i] : i);
+			if (game->states[line->id] != LINE_CROSSED) continue;
+			vertex1= line->ends[0];
+			vertex2= line->ends[1];
 			x= (vertex1->pos.x + vertex2->pos.x)/2.;
 			y= (vertex1->pos.y + vertex2->pos.y)/2.;
 			cairo_move_to(cr, x-geo->cross_radius, y-geo->cross_radius);
 			cairo_line_to(cr, x+geo->cross_radius, y+geo->cross_radius);
 			cairo_move_to(cr, x-geo->cross_radius, y+geo->cross_radius);
 			cairo_line_to(cr, x+geo->cross_radius, y-geo->cross_radius);
-			cairo_stroke(cr);
-		} else if (game->states[line->id] == LINE_ON) {
-			fx_setcolor(cr, line);
-			//cairo_set_source_rgb(cr, 0., 0., 1.);
-			cairo_set_line_width (cr, geo->on_line_width);
-			cairo_move_to(cr, vertex1->pos.x, vertex1->pos.y);
-			cairo_line_to(cr, vertex2->pos.x, vertex2->pos.y);
-			cairo_stroke(cr);
-			//fx_nextframe(line);
-		} else if (game->states[line->id] != LINE_OFF) {
-			g_debug("draw_line: line (%d) state invalid: %d",
-				line->id, game->states[line->id]);
 		}
-		++line;
+		cairo_stroke(cr);
 	}
-	//cairo_stroke(cr);
 
 	/* Draw vertexs */
 	if (0) {
@@ -301,76 +617,296 @@ draw_board(cairo_t *cr, struct geometry *geo, struct game *game)
 		}
 	}
 
-	/* Text in tiles */
-	tile= geo->tiles;
-	cairo_set_font_size(cr, geo->font_size);
-	for(i=0; i<geo->ntiles; ++i) {
-		number= game->numbers[tile->id];
-		if (number != -1) {	// tile has a number
-			if (tile->display_state == DISPLAY_NORMAL) {
-				cairo_set_source_rgb(cr, 0, 0, 0);
-			} else if (tile->display_state == DISPLAY_HANDLED) {
-				cairo_set_source_rgb(cr, 0, 1, 0);
-			} else {
-				cairo_set_source_rgb(cr, 1, 0, 0);
-			}
-			cairo_move_to(cr, tile->center.x - geo->numpos[number].x,
-				      tile->center.y + geo->numpos[number].y);
-			cairo_show_text (cr, geo->numbers + 2*number);
-		}
-		++tile;
-	}
-
-	/* Vertex display state */
-	vertex1= geo->vertex;
-	for(i=0; i < geo->nvertex; ++i) {
-		if (vertex1->display_state == DISPLAY_ERROR) {
-			cairo_set_source_rgb(cr, 1, 0, 0);
+	/* Vertex display state (all errors filled at once) */
+	nvertex= draw_find_elements(cr, index, SPATIAL_VERTEX, geo->nvertex, &ids);
+	cairo_set_source_rgb(cr, 1, 0, 0);
+	for(i=0; i < nvertex; ++i) {
+		vertex1= geo->vertex + ((ids != NULL) ? ids[i] : i);
+		if (game->vertex_display[vertex1->id] == DISPLAY_ERROR) {
+			cairo_new_sub_path(cr);
 			cairo_arc (cr, vertex1->pos.x, vertex1->pos.y,
 					   geo->tile_width / 5.0, 0, 2 * M_PI);
-			cairo_fill(cr);
 		}
-		++vertex1;
 	}
+	cairo_fill(cr);
 }
 
 
 /*
- * Calculate extents (width & height) of all possible tile numbers
- * This has to be done after every window resize because the accuracy of
- * the extents depends on the pixel size.
+ * Draw game on board
+ * Cairo context is assumed to be properly scaled to board units,
+ * i.e., we draw in 'board_size' units.
+ * If spatial index is given, only elements inside clip area are drawn.
+ * Tile numbers are drawn with given metrics.
  */
 void
-draw_measure_font(GtkWidget *drawarea, int width, int height,
-		  struct geometry *geo)
+draw_board(cairo_t *cr, struct geometry *geo, struct game *game,
+		   struct spatial_index *index, const struct number_metrics *metrics)
+{
+	fences_benchmark_enter("draw");
+	draw_static_layer(cr, geo, game, index, metrics, NULL);
+	draw_dynamic_layer(cr, geo, game, index);
+	fences_benchmark_leave();
+}
+
+
+/*
+ * Forget static layer
+ */
+static void
+draw_layer_reset(struct board_layer *layer)
+{
+	if (layer->surface != NULL)
+		cairo_surface_destroy(layer->surface);
+	layer->surface= NULL;
+	g_free(layer->tile_display);
+	layer->tile_display= NULL;
+	layer->geo= NULL;
+}
+
+
+/*
+ * Forget static layers of board (e.g. window resized or new game)
+ */
+void
+draw_invalidate_background(void)
+{
+	draw_layer_reset(&overview);
+	draw_layer_reset(&zoomed);
+}
+
+
+/*
+ * Board-to-pixel scale of static layer
+ */
+static void
+draw_layer_scale(const struct board_layer *layer, double *sx, double *sy)
+{
+	*sx= layer->width/layer->geo->board_size*layer->view.zoom;
+	*sy= layer->height/layer->geo->board_size*layer->view.zoom;
+}
+
+
+/*
+ * Set transform of cairo context (in pixels) to draw board as in layer
+ */
+static void
+draw_layer_transform(cairo_t *cr, const struct board_layer *layer)
+{
+	double sx, sy;
+
+	draw_layer_scale(layer, &sx, &sy);
+	cairo_scale(cr, sx, sy);
+	cairo_translate(cr, -layer->view.x, -layer->view.y);
+}
+
+
+/*
+ * Is layer a valid static layer for given board, size and view?
+ */
+static gboolean
+draw_layer_matches(const struct board_layer *layer, int width, int height,
+				   struct geometry *geo, const struct view *view)
+{
+	return layer->surface != NULL && layer->geo == geo &&
+		layer->width == width && layer->height == height &&
+		layer->view.zoom == view->zoom &&
+		layer->view.x == view->x && layer->view.y == view->y;
+}
+
+
+/*
+ * Draw static layer again inside area (board units). Area is extended to
+ * whole pixels, so no seams are left at its borders.
+ */
+static void
+draw_background_area(struct board_layer *layer, struct game *game,
+					 struct spatial_index *index,
+					 const struct number_metrics *metrics,
+					 struct clipbox *area)
 {
-	int i;
 	cairo_t *cr;
+	double sx, sy;
+	double x0, y0, x1, y1;
+
+	draw_layer_scale(layer, &sx, &sy);
+	x0= floor((area->x - layer->view.x)*sx);
+	y0= floor((area->y - layer->view.y)*sy);
+	x1= ceil((area->x + area->w - layer->view.x)*sx);
+	y1= ceil((area->y + area->h - layer->view.y)*sy);
+
+	cr= cairo_create(layer->surface);
+	cairo_rectangle(cr, x0, y0, x1 - x0, y1 - y0);
+	cairo_clip(cr);
+	draw_layer_transform(cr, layer);
+	draw_static_layer(cr, layer->geo, game, index, metrics,
+					  digit_glyphs_update(&digits, layer->geo, metrics,
+										  sx, sy));
+	cairo_destroy(cr);
+}
+
+
+/*
+ * Draw board on a drawing area of given size (in pixels), as seen
+ * through view (zoom & pan).
+ * Cairo context is not scaled, it may be clipped to the exposed area.
+ * Static layer is copied from offscreen surface (drawn first if needed),
+ * then moving parts are drawn on top. Only elements inside the exposed
+ * area are drawn.
+ */
+void
+draw_board_cached(cairo_t *cr, int width, int height, struct geometry *geo,
+				  struct game *game, struct spatial_index *index,
+				  const struct number_metrics *metrics,
+				  const struct view *view)
+{
+	struct board_layer *layer;
+	cairo_t *layer_cr;
+	double sx, sy;
+	struct clipbox dirty;
+	struct clipbox *box;
+	struct clipbox board_box;
+	const int *ids;
+	int ntiles;
+	int nchanged=0;
+	int i, id;
+
+	fences_benchmark_enter("draw");
+	/* whole board has a layer of its own */
+	layer= (view->zoom == 1.) ? &overview : &zoomed;
+
+	/* draw whole static layer (just the part of board in view) */
+	if (!draw_layer_matches(layer, width, height, geo, view)) {
+		draw_layer_reset(layer);
+		layer->surface= cairo_surface_create_similar
+			(cairo_get_target(cr), CAIRO_CONTENT_COLOR, width, height);
+		layer->width= width;
+		layer->height= height;
+		layer->view= *view;
+		layer->geo= geo;
+		layer->tile_display= (int*)g_memdup(game->tile_display,
+											geo->ntiles*sizeof(int));
+		layer_cr= cairo_create(layer->surface);
+		draw_layer_transform(layer_cr, layer);
+		draw_layer_scale(layer, &sx, &sy);
+		draw_static_layer(layer_cr, geo, game, index, metrics,
+						  digit_glyphs_update(&digits, geo, metrics, sx, sy));
+		cairo_destroy(layer_cr);
+	}
+
+	cairo_save(cr);
+	draw_layer_transform(cr, layer);
+
+	/* update tile numbers whose display state changed (only visible ones:
+	   the rest are checked when they're exposed) */
+	board_box.x= board_box.y= 0.;
+	board_box.w= board_box.h= geo->board_size;
+	ntiles= draw_find_elements(cr, index, SPATIAL_TILES, geo->ntiles, &ids);
+	for(i=0; i < ntiles; ++i) {
+		id= (ids != NULL) ? ids[i] : i;
+		if (game->tile_display[id] == layer->tile_display[id]) continue;
+		layer->tile_display[id]= game->tile_display[id];
+		box= (index != NULL) ? index->grid[SPATIAL_TILES].box + id : &board_box;
+		if (nchanged == 0) dirty= *box;
+		else geometry_clip_union(&dirty, box);
+		++nchanged;
+	}
+	if (nchanged > 0)
+		draw_background_area(layer, game, index, metrics, &dirty);
+	cairo_restore(cr);
+
+	/* copy static layer and draw the rest on top */
+	cairo_set_source_surface(cr, layer->surface, 0, 0);
+	cairo_paint(cr);
+	draw_layer_transform(cr, layer);
+	draw_dynamic_layer(cr, geo, game, index);
+	fences_benchmark_leave();
+}
+
+
+/*
+ * Calculate font size and extents of all possible tile numbers for a
+ * board drawn at width x height pixels, using given cairo context.
+ * Result is stored in metrics (geometry is left untouched).
+ */
+void
+draw_measure_numbers(cairo_t *cr, int width, int height,
+					 const struct geometry *geo, struct number_metrics *metrics)
+{
+	int i;
 	cairo_text_extents_t extent;
 
-	/* set up temporary cairo context */
-	cr= gdk_cairo_create (drawarea->window);
+	if (metrics->nnumbers < geo->max_numlines) {
+		g_free(metrics->numpos);
+		metrics->numpos= (struct point*)
+			g_malloc(geo->max_numlines*sizeof(struct point));
+		metrics->nnumbers= geo->max_numlines;
+	}
+	metrics->geo= geo;
+	metrics->width= width;
+	metrics->height= height;
+
+	cairo_save(cr);
+	cairo_identity_matrix(cr);
 	cairo_scale (cr, width/geo->board_size, height/geo->board_size);
 
 	/* scale font size so number 0 fits in tile_height/2. */
 	cairo_set_font_size(cr, geo->board_size/2.);
 	cairo_text_extents(cr, geo->numbers + 0, &extent);
-	geo->font_size= (geo->tile_height/2.) * (geo->board_size/2./extent.height);
+	metrics->font_size= (geo->tile_height/2.) *
+		(geo->board_size/2./extent.height);
 	/* further scale font to fit current tile type */
-	geo->font_size*= geo->font_scale;
+	metrics->font_size*= geo->font_scale;
 
 	/* measure extent boxes for all numbers at the new font size */
-	cairo_set_font_size(cr, geo->font_size);
+	cairo_set_font_size(cr, metrics->font_size);
 	for(i=0; i < geo->max_numlines; ++i) {
 		cairo_text_extents(cr, geo->numbers + i*2, &extent);
-		geo->numpos[i].x= extent.width/2. + extent.x_bearing;
-		geo->numpos[i].y= extent.height/2. -
+		metrics->numpos[i].x= extent.width/2. + extent.x_bearing;
+		metrics->numpos[i].y= extent.height/2. -
 			(extent.height + extent.y_bearing);
 	}
+	cairo_restore(cr);
+}
+
+
+/*
+ * Calculate extents (width & height) of all possible tile numbers
+ * This has to be done after every window resize because the accuracy of
+ * the extents depends on the pixel size.
+ * Nothing is done if metrics were last measured for the same geometry
+ * and size.
+ */
+void
+draw_measure_font(GtkWidget *drawarea, int width, int height,
+		  struct geometry *geo, struct number_metrics *metrics)
+{
+	cairo_t *cr;
+
+	if (metrics->geo == geo && metrics->width == width &&
+		metrics->height == height)
+		return;
+
+	/* set up temporary cairo context */
+	cr= gdk_cairo_create (drawarea->window);
+	draw_measure_numbers(cr, width, height, geo, metrics);
 	cairo_destroy (cr);
 }
 
 
+/*
+ * Free position hints of metrics and mark them as not measured
+ */
+void
+draw_free_metrics(struct number_metrics *metrics)
+{
+	g_free(metrics->numpos);
+	metrics->numpos= NULL;
+	metrics->nnumbers= 0;
+	metrics->geo= NULL;
+}
+
+
 /*
  * Benchmark speed of drawing routine
  */
@@ -378,52 +914,26 @@ void
 draw_benchmark(GtkWidget *drawarea)
 {
 	cairo_t *cr;
-	struct timeval start_time;	// Contains starting time
-	struct timeval end_time;	// Contains ending time
 	double result;
 	int i;
 	int iters=1000;
 
 	printf("Benchmark (%d): starting ...\n", iters);
-	gettimeofday (&start_time, NULL);
+	fences_benchmark_enter("draw-benchmark");
 	for(i=0; i < iters; ++i) {
 		cr= gdk_cairo_create (drawarea->window);
 		/* set scale so we draw in board_size space */
 		cairo_scale (cr,
 					 drawarea->allocation.width/(double)board.geo->board_size,
 					 drawarea->allocation.height/(double)board.geo->board_size);
-		draw_board(cr, board.geo, board.game);
+		draw_board(cr, board.geo, board.game, board.spatial_index,
+				   &board.metrics);
 		cairo_destroy(cr);
 	}
-	gettimeofday (&end_time, NULL);
-	result= ((double)(end_time.tv_sec - start_time.tv_sec))*1000000. \
-		+ ((double)(end_time.tv_usec - start_time.tv_usec));
+	result= fences_benchmark_leave();
 
 	printf("Benchmark (%d): total= %7.2lf ms ; iter=%5.2lf ms\n", iters,
-	       result/1000., result/iters/1000.);
-}
-
-
-/*
- * Draw to file
- */
-void
-draw_board_to_file(struct geometry *geo, struct game *game, const char *filename)
-{
-	cairo_surface_t *surf;
-	cairo_t *cr;
-
-	surf= cairo_image_surface_create(CAIRO_FORMAT_RGB24, 600, 600);
-	cr= cairo_create(surf);
-
-	/* set scale so we draw in board_size space */
-	cairo_scale (cr,
-				 600.0/(double)board.geo->board_size,
-				 600.0/(double)board.geo->board_size);
-	draw_board(cr, board.geo, board.game);
-	cairo_surface_write_to_png(surf, filename);
-	cairo_destroy(cr);
-	cairo_surface_destroy(surf);
+	       result, result/iters);
 }
 
 
@@ -431,10 +941,9 @@ draw_board_to_file(struct geometry *geo, struct game *game, const char *filename
  * Draw board preview
  */
 void
-draw_board_skeleton(cairo_t *cr, struct geometry *geo)
+draw_board_skeleton(cairo_t *cr, struct skeleton *skel)
 {
-	struct vertex *vertex1, *vertex2;
-	struct line *line;
+	struct point *pt;
 	int i;
 
 	/* white background */
@@ -443,14 +952,12 @@ draw_board_skeleton(cairo_t *cr, struct geometry *geo)
 
 	/* Draw lines */
 	cairo_set_source_rgb(cr, 0./256., 0./256., 0./256.);
-	cairo_set_line_width (cr, geo->off_line_width*2);
-	line= geo->lines;
-	for(i=0; i<geo->nlines; ++i) {
-		vertex1= line->ends[0];
-		vertex2= line->ends[1];
-		cairo_move_to(cr, vertex1->pos.x, vertex1->pos.y);
-		cairo_line_to(cr, vertex2->pos.x, vertex2->pos.y);
-		++line;
+	cairo_set_line_width (cr, skel->line_width);
+	pt= skel->ends;
+	for(i=0; i < skel->nlines; ++i) {
+		cairo_move_to(cr, pt[0].x, pt[0].y);
+		cairo_line_to(cr, pt[1].x, pt[1].y);
+		pt+= 2;
 	}
 	cairo_stroke(cr);
 }
@@ -18,10 +18,21 @@
 #define __INCLUDED_DRAW_H__
 
 
-void draw_board(cairo_t *cr, struct geometry *geo, struct game *game);
-void draw_measure_font(GtkWidget *drawarea, int width, int height, struct geometry *geo);
+void draw_board(cairo_t *cr, struct geometry *geo, struct game *game,
+				struct spatial_index *index,
+				const struct number_metrics *metrics);
+void draw_invalidate_background(void);
+void draw_board_cached(cairo_t *cr, int width, int height, struct geometry *geo,
+					   struct game *game, struct spatial_index *index,
+					   const struct number_metrics *metrics,
+					   const struct view *view);
+void draw_measure_numbers(cairo_t *cr, int width, int height,
+						  const struct geometry *geo,
+						  struct number_metrics *metrics);
+void draw_measure_font(GtkWidget *drawarea, int width, int height,
+					   struct geometry *geo, struct number_metrics *metrics);
+void draw_free_metrics(struct number_metrics *metrics);
 void draw_benchmark(GtkWidget *drawarea);
-void draw_board_to_file(struct geometry *geo, struct game *game, const char *filename);
-void draw_board_skeleton(cairo_t *cr, struct geometry *geo);
+void draw_board_skeleton(cairo_t *cr, struct skeleton *skel);
 
 #endif
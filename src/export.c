@@ -0,0 +1,248 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+#include <unistd.h>
+#include <string.h>
+
+#include <gtk/gtk.h>
+#ifdef CAIRO_HAS_SVG_SURFACE
+#  include <cairo-svg.h>
+#endif
+#ifdef CAIRO_HAS_PDF_SURFACE
+#  include <cairo-pdf.h>
+#endif
+
+#include "gamedata.h"
+#include "draw.h"
+#include "export.h"
+
+
+/*
+ * Batch export of boards to image files.
+ * Items are shared out among worker threads: each worker takes the next
+ * item not yet taken and draws it to its own cairo surface, so nothing
+ * is locked while drawing. Each worker draws from its own copy of the
+ * geometry of its item (geometries may be shared by several items and by
+ * the game on board), and measures tile numbers at the export size into
+ * its own metrics.
+ */
+
+/* maximum number of worker threads */
+#define EXPORT_MAX_THREADS		64
+
+
+/*
+ * Work shared by export threads
+ */
+struct export_job {
+	struct export_item *items;	// boards to export
+	int nitems;					// number of boards
+	const struct export_options *options;
+	gint next;					// next item to take
+	gint nfailed;				// number of files not written
+};
+
+
+/*
+ * Build game to draw for export: numbers of 'game' with given line
+ * states (NULL: no lines) and no errors or animations displayed
+ */
+static struct game*
+export_view(struct geometry *geo, struct game *game, int *states)
+{
+	struct game *view;
+	int i;
+
+	view= create_empty_gamedata(geo);
+	memcpy(view->numbers, game->numbers, geo->ntiles*sizeof(int));
+	if (states != NULL) {
+		memcpy(view->states, states, geo->nlines*sizeof(int));
+		for(i=0; i < geo->nlines; ++i)
+			if (view->states[i] == LINE_CROSSED) view->states[i]= LINE_OFF;
+	}
+	return view;
+}
+
+
+/*
+ * Draw board and write it to file.
+ * PNG files are drawn on 'image' (the worker's surface), vector formats
+ * on a new surface that writes directly to file.
+ * Returns FALSE if file couldn't be written.
+ */
+static gboolean
+export_board(cairo_surface_t *image, struct geometry *geo, struct game *game,
+			 const struct number_metrics *metrics,
+			 const struct export_options *options, const char *filename)
+{
+	cairo_surface_t *surf;
+	cairo_status_t status;
+	cairo_t *cr;
+
+	switch(options->format) {
+		case EXPORT_PNG:
+			surf= cairo_surface_reference(image);
+		break;
+#ifdef CAIRO_HAS_SVG_SURFACE
+		case EXPORT_SVG:
+			surf= cairo_svg_surface_create(filename, options->size,
+										   options->size);
+		break;
+#endif
+#ifdef CAIRO_HAS_PDF_SURFACE
+		case EXPORT_PDF:
+			surf= cairo_pdf_surface_create(filename, options->size,
+										   options->size);
+		break;
+#endif
+		default:
+			g_warning("export: file format %d not supported", options->format);
+			return FALSE;
+	}
+
+	cr= cairo_create(surf);
+	/* set scale so we draw in board_size space */
+	cairo_scale(cr, options->size/geo->board_size,
+				options->size/geo->board_size);
+	draw_board(cr, geo, game, NULL, metrics);
+	if (options->format != EXPORT_PNG)
+		cairo_show_page(cr);
+	cairo_destroy(cr);
+
+	if (options->format == EXPORT_PNG) {
+		status= cairo_surface_write_to_png(surf, filename);
+	} else {
+		cairo_surface_finish(surf);
+		status= cairo_surface_status(surf);
+	}
+	cairo_surface_destroy(surf);
+
+	if (status != CAIRO_STATUS_SUCCESS) {
+		g_warning("export: can't write '%s': %s", filename,
+				  cairo_status_to_string(status));
+		return FALSE;
+	}
+	return TRUE;
+}
+
+
+/*
+ * Worker thread: export items until there are none left
+ */
+static gpointer
+export_worker(gpointer data)
+{
+	struct export_job *job=(struct export_job*)data;
+	struct export_item *item;
+	cairo_surface_t *image=NULL;
+	cairo_surface_t *scratch;
+	cairo_t *measure_cr;
+	struct number_metrics metrics={NULL, 0, 0, 0., 0, NULL};
+	const struct geometry *source=NULL;	// geometry copied to 'geo'
+	struct geometry *geo=NULL;
+	struct game *view;
+	int i;
+
+	/* scratch context to measure tile numbers */
+	scratch= cairo_image_surface_create(CAIRO_FORMAT_A8, 1, 1);
+	measure_cr= cairo_create(scratch);
+
+	if (job->options->format == EXPORT_PNG)
+		image= cairo_image_surface_create(CAIRO_FORMAT_RGB24,
+										  job->options->size,
+										  job->options->size);
+
+	while((i= g_atomic_int_exchange_and_add(&job->next, 1)) < job->nitems) {
+		item= job->items + i;
+		if (item->geo != source) {
+			if (geo != NULL) geometry_destroy(geo);
+			geo= geometry_clone(item->geo);
+			source= item->geo;
+			/* copy may be allocated where the last one was */
+			draw_measure_numbers(measure_cr, job->options->size,
+								 job->options->size, geo, &metrics);
+		}
+		if (item->filename != NULL) {
+			view= export_view(geo, item->game, NULL);
+			if (!export_board(image, geo, view, &metrics, job->options,
+							  item->filename))
+				g_atomic_int_inc(&job->nfailed);
+			free_gamedata(view);
+		}
+		if (item->solution_filename != NULL) {
+			view= export_view(geo, item->game, item->game->solution);
+			if (!export_board(image, geo, view, &metrics, job->options,
+							  item->solution_filename))
+				g_atomic_int_inc(&job->nfailed);
+			free_gamedata(view);
+		}
+	}
+
+	if (image != NULL) cairo_surface_destroy(image);
+	if (geo != NULL) geometry_destroy(geo);
+	cairo_destroy(measure_cr);
+	cairo_surface_destroy(scratch);
+	draw_free_metrics(&metrics);
+	return NULL;
+}
+
+
+/*
+ * Export boards (puzzles and/or solutions) to files, using several
+ * threads. Returns number of files that could not be written.
+ */
+int
+export_boards(struct export_item *items, int nitems,
+			  const struct export_options *options)
+{
+	struct export_job job;
+	GThread *threads[EXPORT_MAX_THREADS];
+	GError *error=NULL;
+	int nthreads;
+	int i;
+
+	g_assert(options->format >= 0 && options->format < NUM_EXPORT_FORMATS);
+	g_assert(options->size > 0);
+	if (nitems <= 0) return 0;
+
+	job.items= items;
+	job.nitems= nitems;
+	job.options= options;
+	job.next= 0;
+	job.nfailed= 0;
+
+	/* number of threads: no more than items to export */
+	nthreads= options->nthreads;
+	if (nthreads <= 0) nthreads= (int)sysconf(_SC_NPROCESSORS_ONLN);
+	nthreads= CLAMP(nthreads, 1, EXPORT_MAX_THREADS);
+	if (nthreads > nitems) nthreads= nitems;
+
+	/* calling thread does its share of the work too */
+	for(i=1; i < nthreads; ++i) {
+		threads[i]= g_thread_create(export_worker, &job, TRUE, &error);
+		if (threads[i] == NULL) {
+			g_warning("export: can't create thread: %s", error->message);
+			g_error_free(error);
+			break;
+		}
+	}
+	nthreads= i;
+	export_worker(&job);
+	for(i=1; i < nthreads; ++i)
+		g_thread_join(threads[i]);
+
+	return job.nfailed;
+}
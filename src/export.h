@@ -0,0 +1,55 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+#ifndef __INCLUDED_EXPORT_H__
+#define __INCLUDED_EXPORT_H__
+
+
+/* File formats for exported boards */
+enum {
+	EXPORT_PNG,
+	EXPORT_SVG,
+	EXPORT_PDF,
+	NUM_EXPORT_FORMATS
+};
+
+
+/*
+ * A board to export: puzzle (numbers only) and, optionally, its solution
+ */
+struct export_item {
+	struct geometry *geo;		// geometry of board
+	struct game *game;			// numbers and solution of board
+	const char *filename;		// file for puzzle (NULL: don't export)
+	const char *solution_filename;	// file for solution (NULL: don't export)
+};
+
+
+/*
+ * How boards are exported
+ */
+struct export_options {
+	int format;			// file format (EXPORT_PNG, ...)
+	int size;			// width & height of image (pixels or points)
+	int nthreads;		// number of worker threads (0: one per processor)
+};
+
+
+/* export.c */
+int export_boards(struct export_item *items, int nitems,
+				  const struct export_options *options);
+
+#endif
@@ -14,12 +14,18 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
  */
 
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
 #include <glib.h>
 #include <string.h>
 #include <stdio.h>
 
 #include "gamedata.h"
 #include "game-solver.h"
+#include "solve-profile.h"
+#include "benchmark.h"
 
 
 
@@ -138,6 +144,7 @@ solve_zero_tiles(struct solution *sol)
 	struct geometry *geo=sol->geo;
 
 	sol->nchanges= sol->ntile_changes= 0;
+	SOLVE_PROFILE_ENTER(SOLVE_RULE_ZERO_TILES);
 	for(i=0; i < geo->ntiles; ++i) {
 		/* only care about unhandled 0 tiles */
 		if (sol->numbers[i] != 0 || sol->tile_done[i]) continue;
@@ -150,6 +157,8 @@ solve_zero_tiles(struct solution *sol)
 		for(j=0; j < tile->nsides; ++j)
 			solve_set_line_cross(sol, tile->sides[j]);
 	}
+	SOLVE_PROFILE_SCAN(geo->ntiles);
+	SOLVE_PROFILE_LEAVE(sol);
 }
 
 
@@ -166,6 +175,7 @@ solve_trivial_tiles(struct solution *sol)
 	struct geometry *geo=sol->geo;
 
 	sol->nchanges= sol->ntile_changes= 0;
+	SOLVE_PROFILE_ENTER(SOLVE_RULE_TRIVIAL_TILES);
 	for(i=0; i < geo->ntiles; ++i) {
 		/* only unhandled tiles */
 		if (sol->tile_done[i])
@@ -185,6 +195,8 @@ solve_trivial_tiles(struct solution *sol)
 		/* only allow one trivial tile to be set at a time */
 		if (sol->nchanges > 0) break;
 	}
+	SOLVE_PROFILE_SCAN(MIN(i + 1, geo->ntiles));
+	SOLVE_PROFILE_LEAVE(sol);
 }
 
 
@@ -202,6 +214,7 @@ solve_trivial_vertex(struct solution *sol)
 	struct geometry *geo=sol->geo;
 
 	sol->nchanges= sol->ntile_changes= 0;
+	SOLVE_PROFILE_ENTER(SOLVE_RULE_TRIVIAL_VERTEX);
 	for(i=0; i < geo->nvertex; ++i) {
 		/* unfinished vertices with just one incoming ON line */
 		if (sol->vertex_done[i] || sol->vertex_count[i].on != 1) continue;
@@ -225,6 +238,8 @@ solve_trivial_vertex(struct solution *sol)
 		/* only allow one trivial vertex to be set at a time */
 		if (sol->nchanges > 0) break;
 	}
+	SOLVE_PROFILE_SCAN(MIN(i + 1, geo->nvertex));
+	SOLVE_PROFILE_LEAVE(sol);
 }
 
 
@@ -247,6 +262,7 @@ solve_maxnumber_tiles(struct solution *sol)
 	int cache;
 
 	sol->nchanges= sol->ntile_changes= 0;
+	SOLVE_PROFILE_ENTER(SOLVE_RULE_MAXNUMBER_TILES);
 	/* iterate over all tiles */
 	for(i=0; i < geo->ntiles; ++i) {
 		tile= geo->tiles + i;
@@ -326,6 +342,8 @@ solve_maxnumber_tiles(struct solution *sol)
 			}
 		}
 	}
+	SOLVE_PROFILE_SCAN(geo->ntiles);
+	SOLVE_PROFILE_LEAVE(sol);
 }
 
 
@@ -349,6 +367,7 @@ solve_maxnumber_incoming_line(struct solution *sol)
 	int cache;
 
 	sol->nchanges= sol->ntile_changes= 0;
+	SOLVE_PROFILE_ENTER(SOLVE_RULE_MAXNUMBER_INCOMING);
 	/* iterate over all tiles */
 	for(i=0; i < geo->ntiles; ++i) {
 		tile= geo->tiles + i;
@@ -396,6 +415,8 @@ solve_maxnumber_incoming_line(struct solution *sol)
 			break;
 		}
 	}
+	SOLVE_PROFILE_SCAN(geo->ntiles);
+	SOLVE_PROFILE_LEAVE(sol);
 }
 
 
@@ -418,6 +439,7 @@ solve_maxnumber_exit_line(struct solution *sol)
 	struct geometry *geo=sol->geo;
 
 	sol->nchanges= sol->ntile_changes= 0;
+	SOLVE_PROFILE_ENTER(SOLVE_RULE_MAXNUMBER_EXIT);
 	/* iterate over all tiles */
 	for(i=0; i < geo->ntiles; ++i) {
 		tile= geo->tiles + i;
@@ -468,6 +490,8 @@ solve_maxnumber_exit_line(struct solution *sol)
 		++sol->ntile_changes;
 		break;
 	}
+	SOLVE_PROFILE_SCAN(MIN(i + 1, geo->ntiles));
+	SOLVE_PROFILE_LEAVE(sol);
 }
 
 
@@ -487,6 +511,7 @@ solve_corner(struct solution *sol)
 	int cache;
 
 	sol->nchanges= sol->ntile_changes= 0;
+	SOLVE_PROFILE_ENTER(SOLVE_RULE_CORNER);
 	/* iterate over all tiles */
 	for(i=0; i < geo->ntiles; ++i) {
 		tile= geo->tiles + i;
@@ -520,6 +545,8 @@ solve_corner(struct solution *sol)
 			++sol->ntile_changes;
 		}
 	}
+	SOLVE_PROFILE_SCAN(geo->ntiles);
+	SOLVE_PROFILE_LEAVE(sol);
 }
 
 
@@ -540,6 +567,7 @@ solve_tiles_net_1(struct solution *sol)
 	int cache;
 
 	sol->nchanges= sol->ntile_changes= 0;
+	SOLVE_PROFILE_ENTER(SOLVE_RULE_TILES_NET_1);
 	/* iterate over all tiles */
 	for(i=0; i < geo->ntiles; ++i) {
 		tile= geo->tiles + i;
@@ -588,6 +616,8 @@ solve_tiles_net_1(struct solution *sol)
 			++sol->ntile_changes;
 		}
 	}
+	SOLVE_PROFILE_SCAN(geo->ntiles);
+	SOLVE_PROFILE_LEAVE(sol);
 }
 
 
@@ -612,6 +642,7 @@ solve_cross_lines(struct solution *sol)
 	int cache;
 
 	sol->nchanges= sol->ntile_changes= 0;
+	SOLVE_PROFILE_ENTER(SOLVE_RULE_CROSS_LINES);
 	/* go through all tiles */
 	for(i=0; i < geo->ntiles; ++i) {
 		/* only unhandled tiles */
@@ -647,9 +678,11 @@ solve_cross_lines(struct solution *sol)
 			++sol->ntile_changes;
 		}
 	}
+	SOLVE_PROFILE_SCAN(geo->ntiles);
 
 	while (old_count != sol->nchanges) {
 		old_count= sol->nchanges;
+		SOLVE_PROFILE_SCAN(geo->nvertex);
 		/* go through all vertices */
 		for(i=0; i < geo->nvertex; ++i) {
 			if (sol->vertex_done[i]) continue;
@@ -676,6 +709,7 @@ solve_cross_lines(struct solution *sol)
 			}
 		}
 	}
+	SOLVE_PROFILE_LEAVE(sol);
 }
 
 
@@ -725,42 +759,21 @@ bottleneck_is_final_line(struct solution *sol, struct line *lin)
 
 
 /*
- * Find two ends of a partial loop. If only separated by a line, cross it
- * Returns length of partial loop
+ * Follow partial loops (lines ON, set in lin_mask) to find two ends only
+ * separated by a line
+ * Returns line connecting the ends, to be crossed out (NULL if none)
  */
-void
-solve_bottleneck(struct solution *sol)
+static struct line*
+bottleneck_find_line(struct solution *sol, int nlines_on, gboolean all_handled)
 {
 	int i;
-
 	struct line *end1;
 	struct line *end2;
 	struct line *next;
 	int dir1, dir2;		// direction each end is going
 	int stuck;
-	int nlines_on=0;		// total number of lines on
 	struct geometry *geo=sol->geo;
 	int length=0;
-	gboolean all_handled=TRUE;
-
-	sol->nchanges= sol->ntile_changes= 0;
-	/* check if all numbered tiles have been handled */
-	for(i=0; i < geo->ntiles; ++i) {
-		if (sol->numbers[i] != -1 && sol->tile_done[i] == FALSE) {
-			all_handled= FALSE;
-			break;
-		}
-	}
-
-	/* initialize line mask */
-	for(i=0; i < geo->nlines; ++i) {
-		if (sol->states[i] == LINE_ON) {
-			sol->lin_mask[i]= TRUE;
-			++nlines_on;
-		} else {
-			sol->lin_mask[i]= FALSE;	// mask out not-ON lines
-		}
-	}
 
 	/* find a line on and follow it */
 	for(i=0; i < geo->nlines; ++i) {
@@ -781,7 +794,7 @@ solve_bottleneck(struct solution *sol)
 				if (next != NULL) {
 					end1= next;
 					if (sol->lin_mask[next->id] == FALSE)
-						return;
+						return NULL;
 					sol->lin_mask[next->id]= FALSE;
 				} else stuck|= 1;
 			}
@@ -793,14 +806,14 @@ solve_bottleneck(struct solution *sol)
 				if (next != NULL) {
 					end2= next;
 					if (sol->lin_mask[next->id] == FALSE)
-						return;
+						return NULL;
 					sol->lin_mask[next->id]= FALSE;
 				} else stuck|= 2;
 			}
 		}
 		/* while quitted unexpectedly -> we have a closed loop */
 		if (stuck != 3) {
-			return;
+			return NULL;
 		}
 
 		/* check if ends are within a line away */
@@ -809,18 +822,57 @@ solve_bottleneck(struct solution *sol)
 			/* we have just one big open loop */
 			if (length == nlines_on) {
 				/* avoid creating artificial solutions */
-				if (all_handled) return;
+				if (all_handled) return NULL;
 				/* assume a situation where the only un-handled tile(s)
 				   would be handled by setting this line. In this situation,
 				   we can't cross out this line. */
-				if (bottleneck_is_final_line(sol, next)) return;
+				if (bottleneck_is_final_line(sol, next)) return NULL;
 			}
-			solve_set_line_cross(sol, next);
+			return next;
+		}
+	}
+	return NULL;
+}
 
-			//return length;
-			return;
+
+/*
+ * Find two ends of a partial loop. If only separated by a line, cross it
+ */
+void
+solve_bottleneck(struct solution *sol)
+{
+	int i;
+	struct line *lin;
+	int nlines_on=0;		// total number of lines on
+	struct geometry *geo=sol->geo;
+	gboolean all_handled=TRUE;
+
+	sol->nchanges= sol->ntile_changes= 0;
+	SOLVE_PROFILE_ENTER(SOLVE_RULE_BOTTLENECK);
+	/* check if all numbered tiles have been handled */
+	for(i=0; i < geo->ntiles; ++i) {
+		if (sol->numbers[i] != -1 && sol->tile_done[i] == FALSE) {
+			all_handled= FALSE;
+			break;
 		}
 	}
+	SOLVE_PROFILE_SCAN(MIN(i + 1, geo->ntiles));
+
+	/* initialize line mask */
+	for(i=0; i < geo->nlines; ++i) {
+		if (sol->states[i] == LINE_ON) {
+			sol->lin_mask[i]= TRUE;
+			++nlines_on;
+		} else {
+			sol->lin_mask[i]= FALSE;	// mask out not-ON lines
+		}
+	}
+	SOLVE_PROFILE_SCAN(geo->nlines);
+
+	lin= bottleneck_find_line(sol, nlines_on, all_handled);
+	if (lin != NULL)
+		solve_set_line_cross(sol, lin);
+	SOLVE_PROFILE_LEAVE(sol);
 }
 
 
@@ -972,7 +1024,7 @@ solution_loop(struct solution *sol, int max_iter, int max_level)
 		/* quick check to see if we found a solution */
 		if (sol->num_tile_done == sol->geo->ntiles &&
 			sol->num_vertex_done == sol->geo->nvertex) {
-			printf("last level: %d  (%d)\n", level, sol->nchanges);
+			g_debug("last level: %d  (%d)", level, sol->nchanges);
 			break;
 		}
 
@@ -991,14 +1043,15 @@ solve_game(struct geometry *geo, struct game *game, double *final_score)
 {
 	struct solution *sol;
 
+	fences_benchmark_enter("solve");
 	/* init solution structure */
 	sol= solve_create_solution_data(geo, game);
 
 	/* These two tests only run once at the very start */
 	solve_zero_tiles(sol);
-	printf("zero: changes %d\n", sol->nchanges);
+	g_debug("zero: changes %d", sol->nchanges);
 	solve_maxnumber_tiles(sol);
-	printf("maxnumber: changes %d\n", sol->nchanges);
+	g_debug("maxnumber: changes %d", sol->nchanges);
 
 	/* run solution loop with no limits */
 	solution_loop(sol, -1, -1);
@@ -1006,20 +1059,21 @@ solve_game(struct geometry *geo, struct game *game, double *final_score)
 	/* print level counts */
 	int i;
 	for(i=0; i < SOLVE_NUM_LEVELS; ++i)
-		printf("-Level %1d: %3d\n", i, sol->level_count[i]);
+		g_debug("-Level %1d: %3d", i, sol->level_count[i]);
 
 	calculate_difficulty(sol);
 
 	/* check if we have a valid solution */
 	if (solve_check_solution(sol)) {
 		sol->solved= TRUE;
-		printf("Solution good! (%lf)\n", sol->difficulty);
+		g_debug("Solution good! (%lf)", sol->difficulty);
 	} else {
 		sol->solved= FALSE;
 		sol->difficulty+= 10;
-		printf("Solution BAD! (%lf)\n", sol->difficulty);
+		g_debug("Solution BAD! (%lf)", sol->difficulty);
 	}
 
+	fences_benchmark_leave();
 	return sol;
 }
 
@@ -1099,6 +1153,7 @@ test_solve_game_trace(struct geometry *geo, struct game *game)
 void
 solve_game_solution(struct solution *sol, int max_level)
 {
+	fences_benchmark_enter("solve");
 	/* These two tests only run once at the very start */
 	solve_zero_tiles(sol);
 	solve_maxnumber_tiles(sol);
@@ -1111,9 +1166,10 @@ solve_game_solution(struct solution *sol, int max_level)
 	/* check if we have a valid solution */
 	if (solve_check_solution(sol)) {
 		sol->solved= TRUE;
-		printf("Solution good! (%lf)\n", sol->difficulty);
+		g_debug("Solution good! (%lf)", sol->difficulty);
 	} else {
 		sol->solved= FALSE;
-		printf("Solution BAD! (%lf)\n", sol->difficulty);
+		g_debug("Solution BAD! (%lf)", sol->difficulty);
 	}
+	fences_benchmark_leave();
 }
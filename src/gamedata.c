@@ -14,6 +14,10 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
  */
 
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
 #include <glib.h>
 #include <math.h>
 #include <string.h>
@@ -21,6 +25,15 @@
 #include "gamedata.h"
 #include "tiles.h"
 #include "history.h"
+#include "journal.h"
+#include "animation.h"
+#include "loop-tracker.h"
+#include "hint.h"
+#include "checker.h"
+#include "view.h"
+#include "spatial-index.h"
+#include "solve-profile.h"
+#include "benchmark.h"
 
 
 /* holds info about board */
@@ -55,6 +68,19 @@ static build_geometry_func_type build_skeleton_func[NUMBER_TILE_TYPE]={
 };
 
 
+/* number of tile skeletons kept for New Game previews */
+#define PREVIEW_CACHE_SIZE		16
+
+/*
+ * Cached preview skeleton
+ */
+struct preview_entry {
+	int type;				// tile type
+	int size;				// game size
+	struct skeleton *skel;	// line segments (NULL if entry is empty)
+};
+
+
 
 /*
  * Create a new empty game structure that fits geometry 'geo'
@@ -70,12 +96,22 @@ create_empty_gamedata(struct geometry *geo)
 	game->states= (int*)g_malloc(geo->nlines*sizeof(int));
 	game->numbers= (int*)g_malloc(geo->ntiles*sizeof(int));
 	game->solution= (int*)g_malloc(geo->nlines*sizeof(int));
-	for(i=0; i < geo->nlines; ++i)
+	game->vertex_display= (int*)g_malloc(geo->nvertex*sizeof(int));
+	game->tile_display= (int*)g_malloc(geo->ntiles*sizeof(int));
+	game->line_fx= (struct fx*)g_malloc(geo->nlines*sizeof(struct fx));
+	for(i=0; i < geo->nlines; ++i) {
 		game->states[i]= LINE_OFF;
+		game->solution[i]= LINE_OFF;
+	}
 	for(i=0; i < geo->ntiles; ++i)
 		game->numbers[i]= -1;
 	game->nlines_on= 0;
 	game->solution_nlines_on= 0;
+	game->nmismatch= 0;
+	game->loops= loop_tracker_new(geo);
+	game->hints= NULL;
+	game->hint= NULL;
+	gamedata_reset_display(geo, game);
 
 	return game;
 }
@@ -90,10 +126,61 @@ free_gamedata(struct game *game)
 	g_free(game->states);
 	g_free(game->numbers);
 	g_free(game->solution);
+	g_free(game->vertex_display);
+	g_free(game->tile_display);
+	g_free(game->line_fx);
+	loop_tracker_destroy(game->loops);
+	hint_engine_destroy(game->hints);
 	g_free(game);
 }
 
 
+/*
+ * Count lines ON (and lines differing from solution) and rebuild chains
+ * of ON lines after line states have been set directly
+ */
+void
+gamedata_count_lines(struct geometry *geo, struct game *game)
+{
+	int i;
+
+	game->nlines_on= 0;
+	game->nmismatch= 0;
+	loop_tracker_clear(game->loops);
+	for(i=0; i < geo->nlines; ++i) {
+		if (game->states[i] == LINE_ON) {
+			++game->nlines_on;
+			loop_tracker_set_line(game->loops, i, TRUE);
+		}
+		if ((game->states[i] == LINE_ON) != (game->solution[i] == LINE_ON))
+			++game->nmismatch;
+	}
+	if (game->hints != NULL) hint_engine_seed(game->hints);
+	game->hint= NULL;
+}
+
+
+/*
+ * Reset display state of vertices & tiles and stop FX animations
+ */
+void
+gamedata_reset_display(struct geometry *geo, struct game *game)
+{
+	int i;
+
+	for(i=0; i < geo->nvertex; ++i)
+		game->vertex_display[i]= DISPLAY_NORMAL;
+	for(i=0; i < geo->ntiles; ++i)
+		game->tile_display[i]= DISPLAY_NORMAL;
+	for(i=0; i < geo->nlines; ++i) {
+		game->line_fx[i].status= FX_OFF;
+		game->line_fx[i].frame= 0;
+	}
+	game->clip.x= game->clip.y= 0.;
+	game->clip.w= game->clip.h= geo->board_size;
+}
+
+
 /*
  * generate a 7x7 example game by hand
  */
@@ -221,8 +308,8 @@ generate_example_game(struct geometry *geo)
 	/* artificial test for FX animation */
 	/*for(i=0; i < 7; ++i) {
 		game->lines[i].state= LINE_ON;
-		game->lines[i].fx_status= 1;
-		game->lines[i].fx_frame= i;
+		game->line_fx[i].status= 1;
+		game->line_fx[i].frame= i;
 	}*/
 
 	return game;
@@ -247,7 +334,18 @@ initialize_board(void)
 	board.gameinfo.diff_index= 3;
 
 	board.click_mesh= NULL;
+	board.spatial_index= NULL;
+	board.metrics.geo= NULL;
+	board.metrics.nnumbers= 0;
+	board.metrics.numpos= NULL;
 	board.history= history_create();
+	board.animation= animation_create();
+	board.checker= checker_create(&board);
+	view_reset(&board.view);
+	board.stroke.button= 0;
+	board.stroke.lines= g_array_new(FALSE, FALSE, sizeof(int));
+	board.stroke.changed= NULL;
+	board.stroke.nlines= 0;
 	board.drawarea= NULL;
 	board.window= NULL;
 	board.game_state= GAMESTATE_NOGAME;
@@ -258,6 +356,9 @@ initialize_board(void)
 	/* generate click mesh for lines */
 	board.click_mesh= click_mesh_setup(board.geo);
 
+	/* locate elements to draw */
+	board.spatial_index= spatial_index_new(board.geo);
+
 	/* empty gamedata */
 	board.game= create_empty_gamedata(board.geo);
 	//board.game= generate_example_game(board.geo);
@@ -275,31 +376,81 @@ gamedata_clear_game(struct board *board)
 {
 	/* clear line states */
 	memset(board->game->states, 0, board->geo->nlines*sizeof(int));
-	/* clear history */
+	board->game->nlines_on= 0;
+	board->game->nmismatch= board->game->solution_nlines_on;
+	loop_tracker_clear(board->game->loops);
+	if (board->game->hints != NULL) hint_engine_seed(board->game->hints);
+	board->game->hint= NULL;
+	gamedata_reset_display(board->geo, board->game);
+	/* clear history, start journal again */
 	history_clear(board->history);
 	board->game_state= GAMESTATE_NEW;
+	history_start_journal(board);
+	checker_reset(board);
+	linechange_show_progress(board);
 }
 
 
 /*
  * Build new geometry of type determined by gameinfo
+ * Geometry is taken from the geometry cache if it has been built before.
+ * Returned geometry must be freed with geometry_cache_release.
  */
 struct geometry *
 build_geometry_tile(struct gameinfo *gameinfo)
 {
+	struct geometry *geo;
+
 	g_assert(gameinfo->type >= 0 &&  gameinfo->type < NUMBER_TILE_TYPE);
-	return build_geometry_func[gameinfo->type](gameinfo);
+	geo= geometry_cache_acquire(gameinfo);
+	if (geo == NULL) {
+		fences_benchmark_enter("geometry");
+		geo= build_geometry_func[gameinfo->type](gameinfo);
+		fences_benchmark_leave();
+		geometry_cache_insert(gameinfo, geo);
+	}
+	return geo;
 }
 
 
 /*
  * Build tile skeleton of type determined by gameinfo
+ * Only the skeleton builders are used (no connections between elements)
+ * and just the line segments are kept.
+ * Skeletons are cached: returned skeleton belongs to the cache and is only
+ * valid until PREVIEW_CACHE_SIZE more skeletons have been requested.
  */
-struct geometry *
+struct skeleton *
 build_tile_skeleton(struct gameinfo *gameinfo)
 {
+	static struct preview_entry preview_cache[PREVIEW_CACHE_SIZE];
+	static int next_entry=0;
+	struct preview_entry *entry;
+	struct geometry *geo;
+	int i;
+
 	g_assert(gameinfo->type >= 0 &&  gameinfo->type < NUMBER_TILE_TYPE);
-	return build_geometry_func[gameinfo->type](gameinfo);
+
+	/* look in cache */
+	for(i=0; i < PREVIEW_CACHE_SIZE; ++i) {
+		entry= preview_cache + i;
+		if (entry->skel != NULL && entry->type == gameinfo->type &&
+			entry->size == gameinfo->size)
+			return entry->skel;
+	}
+
+	/* build skeleton, replacing oldest entry in cache */
+	geo= build_skeleton_func[gameinfo->type](gameinfo);
+	entry= preview_cache + next_entry;
+	next_entry= (next_entry + 1) % PREVIEW_CACHE_SIZE;
+	if (entry->skel != NULL)
+		geometry_skeleton_destroy(entry->skel);
+	entry->type= gameinfo->type;
+	entry->size= gameinfo->size;
+	entry->skel= geometry_extract_skeleton(geo);
+	geometry_destroy(geo);
+
+	return entry->skel;
 }
 
 
@@ -309,31 +460,127 @@ build_tile_skeleton(struct gameinfo *gameinfo)
 void
 gamedata_destroy_current_game(struct board *board)
 {
-	geometry_destroy(board->geo);
+	animation_stop_all(board);
+	board->stroke.button= 0;
+	geometry_cache_release(board->geo);
 	board->geo= NULL;
+	board->metrics.geo= NULL;	// measure numbers again for next geometry
 	free_gamedata(board->game);
 	board->game= NULL;
 	click_mesh_destroy(board->click_mesh);
 	board->click_mesh= NULL;
+	spatial_index_destroy(board->spatial_index);
+	board->spatial_index= NULL;
 	history_clear(board->history);
 	board->game_state= GAMESTATE_NOGAME;
+	checker_reset(board);
+	linechange_show_progress(board);
 }
 
 
 /*
- * Create new game according to given gameinfo
+ * Set up geometry (and what goes with it) for given gameinfo
  */
-void
-gamedata_create_new_game(struct board *board, struct gameinfo *info)
+static void
+gamedata_setup_board(struct board *board, struct gameinfo *info)
 {
 	memcpy(&board->gameinfo, info, sizeof(struct gameinfo));
 
 	/* build geometry data from gameinfo */
 	board->geo= build_geometry_tile(info);
+	board->metrics.geo= NULL;
 
 	/* generate click mesh for lines */
 	board->click_mesh= click_mesh_setup(board->geo);
 
+	/* locate elements to draw */
+	board->spatial_index= spatial_index_new(board->geo);
+
+	/* show whole board */
+	view_reset(&board->view);
+}
+
+
+/*
+ * Create new game according to given gameinfo
+ */
+void
+gamedata_create_new_game(struct board *board, struct gameinfo *info)
+{
+	gamedata_setup_board(board, info);
+
 	/* build new game */
+#ifdef SOLVE_PROFILE
+	solve_profile_reset();
+#endif
 	board->game= build_new_game(board->geo, 4.0);
+#ifdef SOLVE_PROFILE
+	{
+		gchar *label;
+
+		label= g_strdup_printf("build type=%d size=%d", info->type, info->size);
+		solve_profile_write_json(stderr, label);
+		g_free(label);
+		solve_profile_reset();
+	}
+#endif
+
+	/* journal game, so it can be resumed */
+	history_start_journal(board);
+	checker_reset(board);
+	linechange_show_progress(board);
+}
+
+
+/*
+ * Resume game saved in journal (if any) in place of current game.
+ * Returns FALSE if there's no journal to resume from.
+ */
+gboolean
+gamedata_resume_game(struct board *board)
+{
+	struct journal_map *map;
+	struct journal_frame frame;
+	struct gameinfo info;
+	gchar *filename;
+	gboolean ok;
+
+	filename= journal_filename();
+	map= journal_map_open(filename);
+	g_free(filename);
+	if (map == NULL) return FALSE;
+
+	/* game frame comes first */
+	if (!journal_map_next(map, &frame) ||
+		!journal_read_gameinfo(&frame, &info)) {
+		journal_map_close(map);
+		return FALSE;
+	}
+
+	gamedata_destroy_current_game(board);
+	gamedata_setup_board(board, &info);
+	board->game= create_empty_gamedata(board->geo);
+	ok= journal_read_game(&frame, board->geo, board->game) &&
+		history_restore(board, map);
+	journal_map_close(map);
+
+	if (!ok) {
+		/* leave board empty */
+		g_debug("history: journal is not valid, not resuming game");
+		free_gamedata(board->game);
+		board->game= create_empty_gamedata(board->geo);
+		return FALSE;
+	}
+
+	gamedata_count_lines(board->geo, board->game);
+	/* errors and handled tiles are shown from the start */
+	if (linechange_check_all(board))
+		board->game_state= GAMESTATE_FINISHED;
+	else
+		board->game_state= GAMESTATE_ONGOING;
+	/* compact journal (and drop any damaged frames at its end) */
+	history_start_journal(board);
+	checker_reset(board);
+	linechange_show_progress(board);
+	return TRUE;
 }
@@ -43,8 +43,40 @@ enum {
 
 
 
+/* Line animations (status in struct fx) */
+enum {
+	FX_OFF,					/* not animated */
+	FX_LOOP,				/* line in loop of finished game */
+	NUM_FX
+};
+
+/* number of frames in FX_LOOP animation */
+#define FX_LOOP_FRAMES		20
+
+
+/*
+ * Animation state of a line
+ */
+struct fx {
+	int status;		// is it being animated? which animation?
+	int frame;		// frame in FX animation
+};
+
+
+/* chains of ON lines (see loop-tracker.h) */
+struct loop_tracker;
+
+/* solver context used for hints (private declaration, see hint.c) */
+struct hint_engine;
+
+/* hint given to player (see hint.h) */
+struct hint;
+
+
 /*
  * Holds game data (tile numbers and lines that are on)
+ * Also keeps display state of geometry elements, since geometry may be
+ * shared between games.
  */
 struct game {
 	int *states;		// Line states
@@ -52,6 +84,14 @@ struct game {
 	int nlines_on;		// Number of lines currently on
 	int *solution;		// Solved game
 	int solution_nlines_on;	// Number of lines on in solution
+	int nmismatch;		// Number of lines ON in game or solution, not both
+	int *vertex_display;	// display state of each vertex
+	int *tile_display;		// display state of each tile
+	struct fx *line_fx;		// FX animation of each line
+	struct clipbox clip;	// area to redraw after last change
+	struct loop_tracker *loops;	// chains & loops formed by ON lines
+	struct hint_engine *hints;	// solver context for hints (NULL until used)
+	const struct hint *hint;	// hint shown on board (NULL if none)
 };
 
 
@@ -62,21 +102,55 @@ struct line_change {
 	int id;			// id of line that changes
 	int old_state;		// old state of line
 	int new_state;		// new state of line
+	gboolean group;		// undone/redone together with previous change
 };
 
 
 /* stores history data (private declaration, see history.c) */
 struct history;
 
+/* lines being animated (private declaration, see animation.c) */
+struct animation;
+
+/* background check of player's moves (private declaration, see checker.c) */
+struct checker;
+
+/* locates elements on board (see spatial-index.h) */
+struct spatial_index;
+
 
 /*
  * Click mesh: listing lines found inside each mesh tile
+ * Lines in mesh tile b are lines[start[b]] ... lines[start[b + 1] - 1].
  */
 struct click_mesh {
 	int ntiles_side;	// number of mesh tiles per side
 	int ntiles;		// Total num of mesh tiles (nmesh_side^2)
 	double tile_size;	// size of boxes that tile gameboard
-	GSList **tiles;		// array of lists (mesh tile -> lines in it)
+	int *start;		// start of each mesh tile in lines (ntiles + 1)
+	struct line **lines;	// lines in each mesh tile
+};
+
+/*
+ * View of board in drawing area (see view.c)
+ */
+struct view {
+	double zoom;		// zoom factor (1: whole board fits drawing area)
+	double x, y;		// board coords shown at top left corner
+	gboolean dragging;	// is board being dragged (panned)?
+	double drag_x, drag_y;	// last pointer position while dragging (pixels)
+};
+
+/*
+ * Stroke: lines changed by dragging the pointer over the board with a
+ * button held
+ */
+struct line_stroke {
+	int button;			// button held (0: no stroke going on)
+	struct point last;	// last pointer position (board coords)
+	GArray *lines;		// ids of lines already changed in stroke
+	guint8 *changed;	// bit set for each line in 'lines' (by id)
+	int nlines;			// number of lines 'changed' has room for
 };
 
 struct board {
@@ -85,8 +159,14 @@ struct board {
 	struct game *game;	// game data (line states and tile numbers)
 	double width_pxscale;	// Width board-to-pixel scale
 	double height_pxscale;	// Height board-to-pixel scale
+	struct view view;		// zoom & pan of board in drawing area
+	struct line_stroke stroke;	// lines being changed by dragging pointer
 	struct click_mesh *click_mesh; // click mesh
+	struct spatial_index *spatial_index; // elements to draw in each area
+	struct number_metrics metrics;	// tile numbers as drawn in window
 	struct history *history;		// history data
+	struct animation *animation;	// lines being animated
+	struct checker *checker;		// background check of moves
 	gpointer drawarea;	// widget where board is drawn
 	gpointer window;	// main gtk window
 	int game_state;		// hold current state of game
@@ -96,21 +176,28 @@ struct board {
 /* gamedata.c */
 struct game* create_empty_gamedata(struct geometry *geo);
 void free_gamedata(struct game *game);
+void gamedata_reset_display(struct geometry *geo, struct game *game);
+void gamedata_count_lines(struct geometry *geo, struct game *game);
 struct board* initialize_board(void);
 void gamedata_clear_game(struct board *board);
 struct geometry *build_board_geometry(struct gameinfo *gameinfo);
 void gamedata_destroy_current_game(struct board *board);
 void gamedata_create_new_game(struct board *board, struct gameinfo *info);
+gboolean gamedata_resume_game(struct board *board);
 struct geometry *build_geometry_tile(struct gameinfo *gameinfo);
-struct geometry *build_tile_skeleton(struct gameinfo *gameinfo);
+struct skeleton *build_tile_skeleton(struct gameinfo *gameinfo);
+
+/* geometry-cache.c */
+struct geometry* geometry_cache_acquire(const struct gameinfo *info);
+void geometry_cache_insert(const struct gameinfo *info, struct geometry *geo);
+void geometry_cache_release(struct geometry *geo);
+void geometry_cache_clear(void);
 
 /* click-mesh.c */
 void click_mesh_destroy(struct click_mesh *click_mesh);
 struct click_mesh* click_mesh_setup(const struct geometry *geo);
-
-/* mesh-tools.c */
-gboolean is_area_inside_box(struct point *area, struct point *box);
-gboolean is_point_inside_area(struct point *point, struct point *area);
+struct line* click_mesh_find_line(const struct click_mesh *click_mesh,
+								  struct point *point);
 
 /* build-game.c */
 struct game* build_new_game(struct geometry *geo, double difficulty);
@@ -119,6 +206,11 @@ struct game* build_new_game(struct geometry *geo, double difficulty);
 void build_new_loop(struct geometry *geo, struct game *game, gboolean trace);
 
 /* line-change.c */
+void make_line_changes(struct board *board, struct line_change *changes,
+					   int nchanges);
 inline void make_line_change(struct board *board, struct line_change *change);
+void linechange_show_progress(struct board *board);
+void linechange_show_hint(struct board *board, const struct hint *hint);
+gboolean linechange_check_all(struct board *board);
 
 #endif
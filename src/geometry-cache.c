@@ -0,0 +1,238 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+#include <glib.h>
+
+#include "geometry.h"
+#include "gamedata.h"
+#include "geometry-file.h"
+
+
+/*
+ * Geometry cache.
+ * Geometries are kept in memory (most recently used first) and also saved
+ * to disk as geometry files (see geometry-file.c), so a (tile type, size)
+ * is only ever built once. Cached geometries are shared: nothing that
+ * changes during a game may be stored in them.
+ */
+
+/* number of unused geometries kept in memory */
+#define GEOMETRY_CACHE_SIZE		4
+
+/* version of cache files, bump whenever the builders change */
+#define GEOMETRY_CACHE_VERSION	3
+
+
+/*
+ * In-memory cache entry
+ */
+struct cache_entry {
+	int type;				// tile type
+	int size;				// game size
+	struct geometry *geo;	// cached geometry
+	int refs;				// number of users of geometry
+};
+
+
+/* list of cached geometries, most recently used first */
+static GList *cache_list=NULL;
+
+
+
+/*
+ * Return name of cache file for given tile type and size.
+ * Must be freed with g_free.
+ */
+static gchar*
+geometry_cache_filename(int type, int size)
+{
+	gchar *name;
+	gchar *filename;
+
+	name= g_strdup_printf("geometry-v%d-%d-%d.bin", GEOMETRY_CACHE_VERSION,
+						  type, size);
+	filename= g_build_filename(g_get_user_cache_dir(), "fences", name, NULL);
+	g_free(name);
+	return filename;
+}
+
+
+/*
+ * Save geometry to disk
+ */
+static void
+geometry_cache_save(const struct gameinfo *info, struct geometry *geo)
+{
+	gchar *dir;
+	gchar *filename;
+
+	filename= geometry_cache_filename(info->type, info->size);
+	dir= g_build_filename(g_get_user_cache_dir(), "fences", NULL);
+	if (g_mkdir_with_parents(dir, 0755) != 0 ||
+		!geometry_file_save(geo, info->type, info->size, filename)) {
+		g_debug("geometry cache: could not write '%s'", filename);
+	}
+	g_free(dir);
+	g_free(filename);
+}
+
+
+/*
+ * Load geometry from disk.
+ * Returns NULL if geometry is not in disk cache or file is not valid.
+ */
+static struct geometry*
+geometry_cache_load(const struct gameinfo *info)
+{
+	struct geometry_map *map;
+	struct geometry *geo=NULL;
+	gchar *filename;
+
+	filename= geometry_cache_filename(info->type, info->size);
+	map= geometry_map_open(filename);
+	g_free(filename);
+	if (map == NULL) return NULL;
+
+	if (map->header->type == info->type && map->header->size == info->size)
+		geo= geometry_map_to_geometry(map);
+	geometry_map_close(map);
+	return geo;
+}
+
+
+/*
+ * Drop unused geometries beyond cache size (least recently used first)
+ */
+static void
+geometry_cache_trim(int keep)
+{
+	GList *list;
+	GList *prev;
+	struct cache_entry *entry;
+	int nunused=0;
+
+	for(list=cache_list; list != NULL; list=g_list_next(list)) {
+		entry= (struct cache_entry*)list->data;
+		if (entry->refs == 0) ++nunused;
+	}
+
+	list= g_list_last(cache_list);
+	while(list != NULL && nunused > keep) {
+		prev= g_list_previous(list);
+		entry= (struct cache_entry*)list->data;
+		if (entry->refs == 0) {
+			geometry_destroy(entry->geo);
+			g_free(entry);
+			cache_list= g_list_delete_link(cache_list, list);
+			--nunused;
+		}
+		list= prev;
+	}
+}
+
+
+/*
+ * Add new entry to front of cache
+ */
+static void
+geometry_cache_add_entry(const struct gameinfo *info, struct geometry *geo)
+{
+	struct cache_entry *entry;
+
+	entry= (struct cache_entry*)g_malloc(sizeof(struct cache_entry));
+	entry->type= info->type;
+	entry->size= info->size;
+	entry->geo= geo;
+	entry->refs= 1;
+	cache_list= g_list_prepend(cache_list, entry);
+}
+
+
+/*
+ * Get geometry of given type and size from cache (memory or disk).
+ * Returns NULL if geometry is not cached.
+ * Returned geometry is shared and must be freed with geometry_cache_release.
+ */
+struct geometry*
+geometry_cache_acquire(const struct gameinfo *info)
+{
+	GList *list;
+	struct cache_entry *entry;
+	struct geometry *geo;
+
+	/* look in memory */
+	for(list=cache_list; list != NULL; list=g_list_next(list)) {
+		entry= (struct cache_entry*)list->data;
+		if (entry->type == info->type && entry->size == info->size) {
+			/* move to front of list */
+			cache_list= g_list_remove_link(cache_list, list);
+			cache_list= g_list_concat(list, cache_list);
+			++entry->refs;
+			return entry->geo;
+		}
+	}
+
+	/* look on disk */
+	geo= geometry_cache_load(info);
+	if (geo != NULL)
+		geometry_cache_add_entry(info, geo);
+	return geo;
+}
+
+
+/*
+ * Add newly built geometry to cache (memory and disk).
+ * Caller keeps a reference and must free it with geometry_cache_release.
+ */
+void
+geometry_cache_insert(const struct gameinfo *info, struct geometry *geo)
+{
+	geometry_cache_add_entry(info, geo);
+	geometry_cache_save(info, geo);
+}
+
+
+/*
+ * Release geometry obtained from the cache
+ */
+void
+geometry_cache_release(struct geometry *geo)
+{
+	GList *list;
+	struct cache_entry *entry;
+
+	for(list=cache_list; list != NULL; list=g_list_next(list)) {
+		entry= (struct cache_entry*)list->data;
+		if (entry->geo == geo) {
+			g_assert(entry->refs > 0);
+			--entry->refs;
+			geometry_cache_trim(GEOMETRY_CACHE_SIZE);
+			return;
+		}
+	}
+	/* not a cached geometry */
+	geometry_destroy(geo);
+}
+
+
+/*
+ * Free all unused geometries kept in memory
+ */
+void
+geometry_cache_clear(void)
+{
+	geometry_cache_trim(0);
+}
@@ -0,0 +1,442 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+#include <glib.h>
+#include <string.h>
+
+#include "geometry.h"
+#include "geometry-file.h"
+
+
+/* arrays in file are aligned to this many bytes */
+#define GEOFILE_ALIGN		8
+#define GEOFILE_ALIGN_UP(x)	(((x) + GEOFILE_ALIGN - 1) & ~(guint64)(GEOFILE_ALIGN - 1))
+
+
+/*
+ * Save geometry to a binary geometry file.
+ * 'type' and 'size' are stored to identify the geometry (may be -1).
+ * File is written atomically.
+ */
+gboolean
+geometry_file_save(struct geometry *geo, int type, int size,
+				   const char *filename)
+{
+	struct geofile_header *header;
+	struct geofile_vertex *fvertex;
+	struct geofile_tile *ftile;
+	struct geofile_line *flin;
+	gint32 *index;
+	gint32 pos=0;
+	struct vertex *vertex;
+	struct tile *tile;
+	struct line *lin;
+	gchar *data;
+	guint64 vertex_offset, tile_offset, line_offset, index_offset;
+	guint64 len;
+	int nindex=0;
+	int i, j;
+	gboolean ret;
+
+	/* size of index pool */
+	for(i=0; i < geo->nvertex; ++i)
+		nindex+= geo->vertex[i].nlines + geo->vertex[i].ntiles;
+	for(i=0; i < geo->ntiles; ++i)
+		nindex+= geo->tiles[i].nvertex + geo->tiles[i].nsides;
+	for(i=0; i < geo->nlines; ++i)
+		nindex+= geo->lines[i].nin + geo->lines[i].nout;
+
+	/* header + arrays, each one aligned */
+	vertex_offset= GEOFILE_ALIGN_UP(sizeof(struct geofile_header));
+	tile_offset= GEOFILE_ALIGN_UP(vertex_offset +
+								  geo->nvertex*sizeof(struct geofile_vertex));
+	line_offset= GEOFILE_ALIGN_UP(tile_offset +
+								  geo->ntiles*sizeof(struct geofile_tile));
+	index_offset= GEOFILE_ALIGN_UP(line_offset +
+								   geo->nlines*sizeof(struct geofile_line));
+	len= index_offset + nindex*sizeof(gint32);
+	data= (gchar*)g_malloc0(len);
+
+	header= (struct geofile_header*)data;
+	header->magic= GEOFILE_MAGIC;
+	header->version= GEOFILE_VERSION;
+	header->header_size= sizeof(struct geofile_header);
+	header->byte_order= GEOFILE_BYTE_ORDER;
+	header->type= type;
+	header->size= size;
+	header->nvertex= geo->nvertex;
+	header->ntiles= geo->ntiles;
+	header->nlines= geo->nlines;
+	header->max_numlines= geo->max_numlines;
+	header->nindex= nindex;
+	header->vertex_offset= vertex_offset;
+	header->tile_offset= tile_offset;
+	header->line_offset= line_offset;
+	header->index_offset= index_offset;
+	header->file_size= len;
+	header->tile_width= geo->tile_width;
+	header->tile_height= geo->tile_height;
+	header->on_line_width= geo->on_line_width;
+	header->off_line_width= geo->off_line_width;
+	header->cross_line_width= geo->cross_line_width;
+	header->cross_radius= geo->cross_radius;
+	header->font_scale= geo->font_scale;
+	header->board_size= geo->board_size;
+	header->board_margin= geo->board_margin;
+	header->game_size= geo->game_size;
+
+	fvertex= (struct geofile_vertex*)(data + vertex_offset);
+	ftile= (struct geofile_tile*)(data + tile_offset);
+	flin= (struct geofile_line*)(data + line_offset);
+	index= (gint32*)(data + index_offset);
+
+	/* vertices */
+	vertex= geo->vertex;
+	for(i=0; i < geo->nvertex; ++i) {
+		fvertex->pos= vertex->pos;
+		fvertex->nlines= vertex->nlines;
+		fvertex->lines= pos;
+		for(j=0; j < vertex->nlines; ++j)
+			index[pos++]= vertex->lines[j]->id;
+		fvertex->ntiles= vertex->ntiles;
+		fvertex->tiles= pos;
+		for(j=0; j < vertex->ntiles; ++j)
+			index[pos++]= vertex->tiles[j]->id;
+		++fvertex;
+		++vertex;
+	}
+
+	/* tiles */
+	tile= geo->tiles;
+	for(i=0; i < geo->ntiles; ++i) {
+		ftile->center= tile->center;
+		ftile->nvertex= tile->nvertex;
+		ftile->vertex= pos;
+		for(j=0; j < tile->nvertex; ++j)
+			index[pos++]= tile->vertex[j]->id;
+		ftile->nsides= tile->nsides;
+		ftile->sides= pos;
+		for(j=0; j < tile->nsides; ++j)
+			index[pos++]= tile->sides[j]->id;
+		++ftile;
+		++tile;
+	}
+
+	/* lines */
+	lin= geo->lines;
+	for(i=0; i < geo->nlines; ++i) {
+		memcpy(flin->inf, lin->inf, 4*sizeof(struct point));
+		flin->clip= lin->clip;
+		flin->ends[0]= lin->ends[0]->id;
+		flin->ends[1]= lin->ends[1]->id;
+		flin->ntiles= lin->ntiles;
+		flin->tiles[0]= lin->tiles[0]->id;
+		flin->tiles[1]= (lin->ntiles == 2) ? lin->tiles[1]->id : -1;
+		flin->nin= lin->nin;
+		flin->in= pos;
+		for(j=0; j < lin->nin; ++j)
+			index[pos++]= lin->in[j]->id;
+		flin->nout= lin->nout;
+		flin->out= pos;
+		for(j=0; j < lin->nout; ++j)
+			index[pos++]= lin->out[j]->id;
+		++flin;
+		++lin;
+	}
+	g_assert(pos == nindex);
+
+	ret= g_file_set_contents(filename, data, len, NULL);
+	g_free(data);
+	return ret;
+}
+
+
+/*
+ * Check that array of 'n' elements of size 'size' at 'offset' fits in file
+ */
+static gboolean
+geometry_map_check_array(guint64 offset, gint32 n, gsize size, guint64 len)
+{
+	if (n < 0 || (offset % GEOFILE_ALIGN) != 0) return FALSE;
+	return offset <= len && (guint64)n*size <= len - offset;
+}
+
+
+/*
+ * Map geometry file in memory (read-only).
+ * Only the header is checked, contents are used as they are on disk.
+ * Returns NULL if file can't be mapped or is not a valid geometry file.
+ */
+struct geometry_map*
+geometry_map_open(const char *filename)
+{
+	GMappedFile *file;
+	struct geometry_map *map;
+	const struct geofile_header *header;
+	const gchar *data;
+	guint64 len;
+
+	file= g_mapped_file_new(filename, FALSE, NULL);
+	if (file == NULL) return NULL;
+	data= g_mapped_file_get_contents(file);
+	len= g_mapped_file_get_length(file);
+
+	/* check header */
+	header= (const struct geofile_header*)data;
+	if (len < sizeof(struct geofile_header) ||
+		header->magic != GEOFILE_MAGIC ||
+		header->version != GEOFILE_VERSION ||
+		header->header_size != sizeof(struct geofile_header) ||
+		header->byte_order != GEOFILE_BYTE_ORDER ||
+		header->file_size != len ||
+		header->max_numlines < 0 ||
+		!geometry_map_check_array(header->vertex_offset, header->nvertex,
+								  sizeof(struct geofile_vertex), len) ||
+		!geometry_map_check_array(header->tile_offset, header->ntiles,
+								  sizeof(struct geofile_tile), len) ||
+		!geometry_map_check_array(header->line_offset, header->nlines,
+								  sizeof(struct geofile_line), len) ||
+		!geometry_map_check_array(header->index_offset, header->nindex,
+								  sizeof(gint32), len)) {
+		g_mapped_file_free(file);
+		return NULL;
+	}
+
+	map= (struct geometry_map*)g_malloc(sizeof(struct geometry_map));
+	map->file= file;
+	map->header= header;
+	map->vertex= (const struct geofile_vertex*)(data + header->vertex_offset);
+	map->tiles= (const struct geofile_tile*)(data + header->tile_offset);
+	map->lines= (const struct geofile_line*)(data + header->line_offset);
+	map->index= (const gint32*)(data + header->index_offset);
+
+	return map;
+}
+
+
+/*
+ * Unmap geometry file
+ */
+void
+geometry_map_close(struct geometry_map *map)
+{
+	g_mapped_file_free(map->file);
+	g_free(map);
+}
+
+
+/*
+ * Check that list of ids (n, offset) is inside index pool and that all
+ * ids are below 'max'
+ */
+static gboolean
+geometry_map_check_list(const struct geometry_map *map, gint32 n,
+						gint32 offset, gint32 max)
+{
+	int i;
+
+	if (n < 0 || offset < 0 || offset > map->header->nindex - n)
+		return FALSE;
+	for(i=0; i < n; ++i) {
+		if (map->index[offset + i] < 0 || map->index[offset + i] >= max)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+
+/*
+ * Check all links in mapped geometry
+ */
+static gboolean
+geometry_map_check_links(const struct geometry_map *map)
+{
+	const struct geofile_header *h=map->header;
+	const struct geofile_vertex *fvertex;
+	const struct geofile_tile *ftile;
+	const struct geofile_line *flin;
+	int i, j;
+
+	fvertex= map->vertex;
+	for(i=0; i < h->nvertex; ++i) {
+		if (!geometry_map_check_list(map, fvertex->nlines, fvertex->lines, h->nlines) ||
+			!geometry_map_check_list(map, fvertex->ntiles, fvertex->tiles, h->ntiles))
+			return FALSE;
+		++fvertex;
+	}
+	ftile= map->tiles;
+	for(i=0; i < h->ntiles; ++i) {
+		if (!geometry_map_check_list(map, ftile->nvertex, ftile->vertex, h->nvertex) ||
+			!geometry_map_check_list(map, ftile->nsides, ftile->sides, h->nlines))
+			return FALSE;
+		++ftile;
+	}
+	flin= map->lines;
+	for(i=0; i < h->nlines; ++i) {
+		if (flin->ntiles < 1 || flin->ntiles > 2) return FALSE;
+		for(j=0; j < 2; ++j) {
+			if (flin->ends[j] < 0 || flin->ends[j] >= h->nvertex) return FALSE;
+			if (j < flin->ntiles &&
+				(flin->tiles[j] < 0 || flin->tiles[j] >= h->ntiles))
+				return FALSE;
+		}
+		if (!geometry_map_check_list(map, flin->nin, flin->in, h->nlines) ||
+			!geometry_map_check_list(map, flin->nout, flin->out, h->nlines))
+			return FALSE;
+		++flin;
+	}
+	return TRUE;
+}
+
+
+/*
+ * Build a regular (pointer linked) geometry from a mapped geometry file.
+ * No geometric computation is done: every array is copied over and ids
+ * are turned into pointers.
+ * Link lists are stored in the geometry arena, as done by
+ * geometry_connect_skeleton.
+ * Returns NULL if links in file are not valid.
+ */
+struct geometry*
+geometry_map_to_geometry(const struct geometry_map *map)
+{
+	const struct geofile_header *h=map->header;
+	const struct geofile_vertex *fvertex;
+	const struct geofile_tile *ftile;
+	const struct geofile_line *flin;
+	const gint32 *ids;
+	struct geometry *geo;
+	struct geometry_links links;
+	struct vertex *vertex;
+	struct tile *tile;
+	struct line *lin;
+	struct line **ptr_l, **ptr_in, **ptr_out, **ptr_s;
+	struct tile **ptr_t;
+	struct vertex **ptr_v;
+	int i, j;
+
+	if (!geometry_map_check_links(map)) return NULL;
+
+	geo= geometry_create_new(h->ntiles, h->nvertex, h->nlines,
+							 h->max_numlines);
+	geo->tile_width= h->tile_width;
+	geo->tile_height= h->tile_height;
+	geo->on_line_width= h->on_line_width;
+	geo->off_line_width= h->off_line_width;
+	geo->cross_line_width= h->cross_line_width;
+	geo->cross_radius= h->cross_radius;
+	geo->font_scale= h->font_scale;
+	geo->board_size= h->board_size;
+	geo->board_margin= h->board_margin;
+	geo->game_size= h->game_size;
+
+	/* skeleton: lines are linked to their ends and tiles, and list
+	   sizes are counted */
+	memset(&links, 0, sizeof(struct geometry_links));
+	lin= geo->lines;
+	flin= map->lines;
+	for(i=0; i < h->nlines; ++i) {
+		lin->ends[0]= geo->vertex + flin->ends[0];
+		lin->ends[1]= geo->vertex + flin->ends[1];
+		lin->ntiles= flin->ntiles;
+		lin->tiles[0]= geo->tiles + flin->tiles[0];
+		lin->tiles[1]= (flin->ntiles == 2) ? geo->tiles + flin->tiles[1] : NULL;
+		links.nline_in+= flin->nin;
+		links.nline_out+= flin->nout;
+		++lin;
+		++flin;
+	}
+	for(i=0; i < h->nvertex; ++i) {
+		links.nvertex_lines+= map->vertex[i].nlines;
+		links.nvertex_tiles+= map->vertex[i].ntiles;
+	}
+	for(i=0; i < h->ntiles; ++i) {
+		links.ntile_vertex+= map->tiles[i].nvertex;
+		links.ntile_sides+= map->tiles[i].nsides;
+	}
+	geometry_arena_alloc(geo, &links);
+
+	ptr_l= links.vertex_lines;
+	ptr_t= links.vertex_tiles;
+	ptr_v= links.tile_vertex;
+	ptr_s= links.tile_sides;
+	ptr_in= links.line_in;
+	ptr_out= links.line_out;
+
+	/* vertices */
+	vertex= geo->vertex;
+	fvertex= map->vertex;
+	for(i=0; i < h->nvertex; ++i) {
+		vertex->id= i;
+		vertex->pos= fvertex->pos;
+		vertex->nlines= fvertex->nlines;
+		vertex->lines= ptr_l;
+		ids= map->index + fvertex->lines;
+		for(j=0; j < fvertex->nlines; ++j)
+			*ptr_l++= geo->lines + ids[j];
+		vertex->ntiles= fvertex->ntiles;
+		vertex->tiles= ptr_t;
+		ids= map->index + fvertex->tiles;
+		for(j=0; j < fvertex->ntiles; ++j)
+			*ptr_t++= geo->tiles + ids[j];
+		++vertex;
+		++fvertex;
+	}
+
+	/* tiles */
+	tile= geo->tiles;
+	ftile= map->tiles;
+	for(i=0; i < h->ntiles; ++i) {
+		tile->id= i;
+		tile->center= ftile->center;
+		tile->nvertex= ftile->nvertex;
+		tile->vertex= ptr_v;
+		ids= map->index + ftile->vertex;
+		for(j=0; j < ftile->nvertex; ++j)
+			*ptr_v++= geo->vertex + ids[j];
+		tile->nsides= ftile->nsides;
+		tile->sides= ptr_s;
+		ids= map->index + ftile->sides;
+		for(j=0; j < ftile->nsides; ++j)
+			*ptr_s++= geo->lines + ids[j];
+		++tile;
+		++ftile;
+	}
+
+	/* lines */
+	lin= geo->lines;
+	flin= map->lines;
+	for(i=0; i < h->nlines; ++i) {
+		lin->id= i;
+		lin->nin= flin->nin;
+		lin->in= ptr_in;
+		ids= map->index + flin->in;
+		for(j=0; j < flin->nin; ++j)
+			*ptr_in++= geo->lines + ids[j];
+		lin->nout= flin->nout;
+		lin->out= ptr_out;
+		ids= map->index + flin->out;
+		for(j=0; j < flin->nout; ++j)
+			*ptr_out++= geo->lines + ids[j];
+		memcpy(lin->inf, flin->inf, 4*sizeof(struct point));
+		mesh_prepare_area(&lin->infarea, lin->inf);
+		lin->clip= flin->clip;
+		++lin;
+		++flin;
+	}
+
+	return geo;
+}
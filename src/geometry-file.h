@@ -0,0 +1,119 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+#ifndef __INCLUDED_GEOMETRY_FILE_H__
+#define __INCLUDED_GEOMETRY_FILE_H__
+
+#include "geometry.h"
+
+
+/*
+ * Binary geometry file.
+ * File is a header followed by arrays of vertices, tiles, lines and a pool
+ * of indices. All links are ids (or offsets into the index pool), so the
+ * file is relocatable and can be used directly from a read-only mapping.
+ * Data is stored in native byte order (file is rejected otherwise).
+ */
+#define GEOFILE_MAGIC		0x46474546	/* "FEGF" */
+#define GEOFILE_VERSION		1
+#define GEOFILE_BYTE_ORDER	0x01020304
+
+
+struct geofile_header {
+	guint32 magic;
+	guint32 version;
+	guint32 header_size;	// sizeof(struct geofile_header)
+	guint32 byte_order;		// GEOFILE_BYTE_ORDER as written by creator
+	gint32 type;			// tile type (-1 if unknown)
+	gint32 size;			// game size (-1 if unknown)
+	gint32 nvertex;
+	gint32 ntiles;
+	gint32 nlines;
+	gint32 max_numlines;
+	gint32 nindex;			// number of entries in index pool
+	gint32 pad;
+	guint64 vertex_offset;	// file offsets of arrays
+	guint64 tile_offset;
+	guint64 line_offset;
+	guint64 index_offset;
+	guint64 file_size;
+	double tile_width;
+	double tile_height;
+	double on_line_width;
+	double off_line_width;
+	double cross_line_width;
+	double cross_radius;
+	double font_scale;
+	double board_size;
+	double board_margin;
+	double game_size;
+};
+
+
+/* lists are given as (number, offset into index pool) */
+struct geofile_vertex {
+	struct point pos;
+	gint32 nlines;
+	gint32 lines;			// line ids
+	gint32 ntiles;
+	gint32 tiles;			// tile ids
+};
+
+
+struct geofile_tile {
+	struct point center;
+	gint32 nvertex;
+	gint32 vertex;			// vertex ids
+	gint32 nsides;
+	gint32 sides;			// line ids
+};
+
+
+struct geofile_line {
+	struct point inf[4];
+	struct clipbox clip;
+	gint32 ends[2];			// vertex ids
+	gint32 ntiles;
+	gint32 tiles[2];		// tile ids (-1 if not present)
+	gint32 nin;
+	gint32 in;				// line ids
+	gint32 nout;
+	gint32 out;				// line ids
+	gint32 pad;
+};
+
+
+/*
+ * Read-only view of a mapped geometry file
+ */
+struct geometry_map {
+	GMappedFile *file;
+	const struct geofile_header *header;
+	const struct geofile_vertex *vertex;
+	const struct geofile_tile *tiles;
+	const struct geofile_line *lines;
+	const gint32 *index;
+};
+
+
+/* geometry-file.c */
+gboolean geometry_file_save(struct geometry *geo, int type, int size,
+							const char *filename);
+struct geometry_map* geometry_map_open(const char *filename);
+void geometry_map_close(struct geometry_map *map);
+struct geometry* geometry_map_to_geometry(const struct geometry_map *map);
+
+#endif
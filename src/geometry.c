@@ -56,30 +56,16 @@ avltree_print(struct avl_node *root, int level)
  * Before this point only lines had references to which vertices they touch.
  * This function builds the opposite references: tracks which lines each
  * vertex touches.
+ * Vertex line counts must be set already (see geometry_count_links).
  */
 static void
-geometry_connect_vertex_lines(struct geometry *geo)
+geometry_connect_vertex_lines(struct geometry *geo, struct line **ptr)
 {
 	int i;
 	struct line *lin;
 	struct vertex *vertex;
-	struct line **ptr;
 
-	/* iterate over lines and count how many lines touch each vertex */
-	lin= geo->lines;
-	for(i=0; i < geo->nlines; ++i) {
-		++(lin->ends[0]->nlines);
-		++(lin->ends[1]->nlines);
-		++lin;
-	}
-
-	/* allocate space for each vertex's list of lines.
-	   To optimize we allocate one single chunk of memory and point each vertex
-	   to a position in it. Mem required is (2*nlines) since each line touches
-	   two vertices.
-	   NOTE: 'lines' pointer of first vertex points to start of memory chunk
-	*/
-	ptr= (struct line **)g_malloc((geo->nlines*2)*sizeof(void*));
+	/* point each vertex to its position in list chunk */
 	vertex= geo->vertex;
 	for(i=0; i < geo->nvertex; ++i) {
 		/* sanity check: all vertices must have at least two lines */
@@ -110,31 +96,16 @@ geometry_connect_vertex_lines(struct geometry *geo)
 
 
 /*
- * Create and populate in & out arrays for each line.
+ * Populate in & out arrays for each line.
  */
 static void
-geometry_fill_inout(struct geometry *geo)
+geometry_fill_inout(struct geometry *geo, struct line **in_ptr,
+					struct line **out_ptr)
 {
 	struct line *lin;
 	struct vertex *vertex;
 	int i, j;
-	struct line **in_ptr, **out_ptr;
-	int in_num=0;
-	int out_num=0;
 
-	/* count total number of in & out lines */
-	lin= geo->lines;
-	for(i=0; i < geo->nlines; ++i) {
-		/* in lines for this line */
-		in_num+= lin->ends[0]->nlines - 1;
-		/* out lines for this line */
-		out_num+= lin->ends[1]->nlines - 1;
-		++lin;
-	}
-
-	/* store two big chunks of memory, then set pointers on it */
-	in_ptr= (struct line **)g_malloc0(in_num*sizeof(void*));
-	out_ptr= (struct line **)g_malloc0(out_num*sizeof(void*));
 	/* populate the in & out arrays of each line */
 	lin= geo->lines;
 	for(i=0; i < geo->nlines; ++i) {
@@ -221,13 +192,12 @@ geometry_go_around_tile(struct tile *tile, struct line *lin)
  * each tile touches, and which tiles each vertex touches.
  */
 static void
-geometry_connect_tiles(struct geometry *geo)
+geometry_connect_tiles(struct geometry *geo, struct geometry_links *links)
 {
 	int i, j;
 	struct line *lin;
 	struct vertex *vertex;
 	struct tile *tile;
-	int num_ele=0;
 	struct tile **ptr_t;
 	struct vertex **ptr_v;
 	struct line **ptr_s;
@@ -243,7 +213,6 @@ geometry_connect_tiles(struct geometry *geo)
 			++(tile->nvertex);
 			++(tile->nsides);
 			++(vertex->ntiles);
-			++num_ele;
 		}
 		vertex= lin->ends[1];
 		for(j=0; j < lin->ntiles; ++j) {
@@ -251,16 +220,12 @@ geometry_connect_tiles(struct geometry *geo)
 			++(tile->nvertex);
 			++(tile->nsides);
 			++(vertex->ntiles);
-			++num_ele;
 		}
 		++lin;
 	}
 
-	/* Compensate for over-counting elements (factor 2) */
-	num_ele= num_ele/2;
-
-	/* allocate space for tiles in each vertex. */
-	ptr_t= (struct tile **)g_malloc0(num_ele*sizeof(void*));
+	/* point to space for tiles in each vertex. */
+	ptr_t= links->vertex_tiles;
 	vertex= geo->vertex;
 	for(i=0; i < geo->nvertex; ++i) {
 		vertex->tiles= ptr_t;
@@ -269,10 +234,10 @@ geometry_connect_tiles(struct geometry *geo)
 		++vertex;
 	}
 
-	/* allocate space for vertices and lines in each tile */
+	/* point to space for vertices and lines in each tile */
 	tile= geo->tiles;
-	ptr_v= (struct vertex **)g_malloc0(num_ele*2*sizeof(void*));
-	ptr_s= (struct line **)(ptr_v + num_ele);
+	ptr_v= links->tile_vertex;
+	ptr_s= links->tile_sides;
 	for(i=0; i < geo->ntiles; ++i) {
 		tile->vertex= ptr_v;
 		ptr_v+= tile->nvertex/2;
@@ -286,30 +251,26 @@ geometry_connect_tiles(struct geometry *geo)
 	/* try each line and follow it around the tiles it touches
 	   while doing this, set tile's sides & vertex, and set
 	   vertex's tiles
-	   NOTE: tile->fx_status is reused (shamelessly) as a mask to know
-	   which tiles have been already handled. */
+	   NOTE: tile->nsides is zero until tile has been handled. */
 	lin= geo->lines;
 	for(i=0; i < geo->nlines; ++i) {
 		tile= lin->tiles[0];
-		if (tile->fx_status == 0) {
+		if (tile->nsides == 0) {
 			geometry_go_around_tile(tile, lin);
-			tile->fx_status= 1;
 		}
 		if (lin->ntiles == 2) {
 			tile= lin->tiles[1];
-			if (tile->fx_status == 0) {
+			if (tile->nsides == 0) {
 				geometry_go_around_tile(tile, lin);
-				tile->fx_status= 1;
 			}
 		}
 		++lin;
 	}
 
-	/* reset fx_status, which was used as a mask */
+	/* sanity check: all tiles handled */
 	tile= geo->tiles;
 	for(i=0; i < geo->ntiles; ++i) {
-		g_assert(tile->fx_status == 1);
-		tile->fx_status= 0;
+		g_assert(tile->nsides > 0);
 		++tile;
 	}
 }
@@ -347,6 +308,7 @@ geometry_define_line_infarea(struct geometry *geo)
 			lin->inf[3].x= lin->inf[0].x + lin->inf[2].x - lin->inf[1].x;
 			lin->inf[3].y= lin->inf[0].y + lin->inf[2].y - lin->inf[1].y;
 		}
+		mesh_prepare_area(&lin->infarea, lin->inf);
 		/* define box that contains line as [x,y];[w,h]
 		 inf[0].xy & inf[2].xy are both ends of the line */
 		if (lin->inf[0].x < lin->inf[2].x) {
@@ -491,7 +453,6 @@ geometry_add_vertex(struct geometry *geo, struct point *point)
 		vertex->lines= NULL;
 		vertex->ntiles= 0;
 		vertex->tiles= NULL;
-		vertex->display_state= DISPLAY_NORMAL;
 		++geo->nvertex;
 
 		/* insert new vertex in AVL tree */
@@ -539,20 +500,7 @@ geometry_add_line(struct geometry *geo, struct vertex *v1, struct vertex *v2)
 					  AVLTREE_DATACMP(line_cmp), &parent);
 
 	if (lin == NULL) {		/* not found, create new */
-		lin= geo->lines + geo->nlines;
-		lin->id= geo->nlines;
-		lin->ends[0]= v1;
-		lin->ends[1]= v2;
-		lin->ntiles= 0;
-		lin->tiles[0]= NULL;
-		lin->tiles[1]= NULL;
-		lin->nin= 0;
-		lin->in= NULL;
-		lin->nout= 0;
-		lin->out= NULL;
-		lin->fx_status= 0;
-		lin->fx_frame= 0;
-		++geo->nlines;
+		lin= geometry_new_line(geo, v1->id, v2->id);
 
 		/* insert new vertex in AVL tree */
 		geo->line_root= avltree_insert_node_at(parent, &value, lin,	value_cmp_int);
@@ -562,6 +510,46 @@ geometry_add_line(struct geometry *geo, struct vertex *v1, struct vertex *v2)
 }
 
 
+/*
+ * Append a new tile to skeleton geometry (no sides nor vertices yet)
+ * center: center point of tile, must be given
+ */
+struct tile*
+geometry_new_tile(struct geometry *geo, struct point *center)
+{
+	struct tile *tile;
+
+	tile= geo->tiles + geo->ntiles;
+	tile->id= geo->ntiles;
+	tile->nvertex= 0;
+	tile->vertex= NULL;
+	tile->nsides= 0;
+	tile->sides= NULL;
+	tile->center.x= center->x;
+	tile->center.y= center->y;
+	++geo->ntiles;
+
+	return tile;
+}
+
+
+/*
+ * Add side of tile going from v1 to v2 (add line if it doesn't exist)
+ * and store tile in line.
+ */
+static void
+geometry_add_tile_side(struct geometry *geo, struct tile *tile,
+					   struct vertex *v1, struct vertex *v2)
+{
+	struct line *lin;
+
+	lin= geometry_add_line(geo, v1, v2);
+	g_assert(lin->ntiles < 2);	/* no more than 2 tiles touching line */
+	lin->tiles[lin->ntiles]= tile;
+	++lin->ntiles;
+}
+
+
 /*
  * Add tile to list of tiles in skeleton geometry.
  * Add vertices and lines as required (avoiding repetitions).
@@ -581,34 +569,22 @@ geometry_add_tile(struct geometry *geo, struct point *pts, int npts,
 	struct vertex *vertex=NULL;
 	struct vertex *vertex_first;
 	struct vertex *vertex_prev=NULL;
-	struct line *lin;
+	struct point cpos;
 	int i;
 
-	tile= geo->tiles + geo->ntiles;
-	tile->id= geo->ntiles;
-	tile->nvertex= 0;
-	tile->vertex= NULL;
-	tile->nsides= 0;
-	tile->sides= NULL;
-	tile->fx_status= 0;
-	tile->fx_frame= 0;
-	tile->display_state= DISPLAY_NORMAL;
-	++geo->ntiles;
-
 	/* calculate center of tile if needed */
 	if (center == NULL) {
-		tile->center.x= pts[0].x;
-		tile->center.y= pts[0].y;
+		cpos.x= pts[0].x;
+		cpos.y= pts[0].y;
 		for(i=1; i < npts; ++i) {
-			tile->center.x+= pts[i].x;
-			tile->center.y+= pts[i].y;
+			cpos.x+= pts[i].x;
+			cpos.y+= pts[i].y;
 		}
-		tile->center.x/= (double)npts;
-		tile->center.y/= (double)npts;
-	} else {
-		tile->center.x= center->x;
-		tile->center.y= center->y;
+		cpos.x/= (double)npts;
+		cpos.y/= (double)npts;
+		center= &cpos;
 	}
+	tile= geometry_new_tile(geo, center);
 
 	/* add first vertex */
 	vertex_first= geometry_add_vertex(geo, pts);
@@ -619,19 +595,135 @@ geometry_add_tile(struct geometry *geo, struct point *pts, int npts,
 		vertex= geometry_add_vertex(geo, pts + i);
 
 		/* add line connecting last two points*/
-		lin= geometry_add_line(geo, vertex_prev, vertex);
-		/* store tile in line */
-		g_assert(lin->ntiles < 2);	/* no more than 2 tiles touching line */
-		lin->tiles[lin->ntiles]= tile;
-		++lin->ntiles;
+		geometry_add_tile_side(geo, tile, vertex_prev, vertex);
 		vertex_prev= vertex;
 	}
 
 	/* connect last point to first */
-	lin= geometry_add_line(geo, vertex, vertex_first);
-	g_assert(lin->ntiles < 2);		/* no more than 2 tiles touching line */
-	lin->tiles[lin->ntiles]= tile;
-	++lin->ntiles;
+	geometry_add_tile_side(geo, tile, vertex, vertex_first);
+}
+
+
+/*
+ * Append vertex to skeleton geometry, without looking for repetitions.
+ * Used by builders that already know which vertices are shared.
+ * Returns id of new vertex.
+ */
+int
+geometry_new_vertex(struct geometry *geo, struct point *pos)
+{
+	struct vertex *vertex;
+
+	vertex= geo->vertex + geo->nvertex;
+	vertex->id= geo->nvertex;
+	vertex->pos.x= pos->x;
+	vertex->pos.y= pos->y;
+	vertex->nlines= 0;
+	vertex->lines= NULL;
+	vertex->ntiles= 0;
+	vertex->tiles= NULL;
+	++geo->nvertex;
+
+	return vertex->id;
+}
+
+
+/*
+ * Append line joining vertices v1 and v2 (ids) to skeleton geometry,
+ * without looking for repetitions. Tiles touching line are left empty.
+ */
+struct line*
+geometry_new_line(struct geometry *geo, int v1, int v2)
+{
+	struct line *lin;
+
+	lin= geo->lines + geo->nlines;
+	lin->id= geo->nlines;
+	lin->ends[0]= geo->vertex + v1;
+	lin->ends[1]= geo->vertex + v2;
+	lin->ntiles= 0;
+	lin->tiles[0]= NULL;
+	lin->tiles[1]= NULL;
+	lin->nin= 0;
+	lin->in= NULL;
+	lin->nout= 0;
+	lin->out= NULL;
+	++geo->nlines;
+
+	return lin;
+}
+
+
+/*
+ * Add tile to skeleton geometry using already existing vertices (see
+ * geometry_new_vertex). Same as geometry_add_tile but vertices are given
+ * by id, so no position comparisons are needed.
+ * center: center point of tile, if NULL is auto-calculated as centre of gravity
+ */
+void
+geometry_add_tile_indexed(struct geometry *geo, const int *vids, int npts,
+						  struct point *center)
+{
+	struct tile *tile;
+	struct point cpos;
+	int i;
+
+	/* calculate center of tile if needed */
+	if (center == NULL) {
+		cpos.x= cpos.y= 0.;
+		for(i=0; i < npts; ++i) {
+			cpos.x+= geo->vertex[vids[i]].pos.x;
+			cpos.y+= geo->vertex[vids[i]].pos.y;
+		}
+		cpos.x/= (double)npts;
+		cpos.y/= (double)npts;
+		center= &cpos;
+	}
+	tile= geometry_new_tile(geo, center);
+
+	for(i=0; i < npts; ++i) {
+		geometry_add_tile_side(geo, tile, geo->vertex + vids[i],
+							   geo->vertex + vids[(i + 1) % npts]);
+	}
+}
+
+
+/*
+ * Measure link lists of a skeleton geometry before connecting it.
+ * Number of lines touching each vertex is stored in vertex.
+ */
+static void
+geometry_count_links(struct geometry *geo, struct geometry_links *links)
+{
+	struct line *lin;
+	int nsides=0;
+	int i;
+
+	lin= geo->lines;
+	for(i=0; i < geo->nlines; ++i) {
+		++(lin->ends[0]->nlines);
+		++(lin->ends[1]->nlines);
+		nsides+= lin->ntiles;
+		++lin;
+	}
+
+	/* each line has an in list (lines at first end but itself) and an
+	   out list (lines at second end but itself) */
+	links->nline_in= 0;
+	links->nline_out= 0;
+	lin= geo->lines;
+	for(i=0; i < geo->nlines; ++i) {
+		links->nline_in+= lin->ends[0]->nlines - 1;
+		links->nline_out+= lin->ends[1]->nlines - 1;
+		++lin;
+	}
+
+	/* tiles have as many vertices as sides, and each tile vertex is
+	   a vertex tile */
+	links->nvertex_lines= 2*geo->nlines;
+	links->ntile_sides= nsides;
+	links->ntile_vertex= nsides;
+	links->nvertex_tiles= nsides;
 }
 
 
@@ -662,6 +754,8 @@ geometry_set_distance_resolution(double distance)
 void
 geometry_connect_skeleton(struct geometry *geo)
 {
+	struct geometry_links links;
+
 	/* first free AVL trees, since they're not needed anymore */
 	if (geo->vertex_root) {
 		avltree_destroy(geo->vertex_root);
@@ -675,14 +769,18 @@ geometry_connect_skeleton(struct geometry *geo)
 	printf("nvertex: %d\n", geo->nvertex);
 	printf("nlines: %d\n", geo->nlines);
 
+	/* size link lists and move everything to a single block */
+	geometry_count_links(geo, &links);
+	geometry_arena_alloc(geo, &links);
+
 	/* connect vertices and lines */
-	geometry_connect_vertex_lines(geo);
+	geometry_connect_vertex_lines(geo, links.vertex_lines);
 
-	/* create and populate in & out arrays in each line */
-	geometry_fill_inout(geo);
+	/* populate in & out arrays in each line */
+	geometry_fill_inout(geo, links.line_in, links.line_out);
 
 	/* connect tiles to lines and vertices */
-	geometry_connect_tiles(geo);
+	geometry_connect_tiles(geo, &links);
 
 	/* define area of influence of each line */
 	geometry_define_line_infarea(geo);
@@ -694,6 +792,8 @@ geometry_connect_skeleton(struct geometry *geo)
 
 /*
  * Create new geometry
+ * Element arrays are allocated separately until geometry is connected,
+ * when they are moved to the geometry arena.
  */
 struct geometry*
 geometry_create_new(int ntiles, int nvertex, int nlines, int max_numlines)
@@ -709,7 +809,6 @@ geometry_create_new(int ntiles, int nvertex, int nlines, int max_numlines)
 	geo->tiles= (struct tile*)g_malloc(geo->ntiles*sizeof(struct tile));
 	geo->vertex= (struct vertex*)g_malloc(geo->nvertex*sizeof(struct vertex));
 	geo->lines= (struct line*)g_malloc(geo->nlines*sizeof(struct line));
-	geo->numpos= (struct point *)g_malloc(max_numlines*sizeof(struct point));
 	geo->numbers= (char *)g_malloc(2*max_numlines*sizeof(char));
 	for(i=0; i < max_numlines; ++i)
 		snprintf(geo->numbers + 2*i, 2, "%1d", i);
@@ -719,7 +818,6 @@ geometry_create_new(int ntiles, int nvertex, int nlines, int max_numlines)
 	geo->off_line_width= 0.;
 	geo->cross_line_width= 0.;
 	geo->cross_radius= 0.;
-	geo->font_size= 0.;
 	geo->font_scale= 1.;
 	geo->max_numlines= max_numlines;
 	geo->board_size= 0.;
@@ -727,27 +825,272 @@ geometry_create_new(int ntiles, int nvertex, int nlines, int max_numlines)
 	geo->game_size= 0.;
 	geo->vertex_root= NULL;
 	geo->line_root= NULL;
+	geo->arena= NULL;
+	geo->arena_size= 0;
 
 	return geo;
 }
 
 
 /*
- * Free memory used by a geometry structure
+ * Move element arrays of a skeleton geometry to a single block of memory
+ * (the arena), which also holds all link lists with sizes given in 'links'.
+ * Arena layout: tiles, vertices, lines, link lists, numbers.
+ * Skeleton links (line ends and tiles) are updated to the new arrays.
+ * On return, 'links' points to the start of each kind of list.
  */
 void
-geometry_destroy(struct geometry *geo)
+geometry_arena_alloc(struct geometry *geo, struct geometry_links *links)
 {
-	g_free(geo->tiles[0].vertex);
-	g_free(geo->vertex[0].lines);
-	g_free(geo->vertex[0].tiles);
-	g_free(geo->lines[0].in);
-	g_free(geo->lines[0].out);
+	gsize size_tiles, size_vertex, size_lines, size_lists;
+	char *ptr;
+	struct tile *tiles;
+	struct vertex *vertex;
+	struct line *lines;
+	struct line *lin;
+	int i, j;
+
+	g_assert(geo->arena == NULL);
+
+	size_tiles= geo->ntiles*sizeof(struct tile);
+	size_vertex= geo->nvertex*sizeof(struct vertex);
+	size_lines= geo->nlines*sizeof(struct line);
+	size_lists= (links->nvertex_lines + links->nvertex_tiles +
+				 links->ntile_vertex + links->ntile_sides +
+				 links->nline_in + links->nline_out)*sizeof(void*);
+	geo->arena_size= size_tiles + size_vertex + size_lines + size_lists +
+		2*geo->max_numlines*sizeof(char);
+	geo->arena= g_malloc(geo->arena_size);
+
+	/* element arrays */
+	ptr= (char*)geo->arena;
+	tiles= (struct tile*)ptr;
+	memcpy(tiles, geo->tiles, size_tiles);
+	ptr+= size_tiles;
+	vertex= (struct vertex*)ptr;
+	memcpy(vertex, geo->vertex, size_vertex);
+	ptr+= size_vertex;
+	lines= (struct line*)ptr;
+	memcpy(lines, geo->lines, size_lines);
+	ptr+= size_lines;
+
+	/* lines are the only elements with links in a skeleton */
+	lin= lines;
+	for(i=0; i < geo->nlines; ++i) {
+		lin->ends[0]= vertex + (lin->ends[0] - geo->vertex);
+		lin->ends[1]= vertex + (lin->ends[1] - geo->vertex);
+		for(j=0; j < lin->ntiles; ++j)
+			lin->tiles[j]= tiles + (lin->tiles[j] - geo->tiles);
+		++lin;
+	}
+
+	/* link lists */
+	links->vertex_lines= (struct line**)ptr;
+	links->vertex_tiles= (struct tile**)(links->vertex_lines + links->nvertex_lines);
+	links->tile_vertex= (struct vertex**)(links->vertex_tiles + links->nvertex_tiles);
+	links->tile_sides= (struct line**)(links->tile_vertex + links->ntile_vertex);
+	links->line_in= (struct line**)(links->tile_sides + links->ntile_sides);
+	links->line_out= links->line_in + links->nline_in;
+	ptr+= size_lists;
+
+	memcpy(ptr, geo->numbers, 2*geo->max_numlines*sizeof(char));
+	g_free(geo->numbers);
+	geo->numbers= ptr;
+
 	g_free(geo->tiles);
 	g_free(geo->vertex);
 	g_free(geo->lines);
-	g_free(geo->numbers);
-	g_free(geo->numpos);
+	geo->tiles= tiles;
+	geo->vertex= vertex;
+	geo->lines= lines;
+}
+
+
+/*
+ * Move pointer into arena by 'delta' bytes
+ */
+#define ARENA_REBASE(ptr, delta)	((ptr)= (void*)((char*)(ptr) + (delta)))
+
+
+/*
+ * Make a copy of a connected geometry.
+ * Arena is copied in one go, then pointers are moved to the new block.
+ * Copy can be used independently of original (e.g. from another thread).
+ */
+struct geometry*
+geometry_clone(const struct geometry *geo)
+{
+	struct geometry *copy;
+	struct tile *tile;
+	struct vertex *vertex;
+	struct line *lin;
+	gpointer *ptr;
+	gpointer *end;
+	gssize delta;
+	int i;
+
+	g_assert(geo->arena != NULL);
+	g_assert(geo->vertex_root == NULL && geo->line_root == NULL);
+
+	copy= (struct geometry*)g_memdup(geo, sizeof(struct geometry));
+	copy->arena= g_memdup(geo->arena, geo->arena_size);
+	delta= (char*)copy->arena - (char*)geo->arena;
+
+	ARENA_REBASE(copy->tiles, delta);
+	ARENA_REBASE(copy->vertex, delta);
+	ARENA_REBASE(copy->lines, delta);
+	ARENA_REBASE(copy->numbers, delta);
+
+	tile= copy->tiles;
+	for(i=0; i < copy->ntiles; ++i) {
+		ARENA_REBASE(tile->vertex, delta);
+		ARENA_REBASE(tile->sides, delta);
+		++tile;
+	}
+	vertex= copy->vertex;
+	for(i=0; i < copy->nvertex; ++i) {
+		ARENA_REBASE(vertex->lines, delta);
+		ARENA_REBASE(vertex->tiles, delta);
+		++vertex;
+	}
+	lin= copy->lines;
+	for(i=0; i < copy->nlines; ++i) {
+		ARENA_REBASE(lin->ends[0], delta);
+		ARENA_REBASE(lin->ends[1], delta);
+		ARENA_REBASE(lin->tiles[0], delta);
+		if (lin->ntiles == 2) ARENA_REBASE(lin->tiles[1], delta);
+		ARENA_REBASE(lin->in, delta);
+		ARENA_REBASE(lin->out, delta);
+		++lin;
+	}
+
+	/* link lists sit between lines and numbers: all entries are
+	   pointers into arena */
+	ptr= (gpointer*)(copy->lines + copy->nlines);
+	end= (gpointer*)copy->numbers;
+	while(ptr < end) {
+		ARENA_REBASE(*ptr, delta);
+		++ptr;
+	}
+
+	g_assert(geometry_check_arena(copy));
+	return copy;
+}
+
+
+/*
+ * Is pointer to 'n' elements of given size inside [start, end)?
+ */
+static inline gboolean
+arena_holds(gconstpointer ptr, int n, gsize size, gconstpointer start,
+			gconstpointer end)
+{
+	return (const char*)ptr >= (const char*)start &&
+		(const char*)ptr + n*size <= (const char*)end;
+}
+
+
+/*
+ * Is pointer to an element of array 'base' (with 'n' elements)?
+ */
+static inline gboolean
+arena_element(gconstpointer ptr, gconstpointer base, int n, gsize size)
+{
+	return arena_holds(ptr, 1, size, base, (const char*)base + n*size) &&
+		((const char*)ptr - (const char*)base) % size == 0;
+}
+
+
+/*
+ * Check that every link of a connected geometry resolves inside its own
+ * arena: element arrays at their place in arena, link lists between
+ * lines and numbers, and every link pointing to an element.
+ */
+gboolean
+geometry_check_arena(const struct geometry *geo)
+{
+	const char *arena=(const char*)geo->arena;
+	gconstpointer lists;
+	gconstpointer end;
+	const struct tile *tile;
+	const struct vertex *vertex;
+	const struct line *lin;
+	int i, j;
+
+	if (arena == NULL ||
+		(gconstpointer)geo->tiles != (gconstpointer)arena ||
+		(gconstpointer)geo->vertex != (gconstpointer)(geo->tiles + geo->ntiles) ||
+		(gconstpointer)geo->lines != (gconstpointer)(geo->vertex + geo->nvertex) ||
+		!arena_holds(geo->numbers, 2*geo->max_numlines, sizeof(char),
+					 geo->lines + geo->nlines, arena + geo->arena_size))
+		return FALSE;
+	lists= geo->lines + geo->nlines;
+	end= geo->numbers;
+
+	tile= geo->tiles;
+	for(i=0; i < geo->ntiles; ++i) {
+		if (!arena_holds(tile->vertex, tile->nvertex, sizeof(void*), lists, end) ||
+			!arena_holds(tile->sides, tile->nsides, sizeof(void*), lists, end))
+			return FALSE;
+		for(j=0; j < tile->nvertex; ++j)
+			if (!arena_element(tile->vertex[j], geo->vertex, geo->nvertex,
+							   sizeof(struct vertex))) return FALSE;
+		for(j=0; j < tile->nsides; ++j)
+			if (!arena_element(tile->sides[j], geo->lines, geo->nlines,
+							   sizeof(struct line))) return FALSE;
+		++tile;
+	}
+	vertex= geo->vertex;
+	for(i=0; i < geo->nvertex; ++i) {
+		if (!arena_holds(vertex->lines, vertex->nlines, sizeof(void*), lists, end) ||
+			!arena_holds(vertex->tiles, vertex->ntiles, sizeof(void*), lists, end))
+			return FALSE;
+		for(j=0; j < vertex->nlines; ++j)
+			if (!arena_element(vertex->lines[j], geo->lines, geo->nlines,
+							   sizeof(struct line))) return FALSE;
+		for(j=0; j < vertex->ntiles; ++j)
+			if (!arena_element(vertex->tiles[j], geo->tiles, geo->ntiles,
+							   sizeof(struct tile))) return FALSE;
+		++vertex;
+	}
+	lin= geo->lines;
+	for(i=0; i < geo->nlines; ++i) {
+		if (!arena_holds(lin->in, lin->nin, sizeof(void*), lists, end) ||
+			!arena_holds(lin->out, lin->nout, sizeof(void*), lists, end))
+			return FALSE;
+		for(j=0; j < 2; ++j)
+			if (!arena_element(lin->ends[j], geo->vertex, geo->nvertex,
+							   sizeof(struct vertex))) return FALSE;
+		for(j=0; j < lin->ntiles; ++j)
+			if (!arena_element(lin->tiles[j], geo->tiles, geo->ntiles,
+							   sizeof(struct tile))) return FALSE;
+		for(j=0; j < lin->nin; ++j)
+			if (!arena_element(lin->in[j], geo->lines, geo->nlines,
+							   sizeof(struct line))) return FALSE;
+		for(j=0; j < lin->nout; ++j)
+			if (!arena_element(lin->out[j], geo->lines, geo->nlines,
+							   sizeof(struct line))) return FALSE;
+		++lin;
+	}
+	return TRUE;
+}
+
+
+/*
+ * Free memory used by a geometry structure
+ */
+void
+geometry_destroy(struct geometry *geo)
+{
+	if (geo->arena != NULL) {
+		g_free(geo->arena);
+	} else {
+		/* skeleton: element arrays are still separate (no link lists) */
+		g_free(geo->tiles);
+		g_free(geo->vertex);
+		g_free(geo->lines);
+		g_free(geo->numbers);
+	}
 	if (geo->vertex_root) avltree_destroy(geo->vertex_root);
 	if (geo->line_root) avltree_destroy(geo->line_root);
 	g_free(geo);
@@ -755,27 +1098,57 @@ geometry_destroy(struct geometry *geo)
 
 
 /*
- * Set the clip region to be used in next redraw
+ * Update clip region to a box that includes previous + new clip box
  */
-void geometry_set_clip(struct geometry *geo, struct clipbox *clip)
+void geometry_clip_union(struct clipbox *clip, struct clipbox *add)
 {
-	memcpy(&geo->clip, clip, sizeof(struct clipbox));
+	struct point bt;
+
+	if (add->x + add->w > clip->x + clip->w) bt.x= add->x + add->w;
+	else bt.x= clip->x + clip->w;
+	if (add->y + add->h > clip->y + clip->h) bt.y= add->y + add->h;
+	else bt.y= clip->y + clip->h;
+	if (add->x < clip->x) clip->x= add->x;
+	if (add->y < clip->y) clip->y= add->y;
+	clip->w= bt.x - clip->x;
+	clip->h= bt.y - clip->y;
 }
 
 
 /*
- * Update the clip region to a box that includes previous + new clip box
+ * Extract line segments from a (possibly unconnected) skeleton geometry
  */
-void geometry_update_clip(struct geometry *geo, struct clipbox *clip)
+struct skeleton*
+geometry_extract_skeleton(struct geometry *geo)
 {
-	struct point bt;
+	struct skeleton *skel;
+	struct line *lin;
+	struct point *pt;
+	int i;
+
+	skel= (struct skeleton*)g_malloc(sizeof(struct skeleton));
+	skel->nlines= geo->nlines;
+	skel->ends= (struct point*)g_malloc(2*geo->nlines*sizeof(struct point));
+	skel->board_size= geo->board_size;
+	skel->line_width= geo->board_size/1000.*2;
 
-	if (clip->x + clip->w > geo->clip.x + geo->clip.w) bt.x= clip->x + clip->w;
-	else bt.x= geo->clip.x + geo->clip.w;
-	if (clip->y + clip->h > geo->clip.y + geo->clip.h) bt.y= clip->y + clip->h;
-	else bt.y= geo->clip.y + geo->clip.h;
-	if (clip->x < geo->clip.x) geo->clip.x= clip->x;
-	if (clip->y < geo->clip.y) geo->clip.y= clip->y;
-	geo->clip.w= bt.x - geo->clip.x;
-	geo->clip.h= bt.y - geo->clip.y;
+	pt= skel->ends;
+	lin= geo->lines;
+	for(i=0; i < geo->nlines; ++i) {
+		*pt++= lin->ends[0]->pos;
+		*pt++= lin->ends[1]->pos;
+		++lin;
+	}
+	return skel;
+}
+
+
+/*
+ * Free skeleton line segments
+ */
+void
+geometry_skeleton_destroy(struct skeleton *skel)
+{
+	g_free(skel->ends);
+	g_free(skel);
 }
@@ -57,7 +57,6 @@ struct vertex {
 	struct line **lines;	// lines touching dot
 	int ntiles;		// number of tiles vertex touches
 	struct tile **tiles;		// tiles vertex touches
-	int display_state;			// display state
 };
 
 
@@ -71,9 +70,20 @@ struct tile {
 	int nsides;				// number of sides of tile
 	struct line **sides;	// lines around tile
 	struct point center;	// coords of center of tile
-	int fx_status;		// is it being animated? which animation?
-	int fx_frame;		// frame in FX animation
-	int display_state;			// display state
+};
+
+
+/*
+ * Area of influence of a line prepared for hit tests: outward normal of
+ * each of its 4 sides and extent of the area projected on each normal.
+ * Side i goes from inf[i] to inf[(i + 1)%4].
+ */
+struct infarea {
+	struct point normal[4];	// outward normal of each side (not unit length)
+	double min[4];			// smallest projection of area on each normal
+	double max[4];			// largest projection of area on each normal
+	struct point tl, br;	// bounding box (top left, bottom right)
+	gboolean convex;		// is area convex?
 };
 
 
@@ -90,14 +100,15 @@ struct line {
 	struct line **in;	// lines in
 	struct line **out;	// lines out
 	struct point inf[4];	// coords of 4 points defining area of influence
+	struct infarea infarea;	// area of influence prepared for hit tests
 	struct clipbox clip;	// clip box that contains line
-	int fx_status;		// is it being animated? which animation?
-	int fx_frame;		// frame in FX animation
 };
 
 
 /*
  * Describes game geometry (how lines, tiles and dots connect to each other)
+ * Geometry may be shared by several games (see geometry-cache.c), so
+ * anything that changes during a game is kept in 'struct game'.
  */
 struct geometry {
 	int nvertex;		// Number of dots
@@ -112,9 +123,7 @@ struct geometry {
 	double off_line_width;		// width of OFF line
 	double cross_line_width;	// width of CROSSED line
 	double cross_radius;		// cross size
-	double font_size;		// font size to use for tile numbers
 	double font_scale;		// additional font scale factor for the particular type of tile
-	struct point *numpos;		// position hints for numbers
 	char *numbers;			// numbers in tiles
 	int max_numlines;		// maximum number of lines around a tile
 	double board_size;		// size of board
@@ -122,21 +131,84 @@ struct geometry {
 	double game_size;		// size of game area (board_size-2*board_margin)
 	struct avl_node *vertex_root;	// AVL tree to track vertices
 	struct avl_node *line_root;		// AVL tree to track lines
-	struct clipbox clip;		// current clip area
+	gpointer arena;			// single block holding elements and link lists
+	gsize arena_size;		// size of arena in bytes
+};
+
+
+/*
+ * Total length of each kind of link list in a connected geometry and,
+ * once the arena is allocated (see geometry_arena_alloc), where each kind
+ * of list starts in it.
+ */
+struct geometry_links {
+	int nvertex_lines;			// length of all vertex->lines lists
+	int nvertex_tiles;			// length of all vertex->tiles lists
+	int ntile_vertex;			// length of all tile->vertex lists
+	int ntile_sides;			// length of all tile->sides lists
+	int nline_in;				// length of all line->in lists
+	int nline_out;				// length of all line->out lists
+	struct line **vertex_lines;
+	struct tile **vertex_tiles;
+	struct vertex **tile_vertex;
+	struct line **tile_sides;
+	struct line **line_in;
+	struct line **line_out;
 };
 
 
+/*
+ * Font size and position of tile numbers, measured for a geometry drawn
+ * at a given size in pixels (see draw_measure_font).
+ * Geometries are shared, so whoever draws keeps its own metrics.
+ */
+struct number_metrics {
+	const struct geometry *geo;	// geometry measured (NULL: not measured)
+	int width, height;		// size in pixels measured for
+	double font_size;		// font size to use for tile numbers
+	int nnumbers;			// number of positions in numpos
+	struct point *numpos;	// position hints for numbers
+};
+
+
+/*
+ * Line segments of a tile skeleton: all that's needed to draw a preview.
+ */
+struct skeleton {
+	int nlines;				// number of lines
+	struct point *ends;		// ends of lines (2 points per line)
+	double board_size;		// size of board
+	double line_width;		// width of lines
+};
+
 
 /* geometry.c */
 void geometry_add_tile(struct geometry *geo, struct point *pts, int npts,
 					   struct point *center);
+int geometry_new_vertex(struct geometry *geo, struct point *pos);
+struct tile* geometry_new_tile(struct geometry *geo, struct point *center);
+struct line* geometry_new_line(struct geometry *geo, int v1, int v2);
+void geometry_add_tile_indexed(struct geometry *geo, const int *vids, int npts,
+							   struct point *center);
 void geometry_set_distance_resolution(double distance);
 void geometry_connect_skeleton(struct geometry *geo);
 struct geometry* geometry_create_new(int ntiles, int nvertex, int nlines,
 									 int max_numlines);
+void geometry_arena_alloc(struct geometry *geo, struct geometry_links *links);
+struct geometry* geometry_clone(const struct geometry *geo);
+gboolean geometry_check_arena(const struct geometry *geo);
 void geometry_destroy(struct geometry *geo);
-void geometry_set_clip(struct geometry *geo, struct clipbox *clip);
-void geometry_update_clip(struct geometry *geo, struct clipbox *clip);
+void geometry_clip_union(struct clipbox *clip, struct clipbox *add);
+struct skeleton* geometry_extract_skeleton(struct geometry *geo);
+void geometry_skeleton_destroy(struct skeleton *skel);
+
+/* mesh-tools.c */
+void mesh_prepare_area(struct infarea *infarea, const struct point *area);
+gboolean is_area_inside_box(const struct infarea *infarea,
+							const struct point *box);
+gboolean is_point_inside_area(const struct point *point,
+							  const struct infarea *infarea,
+							  const struct point *area);
 
 
 /* geometry-legacy.c */
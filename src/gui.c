@@ -55,6 +55,17 @@ static const GtkActionEntry ui_actions[]=
 	  N_("Give a hint"), G_CALLBACK(action_hint_cb) }
 };
 
+/*
+ * Toggle menu entries
+ */
+static const GtkToggleActionEntry ui_toggle_actions[]=
+{
+	/* Edit menu */
+	{ "check", NULL, N_("_Check Moves"), NULL,
+	  N_("Point out moves that leave no solution"),
+	  G_CALLBACK(action_check_cb), FALSE }
+};
+
 
 /*
  * Setup UIManager
@@ -85,6 +96,9 @@ gui_setup_uimanager(GtkWidget *window, struct board *board)
 	gtk_action_group_add_actions(action_group,
 								 ui_actions, G_N_ELEMENTS(ui_actions),
 								 board);
+	gtk_action_group_add_toggle_actions(action_group, ui_toggle_actions,
+										G_N_ELEMENTS(ui_toggle_actions),
+										board);
 	gtk_ui_manager_insert_action_group  (uiman, action_group, 0);
 
 	/* store some actions in main window */
@@ -148,6 +162,7 @@ gui_setup_main_window(const char *xml_file, struct board *board)
 	/* status bar */
 	statbar= gtk_statusbar_new();
 	gtk_box_pack_start(GTK_BOX(vbox), statbar, FALSE, TRUE, 0);
+	g_object_set_data(G_OBJECT(window), "statusbar", statbar);
 
 
 	/* connect some signals */
@@ -163,11 +178,18 @@ gui_setup_main_window(const char *xml_file, struct board *board)
 	g_signal_connect ((gpointer) window, "key-press-event",
 					  G_CALLBACK (window_keypressed), board);
 
-	/* catch mouse clicks on game board */
+	/* catch mouse clicks & drags on game board (and wheel for zoom) */
 	gtk_widget_add_events(drawarea,
-			      GDK_BUTTON_PRESS_MASK|GDK_BUTTON_RELEASE_MASK);
+			      GDK_BUTTON_PRESS_MASK|GDK_BUTTON_RELEASE_MASK|
+			      GDK_BUTTON_MOTION_MASK|GDK_SCROLL_MASK);
 	g_signal_connect (G_OBJECT (drawarea), "button_release_event",
 			  G_CALLBACK (drawarea_mouseclicked), board);
+	g_signal_connect (G_OBJECT (drawarea), "button_press_event",
+			  G_CALLBACK (drawarea_mousepressed), board);
+	g_signal_connect (G_OBJECT (drawarea), "motion_notify_event",
+			  G_CALLBACK (drawarea_mousemoved), board);
+	g_signal_connect (G_OBJECT (drawarea), "scroll_event",
+			  G_CALLBACK (drawarea_scrolled), board);
 
 	gtk_widget_show_all(window);
 
@@ -270,6 +292,48 @@ fencesgui_set_undoredo_state(struct board *board)
 }
 
 
+/*
+ * Replace message of given context in status bar (NULL: clear it)
+ */
+static void
+fencesgui_statusbar_message(struct board *board, const gchar *context_name,
+							const gchar *text)
+{
+	GtkStatusbar *statbar;
+	guint context;
+
+	if (board->window == NULL) return;
+	statbar= GTK_STATUSBAR(g_object_get_data(G_OBJECT(board->window),
+											 "statusbar"));
+	if (statbar == NULL) return;
+	context= gtk_statusbar_get_context_id(statbar, context_name);
+	gtk_statusbar_pop(statbar, context);
+	if (text != NULL)
+		gtk_statusbar_push(statbar, context, text);
+}
+
+
+/*
+ * Show message in status bar (NULL: clear it)
+ */
+void
+fencesgui_set_status(struct board *board, const gchar *text)
+{
+	fencesgui_statusbar_message(board, "game", text);
+}
+
+
+/*
+ * Show progress of game in status bar (NULL: clear it). Kept apart from
+ * the messages of fencesgui_set_status, so neither clears the other.
+ */
+void
+fencesgui_set_progress(struct board *board, const gchar *text)
+{
+	fencesgui_statusbar_message(board, "progress", text);
+}
+
+
 /*
  * Show About dialog
  */
@@ -293,4 +357,6 @@ void
 gui_initialize(struct board *board)
 {
 	fencesgui_set_undoredo_state(board);
+	/* game may have been set up before window existed (e.g. resumed) */
+	linechange_show_progress(board);
 }
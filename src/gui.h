@@ -26,6 +26,8 @@ GtkWidget* gui_setup_main_window(const char *xml_file, struct board *board);
 gboolean fences_clear_dialog(GtkWindow *parent);
 void fencesgui_set_undoredo_state(struct board *board);
 void fencesgui_show_about_dialog(struct board *board);
+void fencesgui_set_status(struct board *board, const gchar *text);
+void fencesgui_set_progress(struct board *board, const gchar *text);
 void gui_initialize(struct board *board);
 
 /* newgame-dialog.c */
@@ -19,6 +19,7 @@
 
 #include "geometry.h"
 #include "tiles.h"
+#include "lattice.h"
 
 #include <stdio.h>
 
@@ -45,6 +46,23 @@ hexagonal_calculate_sizes(struct geometry *geo, int dim)
 }
 
 
+/*
+ * Keep hexagons in the dimx x dimy grid of columns (missing the top one of
+ * even columns). Unit (i,j) is hexagon j + i/2 of column i.
+ */
+static gboolean
+hexagonal_clip(int i, int j, int face, const struct point *pts, int npts,
+			   gpointer data)
+{
+	int *dim=(int*)data;
+	int row;
+
+	row= j + i/2;
+	if (row < 0 || row >= dim[1]) return FALSE;
+	return !(row == 0 && (i % 2) == 0);
+}
+
+
 /*
  * Build hexagonal tile geometry skeleton (no connections)
  */
@@ -52,22 +70,14 @@ struct geometry*
 build_hex_tile_skeleton(const struct gameinfo *info)
 {
 	struct geometry *geo;
-	int i, j;
-	int dimx;
-	int dimy=info->size;
+	struct lattice lat;
+	struct lattice_face hexagon;
+	int dim[2];
 	int extra;
 	double num_x;
 	double num_y;
 	double height;
 	double side;
-	int ntiles;
-	int nvertex;
-	int nlines;
-	double x0;
-	double y0;
-	double yoffset;
-	struct point pos;
-	struct point pts[6];
 
 	/* estimate how many 'sides' wide we have */
 	num_x= (info->size/2)*3;
@@ -83,67 +93,52 @@ build_hex_tile_skeleton(const struct gameinfo *info)
 	num_x+= extra * 1.5;
 
 	/* number of units that fit wide and tall */
-	dimx= info->size + extra;
-	dimy= info->size;
+	dim[0]= info->size + extra;
+	dim[1]= info->size;
 
 	printf("num:%lfx%lf\n", num_x, num_y);
-	printf("dim:%dx%d\n", dimx, dimy);
+	printf("dim:%dx%d\n", dim[0], dim[1]);
 	printf("side: %lf\n", side);
 
-	/* coordinates of unit on top left (center of unit coords) */
-	x0= HEX_BOARD_MARGIN + (HEX_GAME_SIZE - num_x*side) / 2.0;
-	y0= HEX_BOARD_MARGIN + (HEX_GAME_SIZE - num_y*side) / 2.0;
-
-	/* create geometry with plenty of space for lines and vertex */
-	ntiles= dimx * (dimy - 1) + dimx/2;
-	nvertex= (int)(ntiles*3.5);		/* found by trial-and-error (size 5>) */
-	nlines= (int)(ntiles*4.0);		/* found by trial-and-error (size 5>) */
-	geo= geometry_create_new(ntiles, nvertex, nlines, 6);
+	/* hexagon (left vertex is position of unit) */
+	hexagon.nsides= 6;
+	hexagon.pts[0].x= 0.;
+	hexagon.pts[0].y= 0.;
+	hexagon.pts[1].x= side/2.0;
+	hexagon.pts[1].y= -height / 2.0;
+	hexagon.pts[2].x= side*3.0/2.0;
+	hexagon.pts[2].y= -height / 2.0;
+	hexagon.pts[3].x= 2.0*side;
+	hexagon.pts[3].y= 0.;
+	hexagon.pts[4].x= side*3.0/2.0;
+	hexagon.pts[4].y= height / 2.0;
+	hexagon.pts[5].x= side/2.0;
+	hexagon.pts[5].y= height / 2.0;
+
+	/* coordinates of unit on top left; odd columns are half a hexagon lower */
+	lat.origin.x= HEX_BOARD_MARGIN + (HEX_GAME_SIZE - num_x*side) / 2.0;
+	lat.origin.y= HEX_BOARD_MARGIN + (HEX_GAME_SIZE - num_y*side) / 2.0;
+	lat.a.x= side + side/2.0;
+	lat.a.y= height/2.0;
+	lat.b.x= 0.;
+	lat.b.y= height;
+	lat.nfaces= 1;
+	lat.faces= &hexagon;
+	lat.imin= 0;
+	lat.imax= dim[0] - 1;
+	lat.jmin= -(dim[0] - 1)/2;
+	lat.jmax= dim[1] - 1;
+	lat.clip= hexagonal_clip;
+	lat.clip_data= dim;
+	lat.max_numlines= 6;
+
+	geo= lattice_build_skeleton(&lat);
 	geo->board_size= HEX_BOARD_SIZE;
 	geo->board_margin= HEX_BOARD_MARGIN;
 	geo->game_size= HEX_BOARD_SIZE - 2*HEX_BOARD_MARGIN;
-	geometry_set_distance_resolution(side/10.0);
-
-	/* create hexagons */
-	geo->ntiles= 0;
-	geo->nvertex= 0;
-	geo->nlines= 0;
-	for(i=0; i < dimx; ++i) {
-		pos.x= x0 + i*(side + side/2.0);
-		yoffset= (i % 2) * height/2.0;
-		for(j=0; j < dimy; ++j) {
-			if (j == 0 && (i % 2) == 0) continue;
-			pos.y= y0 + yoffset + j * height;
-			pts[0].x= pos.x;
-			pts[0].y= pos.y;
-			pts[1].x= pos.x + side/2.0;
-			pts[1].y= pos.y - height / 2.0;
-			pts[2].x= pos.x + side*3.0/2.0;
-			pts[2].y= pos.y - height / 2.0;
-			pts[3].x= pos.x + 2.0*side;
-			pts[3].y= pos.y;
-			pts[4].x= pos.x + side*3.0/2.0;
-			pts[4].y= pos.y + height / 2.0;
-			pts[5].x= pos.x + side/2.0;
-			pts[5].y= pos.y + height / 2.0;
-
-			geometry_add_tile(geo, pts, 6, NULL);
-		}
-	}
-
-	printf("ntiles: %d (%d)\n", geo->ntiles, ntiles);
-	printf("nvertex: %d (%d)\n", geo->nvertex, nvertex);
-	printf("nlines: %d (%d)\n", geo->nlines, nlines);
-
-	/* make sure we didn't underestimate max numbers */
-	g_assert(geo->ntiles <= ntiles);
-	g_assert(geo->nvertex <= nvertex);
-	g_assert(geo->nlines <= nlines);
-
-	/* realloc to actual number of tiles, vertices and lines */
-	geo->tiles= g_realloc(geo->tiles, geo->ntiles*sizeof(struct tile));
-	geo->vertex= g_realloc(geo->vertex, geo->nvertex*sizeof(struct vertex));
-	geo->lines= g_realloc(geo->lines, geo->nlines*sizeof(struct line));
+
+	/* sanity check: see if we got the number of tiles we expected */
+	g_assert(geo->ntiles == dim[0] * (dim[1] - 1) + dim[0]/2);
 
 	return geo;
 }
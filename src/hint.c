@@ -0,0 +1,403 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+#include <glib.h>
+
+#include "gamedata.h"
+#include "game-solver.h"
+#include "hint.h"
+
+
+/*
+ * Hint engine.
+ * A solver context is seeded once from the player's lines and then kept
+ * up to date as lines change (only the counts of the tiles and vertices
+ * touching a changed line are touched), so a hint doesn't have to build
+ * the solver state from scratch.
+ * Only lines that agree with the solution are given to the solver: lines
+ * ON where the solution is OFF, or crossed where the solution is ON, are
+ * counted as wrong and are the first thing reported.
+ * A hint runs the solver rules, cheapest first, until one of them finds
+ * something. The lines it sets are reported and then taken back, so the
+ * context keeps following the player's lines.
+ */
+
+
+/*
+ * Stores hint engine data
+ */
+struct hint_engine {
+	struct geometry *geo;	// geometry of game
+	struct game *game;		// game followed by engine
+	struct solution *sol;	// player's lines that agree with solution
+	int nwrong;				// number of lines contradicting solution
+	struct hint hint;		// last hint found
+};
+
+
+/*
+ * Solver rule tried for a hint
+ */
+struct hint_rule {
+	int level;					// solver level of rule
+	void (*solve)(struct solution *sol);
+};
+
+static void hint_try_combinations0(struct solution *sol);
+static void hint_try_combinations1(struct solution *sol);
+static void hint_try_combinations2(struct solution *sol);
+
+/* rules, cheapest first. Crossing lines comes first: it also marks
+   finished tiles and vertices as handled, so the rules after it see the
+   same context whether it has just been seeded or has followed the game
+   for a while. */
+static const struct hint_rule hint_rules[]={
+	{0, solve_cross_lines},
+	{0, solve_trivial_vertex},
+	{0, solve_zero_tiles},
+	{0, solve_maxnumber_tiles},
+	{1, solve_trivial_tiles},
+	{2, solve_bottleneck},
+	{3, solve_corner},
+	{4, solve_maxnumber_incoming_line},
+	{4, solve_maxnumber_exit_line},
+	{5, solve_tiles_net_1},
+	{6, hint_try_combinations0},
+	{7, hint_try_combinations1},
+	{8, hint_try_combinations2}
+};
+#define NUM_HINT_RULES	(sizeof(hint_rules)/sizeof(struct hint_rule))
+
+
+/*
+ * Try combinations around tiles, with increasing look-ahead
+ */
+static void
+hint_try_combinations0(struct solution *sol)
+{
+	solve_try_combinations(sol, 0);
+}
+
+static void
+hint_try_combinations1(struct solution *sol)
+{
+	solve_try_combinations(sol, 1);
+}
+
+static void
+hint_try_combinations2(struct solution *sol)
+{
+	solve_try_combinations(sol, 2);
+}
+
+
+/*
+ * Does player's line state contradict solution?
+ */
+static inline gboolean
+hint_is_wrong(const struct game *game, int id, int state)
+{
+	if (state == LINE_ON) return game->solution[id] != LINE_ON;
+	if (state == LINE_CROSSED) return game->solution[id] == LINE_ON;
+	return FALSE;
+}
+
+
+/*
+ * Add (delta=1) or remove (delta=-1) line state to counts of tiles and
+ * vertices around line
+ */
+static void
+hint_count_line(struct solution *sol, const struct line *lin, int state,
+				int delta)
+{
+	int i;
+
+	if (state == LINE_ON) {
+		for(i=0; i < lin->ntiles; ++i)
+			sol->tile_count[lin->tiles[i]->id].on+= delta;
+		sol->vertex_count[lin->ends[0]->id].on+= delta;
+		sol->vertex_count[lin->ends[1]->id].on+= delta;
+	} else if (state == LINE_CROSSED) {
+		for(i=0; i < lin->ntiles; ++i)
+			sol->tile_count[lin->tiles[i]->id].cross+= delta;
+		sol->vertex_count[lin->ends[0]->id].cross+= delta;
+		sol->vertex_count[lin->ends[1]->id].cross+= delta;
+	}
+}
+
+
+/*
+ * Tiles and vertices around line must be looked at again by the rules
+ */
+static void
+hint_undo_done(struct solution *sol, const struct line *lin)
+{
+	int i, id;
+
+	for(i=0; i < lin->ntiles; ++i) {
+		id= lin->tiles[i]->id;
+		if (sol->tile_done[id]) {
+			sol->tile_done[id]= FALSE;
+			--sol->num_tile_done;
+		}
+	}
+	for(i=0; i < 2; ++i) {
+		id= lin->ends[i]->id;
+		if (sol->vertex_done[id]) {
+			sol->vertex_done[id]= FALSE;
+			--sol->num_vertex_done;
+		}
+	}
+}
+
+
+/*
+ * Change state of a line in solver context
+ */
+static void
+hint_put_line(struct solution *sol, int id, int state)
+{
+	const struct line *lin=sol->geo->lines + id;
+
+	if (sol->states[id] == state) return;
+	hint_count_line(sol, lin, sol->states[id], -1);
+	hint_count_line(sol, lin, state, 1);
+	sol->states[id]= state;
+	hint_undo_done(sol, lin);
+}
+
+
+/*
+ * Create hint engine following the lines of a game
+ */
+struct hint_engine*
+hint_engine_new(struct geometry *geo, struct game *game)
+{
+	struct hint_engine *engine;
+
+	engine= (struct hint_engine*)g_malloc(sizeof(struct hint_engine));
+	engine->geo= geo;
+	engine->game= game;
+	engine->sol= solve_create_solution_data(geo, game);
+	engine->hint.changes= (int*)g_malloc(geo->nlines*sizeof(int));
+	engine->hint.states= (int*)g_malloc(geo->nlines*sizeof(int));
+	engine->hint.tile_changes= (int*)g_malloc(geo->ntiles*sizeof(int));
+	hint_engine_seed(engine);
+	return engine;
+}
+
+
+/*
+ * Free hint engine
+ */
+void
+hint_engine_destroy(struct hint_engine *engine)
+{
+	if (engine == NULL) return;
+	solve_free_solution_data(engine->sol);
+	g_free(engine->hint.changes);
+	g_free(engine->hint.states);
+	g_free(engine->hint.tile_changes);
+	g_free(engine);
+}
+
+
+/*
+ * Seed solver context from the game's line states (e.g. after they have
+ * been set directly)
+ */
+void
+hint_engine_seed(struct hint_engine *engine)
+{
+	struct solution *sol=engine->sol;
+	struct game *game=engine->game;
+	int i;
+
+	solve_reset_solution(sol);
+	engine->nwrong= 0;
+	for(i=0; i < engine->geo->nlines; ++i) {
+		if (hint_is_wrong(game, i, game->states[i])) {
+			++engine->nwrong;
+			continue;
+		}
+		sol->states[i]= game->states[i];
+		hint_count_line(sol, engine->geo->lines + i, game->states[i], 1);
+	}
+}
+
+
+/*
+ * Player changed a line: update solver context
+ */
+void
+hint_engine_set_line(struct hint_engine *engine, int id, int old_state,
+					 int new_state)
+{
+	struct game *game=engine->game;
+
+	if (hint_is_wrong(game, id, old_state)) --engine->nwrong;
+	if (hint_is_wrong(game, id, new_state)) {
+		++engine->nwrong;
+		hint_put_line(engine->sol, id, LINE_OFF);
+	} else
+		hint_put_line(engine->sol, id, new_state);
+}
+
+
+/*
+ * Hint: undo every line contradicting the solution
+ */
+static void
+hint_find_wrong(struct hint_engine *engine, struct hint *hint)
+{
+	struct game *game=engine->game;
+	int i;
+
+	hint->kind= HINT_WRONG;
+	for(i=0; i < engine->geo->nlines; ++i) {
+		if (!hint_is_wrong(game, i, game->states[i])) continue;
+		hint->changes[hint->nchanges]= i;
+		hint->states[hint->nchanges]= LINE_OFF;
+		++hint->nchanges;
+	}
+}
+
+
+/*
+ * Has a rule just set any side of tile? (player's lines all agree with
+ * solution here, so they're the same in game and solver context)
+ */
+static gboolean
+hint_tile_changed(struct hint_engine *engine, int id)
+{
+	struct tile *tile=engine->geo->tiles + id;
+	int i, lid;
+
+	for(i=0; i < tile->nsides; ++i) {
+		lid= tile->sides[i]->id;
+		if (engine->sol->states[lid] != engine->game->states[lid])
+			return TRUE;
+	}
+	return FALSE;
+}
+
+
+/*
+ * Hint: lines set by the first (cheapest) rule that makes progress.
+ * Lines set by the rule are taken back afterwards.
+ * Returns FALSE if no rule found anything.
+ */
+static gboolean
+hint_find_deduction(struct hint_engine *engine, struct hint *hint)
+{
+	struct solution *sol=engine->sol;
+	struct game *game=engine->game;
+	int i, r, id;
+
+	for(r=0; r < NUM_HINT_RULES; ++r) {
+		sol->nchanges= sol->ntile_changes= 0;
+		hint_rules[r].solve(sol);
+		if (sol->nchanges == 0) continue;
+
+		/* keep lines that agree with solution (puzzle could have more
+		   than one) */
+		for(i=0; i < sol->nchanges; ++i) {
+			id= sol->changes[i];
+			if ((sol->states[id] == LINE_ON) != (game->solution[id] == LINE_ON))
+				continue;
+			hint->changes[hint->nchanges]= id;
+			hint->states[hint->nchanges]= sol->states[id];
+			++hint->nchanges;
+		}
+		/* keep tiles next to a line set by rule */
+		for(i=0; i < sol->ntile_changes; ++i) {
+			if (!hint_tile_changed(engine, sol->tile_changes[i])) continue;
+			hint->tile_changes[hint->ntile_changes]= sol->tile_changes[i];
+			++hint->ntile_changes;
+		}
+
+		/* take back lines set by rule */
+		for(i=0; i < sol->nchanges; ++i)
+			hint_put_line(sol, sol->changes[i], LINE_OFF);
+		for(i=0; i < sol->ntile_changes; ++i) {
+			id= sol->tile_changes[i];
+			if (sol->tile_done[id]) {
+				sol->tile_done[id]= FALSE;
+				--sol->num_tile_done;
+			}
+		}
+		sol->nchanges= sol->ntile_changes= 0;
+
+		if (hint->nchanges > 0) {
+			hint->kind= HINT_DEDUCTION;
+			hint->level= hint_rules[r].level;
+			return TRUE;
+		}
+		hint->ntile_changes= 0;
+	}
+	return FALSE;
+}
+
+
+/*
+ * Hint: a line ON in solution the player hasn't set yet
+ */
+static void
+hint_find_reveal(struct hint_engine *engine, struct hint *hint)
+{
+	struct game *game=engine->game;
+	struct line *lin;
+	int i, j;
+
+	for(i=0; i < engine->geo->nlines; ++i) {
+		if (game->solution[i] != LINE_ON || game->states[i] == LINE_ON)
+			continue;
+		lin= engine->geo->lines + i;
+		hint->kind= HINT_REVEAL;
+		hint->changes[0]= i;
+		hint->states[0]= LINE_ON;
+		hint->nchanges= 1;
+		for(j=0; j < lin->ntiles; ++j)
+			hint->tile_changes[j]= lin->tiles[j]->id;
+		hint->ntile_changes= lin->ntiles;
+		return;
+	}
+}
+
+
+/*
+ * Find a hint for the game's current line states.
+ * Wrong lines come first, then the cheapest solver rule that makes
+ * progress and, if no rule applies, a line from the solution.
+ * Returned hint belongs to engine and is valid until next call.
+ */
+struct hint*
+hint_engine_find(struct hint_engine *engine)
+{
+	struct hint *hint=&engine->hint;
+
+	hint->kind= HINT_NONE;
+	hint->level= -1;
+	hint->nchanges= 0;
+	hint->ntile_changes= 0;
+
+	if (engine->nwrong > 0)
+		hint_find_wrong(engine, hint);
+	else if (!hint_find_deduction(engine, hint))
+		hint_find_reveal(engine, hint);
+	return hint;
+}
@@ -0,0 +1,60 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+#ifndef __INCLUDED_HINT_H__
+#define __INCLUDED_HINT_H__
+
+#include "gamedata.h"
+
+
+/* Kinds of hint */
+enum {
+	HINT_NONE,			/* nothing left to tell */
+	HINT_WRONG,			/* lines contradicting solution must be undone */
+	HINT_DEDUCTION,		/* lines that follow from a solver rule */
+	HINT_REVEAL			/* line taken from solution (no rule applies) */
+};
+
+
+/* solver context kept in step with the game (private, see hint.c) */
+struct hint_engine;
+
+
+/*
+ * A hint: lines to change (and the state they should take) and the tiles
+ * that lead to the change. Arrays belong to the hint engine and are valid
+ * until next hint is requested.
+ */
+struct hint {
+	int kind;			// kind of hint
+	int level;			// solver level of deduction (-1 if none)
+	int nchanges;		// number of lines in hint
+	int *changes;		// ID of lines in hint
+	int *states;		// state each line in hint should take
+	int ntile_changes;	// number of tiles involved
+	int *tile_changes;	// ID of tiles involved
+};
+
+
+/* hint.c */
+struct hint_engine* hint_engine_new(struct geometry *geo, struct game *game);
+void hint_engine_destroy(struct hint_engine *engine);
+void hint_engine_seed(struct hint_engine *engine);
+void hint_engine_set_line(struct hint_engine *engine, int id, int old_state,
+						  int new_state);
+struct hint* hint_engine_find(struct hint_engine *engine);
+
+#endif
@@ -17,62 +17,75 @@
 #include <gtk/gtk.h>
 #include <string.h>
 #include <stdio.h>
+#include <time.h>
 
 #include "gamedata.h"
 #include "history.h"
 #include "gui.h"
+#include "journal.h"
+#include "view.h"
 
 
 /*
- * History is a double-linked list containing changes.
- * Event is an instance of line_change describing a line change
+ * History is a sequence of changes, each one encoded as a single varint
+ * (see journal.c) holding the difference between its line id and the id
+ * of the previous change, the group flag and the old and new states:
+ *     value= zigzag(id delta) << 5 | group << 4 | old_state << 2 | new_state
+ * Most changes take one or two bytes. The last byte of a varint is the
+ * only one with the high bit clear, so history can be walked both ways.
+ * Changes are also written to a journal on disk, from which the game can
+ * be resumed when fences starts again. Changes recorded for a batch (e.g.
+ * lines of a stroke crossed by one mouse motion) go into a single journal
+ * frame, written once the batch has been made.
  */
 
-void history_free_event(GSList *event);
+/* bits used by group flag and states in an encoded change */
+#define HISTORY_STATE_BITS	5
 
+/* minimum size of changes between checkpoints (bytes of records) */
+#define HISTORY_MIN_CHECKPOINT	1024
 
 
 /*
- * History is made up of chunks chained together
- * Each chunk is HISTORY_SEGMENT_SIZE consecutive struct line_change
- * num_segments: total number of allocated segments
- * current_segment: index of current segment
- * index: current position in history
- * last: head of history
- * Variables index and last point to last change, initially (no changes yet)
- * they point to -1.
- * Segments are prepended into list. Example: (segment size 5)
- *      | 5 | 6 | x | x | x |   -   | 0 | 1 | 2 | 3 | 4 |
- *             segment 1                    segment 0
- *       index and last point to 6
+ * Line states at some position in history, so a jump far back or forward
+ * in history doesn't have to go through every change in between.
+ * Checkpoints are taken as changes are recorded, once the changes since
+ * the last checkpoint take as much space as a checkpoint.
  */
-#define HISTORY_SEGMENT_SIZE	100
+struct history_checkpoint {
+	guint pos;			// position in records
+	int id;				// line id of change at pos
+	guint8 *states;		// line states (2 bits per line)
+};
+
+
 /*
- * Stores history data
+ * When groups of changes were recorded. An entry is only added for the
+ * first group recorded in a new second: groups after it, up to the next
+ * entry, were recorded in the same second.
  */
-struct history {
-	GList *segments;			// start of list of segments
-	GList *segment;				// current segment (where index points)
-	int num_segments;			// total number of segments allocated
-	int current_segment;		// current segment
-	int index;					// index of current history position
-	int last;					// last history change
+struct history_time {
+	guint pos;			// start of group in records
+	time_t time;		// when group was recorded
 };
 
 
 /*
- * Initialize history as empty
+ * Stores history data
  */
-static void
-history_reset(struct history *history)
-{
-	history->segments= NULL;
-	history->segment= NULL;
-	history->num_segments= 0;
-	history->current_segment= -1;
-	history->index= -1;
-	history->last= -1;
-}
+struct history {
+	GByteArray *records;		// encoded changes, oldest first
+	guint pos;					// end of current change in records (0: none)
+	int id;						// line id of current change (0 if none)
+	GArray *checkpoints;		// checkpoints, sorted by position
+	GArray *times;				// recording times, sorted by position
+	guint group;				// start of last group recorded
+	guint first_error;			// start of first group going against
+								// solution (G_MAXUINT: none)
+	struct journal *journal;	// journal on disk (NULL if none)
+	guint unjournaled;			// start of records not in journal yet
+								// (G_MAXUINT: none)
+};
 
 
 /*
@@ -84,40 +97,202 @@ history_create(void)
 	struct history *history;
 
 	history= g_malloc(sizeof(struct history));
-	history_reset(history);
+	history->records= g_byte_array_new();
+	history->pos= 0;
+	history->id= 0;
+	history->checkpoints= g_array_new(FALSE, FALSE,
+									  sizeof(struct history_checkpoint));
+	history->times= g_array_new(FALSE, FALSE, sizeof(struct history_time));
+	history->group= 0;
+	history->first_error= G_MAXUINT;
+	history->journal= NULL;
+	history->unjournaled= G_MAXUINT;
 	return history;
 }
 
 
+/*
+ * Free history (and close its journal)
+ */
+void
+history_destroy(struct history *history)
+{
+	history_clear(history);
+	g_byte_array_free(history->records, TRUE);
+	g_array_free(history->checkpoints, TRUE);
+	g_array_free(history->times, TRUE);
+	g_free(history);
+}
+
+
+/*
+ * Encode change at end of records. 'delta' is the difference from the
+ * line id of the previous change.
+ */
+static void
+history_encode(GByteArray *records, int delta, const struct line_change *change)
+{
+	guint32 zigzag;
+
+	zigzag= ((guint32)delta << 1) ^ (guint32)(delta >> 31);
+	journal_put_varint(records, ((guint64)zigzag << HISTORY_STATE_BITS) |
+					   (change->group ? 1 << 4 : 0) |
+					   (change->old_state << 2) | change->new_state);
+}
+
+
+/*
+ * Decode change at *p (moved past it). Line id of change is the id of the
+ * previous change plus 'delta'.
+ * Returns FALSE if change is not valid.
+ */
+static gboolean
+history_decode(const guint8 **p, const guint8 *end, int *delta,
+			   struct line_change *change)
+{
+	guint64 value;
+	guint32 zigzag;
+
+	if (!journal_get_varint(p, end, &value)) return FALSE;
+	zigzag= (guint32)(value >> HISTORY_STATE_BITS);
+	*delta= (int)(zigzag >> 1) ^ -(int)(zigzag & 1);
+	change->group= (value >> 4) & 1;
+	change->old_state= (value >> 2) & 3;
+	change->new_state= value & 3;
+	return change->old_state <= LINE_CROSSED &&
+		change->new_state <= LINE_CROSSED;
+}
+
+
+/*
+ * Journal history position and line states, if it's been a while
+ * since the last snapshot
+ */
+static void
+history_check_snapshot(struct board *board)
+{
+	struct history *history=board->history;
+
+	if (history->journal != NULL &&
+		journal_wants_snapshot(history->journal, board->geo))
+		history_save_snapshot(board);
+}
+
+
+/*
+ * Drop checkpoints after position 'pos' (changes after it are replaced)
+ */
+static void
+history_drop_checkpoints(struct history *history, guint pos)
+{
+	struct history_checkpoint *cp;
+
+	while(history->checkpoints->len > 0) {
+		cp= &g_array_index(history->checkpoints, struct history_checkpoint,
+						   history->checkpoints->len - 1);
+		if (cp->pos <= pos) break;
+		g_free(cp->states);
+		g_array_set_size(history->checkpoints, history->checkpoints->len - 1);
+	}
+}
+
+
+/*
+ * Take checkpoint at current position, if it's far enough from the last
+ * one
+ */
+static void
+history_check_checkpoint(struct board *board)
+{
+	struct history *history=board->history;
+	struct history_checkpoint cp;
+	int nlines=board->geo->nlines;
+	guint last=0;
+	int i;
+
+	if (history->checkpoints->len > 0)
+		last= g_array_index(history->checkpoints, struct history_checkpoint,
+							history->checkpoints->len - 1).pos;
+	if (history->pos < last + MAX(HISTORY_MIN_CHECKPOINT, nlines/4)) return;
+
+	cp.pos= history->pos;
+	cp.id= history->id;
+	cp.states= (guint8*)g_malloc0((nlines + 3)/4);
+	for(i=0; i < nlines; ++i)
+		cp.states[i/4]|= board->game->states[i] << (2*(i % 4));
+	g_array_append_val(history->checkpoints, cp);
+}
+
+
+/*
+ * Forget recording times of groups from position 'pos' on (changes there
+ * are replaced), then note the time of the group starting at 'pos'
+ */
+static void
+history_time_group(struct history *history, guint pos)
+{
+	struct history_time entry;
+	guint len=history->times->len;
+
+	while(len > 0 &&
+		  g_array_index(history->times, struct history_time, len - 1).pos >= pos)
+		--len;
+	g_array_set_size(history->times, len);
+
+	entry.pos= pos;
+	entry.time= time(NULL);
+	if (len == 0 ||
+		g_array_index(history->times, struct history_time, len - 1).time !=
+		entry.time)
+		g_array_append_val(history->times, entry);
+}
+
+
+/*
+ * Does change go against the solution? (line ON that is not in the
+ * solution, or solution line crossed out)
+ */
+static inline gboolean
+history_is_error(const struct line_change *change, const int *solution)
+{
+	return (change->new_state == LINE_ON && solution[change->id] != LINE_ON) ||
+		(change->new_state == LINE_CROSSED && solution[change->id] == LINE_ON);
+}
+
+
 /*
  * Record an event
  */
 void
 history_record_change(struct board *board, struct line_change *change)
 {
-	struct line_change *change_ptr;
 	struct history *history=board->history;
-	int pos;
-
-	/* allocate a new segment if needed:
-	   if first change or current segment is full */
-	pos= (history->num_segments) * HISTORY_SEGMENT_SIZE - 1;
-	if (history->index == pos) {
-		change_ptr= g_malloc(sizeof(struct line_change)*HISTORY_SEGMENT_SIZE);
-		history->segments= g_list_prepend(history->segments, change_ptr);
-		history->segment= history->segments;
-		++history->num_segments;
-		++history->current_segment;
+	guint start;
+
+	/* changes in a group are recorded before any of them is made: states
+	   are only consistent with history at the start of a group */
+	if (!change->group) {
+		history_check_snapshot(board);
+		history_drop_checkpoints(history, history->pos);
+		history_check_checkpoint(board);
+		history_time_group(history, history->pos);
+		history->group= history->pos;
+		if (history->first_error >= history->pos)
+			history->first_error= G_MAXUINT;
 	}
+	if (history->first_error == G_MAXUINT &&
+		history_is_error(change, board->game->solution))
+		history->first_error= history->group;
 
-	/* store change */
-	++history->index;
-	history->last= history->index;
-	pos= history->index % HISTORY_SEGMENT_SIZE;
-	change_ptr= ((struct line_change *)history->segment->data) + pos;
-	change_ptr->id= change->id;
-	change_ptr->old_state= change->old_state;
-	change_ptr->new_state= change->new_state;
+	/* drop changes that could be redone, store change */
+	g_byte_array_set_size(history->records, history->pos);
+	start= history->pos;
+	history_encode(history->records, change->id - history->id, change);
+	history->pos= history->records->len;
+	history->id= change->id;
+	/* journaled along with the rest of its batch */
+	if (history->unjournaled == G_MAXUINT)
+		history->unjournaled= start;
 
 	/* set undo/redo sensitivity */
 	fencesgui_set_undoredo_state(board);
@@ -125,75 +300,393 @@ history_record_change(struct board *board, struct line_change *change)
 
 
 /*
- * Revisit history
- * offset indicates which direction (only goes one step)
+ * Write changes recorded since last call to journal, as a single frame
+ * (called once a batch of changes has been made)
  */
 void
-history_travel_history(struct board *board, int offset)
+history_flush_journal(struct history *history)
 {
-	struct history *history=board->history;
-	int pos;
-	struct line_change *change;
+	guint start=history->unjournaled;
+
+	if (start == G_MAXUINT) return;
+	history->unjournaled= G_MAXUINT;
+	if (history->journal == NULL) return;
+	journal_write_changes(history->journal, start,
+						  history->records->data + start,
+						  history->records->len - start);
+}
+
+
+/*
+ * Move one step back in history. Returns FALSE if there's nothing to undo.
+ */
+static gboolean
+history_step_back(struct history *history, struct line_change *change)
+{
+	const guint8 *data=history->records->data;
+	const guint8 *p;
+	guint start;
+	int delta;
+
+	if (history->pos == 0) return FALSE;
+	/* find start of current change */
+	start= history->pos - 1;
+	while(start > 0 && (data[start - 1] & 0x80))
+		--start;
+	p= data + start;
+	if (!history_decode(&p, data + history->pos, &delta, change)) return FALSE;
+	change->id= history->id;
+	history->id-= delta;
+	history->pos= start;
+	return TRUE;
+}
+
+
+/*
+ * Next change to redo, without moving in history. 'end' is set to the end
+ * of the change. Returns FALSE if there's nothing to redo.
+ */
+static gboolean
+history_peek_forward(struct history *history, struct line_change *change,
+					 guint *end)
+{
+	const guint8 *data=history->records->data;
+	const guint8 *p=data + history->pos;
+	int delta;
+
+	if (history->pos == history->records->len) return FALSE;
+	if (!history_decode(&p, data + history->records->len, &delta, change))
+		return FALSE;
+	change->id= history->id + delta;
+	*end= p - data;
+	return TRUE;
+}
+
+
+/*
+ * Move one step forward in history. Returns FALSE if there's nothing to
+ * redo.
+ */
+static gboolean
+history_step_forward(struct history *history, struct line_change *change)
+{
+	guint end;
+
+	if (!history_peek_forward(history, change, &end)) return FALSE;
+	history->pos= end;
+	history->id= change->id;
+	return TRUE;
+}
+
+
+/*
+ * Move in history one step (offset < 0: back, > 0: forward).
+ * A step undoes/redoes a whole group of changes (e.g. lines drawn in a
+ * single drag): changes to make are appended to batch (if not NULL).
+ */
+static void
+history_travel_batch(struct history *history, int offset, GArray *batch)
+{
+	struct line_change change;
 	struct line_change undo_change;
+	guint end;
 
-	if (offset == 0) return;
 	if (offset < 0) {	// backward (undo)
-		if (history->index == -1) return;
-		// get change
-		pos= history->index % HISTORY_SEGMENT_SIZE;
-		g_assert(pos == history->index - (history->current_segment*HISTORY_SEGMENT_SIZE));
-		change= ((struct line_change *)history->segment->data) + pos;
-		// decrement index
-		--history->index;
-		if (pos == 0 && history->index != -1) {			// change segment
-			--history->current_segment;
-			history->segment= g_list_next(history->segment);
+		/* undo back to first change in group */
+		while(history_step_back(history, &change)) {
+			/* set up undo -> reverse change */
+			undo_change.id= change.id;
+			undo_change.old_state= change.new_state;
+			undo_change.new_state= change.old_state;
+			undo_change.group= FALSE;
+			if (batch != NULL) g_array_append_val(batch, undo_change);
+			if (!change.group) break;
 		}
-		g_assert(history->segment != NULL);
-		/* set up undo -> reverse change */
-		undo_change.id= change->id;
-		undo_change.old_state= change->new_state;
-		undo_change.new_state= change->old_state;
-		make_line_change(board, &undo_change);
-	} else {		// forward (redo)
-		if (history->index == history->last) return;
-		// increment index
-		++history->index;
-		pos= history->index % HISTORY_SEGMENT_SIZE;
-		if (pos == 0 && history->index != 0) {
-			++history->current_segment;
-			history->segment= g_list_previous(history->segment);
+	} else if (offset > 0) {		// forward (redo)
+		if (history_step_forward(history, &change)) {
+			if (batch != NULL) g_array_append_val(batch, change);
+			/* rest of group */
+			while(history_peek_forward(history, &change, &end) &&
+				  change.group) {
+				history->pos= end;
+				history->id= change.id;
+				if (batch != NULL) g_array_append_val(batch, change);
+			}
 		}
-		g_assert(history->segment != NULL);
-		// get change
-		g_assert(pos == history->index - (history->current_segment*HISTORY_SEGMENT_SIZE));
-		change= ((struct line_change *)history->segment->data) + pos;
-		make_line_change(board, change);
 	}
+}
+
+
+/*
+ * Make batch of changes from history travel, with a single redraw of the
+ * area they cover
+ */
+static void
+history_make_changes(struct board *board, GArray *batch)
+{
+	make_line_changes(board, (struct line_change*)batch->data, batch->len);
+	if (batch->len > 0)
+		view_queue_draw_clip(board, &board->game->clip);
 
 	/* set undo/redo sensitivity */
 	fencesgui_set_undoredo_state(board);
-	/* redraw board */
-	gtk_widget_queue_draw(board->drawarea);
+}
+
+
+/*
+ * Line states at position 'target' in history are put in 'states'.
+ * They're worked out from current states or from the last checkpoint
+ * before target (or the start of history, when all lines are OFF),
+ * whichever is closer.
+ * Returns line id of change at target.
+ */
+static int
+history_states_at(struct board *board, guint target, int *states)
+{
+	struct history *history=board->history;
+	struct history cursor=*history;
+	struct history_checkpoint *cp=NULL;
+	struct line_change change;
+	int nlines=board->geo->nlines;
+	guint from=0;
+	guint distance;
+	int lo, hi, mid;
+	int i;
+
+	/* last checkpoint at or before target */
+	lo= 0;
+	hi= history->checkpoints->len;
+	while(lo < hi) {
+		mid= (lo + hi)/2;
+		if (g_array_index(history->checkpoints, struct history_checkpoint,
+						  mid).pos <= target)
+			lo= mid + 1;
+		else
+			hi= mid;
+	}
+	if (lo > 0) {
+		cp= &g_array_index(history->checkpoints, struct history_checkpoint,
+						   lo - 1);
+		from= cp->pos;
+	}
+
+	distance= (target > history->pos) ? target - history->pos :
+		history->pos - target;
+	if (distance <= target - from) {
+		memcpy(states, board->game->states, nlines*sizeof(int));
+	} else {
+		for(i=0; i < nlines; ++i)
+			states[i]= (cp == NULL) ? LINE_OFF :
+				(cp->states[i/4] >> (2*(i % 4))) & 3;
+		cursor.pos= from;
+		cursor.id= (cp == NULL) ? 0 : cp->id;
+	}
+
+	while(cursor.pos > target && history_step_back(&cursor, &change))
+		states[change.id]= change.old_state;
+	while(cursor.pos < target && history_step_forward(&cursor, &change))
+		states[change.id]= change.new_state;
+	return cursor.id;
+}
+
+
+/*
+ * Jump to position 'target' in history (start of a group of changes).
+ * Only the net difference between current line states and states at
+ * target is made, as a single batch.
+ */
+static void
+history_jump(struct board *board, guint target)
+{
+	struct history *history=board->history;
+	struct game *game=board->game;
+	struct line_change change;
+	GArray *batch;
+	int *states;
+	int i;
+
+	if (target == history->pos) return;
+	states= (int*)g_malloc(board->geo->nlines*sizeof(int));
+	history->id= history_states_at(board, target, states);
+	history->pos= target;
+
+	batch= g_array_new(FALSE, FALSE, sizeof(struct line_change));
+	change.group= FALSE;
+	for(i=0; i < board->geo->nlines; ++i) {
+		if (states[i] == game->states[i]) continue;
+		change.id= i;
+		change.old_state= game->states[i];
+		change.new_state= states[i];
+		g_array_append_val(batch, change);
+	}
+	g_free(states);
+	history_make_changes(board, batch);
+	g_array_free(batch, TRUE);
+
+	/* journal new position along with the states it leads to */
+	history_save_snapshot(board);
+}
+
+
+/*
+ * Revisit history
+ * offset indicates which direction and how many steps. A step
+ * undoes/redoes a whole group of changes (e.g. lines drawn in a single
+ * drag). All changes are applied as one batch.
+ */
+void
+history_travel_history(struct board *board, int offset)
+{
+	struct history *history=board->history;
+	struct history cursor;
+	GArray *batch;
+	int i;
+
+	if (offset == 0) return;
+	history_check_snapshot(board);
+
+	/* several steps: jump to where they lead */
+	if (offset < -1 || offset > 1) {
+		cursor= *history;
+		for(i=0; i < ABS(offset); ++i)
+			history_travel_batch(&cursor, offset, NULL);
+		history_jump(board, cursor.pos);
+		return;
+	}
+
+	batch= g_array_new(FALSE, FALSE, sizeof(struct line_change));
+	history_travel_batch(history, offset, batch);
+	history_flush_journal(history);
+	if (batch->len > 0 && history->journal != NULL)
+		journal_write_step(history->journal,
+						   (offset < 0) ? JOURNAL_UNDO : JOURNAL_REDO);
+	history_make_changes(board, batch);
+	g_array_free(batch, TRUE);
+}
+
+
+/*
+ * Jump to start of history (all changes undone)
+ */
+void
+history_jump_to_start(struct board *board)
+{
+	history_check_snapshot(board);
+	history_jump(board, 0);
+}
+
+
+/*
+ * Jump to end of history (all changes redone)
+ */
+void
+history_jump_to_end(struct board *board)
+{
+	history_check_snapshot(board);
+	history_jump(board, board->history->records->len);
+}
+
+
+/*
+ * Jump to how the board was at given time: after every group of changes
+ * recorded until then (changes resumed from the journal have no time:
+ * they count as recorded before any other).
+ */
+void
+history_jump_to_time(struct board *board, time_t when)
+{
+	struct history *history=board->history;
+	guint target=history->records->len;
+	int lo, hi, mid;
+
+	/* first group recorded after 'when' */
+	lo= 0;
+	hi= history->times->len;
+	while(lo < hi) {
+		mid= (lo + hi)/2;
+		if (g_array_index(history->times, struct history_time, mid).time <=
+			when)
+			lo= mid + 1;
+		else
+			hi= mid;
+	}
+	if (lo < history->times->len)
+		target= g_array_index(history->times, struct history_time, lo).pos;
+	history_check_snapshot(board);
+	history_jump(board, target);
+}
+
+
+/*
+ * Jump to just before the first change (group) in history that went
+ * against the solution: a line ON that is not in the solution, or a
+ * solution line crossed out. Changes that can be redone don't count.
+ * Returns FALSE if there's no such change.
+ */
+gboolean
+history_jump_to_first_error(struct board *board)
+{
+	struct history *history=board->history;
+
+	if (history->first_error >= history->pos) return FALSE;
+	history_check_snapshot(board);
+	history_jump(board, history->first_error);
+	return TRUE;
+}
+
+
+/*
+ * Find first group of changes going against the solution (history
+ * resumed from the journal)
+ */
+static void
+history_find_first_error(struct history *history, const int *solution)
+{
+	struct history cursor=*history;
+	struct line_change change;
+	guint start;
+
+	history->first_error= G_MAXUINT;
+	history->group= 0;
+	cursor.pos= 0;
+	cursor.id= 0;
+	for(;;) {
+		start= cursor.pos;
+		if (!history_step_forward(&cursor, &change)) break;
+		if (!change.group) history->group= start;
+		if (history->first_error == G_MAXUINT &&
+			history_is_error(&change, solution))
+			history->first_error= history->group;
+	}
 }
 
 
 /*
  * Clear history: Free memory used by history and reset to empty.
  * Variable history is not freed and can be reused.
+ * Journal is closed (but left on disk).
  */
 void
 history_clear(struct history *history)
 {
-	GList *list;
+	int i;
 
 	g_assert(history != NULL);
-	list= history->segments;
-	while(list != NULL) {
-		g_free(list->data);
-		list= g_list_delete_link(list, list);
+	for(i=0; i < history->checkpoints->len; ++i)
+		g_free(g_array_index(history->checkpoints, struct history_checkpoint,
+							 i).states);
+	g_array_set_size(history->checkpoints, 0);
+	g_array_set_size(history->times, 0);
+	history->group= 0;
+	history->first_error= G_MAXUINT;
+	g_byte_array_set_size(history->records, 0);
+	history->pos= 0;
+	history->id= 0;
+	history->unjournaled= G_MAXUINT;
+	if (history->journal != NULL) {
+		journal_close(history->journal);
+		history->journal= NULL;
 	}
-	history_reset(history);
 }
 
 
@@ -203,7 +696,7 @@ history_clear(struct history *history)
 inline gboolean
 history_can_undo(struct history *history)
 {
-	return (history->index > -1);
+	return (history->pos > 0);
 }
 
 
@@ -213,5 +706,164 @@ history_can_undo(struct history *history)
 inline gboolean
 history_can_redo(struct history *history)
 {
-	return (history->index < history->last);
+	return (history->pos < history->records->len);
+}
+
+
+/*
+ * Start a new journal for current game, holding game, history and line
+ * states. It replaces any previous journal.
+ */
+void
+history_start_journal(struct board *board)
+{
+	struct history *history=board->history;
+	gchar *filename;
+
+	if (history->journal != NULL)
+		journal_close(history->journal);
+	history->unjournaled= G_MAXUINT;	// all of history is written below
+
+	filename= journal_filename();
+	history->journal= journal_new(filename);
+	if (history->journal != NULL) {
+		journal_write_game(history->journal, &board->gameinfo, board->geo,
+						   board->game);
+		if (history->records->len > 0)
+			journal_write_changes(history->journal, 0, history->records->data,
+								  history->records->len);
+		history_save_snapshot(board);
+		if (!journal_commit(history->journal)) {
+			journal_close(history->journal);
+			history->journal= NULL;
+		}
+	}
+	if (history->journal == NULL)
+		g_debug("history: could not write journal '%s'", filename);
+	g_free(filename);
+}
+
+
+/*
+ * Journal line states and history position (e.g. after line states have
+ * been set directly)
+ */
+void
+history_save_snapshot(struct board *board)
+{
+	struct history *history=board->history;
+
+	/* snapshot comes after the changes it includes */
+	history_flush_journal(history);
+	if (history->journal == NULL) return;
+	journal_write_snapshot(history->journal, board->geo, board->game,
+						   history->records->len, history->pos, history->id);
+}
+
+
+/*
+ * Apply changes to line states (no checks, no redraw)
+ */
+static void
+history_apply_states(struct game *game, const struct line_change *changes,
+					 int nchanges)
+{
+	int i;
+
+	for(i=0; i < nchanges; ++i)
+		game->states[changes[i].id]= changes[i].new_state;
+}
+
+
+/*
+ * Store encoded changes of a journal frame in history.
+ * If 'game' is given, changes are also applied to its line states (history
+ * position must be at the place they're stored).
+ */
+static gboolean
+history_restore_changes(struct history *history, const struct journal_frame *frame,
+						int nlines, struct game *game)
+{
+	const guint8 *p=frame->data;
+	const guint8 *end=frame->data + frame->len;
+	struct line_change change;
+	guint64 offset;
+	int delta;
+
+	if (!journal_get_varint(&p, end, &offset) ||
+		offset > history->records->len ||
+		(game != NULL && offset != history->pos))
+		return FALSE;
+	g_byte_array_set_size(history->records, offset);
+	g_byte_array_append(history->records, p, end - p);
+	if (game == NULL) return TRUE;
+
+	while(p < end) {
+		if (!history_decode(&p, end, &delta, &change)) return FALSE;
+		change.id= history->id + delta;
+		if (change.id < 0 || change.id >= nlines) return FALSE;
+		history_apply_states(game, &change, 1);
+		history->id= change.id;
+	}
+	history->pos= history->records->len;
+	return TRUE;
+}
+
+
+/*
+ * Rebuild history and line states from journal frames following the game
+ * frame. Frames before the last snapshot only add their changes to history:
+ * line states are taken from the snapshot and only the changes after it
+ * are replayed.
+ * Returns FALSE if journal is not consistent.
+ */
+gboolean
+history_restore(struct board *board, struct journal_map *map)
+{
+	struct history *history=board->history;
+	struct journal_frame frame;
+	GArray *batch;
+	gsize start=map->pos;
+	gsize snapshot=0;
+	gboolean found=FALSE;
+	gboolean ok=TRUE;
+	guint len;
+
+	/* find last snapshot */
+	while(journal_map_next(map, &frame)) {
+		if (frame.kind == JOURNAL_SNAPSHOT) {
+			snapshot= frame.offset;
+			found= TRUE;
+		}
+	}
+	if (!found) return FALSE;
+
+	history_clear(history);
+	batch= g_array_new(FALSE, FALSE, sizeof(struct line_change));
+	map->pos= start;
+	while(ok && journal_map_next(map, &frame)) {
+		if (frame.offset < snapshot) {
+			if (frame.kind == JOURNAL_CHANGES)
+				ok= history_restore_changes(history, &frame,
+											board->geo->nlines, NULL);
+		} else if (frame.kind == JOURNAL_SNAPSHOT) {
+			ok= journal_read_snapshot(&frame, board->geo, board->game, &len,
+									  &history->pos, &history->id) &&
+				len == history->records->len;
+		} else if (frame.kind == JOURNAL_CHANGES) {
+			ok= history_restore_changes(history, &frame, board->geo->nlines,
+										board->game);
+		} else if (frame.kind == JOURNAL_UNDO || frame.kind == JOURNAL_REDO) {
+			g_array_set_size(batch, 0);
+			history_travel_batch(history,
+								 (frame.kind == JOURNAL_UNDO) ? -1 : 1, batch);
+			history_apply_states(board->game,
+								 (struct line_change*)batch->data, batch->len);
+		}
+	}
+	g_array_free(batch, TRUE);
+
+	if (!ok) history_clear(history);
+	else history_find_first_error(history, board->game->solution);
+	return ok;
 }
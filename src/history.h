@@ -17,16 +17,38 @@
 #ifndef __INCLUDED_HISTORY_H__
 #define __INCLUDED_HISTORY_H__
 
+#include <time.h>
+
+
+/* groups of changes undone/redone by a page step */
+#define HISTORY_PAGE_STEPS		10
+
+/* how far back a time step goes (seconds) */
+#define HISTORY_TIME_STEP		60
+
+
+/* mapped journal file (see journal.h) */
+struct journal_map;
+
 
 /*
  * Functions
  */
 struct history *history_create(void);
+void history_destroy(struct history *history);
 void history_record_change(struct board *board, struct line_change *change);
+void history_flush_journal(struct history *history);
 void history_travel_history(struct board *board, int offset);
+void history_jump_to_start(struct board *board);
+void history_jump_to_end(struct board *board);
+void history_jump_to_time(struct board *board, time_t when);
+gboolean history_jump_to_first_error(struct board *board);
 void history_clear(struct history *history);
 inline gboolean history_can_undo(struct history *history);
 inline gboolean history_can_redo(struct history *history);
+void history_start_journal(struct board *board);
+void history_save_snapshot(struct board *board);
+gboolean history_restore(struct board *board, struct journal_map *map);
 
 
 #endif
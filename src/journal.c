@@ -0,0 +1,521 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "gamedata.h"
+#include "journal.h"
+
+
+/*
+ * Journal.
+ * Frames are appended to the file as changes are recorded, and flushed
+ * right away, so a crash loses at most the frame being written. A new
+ * journal is written to a temporary file and renamed into place once its
+ * first frames (game and snapshot) are on disk: there is always a valid
+ * journal to resume from.
+ * Snapshots keep resuming cheap: the journal is read from its last
+ * snapshot, and a new snapshot is written once the frames after the last
+ * one take as much space as a snapshot.
+ */
+
+/* name of journal file (in fences cache directory) */
+#define JOURNAL_FILENAME	"journal.bin"
+
+/* minimum size of frames between snapshots (bytes) */
+#define JOURNAL_MIN_TAIL	4096
+
+
+/*
+ * Journal being written
+ */
+struct journal {
+	FILE *file;
+	gchar *filename;		// name of journal file
+	gchar *tmpname;			// name while being created (NULL if committed)
+	GByteArray *frame;		// frame being written
+	gsize tail;				// bytes written since last snapshot
+	gboolean failed;		// write failed, nothing else is written
+};
+
+
+
+/*
+ * Append unsigned integer as varint (7 bits per byte, least significant
+ * first, high bit set in all bytes but the last)
+ */
+void
+journal_put_varint(GByteArray *buf, guint64 value)
+{
+	guint8 byte;
+
+	while(value >= 0x80) {
+		byte= (guint8)(value | 0x80);
+		g_byte_array_append(buf, &byte, 1);
+		value>>= 7;
+	}
+	byte= (guint8)value;
+	g_byte_array_append(buf, &byte, 1);
+}
+
+
+/*
+ * Read varint at *p (not going past 'end'). *p is moved past it.
+ * Returns FALSE if varint is cut short or too long.
+ */
+gboolean
+journal_get_varint(const guint8 **p, const guint8 *end, guint64 *value)
+{
+	const guint8 *q=*p;
+	int shift=0;
+
+	*value= 0;
+	while(q < end && shift < 64) {
+		*value|= (guint64)(*q & 0x7f) << shift;
+		if ((*q++ & 0x80) == 0) {
+			*p= q;
+			return TRUE;
+		}
+		shift+= 7;
+	}
+	return FALSE;
+}
+
+
+/*
+ * Fletcher-16 checksum
+ */
+static guint16
+journal_checksum(const guint8 *data, gsize len)
+{
+	guint32 s1=0, s2=0;
+	gsize i;
+
+	for(i=0; i < len; ++i) {
+		s1= (s1 + data[i]) % 255;
+		s2= (s2 + s1) % 255;
+	}
+	return (guint16)((s2 << 8) | s1);
+}
+
+
+/*
+ * Name of journal file. Must be freed with g_free.
+ */
+gchar*
+journal_filename(void)
+{
+	return g_build_filename(g_get_user_cache_dir(), "fences", JOURNAL_FILENAME,
+							NULL);
+}
+
+
+/*
+ * Start new journal. It is written to a temporary file until committed.
+ * Returns NULL if file can't be created.
+ */
+struct journal*
+journal_new(const char *filename)
+{
+	struct journal *journal;
+	gchar *dir;
+	FILE *file;
+	gchar *tmpname;
+
+	dir= g_path_get_dirname(filename);
+	g_mkdir_with_parents(dir, 0755);
+	g_free(dir);
+
+	tmpname= g_strconcat(filename, ".tmp", NULL);
+	file= g_fopen(tmpname, "wb");
+	if (file == NULL) {
+		g_free(tmpname);
+		return NULL;
+	}
+
+	journal= (struct journal*)g_malloc(sizeof(struct journal));
+	journal->file= file;
+	journal->filename= g_strdup(filename);
+	journal->tmpname= tmpname;
+	journal->frame= g_byte_array_new();
+	journal->tail= 0;
+	journal->failed= FALSE;
+	if (fwrite(JOURNAL_MAGIC, JOURNAL_MAGIC_LEN, 1, file) != 1)
+		journal->failed= TRUE;
+	return journal;
+}
+
+
+/*
+ * Make sure everything written so far is on disk
+ */
+static void
+journal_sync(struct journal *journal)
+{
+	if (fflush(journal->file) != 0 || fsync(fileno(journal->file)) != 0)
+		journal->failed= TRUE;
+}
+
+
+/*
+ * Put new journal in place of the old one (frames written after this
+ * are appended to it).
+ * Returns FALSE if journal couldn't be written.
+ */
+gboolean
+journal_commit(struct journal *journal)
+{
+	if (journal->tmpname == NULL) return !journal->failed;
+	journal_sync(journal);
+	if (!journal->failed && g_rename(journal->tmpname, journal->filename) != 0)
+		journal->failed= TRUE;
+	if (journal->failed) g_unlink(journal->tmpname);
+	g_free(journal->tmpname);
+	journal->tmpname= NULL;
+	return !journal->failed;
+}
+
+
+/*
+ * Close journal (an uncommitted journal is discarded)
+ */
+void
+journal_close(struct journal *journal)
+{
+	fclose(journal->file);
+	if (journal->tmpname != NULL) {
+		g_unlink(journal->tmpname);
+		g_free(journal->tmpname);
+	}
+	g_free(journal->filename);
+	g_byte_array_free(journal->frame, TRUE);
+	g_free(journal);
+}
+
+
+/*
+ * Start a frame: returns its (empty) payload
+ */
+static GByteArray*
+journal_begin_frame(struct journal *journal)
+{
+	g_byte_array_set_size(journal->frame, 0);
+	return journal->frame;
+}
+
+
+/*
+ * Write frame with payload built in journal->frame
+ */
+static void
+journal_end_frame(struct journal *journal, int kind)
+{
+	GByteArray *payload=journal->frame;
+	GByteArray *buf;
+	guint8 byte;
+	guint16 check;
+
+	if (journal->failed) return;
+
+	buf= g_byte_array_sized_new(payload->len + 16);
+	byte= (guint8)kind;
+	g_byte_array_append(buf, &byte, 1);
+	journal_put_varint(buf, payload->len);
+	g_byte_array_append(buf, payload->data, payload->len);
+	check= journal_checksum(buf->data, buf->len);
+	byte= (guint8)(check & 0xff);
+	g_byte_array_append(buf, &byte, 1);
+	byte= (guint8)(check >> 8);
+	g_byte_array_append(buf, &byte, 1);
+
+	if (fwrite(buf->data, buf->len, 1, journal->file) != 1 ||
+		fflush(journal->file) != 0)
+		journal->failed= TRUE;
+	journal->tail+= buf->len;
+	g_byte_array_free(buf, TRUE);
+}
+
+
+/*
+ * Write game frame: game info, tile numbers and solution
+ */
+void
+journal_write_game(struct journal *journal, const struct gameinfo *info,
+				   const struct geometry *geo, const struct game *game)
+{
+	GByteArray *payload;
+	guint8 byte;
+	int i;
+
+	payload= journal_begin_frame(journal);
+	journal_put_varint(payload, info->type);
+	journal_put_varint(payload, info->size);
+	journal_put_varint(payload, info->diff_index);
+	journal_put_varint(payload, geo->nlines);
+	journal_put_varint(payload, geo->ntiles);
+	/* numbers (-1 for no number) */
+	for(i=0; i < geo->ntiles; ++i) {
+		byte= (guint8)(game->numbers[i] + 1);
+		g_byte_array_append(payload, &byte, 1);
+	}
+	/* solution: one bit per line (set if ON) */
+	byte= 0;
+	for(i=0; i < geo->nlines; ++i) {
+		if (game->solution[i] == LINE_ON) byte|= 1 << (i % 8);
+		if (i % 8 == 7 || i == geo->nlines - 1) {
+			g_byte_array_append(payload, &byte, 1);
+			byte= 0;
+		}
+	}
+	journal_end_frame(journal, JOURNAL_GAME);
+}
+
+
+/*
+ * Write snapshot frame: history position (length of encoded history,
+ * end of current change and id of its line) and line states (2 bits
+ * per line)
+ */
+void
+journal_write_snapshot(struct journal *journal, const struct geometry *geo,
+					   const struct game *game, guint len, guint pos, int id)
+{
+	GByteArray *payload;
+	guint8 byte;
+	int i;
+
+	payload= journal_begin_frame(journal);
+	journal_put_varint(payload, len);
+	journal_put_varint(payload, pos);
+	journal_put_varint(payload, id);
+	byte= 0;
+	for(i=0; i < geo->nlines; ++i) {
+		byte|= game->states[i] << (2*(i % 4));
+		if (i % 4 == 3 || i == geo->nlines - 1) {
+			g_byte_array_append(payload, &byte, 1);
+			byte= 0;
+		}
+	}
+	journal_end_frame(journal, JOURNAL_SNAPSHOT);
+	if (!journal->failed) journal_sync(journal);
+	journal->tail= 0;
+}
+
+
+/*
+ * Write encoded changes stored in history at 'offset' (anything after
+ * them in history is dropped)
+ */
+void
+journal_write_changes(struct journal *journal, guint offset,
+					  const guint8 *records, guint len)
+{
+	GByteArray *payload;
+
+	payload= journal_begin_frame(journal);
+	journal_put_varint(payload, offset);
+	g_byte_array_append(payload, records, len);
+	journal_end_frame(journal, JOURNAL_CHANGES);
+}
+
+
+/*
+ * Write history step (JOURNAL_UNDO or JOURNAL_REDO)
+ */
+void
+journal_write_step(struct journal *journal, int kind)
+{
+	journal_begin_frame(journal);
+	journal_end_frame(journal, kind);
+}
+
+
+/*
+ * Is it time for a snapshot? (frames since last one take as much space
+ * as a snapshot)
+ */
+gboolean
+journal_wants_snapshot(const struct journal *journal,
+					   const struct geometry *geo)
+{
+	return journal->tail >= MAX(JOURNAL_MIN_TAIL, (gsize)geo->nlines/4);
+}
+
+
+/*
+ * Map journal file in memory (read-only).
+ * Returns NULL if there's no journal or file is not a journal.
+ */
+struct journal_map*
+journal_map_open(const char *filename)
+{
+	GMappedFile *file;
+	struct journal_map *map;
+
+	file= g_mapped_file_new(filename, FALSE, NULL);
+	if (file == NULL) return NULL;
+	if (g_mapped_file_get_length(file) < JOURNAL_MAGIC_LEN ||
+		memcmp(g_mapped_file_get_contents(file), JOURNAL_MAGIC,
+			   JOURNAL_MAGIC_LEN) != 0) {
+		g_mapped_file_free(file);
+		return NULL;
+	}
+
+	map= (struct journal_map*)g_malloc(sizeof(struct journal_map));
+	map->file= file;
+	map->data= (const guint8*)g_mapped_file_get_contents(file);
+	map->len= g_mapped_file_get_length(file);
+	map->pos= JOURNAL_MAGIC_LEN;
+	return map;
+}
+
+
+/*
+ * Unmap journal file
+ */
+void
+journal_map_close(struct journal_map *map)
+{
+	g_mapped_file_free(map->file);
+	g_free(map);
+}
+
+
+/*
+ * Read next frame. Returns FALSE at end of journal (or at the first frame
+ * that is cut short or damaged).
+ */
+gboolean
+journal_map_next(struct journal_map *map, struct journal_frame *frame)
+{
+	const guint8 *start=map->data + map->pos;
+	const guint8 *end=map->data + map->len;
+	const guint8 *p=start;
+	guint64 len;
+	guint16 check;
+
+	if (p >= end) return FALSE;
+	frame->kind= *p++;
+	if (!journal_get_varint(&p, end, &len) || len + 2 > (guint64)(end - p))
+		return FALSE;
+	check= journal_checksum(start, (p - start) + len);
+	if (p[len] != (check & 0xff) || p[len + 1] != (check >> 8))
+		return FALSE;
+
+	frame->data= p;
+	frame->len= len;
+	frame->offset= map->pos;
+	map->pos= (p + len + 2) - map->data;
+	return TRUE;
+}
+
+
+/*
+ * Read game info from game frame
+ */
+gboolean
+journal_read_gameinfo(const struct journal_frame *frame, struct gameinfo *info)
+{
+	const guint8 *p=frame->data;
+	const guint8 *end=frame->data + frame->len;
+	guint64 type, size, diff_index;
+
+	if (frame->kind != JOURNAL_GAME ||
+		!journal_get_varint(&p, end, &type) ||
+		!journal_get_varint(&p, end, &size) ||
+		!journal_get_varint(&p, end, &diff_index) ||
+		type >= NUMBER_TILE_TYPE || size > G_MAXINT || diff_index > G_MAXINT)
+		return FALSE;
+	info->type= (int)type;
+	info->size= (int)size;
+	info->diff_index= (int)diff_index;
+	info->difficulty= 0.;
+	return TRUE;
+}
+
+
+/*
+ * Read tile numbers and solution from game frame into game
+ */
+gboolean
+journal_read_game(const struct journal_frame *frame,
+				  const struct geometry *geo, struct game *game)
+{
+	const guint8 *p=frame->data;
+	const guint8 *end=frame->data + frame->len;
+	guint64 value, nlines, ntiles;
+	int i;
+
+	if (!journal_get_varint(&p, end, &value) ||
+		!journal_get_varint(&p, end, &value) ||
+		!journal_get_varint(&p, end, &value) ||
+		!journal_get_varint(&p, end, &nlines) ||
+		!journal_get_varint(&p, end, &ntiles) ||
+		nlines != (guint64)geo->nlines || ntiles != (guint64)geo->ntiles ||
+		end - p != geo->ntiles + (geo->nlines + 7)/8)
+		return FALSE;
+
+	for(i=0; i < geo->ntiles; ++i)
+		game->numbers[i]= (int)*p++ - 1;
+	game->solution_nlines_on= 0;
+	for(i=0; i < geo->nlines; ++i) {
+		if (p[i/8] & (1 << (i % 8))) {
+			game->solution[i]= LINE_ON;
+			++game->solution_nlines_on;
+		} else {
+			game->solution[i]= LINE_OFF;
+		}
+	}
+	return TRUE;
+}
+
+
+/*
+ * Read snapshot frame: line states go into game
+ */
+gboolean
+journal_read_snapshot(const struct journal_frame *frame,
+					  const struct geometry *geo, struct game *game,
+					  guint *len, guint *pos, int *id)
+{
+	const guint8 *p=frame->data;
+	const guint8 *end=frame->data + frame->len;
+	guint64 vlen, vpos, vid;
+	int state;
+	int i;
+
+	if (frame->kind != JOURNAL_SNAPSHOT ||
+		!journal_get_varint(&p, end, &vlen) ||
+		!journal_get_varint(&p, end, &vpos) ||
+		!journal_get_varint(&p, end, &vid) ||
+		vlen > G_MAXUINT || vpos > vlen || vid >= (guint64)MAX(geo->nlines, 1) ||
+		end - p != (geo->nlines + 3)/4)
+		return FALSE;
+
+	for(i=0; i < geo->nlines; ++i) {
+		state= (p[i/4] >> (2*(i % 4))) & 3;
+		if (state > LINE_CROSSED) return FALSE;
+		game->states[i]= state;
+	}
+	*len= (guint)vlen;
+	*pos= (guint)vpos;
+	*id= (int)vid;
+	return TRUE;
+}
@@ -0,0 +1,102 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+#ifndef __INCLUDED_JOURNAL_H__
+#define __INCLUDED_JOURNAL_H__
+
+#include "gamedata.h"
+
+
+/*
+ * Journal file.
+ * Append-only record of a game session: the file starts with JOURNAL_MAGIC
+ * followed by frames, each one being
+ *     kind (1 byte), payload length (varint), payload, checksum (2 bytes)
+ * Integers in payloads are varints (LEB128), so the file doesn't depend on
+ * byte order. A frame that is cut short or doesn't match its checksum (e.g.
+ * after a crash while writing) ends the journal.
+ */
+#define JOURNAL_MAGIC		"FENCESJ1"
+#define JOURNAL_MAGIC_LEN	8
+
+/* kinds of frames */
+enum {
+	JOURNAL_GAME='G',		/* game info, tile numbers & solution (first) */
+	JOURNAL_SNAPSHOT='S',	/* line states & history position */
+	JOURNAL_CHANGES='C',	/* encoded changes written into history */
+	JOURNAL_UNDO='U',		/* history step back */
+	JOURNAL_REDO='R'		/* history step forward */
+};
+
+
+/* journal being written (private declaration, see journal.c) */
+struct journal;
+
+
+/*
+ * Frame read from a journal
+ */
+struct journal_frame {
+	int kind;				// kind of frame
+	const guint8 *data;		// payload
+	gsize len;				// length of payload
+	gsize offset;			// position of frame in file
+};
+
+
+/*
+ * Read-only view of a mapped journal file
+ */
+struct journal_map {
+	GMappedFile *file;
+	const guint8 *data;		// contents of file
+	gsize len;				// length of file
+	gsize pos;				// position of next frame
+};
+
+
+/* journal.c */
+void journal_put_varint(GByteArray *buf, guint64 value);
+gboolean journal_get_varint(const guint8 **p, const guint8 *end,
+							guint64 *value);
+gchar* journal_filename(void);
+struct journal* journal_new(const char *filename);
+gboolean journal_commit(struct journal *journal);
+void journal_close(struct journal *journal);
+void journal_write_game(struct journal *journal, const struct gameinfo *info,
+						const struct geometry *geo, const struct game *game);
+void journal_write_snapshot(struct journal *journal,
+							const struct geometry *geo,
+							const struct game *game,
+							guint len, guint pos, int id);
+void journal_write_changes(struct journal *journal, guint offset,
+						   const guint8 *records, guint len);
+void journal_write_step(struct journal *journal, int kind);
+gboolean journal_wants_snapshot(const struct journal *journal,
+								const struct geometry *geo);
+struct journal_map* journal_map_open(const char *filename);
+void journal_map_close(struct journal_map *map);
+gboolean journal_map_next(struct journal_map *map,
+						  struct journal_frame *frame);
+gboolean journal_read_gameinfo(const struct journal_frame *frame,
+							   struct gameinfo *info);
+gboolean journal_read_game(const struct journal_frame *frame,
+						   const struct geometry *geo, struct game *game);
+gboolean journal_read_snapshot(const struct journal_frame *frame,
+							   const struct geometry *geo, struct game *game,
+							   guint *len, guint *pos, int *id);
+
+#endif
@@ -0,0 +1,342 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+#include <glib.h>
+#include <math.h>
+
+#include "geometry.h"
+#include "lattice.h"
+
+
+/*
+ * Element of the tiling given as element 'k' of the unit cell that is
+ * displaced (di,dj) from the current unit.
+ */
+struct lattice_ref {
+	int k;
+	int di, dj;
+};
+
+
+/*
+ * Incidences of one face of the unit, in terms of unit cell elements
+ */
+struct lattice_cell_face {
+	struct lattice_ref face;
+	struct lattice_ref vertex[LATTICE_MAX_SIDES];
+	struct lattice_ref edge[LATTICE_MAX_SIDES];
+};
+
+
+/*
+ * Unit cell: every vertex, edge and face of the tiling is a translate of
+ * exactly one element in here.
+ */
+struct lattice_cell {
+	int nvertex;
+	int nedges;
+	int nfaces;
+	struct point *vertex;	// reduced position of cell vertices
+	struct point *edges;	// reduced midpoint of cell edges
+	struct point *faces;	// reduced center of cell faces
+	struct lattice_cell_face *incidence;	// one per face of lattice unit
+	int dimin, dimax;		// range of displacements found in refs
+	int djmin, djmax;
+};
+
+
+
+/*
+ * Split point (relative to unit) into a lattice displacement and a
+ * position inside the unit cell.
+ */
+static void
+lattice_reduce(const struct lattice *lat, const struct point *pt,
+			   int *di, int *dj, struct point *rem)
+{
+	double det;
+	double u, v;
+
+	det= lat->a.x*lat->b.y - lat->a.y*lat->b.x;
+	u= (pt->x*lat->b.y - pt->y*lat->b.x)/det;
+	v= (lat->a.x*pt->y - lat->a.y*pt->x)/det;
+	/* points on the cell boundary must always fall on the same side */
+	*di= (int)floor(u + 1e-6);
+	*dj= (int)floor(v + 1e-6);
+	rem->x= pt->x - *di*lat->a.x - *dj*lat->b.x;
+	rem->y= pt->y - *di*lat->a.y - *dj*lat->b.y;
+}
+
+
+/*
+ * Find reduced point in list of cell elements (add it if not there).
+ * Returns index of element.
+ */
+static int
+lattice_cell_element(struct point *list, int *n, const struct point *pt,
+					 double tol)
+{
+	int i;
+
+	for(i=0; i < *n; ++i) {
+		if (fabs(list[i].x - pt->x) < tol && fabs(list[i].y - pt->y) < tol)
+			return i;
+	}
+	list[*n]= *pt;
+	++(*n);
+	return i;
+}
+
+
+/*
+ * Convert point into a reference to a cell element
+ */
+static void
+lattice_make_ref(const struct lattice *lat, struct lattice_cell *cell,
+				 struct point *list, int *n, const struct point *pt,
+				 double tol, struct lattice_ref *ref)
+{
+	struct point rem;
+
+	lattice_reduce(lat, pt, &ref->di, &ref->dj, &rem);
+	ref->k= lattice_cell_element(list, n, &rem, tol);
+	if (ref->di < cell->dimin) cell->dimin= ref->di;
+	if (ref->di > cell->dimax) cell->dimax= ref->di;
+	if (ref->dj < cell->djmin) cell->djmin= ref->dj;
+	if (ref->dj > cell->djmax) cell->djmax= ref->dj;
+}
+
+
+/*
+ * Work out unit cell and incidences of the faces in a lattice unit.
+ * Only depends on the unit, not on the size of the board.
+ */
+static struct lattice_cell*
+lattice_cell_new(const struct lattice *lat)
+{
+	struct lattice_cell *cell;
+	const struct lattice_face *face;
+	struct lattice_cell_face *inc;
+	struct point mid;
+	double tol;
+	int nmax;
+	int f, s, s1;
+
+	/* no more elements in the cell than in the unit */
+	nmax= 0;
+	for(f=0; f < lat->nfaces; ++f) {
+		g_assert(lat->faces[f].nsides >= 3 &&
+				 lat->faces[f].nsides <= LATTICE_MAX_SIDES);
+		nmax+= lat->faces[f].nsides;
+	}
+	cell= (struct lattice_cell*)g_malloc(sizeof(struct lattice_cell));
+	cell->vertex= (struct point*)g_malloc(nmax*sizeof(struct point));
+	cell->edges= (struct point*)g_malloc(nmax*sizeof(struct point));
+	cell->faces= (struct point*)g_malloc(lat->nfaces*sizeof(struct point));
+	cell->incidence= (struct lattice_cell_face*)
+		g_malloc(lat->nfaces*sizeof(struct lattice_cell_face));
+	cell->nvertex= cell->nedges= cell->nfaces= 0;
+	cell->dimin= cell->dimax= cell->djmin= cell->djmax= 0;
+
+	tol= 1e-6*(fabs(lat->a.x) + fabs(lat->a.y) + fabs(lat->b.x) + fabs(lat->b.y));
+
+	face= lat->faces;
+	inc= cell->incidence;
+	for(f=0; f < lat->nfaces; ++f) {
+		/* vertices and edges (identified by their midpoint) */
+		mid.x= mid.y= 0.;
+		for(s=0; s < face->nsides; ++s) {
+			lattice_make_ref(lat, cell, cell->vertex, &cell->nvertex,
+							 face->pts + s, tol, inc->vertex + s);
+			s1= (s + 1) % face->nsides;
+			mid.x= (face->pts[s].x + face->pts[s1].x)/2.;
+			mid.y= (face->pts[s].y + face->pts[s1].y)/2.;
+			lattice_make_ref(lat, cell, cell->edges, &cell->nedges,
+							 &mid, tol, inc->edge + s);
+		}
+		/* face (identified by its centre) */
+		mid.x= mid.y= 0.;
+		for(s=0; s < face->nsides; ++s) {
+			mid.x+= face->pts[s].x;
+			mid.y+= face->pts[s].y;
+		}
+		mid.x/= face->nsides;
+		mid.y/= face->nsides;
+		lattice_make_ref(lat, cell, cell->faces, &cell->nfaces,
+						 &mid, tol, &inc->face);
+		++face;
+		++inc;
+	}
+
+	return cell;
+}
+
+
+/*
+ * Free unit cell
+ */
+static void
+lattice_cell_destroy(struct lattice_cell *cell)
+{
+	g_free(cell->vertex);
+	g_free(cell->edges);
+	g_free(cell->faces);
+	g_free(cell->incidence);
+	g_free(cell);
+}
+
+
+/*
+ * Build geometry skeleton (no connections) of a periodic tiling.
+ * Ids of vertices, lines and tiles are kept in arrays indexed by unit cell
+ * position, so shared elements are found by index arithmetic.
+ * Board size and margins are left for the caller to set.
+ */
+struct geometry*
+lattice_build_skeleton(const struct lattice *lat)
+{
+	struct geometry *geo;
+	struct lattice_cell *cell;
+	struct lattice_cell_face *inc;
+	const struct lattice_face *face;
+	struct tile *tile;
+	struct line *lin;
+	struct point pts[LATTICE_MAX_SIDES];
+	struct point pos;
+	struct point center;
+	int *vertex_id;
+	int *line_id;
+	int *tile_id;
+	guint8 *keep;
+	int width, height;		// size of grid of cells touched by units
+	int nunits;
+	int ntiles=0, nvertex=0, nlines=0;
+	int pass;
+	int i, j, f, s;
+	int unit;
+	int idx, vid, vid1, lid;
+
+	cell= lattice_cell_new(lat);
+
+	/* grid of cells: units plus displacements found in unit */
+	width= (lat->imax - lat->imin + 1) + cell->dimax - cell->dimin;
+	height= (lat->jmax - lat->jmin + 1) + cell->djmax - cell->djmin;
+	nunits= (lat->imax - lat->imin + 1)*(lat->jmax - lat->jmin + 1);
+	vertex_id= (int*)g_malloc(width*height*cell->nvertex*sizeof(int));
+	line_id= (int*)g_malloc(width*height*cell->nedges*sizeof(int));
+	tile_id= (int*)g_malloc(width*height*cell->nfaces*sizeof(int));
+	keep= (guint8*)g_malloc(nunits*lat->nfaces*sizeof(guint8));
+	for(i=0; i < width*height*cell->nvertex; ++i) vertex_id[i]= -1;
+	for(i=0; i < width*height*cell->nedges; ++i) line_id[i]= -1;
+	for(i=0; i < width*height*cell->nfaces; ++i) tile_id[i]= -1;
+
+/* index in id arrays of element 'ref' seen from unit (i,j) */
+#define CELL_INDEX(ref, n)	((((i) - lat->imin + (ref).di - cell->dimin)*height + \
+							  ((j) - lat->jmin + (ref).dj - cell->djmin))*(n) + (ref).k)
+
+	/* pass 0: choose faces and assign ids.
+	   pass 1: create elements (in the same order ids were assigned) */
+	geo= NULL;
+	for(pass=0; pass < 2; ++pass) {
+		unit= 0;
+		for(i=lat->imin; i <= lat->imax; ++i) {
+			for(j=lat->jmin; j <= lat->jmax; ++j) {
+				pos.x= lat->origin.x + i*lat->a.x + j*lat->b.x;
+				pos.y= lat->origin.y + i*lat->a.y + j*lat->b.y;
+				face= lat->faces;
+				inc= cell->incidence;
+				for(f=0; f < lat->nfaces; ++f, ++face, ++inc) {
+					if (pass == 0) {
+						keep[unit*lat->nfaces + f]= FALSE;
+						for(s=0; s < face->nsides; ++s) {
+							pts[s].x= pos.x + face->pts[s].x;
+							pts[s].y= pos.y + face->pts[s].y;
+						}
+						if (lat->clip != NULL &&
+							!lat->clip(i, j, f, pts, face->nsides, lat->clip_data))
+							continue;
+						/* face may have been added by a neighbouring unit */
+						idx= CELL_INDEX(inc->face, cell->nfaces);
+						if (tile_id[idx] != -1) continue;
+						tile_id[idx]= ntiles++;
+						keep[unit*lat->nfaces + f]= TRUE;
+						for(s=0; s < face->nsides; ++s) {
+							idx= CELL_INDEX(inc->vertex[s], cell->nvertex);
+							if (vertex_id[idx] == -1) vertex_id[idx]= nvertex++;
+							idx= CELL_INDEX(inc->edge[s], cell->nedges);
+							if (line_id[idx] == -1) line_id[idx]= nlines++;
+						}
+						continue;
+					}
+
+					if (!keep[unit*lat->nfaces + f]) continue;
+					center.x= center.y= 0.;
+					for(s=0; s < face->nsides; ++s) {
+						pts[s].x= pos.x + face->pts[s].x;
+						pts[s].y= pos.y + face->pts[s].y;
+						center.x+= pts[s].x;
+						center.y+= pts[s].y;
+					}
+					center.x/= face->nsides;
+					center.y/= face->nsides;
+					tile= geometry_new_tile(geo, &center);
+					g_assert(tile->id == tile_id[CELL_INDEX(inc->face, cell->nfaces)]);
+
+					/* new vertices */
+					for(s=0; s < face->nsides; ++s) {
+						vid= vertex_id[CELL_INDEX(inc->vertex[s], cell->nvertex)];
+						if (vid == geo->nvertex)
+							geometry_new_vertex(geo, pts + s);
+					}
+					/* sides */
+					for(s=0; s < face->nsides; ++s) {
+						vid= vertex_id[CELL_INDEX(inc->vertex[s], cell->nvertex)];
+						vid1= vertex_id[CELL_INDEX(inc->vertex[(s + 1) % face->nsides],
+												   cell->nvertex)];
+						lid= line_id[CELL_INDEX(inc->edge[s], cell->nedges)];
+						if (lid == geo->nlines)
+							geometry_new_line(geo, vid, vid1);
+						lin= geo->lines + lid;
+						g_assert(lin->ntiles < 2);	/* no more than 2 tiles touching line */
+						lin->tiles[lin->ntiles]= tile;
+						++lin->ntiles;
+					}
+				}
+				++unit;
+			}
+		}
+
+		if (pass == 0) {
+			geo= geometry_create_new(ntiles, nvertex, nlines, lat->max_numlines);
+			geo->ntiles= 0;
+			geo->nvertex= 0;
+			geo->nlines= 0;
+		}
+	}
+#undef CELL_INDEX
+
+	g_assert(geo->ntiles == ntiles);
+	g_assert(geo->nvertex == nvertex);
+	g_assert(geo->nlines == nlines);
+
+	g_free(vertex_id);
+	g_free(line_id);
+	g_free(tile_id);
+	g_free(keep);
+	lattice_cell_destroy(cell);
+
+	return geo;
+}
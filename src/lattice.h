@@ -0,0 +1,71 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+#ifndef __INCLUDED_LATTICE_H__
+#define __INCLUDED_LATTICE_H__
+
+#include "geometry.h"
+
+
+/* max number of sides of a face in a lattice unit */
+#define LATTICE_MAX_SIDES	6
+
+
+/*
+ * Polygon in a lattice unit. Points are relative to unit position and
+ * must wrap around the face in order.
+ */
+struct lattice_face {
+	int nsides;
+	struct point pts[LATTICE_MAX_SIDES];
+};
+
+
+/*
+ * Decides if a face of unit (i,j) is part of the board.
+ * pts: board coordinates of face
+ */
+typedef gboolean (*lattice_clip_func)(int i, int j, int face,
+									  const struct point *pts, int npts,
+									  gpointer data);
+
+
+/*
+ * Description of a periodic tiling.
+ * Unit (i,j) is placed at origin + i*a + j*b, for imin <= i <= imax and
+ * jmin <= j <= jmax. Faces of neighbouring units may overlap (e.g. a unit
+ * that includes a ring of faces shared with its neighbours): faces, lines
+ * and vertices that are translates of each other are identified by index,
+ * so no position searches are needed while building the board.
+ */
+struct lattice {
+	struct point origin;		// position of unit (0,0)
+	struct point a;				// translation vectors
+	struct point b;
+	int nfaces;					// number of faces in a unit
+	const struct lattice_face *faces;	// faces of unit
+	int imin, imax;				// range of units
+	int jmin, jmax;
+	lattice_clip_func clip;		// which faces to keep (NULL: all)
+	gpointer clip_data;			// data passed to clip function
+	int max_numlines;			// max number of sides of a face
+};
+
+
+/* lattice.c */
+struct geometry* lattice_build_skeleton(const struct lattice *lat);
+
+#endif
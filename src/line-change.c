@@ -18,142 +18,440 @@
 #  include <config.h>
 #endif
 
-#include <glib.h>
+#include <gtk/gtk.h>
 #include <stdio.h>
+#include <stdlib.h>
 
+#include "i18n.h"
 #include "gamedata.h"
 #include "game-solver.h"
+#include "animation.h"
+#include "loop-tracker.h"
+#include "hint.h"
+#include "checker.h"
+#include "history.h"
+#include "gui.h"
+#include "view.h"
 
 
 /*
- * Check if game is complete
+ * Check if every numbered tile has as many ON lines as its number
  */
 static gboolean
-is_game_finished(struct board *board)
+linechange_numbers_satisfied(struct board *board)
 {
 	struct game *game=board->game;
-	int i;
+	struct tile *tile=board->geo->tiles;
+	int i, j;
+	int num_on;
 
-	g_assert(game != NULL);
-	if (game->nlines_on != game->solution_nlines_on)
-		return FALSE;
-	/* check solution is correct */
-	for(i=0; i < board->geo->nlines; ++i) {
-		if (game->states[i] == LINE_ON || game->solution[i] == LINE_ON) {
-			if (game->states[i] != game->solution[i]) return FALSE;
-		}
+	for(i=0; i < board->geo->ntiles; ++i, ++tile) {
+		if (game->numbers[i] == -1) continue;
+		num_on= 0;
+		for(j=0; j < tile->nsides; ++j)
+			if (game->states[tile->sides[j]->id] == LINE_ON) ++num_on;
+		if (num_on != game->numbers[i]) return FALSE;
 	}
 	return TRUE;
 }
 
 
 /*
- * Check if vertices that touch line have more than two lines ON
+ * Check if game is complete: no line differs from solution, or ON lines
+ * form a single loop that satisfies all the numbers (another solution).
+ * Tiles are only checked when there's a single loop on the board.
+ */
+static gboolean
+is_game_finished(struct board *board)
+{
+	struct game *game=board->game;
+
+	g_assert(game != NULL);
+	if (game->solution_nlines_on == 0) return FALSE;
+	if (game->nmismatch == 0) return TRUE;
+	if (!loop_tracker_is_single_loop(game->loops)) return FALSE;
+	return linechange_numbers_satisfied(board);
+}
+
+
+/*
+ * Check if vertex has more than two lines ON
  */
 static void
-linechange_check_vertices(struct board *board, struct line *line_changed)
+linechange_check_vertex(struct board *board, struct vertex *vertex)
 {
 	struct game *game=board->game;
-	struct vertex *vertex;
 	struct line *lin;
-	int i, j;
+	int j;
 	int num_on;
 	int old_state;
 	struct clipbox clip;
 
-	for(i=0; i < 2; ++i) {
-		vertex= line_changed->ends[i];
-		/* count number of ON lines */
-		num_on= 0;
-		for(j=0; j < vertex->nlines; ++j) {
-			lin= vertex->lines[j];
-			if (game->states[lin->id] == LINE_ON) ++num_on;
-		}
-		old_state= vertex->display_state;
-		if (num_on > 2) {
-			if (vertex->display_state != DISPLAY_ERROR) {
-				vertex->display_state= DISPLAY_ERROR;
-			}
-		} else {
-			vertex->display_state= DISPLAY_NORMAL;
-		}
-		if (old_state != vertex->display_state) {
-			clip.x= vertex->pos.x - board->geo->tile_width/4;
-			clip.y= vertex->pos.y - board->geo->tile_height/4;
-			clip.w= board->geo->tile_width/2;
-			clip.h= board->geo->tile_height/2;
-			geometry_update_clip(board->geo, &clip);
+	/* count number of ON lines */
+	num_on= 0;
+	for(j=0; j < vertex->nlines; ++j) {
+		lin= vertex->lines[j];
+		if (game->states[lin->id] == LINE_ON) ++num_on;
+	}
+	old_state= game->vertex_display[vertex->id];
+	if (num_on > 2) {
+		if (game->vertex_display[vertex->id] != DISPLAY_ERROR) {
+			game->vertex_display[vertex->id]= DISPLAY_ERROR;
 		}
+	} else {
+		game->vertex_display[vertex->id]= DISPLAY_NORMAL;
+	}
+	if (old_state != game->vertex_display[vertex->id]) {
+		clip.x= vertex->pos.x - board->geo->tile_width/4;
+		clip.y= vertex->pos.y - board->geo->tile_height/4;
+		clip.w= board->geo->tile_width/2;
+		clip.h= board->geo->tile_height/2;
+		geometry_clip_union(&game->clip, &clip);
 	}
 }
 
 
 /*
- * Check if tiles that touch line have too many lines ON
+ * Check if tile has too many lines ON
  */
 static void
-linechange_check_tiles(struct board *board, struct line *line_changed)
+linechange_check_tile(struct board *board, struct tile *tile)
 {
 	struct game *game=board->game;
-	struct tile *tile;
 	struct line *lin;
-	int i, j;
+	int j;
 	int tile_number;
 	int num_on;
 	int old_state;
 	struct clipbox clip;
 
-	for(i=0; i < line_changed->ntiles; ++i) {
-		tile= line_changed->tiles[i];
-		tile_number= game->numbers[tile->id];
-		if (tile_number == -1) continue;
-		/* count number of ON lines around tile */
-		num_on= 0;
-		for(j=0; j < tile->nsides; ++j) {
-			lin= tile->sides[j];
-			if (game->states[lin->id] == LINE_ON) ++num_on;
-		}
-		old_state= tile->display_state;
-		if (num_on > tile_number) {
-			tile->display_state= DISPLAY_ERROR;
-		} else if (num_on == tile_number) {
-			tile->display_state= DISPLAY_HANDLED;
-		} else {
-			tile->display_state= DISPLAY_NORMAL;
-		}
-		if (old_state != tile->display_state) {
-			clip.x= tile->center.x - board->geo->tile_width;
-			clip.y= tile->center.y - board->geo->tile_height;
-			clip.w= board->geo->tile_width*2;
-			clip.h= board->geo->tile_height*2;
-			geometry_update_clip(board->geo, &clip);
+	tile_number= game->numbers[tile->id];
+	if (tile_number == -1) return;
+	/* count number of ON lines around tile */
+	num_on= 0;
+	for(j=0; j < tile->nsides; ++j) {
+		lin= tile->sides[j];
+		if (game->states[lin->id] == LINE_ON) ++num_on;
+	}
+	old_state= game->tile_display[tile->id];
+	if (num_on > tile_number) {
+		game->tile_display[tile->id]= DISPLAY_ERROR;
+	} else if (num_on == tile_number) {
+		game->tile_display[tile->id]= DISPLAY_HANDLED;
+	} else {
+		game->tile_display[tile->id]= DISPLAY_NORMAL;
+	}
+	if (old_state != game->tile_display[tile->id]) {
+		clip.x= tile->center.x - board->geo->tile_width;
+		clip.y= tile->center.y - board->geo->tile_height;
+		clip.w= board->geo->tile_width*2;
+		clip.h= board->geo->tile_height*2;
+		geometry_clip_union(&game->clip, &clip);
+	}
+}
+
+
+/*
+ * Compare pointers (for qsort)
+ */
+static int
+linechange_ptr_cmp(const void *a, const void *b)
+{
+	const char *p1=*(const char* const*)a;
+	const char *p2=*(const char* const*)b;
+
+	return (p1 > p2) - (p1 < p2);
+}
+
+
+/*
+ * Check vertices and tiles touching the changed lines (each of them once)
+ */
+static void
+linechange_check_neighbourhood(struct board *board,
+							   const struct line_change *changes, int nchanges)
+{
+	struct line *lin;
+	gpointer *items;
+	int nitems;
+	int i, j;
+
+	items= (gpointer*)g_malloc(2*nchanges*sizeof(gpointer));
+
+	/* vertices */
+	nitems= 0;
+	for(i=0; i < nchanges; ++i) {
+		lin= board->geo->lines + changes[i].id;
+		items[nitems++]= lin->ends[0];
+		items[nitems++]= lin->ends[1];
+	}
+	qsort(items, nitems, sizeof(gpointer), linechange_ptr_cmp);
+	for(i=0; i < nitems; ++i) {
+		if (i > 0 && items[i] == items[i - 1]) continue;
+		linechange_check_vertex(board, (struct vertex*)items[i]);
+	}
+
+	/* tiles */
+	nitems= 0;
+	for(i=0; i < nchanges; ++i) {
+		lin= board->geo->lines + changes[i].id;
+		for(j=0; j < lin->ntiles; ++j)
+			items[nitems++]= lin->tiles[j];
+	}
+	qsort(items, nitems, sizeof(gpointer), linechange_ptr_cmp);
+	for(i=0; i < nitems; ++i) {
+		if (i > 0 && items[i] == items[i - 1]) continue;
+		linechange_check_tile(board, (struct tile*)items[i]);
+	}
+
+	g_free(items);
+}
+
+
+/*
+ * Check every vertex and tile, for a board set up as a whole (e.g. game
+ * resumed from journal). Returns TRUE if the game is finished.
+ */
+gboolean
+linechange_check_all(struct board *board)
+{
+	int i;
+
+	for(i=0; i < board->geo->nvertex; ++i)
+		linechange_check_vertex(board, board->geo->vertex + i);
+	for(i=0; i < board->geo->ntiles; ++i)
+		linechange_check_tile(board, board->geo->tiles + i);
+	return is_game_finished(board);
+}
+
+
+/*
+ * Animate loop of finished game: lines are started at consecutive frames
+ * following the loop, so the glow travels around it
+ */
+static void
+linechange_animate_loop(struct board *board)
+{
+	struct game *game=board->game;
+	struct line *lin, *next;
+	struct vertex *vertex;
+	int i;
+	int frame=0;
+
+	/* find first line in loop */
+	for(i=0; i < board->geo->nlines; ++i)
+		if (game->states[i] == LINE_ON) break;
+	if (i == board->geo->nlines) return;
+	lin= board->geo->lines + i;
+	vertex= lin->ends[1];
+
+	while(game->line_fx[lin->id].status == FX_OFF) {
+		animation_start_line(board, lin->id, FX_LOOP, frame);
+		frame= (frame + FX_LOOP_FRAMES - 1)%FX_LOOP_FRAMES;
+		/* next ON line at vertex */
+		next= NULL;
+		for(i=0; i < vertex->nlines; ++i) {
+			if (vertex->lines[i] != lin &&
+				game->states[vertex->lines[i]->id] == LINE_ON) {
+				next= vertex->lines[i];
+				break;
+			}
 		}
+		if (next == NULL) break;
+		lin= next;
+		vertex= (lin->ends[0] == vertex) ? lin->ends[1] : lin->ends[0];
 	}
 }
 
 
 /*
- * Perform change in game state
+ * Show progress of game in status bar: solved, closed loop leaving lines
+ * out or number of lines still differing from solution
  */
-inline void
-make_line_change(struct board *board, struct line_change *change)
+static void
+linechange_report_progress(struct board *board, gboolean finished)
+{
+	struct game *game=board->game;
+	gchar *text;
+
+	if (finished)
+		text= g_strdup(_("Puzzle solved"));
+	else if (loop_tracker_has_premature_loop(game->loops))
+		text= g_strdup(_("Closed loop leaves other lines out"));
+	else
+		text= g_strdup_printf(_("Lines left to fix: %d"), game->nmismatch);
+	fencesgui_set_progress(board, text);
+	g_free(text);
+}
+
+
+/*
+ * Show progress of game in status bar (board set up or changed as a whole)
+ */
+void
+linechange_show_progress(struct board *board)
+{
+	if (board->game == NULL || board->game->solution_nlines_on == 0) {
+		fencesgui_set_progress(board, NULL);
+		return;
+	}
+	linechange_report_progress(board, is_game_finished(board));
+}
+
+
+/*
+ * Add area covered by lines and tiles of hint to clip box
+ */
+static void
+linechange_hint_clip(struct board *board, const struct hint *hint,
+					 struct clipbox *clip)
+{
+	struct geometry *geo=board->geo;
+	struct tile *tile;
+	int i, j;
+
+	for(i=0; i < hint->nchanges; ++i)
+		geometry_clip_union(clip, &geo->lines[hint->changes[i]].clip);
+	for(i=0; i < hint->ntile_changes; ++i) {
+		tile= geo->tiles + hint->tile_changes[i];
+		for(j=0; j < tile->nsides; ++j)
+			geometry_clip_union(clip, &tile->sides[j]->clip);
+	}
+}
+
+
+/*
+ * Show hint to player: its lines and tiles are marked on the board (until
+ * next change) and the status bar tells what to do with them.
+ * NULL hint clears marks and message of hint shown before (do it before
+ * asking the hint engine for another one: hints share their arrays).
+ */
+void
+linechange_show_hint(struct board *board, const struct hint *hint)
 {
-	struct line *line_changed;
+	struct game *game=board->game;
+	struct clipbox clip;
+	const gchar *text;
+
+	/* marks of hint shown before go away */
+	if (game->hint != NULL) {
+		clip= board->geo->lines[game->hint->changes[0]].clip;
+		linechange_hint_clip(board, game->hint, &clip);
+		view_queue_draw_clip(board, &clip);
+		game->hint= NULL;
+	}
+	if (hint == NULL) {
+		fencesgui_set_status(board, NULL);
+		return;
+	}
+
+	switch(hint->kind) {
+		case HINT_WRONG:
+			text= _("Hint: marked lines go against the solution, undo them");
+		break;
+		case HINT_DEDUCTION:
+			text= _("Hint: marked lines follow from the lines and numbers around them");
+		break;
+		case HINT_REVEAL:
+			text= _("Hint: marked line is taken from the solution");
+		break;
+		default:
+			text= _("No hint: nothing left to do");
+	}
+	fencesgui_set_status(board, text);
+	if (hint->nchanges == 0) return;
 
-	board->game->states[change->id]= change->new_state;
-	if (change->old_state == LINE_ON) --board->game->nlines_on;
-	else if (change->new_state == LINE_ON) ++board->game->nlines_on;
+	game->hint= hint;
+	clip= board->geo->lines[hint->changes[0]].clip;
+	linechange_hint_clip(board, hint, &clip);
+	view_queue_draw_clip(board, &clip);
+}
 
-	/* set clip box */
-	line_changed= board->geo->lines + change->id;
-	geometry_set_clip(board->geo, &line_changed->clip);
+
+/*
+ * Perform a batch of changes in game state: line states are changed, then
+ * the affected vertices and tiles are checked (once) and the game is
+ * checked for completion. Clip box is set to the area to redraw.
+ */
+void
+make_line_changes(struct board *board, struct line_change *changes,
+				  int nchanges)
+{
+	struct game *game=board->game;
+	struct line_change *change;
+	int i;
+	gboolean premature;
+	gboolean finished;
+	guint nloop_events;
+
+	if (nchanges == 0) return;
+	premature= loop_tracker_has_premature_loop(game->loops);
+	nloop_events= game->loops->nloop_events;
+	for(i=0; i < nchanges; ++i) {
+		change= changes + i;
+		game->states[change->id]= change->new_state;
+		if (change->old_state == LINE_ON) --game->nlines_on;
+		else if (change->new_state == LINE_ON) ++game->nlines_on;
+		/* lines differing from solution, chains of ON lines */
+		if ((change->old_state == LINE_ON) != (change->new_state == LINE_ON)) {
+			if ((change->new_state == LINE_ON) ==
+				(game->solution[change->id] == LINE_ON))
+				--game->nmismatch;
+			else
+				++game->nmismatch;
+			loop_tracker_set_line(game->loops, change->id,
+								  change->new_state == LINE_ON);
+		}
+		if (game->hints != NULL)
+			hint_engine_set_line(game->hints, change->id, change->old_state,
+								 change->new_state);
+
+		/* set clip box */
+		if (i == 0) game->clip= board->geo->lines[change->id].clip;
+		else geometry_clip_union(&game->clip,
+								 &board->geo->lines[change->id].clip);
+	}
+
+	/* hint no longer applies: clear its marks */
+	if (game->hint != NULL) {
+		linechange_hint_clip(board, game->hint, &game->clip);
+		game->hint= NULL;
+		fencesgui_set_status(board, NULL);
+	}
+
+	/* premature loops shown or gone, or a loop closed or opened while
+	   there are premature loops: lines of whole chains change colour */
+	if (loop_tracker_has_premature_loop(game->loops) != premature ||
+		(premature && game->loops->nloop_events != nloop_events)) {
+		game->clip.x= game->clip.y= 0.;
+		game->clip.w= game->clip.h= board->geo->board_size;
+	}
 
 	/* did we just solve the game? */
-	if (is_game_finished(board)) {
+	finished= is_game_finished(board);
+	if (finished) {
 		printf("Game Finished!!\n");
+		linechange_animate_loop(board);
+	} else {
+		if (animation_is_running(board->animation))
+			animation_stop_all(board);
 	}
+	linechange_report_progress(board, finished);
 
-	/* check for errors */
-	linechange_check_vertices(board, line_changed);
-	linechange_check_tiles(board, line_changed);
+	/* check for errors (and, in background, whether a solution is left) */
+	linechange_check_neighbourhood(board, changes, nchanges);
+	checker_post_changes(board, changes, nchanges);
+
+	/* journal changes recorded for this batch (one frame) */
+	history_flush_journal(board->history);
+}
+
+
+/*
+ * Perform change in game state
+ */
+inline void
+make_line_change(struct board *board, struct line_change *change)
+{
+	make_line_changes(board, change, 1);
 }
@@ -0,0 +1,447 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+#include <glib.h>
+
+#include "geometry.h"
+#include "loop-tracker.h"
+
+
+/*
+ * Loop tracker.
+ * Each chain of ON lines is kept as a sequence of lines in a treap
+ * (randomized balanced binary tree, ordered by position in the chain):
+ * joining two chains, splitting a chain at a line or reversing a chain
+ * take O(log n) time, so every line change is handled without going
+ * through the rest of the board.
+ * Lines are stored with a direction (which end comes first), so the
+ * vertices at both ends of a chain can be found from its first and last
+ * lines. Reversal is lazy: a flag on a subtree, pushed down when the
+ * subtree is visited.
+ */
+
+
+/*
+ * Node of chain treap (one per line)
+ */
+struct loop_node {
+	int left, right;		// children in treap (-1: none)
+	int parent;				// parent in treap (-1: root)
+	int size;				// number of nodes in subtree
+	guint32 priority;		// treap priority (higher goes on top)
+	gboolean on;			// is line ON?
+	gboolean in_chain;		// is line in a chain? (OFF & branch lines aren't)
+	gboolean flip;			// line goes from ends[1] to ends[0] in chain
+	gboolean reverse;		// subtree must be reversed (pending)
+	gboolean closed;		// chain is a loop (only valid at root)
+};
+
+
+
+/*
+ * Size of subtree (0 if empty)
+ */
+static inline int
+chain_size(const struct loop_node *nodes, int i)
+{
+	return (i < 0) ? 0 : nodes[i].size;
+}
+
+
+/*
+ * Update node after its children changed
+ */
+static void
+chain_update(struct loop_node *nodes, int i)
+{
+	nodes[i].size= 1 + chain_size(nodes, nodes[i].left) +
+		chain_size(nodes, nodes[i].right);
+	if (nodes[i].left >= 0) nodes[nodes[i].left].parent= i;
+	if (nodes[i].right >= 0) nodes[nodes[i].right].parent= i;
+}
+
+
+/*
+ * Apply pending reversal of node to its children
+ */
+static void
+chain_push(struct loop_node *nodes, int i)
+{
+	int tmp;
+
+	if (!nodes[i].reverse) return;
+	tmp= nodes[i].left;
+	nodes[i].left= nodes[i].right;
+	nodes[i].right= tmp;
+	nodes[i].flip= !nodes[i].flip;
+	if (nodes[i].left >= 0) nodes[nodes[i].left].reverse^= TRUE;
+	if (nodes[i].right >= 0) nodes[nodes[i].right].reverse^= TRUE;
+	nodes[i].reverse= FALSE;
+}
+
+
+/*
+ * Join chains a and b (b goes after a). Returns root of new chain.
+ */
+static int
+chain_merge(struct loop_node *nodes, int a, int b)
+{
+	if (a < 0) return b;
+	if (b < 0) return a;
+	if (nodes[a].priority > nodes[b].priority) {
+		chain_push(nodes, a);
+		nodes[a].right= chain_merge(nodes, nodes[a].right, b);
+		chain_update(nodes, a);
+		return a;
+	}
+	chain_push(nodes, b);
+	nodes[b].left= chain_merge(nodes, a, nodes[b].left);
+	chain_update(nodes, b);
+	return b;
+}
+
+
+/*
+ * Split chain t in its first k lines (a) and the rest (b)
+ */
+static void
+chain_split(struct loop_node *nodes, int t, int k, int *a, int *b)
+{
+	if (t < 0) {
+		*a= *b= -1;
+		return;
+	}
+	chain_push(nodes, t);
+	if (chain_size(nodes, nodes[t].left) >= k) {
+		chain_split(nodes, nodes[t].left, k, a, &nodes[t].left);
+		*b= t;
+	} else {
+		chain_split(nodes, nodes[t].right,
+					k - chain_size(nodes, nodes[t].left) - 1,
+					&nodes[t].right, b);
+		*a= t;
+	}
+	chain_update(nodes, t);
+}
+
+
+/*
+ * Make node the root of a tree on its own
+ */
+static inline int
+chain_set_root(struct loop_node *nodes, int i)
+{
+	if (i >= 0) nodes[i].parent= -1;
+	return i;
+}
+
+
+/*
+ * Root of chain containing node
+ */
+static int
+chain_root(const struct loop_node *nodes, int i)
+{
+	while(nodes[i].parent >= 0)
+		i= nodes[i].parent;
+	return i;
+}
+
+
+/*
+ * Apply pending reversals on the path from root down to node
+ */
+static void
+chain_push_path(struct loop_node *nodes, int i)
+{
+	if (nodes[i].parent >= 0)
+		chain_push_path(nodes, nodes[i].parent);
+	chain_push(nodes, i);
+}
+
+
+/*
+ * Position of line in its chain
+ */
+static int
+chain_index(struct loop_node *nodes, int i)
+{
+	int index;
+	int p;
+
+	chain_push_path(nodes, i);
+	index= chain_size(nodes, nodes[i].left);
+	for(p=nodes[i].parent; p >= 0; i=p, p=nodes[p].parent) {
+		if (nodes[p].right == i)
+			index+= chain_size(nodes, nodes[p].left) + 1;
+	}
+	return index;
+}
+
+
+/*
+ * First (end= FALSE) or last (end= TRUE) line of chain with root r
+ */
+static int
+chain_end_line(struct loop_node *nodes, int r, gboolean end)
+{
+	int i=r;
+
+	chain_push(nodes, i);
+	while((end ? nodes[i].right : nodes[i].left) >= 0) {
+		i= end ? nodes[i].right : nodes[i].left;
+		chain_push(nodes, i);
+	}
+	return i;
+}
+
+
+/*
+ * Vertex at start (end= FALSE) or end (end= TRUE) of chain with root r
+ */
+static struct vertex*
+chain_end_vertex(struct loop_tracker *tracker, int r, gboolean end)
+{
+	int i;
+
+	i= chain_end_line(tracker->nodes, r, end);
+	/* start of line is ends[0], unless flipped */
+	return tracker->geo->lines[i].ends[(tracker->nodes[i].flip != end) ? 1 : 0];
+}
+
+
+/*
+ * Number of chained lines touching vertex (one of them is returned in
+ * 'line', if any)
+ */
+static int
+chain_degree(struct loop_tracker *tracker, const struct vertex *vertex,
+			 int *line)
+{
+	int i;
+	int degree=0;
+
+	*line= -1;
+	for(i=0; i < vertex->nlines; ++i) {
+		if (tracker->nodes[vertex->lines[i]->id].in_chain) {
+			*line= vertex->lines[i]->id;
+			++degree;
+		}
+	}
+	return degree;
+}
+
+
+/*
+ * Join ON line to chains at its ends (or keep it apart as a branch line
+ * if a vertex already has two lines)
+ */
+static void
+loop_tracker_join(struct loop_tracker *tracker, int id)
+{
+	struct loop_node *nodes=tracker->nodes;
+	struct line *lin=tracker->geo->lines + id;
+	int du, dv;
+	int lu, lv;
+	int a, b;
+
+	du= chain_degree(tracker, lin->ends[0], &lu);
+	dv= chain_degree(tracker, lin->ends[1], &lv);
+	if (du >= 2 || dv >= 2) {
+		++tracker->nbranches;
+		return;
+	}
+
+	nodes[id].left= nodes[id].right= nodes[id].parent= -1;
+	nodes[id].size= 1;
+	nodes[id].flip= FALSE;
+	nodes[id].reverse= FALSE;
+	nodes[id].closed= FALSE;
+	nodes[id].in_chain= TRUE;
+
+	a= (du == 1) ? chain_root(nodes, lu) : -1;
+	b= (dv == 1) ? chain_root(nodes, lv) : -1;
+
+	/* line joins both ends of a segment: loop is closed */
+	if (a >= 0 && a == b) {
+		nodes[id].flip= (chain_end_vertex(tracker, a, TRUE) != lin->ends[0]);
+		a= chain_set_root(nodes, chain_merge(nodes, a, id));
+		nodes[a].closed= TRUE;
+		++tracker->nloops;
+		++tracker->nloop_events;
+		return;
+	}
+
+	/* segment at ends[0] must end there, segment at ends[1] start there */
+	if (a >= 0 && chain_end_vertex(tracker, a, TRUE) != lin->ends[0])
+		nodes[a].reverse^= TRUE;
+	if (b >= 0 && chain_end_vertex(tracker, b, FALSE) != lin->ends[1])
+		nodes[b].reverse^= TRUE;
+	chain_set_root(nodes, chain_merge(nodes, chain_merge(nodes, a, id), b));
+	tracker->nchains+= 1 - (a >= 0) - (b >= 0);
+}
+
+
+/*
+ * Take line out of its chain. Branch lines waiting at its ends are
+ * joined to chains if there's room for them now.
+ */
+static void
+loop_tracker_leave(struct loop_tracker *tracker, int id)
+{
+	struct loop_node *nodes=tracker->nodes;
+	struct line *lin=tracker->geo->lines + id;
+	struct vertex *vertex;
+	gboolean closed;
+	int r, k;
+	int x, y, rest, mid;
+	int i, j, other;
+
+	if (!nodes[id].in_chain) {
+		--tracker->nbranches;
+		return;
+	}
+
+	r= chain_root(nodes, id);
+	closed= nodes[r].closed;
+	nodes[r].closed= FALSE;
+	k= chain_index(nodes, id);
+	chain_split(nodes, r, k, &x, &rest);
+	chain_split(nodes, chain_set_root(nodes, rest), 1, &mid, &y);
+	g_assert(mid == id);
+	chain_set_root(nodes, x);
+	chain_set_root(nodes, y);
+	nodes[id].in_chain= FALSE;
+
+	if (closed) {
+		/* loop opens: rest of loop becomes a segment */
+		--tracker->nloops;
+		++tracker->nloop_events;
+		if (chain_set_root(nodes, chain_merge(nodes, y, x)) < 0)
+			--tracker->nchains;
+	} else {
+		tracker->nchains+= (x >= 0) + (y >= 0) - 1;
+	}
+
+	/* branch lines that may fit now */
+	for(i=0; i < 2; ++i) {
+		vertex= lin->ends[i];
+		for(j=0; j < vertex->nlines; ++j) {
+			other= vertex->lines[j]->id;
+			if (other == id || !nodes[other].on || nodes[other].in_chain)
+				continue;
+			--tracker->nbranches;
+			loop_tracker_join(tracker, other);
+		}
+	}
+}
+
+
+/*
+ * Set all lines OFF
+ */
+void
+loop_tracker_clear(struct loop_tracker *tracker)
+{
+	int i;
+
+	for(i=0; i < tracker->geo->nlines; ++i) {
+		tracker->nodes[i].on= FALSE;
+		tracker->nodes[i].in_chain= FALSE;
+	}
+	tracker->nchains= 0;
+	tracker->nloops= 0;
+	tracker->nbranches= 0;
+	tracker->nloop_events= 0;
+}
+
+
+/*
+ * Create loop tracker for geometry (all lines OFF)
+ */
+struct loop_tracker*
+loop_tracker_new(const struct geometry *geo)
+{
+	struct loop_tracker *tracker;
+	int i;
+
+	tracker= (struct loop_tracker*)g_malloc(sizeof(struct loop_tracker));
+	tracker->geo= geo;
+	tracker->nodes= (struct loop_node*)
+		g_malloc(geo->nlines*sizeof(struct loop_node));
+	/* priorities: hash of line id (deterministic, doesn't touch the
+	   random number generator used to build games) */
+	for(i=0; i < geo->nlines; ++i)
+		tracker->nodes[i].priority= (guint32)(i + 1)*2654435761u;
+	loop_tracker_clear(tracker);
+	return tracker;
+}
+
+
+/*
+ * Free loop tracker
+ */
+void
+loop_tracker_destroy(struct loop_tracker *tracker)
+{
+	g_free(tracker->nodes);
+	g_free(tracker);
+}
+
+
+/*
+ * Line has been switched ON or OFF
+ */
+void
+loop_tracker_set_line(struct loop_tracker *tracker, int id, gboolean on)
+{
+	if (tracker->nodes[id].on == on) return;
+	tracker->nodes[id].on= on;
+	if (on) loop_tracker_join(tracker, id);
+	else loop_tracker_leave(tracker, id);
+}
+
+
+/*
+ * Is line part of a closed loop?
+ */
+gboolean
+loop_tracker_line_in_loop(struct loop_tracker *tracker, int id)
+{
+	if (!tracker->nodes[id].in_chain) return FALSE;
+	return tracker->nodes[chain_root(tracker->nodes, id)].closed;
+}
+
+
+/*
+ * Do ON lines form a single loop (and nothing else)?
+ */
+gboolean
+loop_tracker_is_single_loop(const struct loop_tracker *tracker)
+{
+	return tracker->nloops == 1 && tracker->nchains == 1 &&
+		tracker->nbranches == 0;
+}
+
+
+/*
+ * Is there a closed loop while other ON lines are left out of it?
+ */
+gboolean
+loop_tracker_has_premature_loop(const struct loop_tracker *tracker)
+{
+	return tracker->nloops > 0 && !loop_tracker_is_single_loop(tracker);
+}
@@ -0,0 +1,53 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+#ifndef __INCLUDED_LOOP_TRACKER_H__
+#define __INCLUDED_LOOP_TRACKER_H__
+
+#include "geometry.h"
+
+
+/* node of a chain of lines (private declaration, see loop-tracker.c) */
+struct loop_node;
+
+
+/*
+ * Shape of the ON lines of a game, kept up to date as lines change.
+ * ON lines are joined into chains through vertices: a chain is either
+ * open (a segment with two free ends) or closed (a loop). A line that
+ * would make a vertex have more than two lines is not joined to any
+ * chain (branch line) until the vertex has room for it again.
+ */
+struct loop_tracker {
+	const struct geometry *geo;	// geometry of game
+	struct loop_node *nodes;	// one node per line
+	int nchains;				// number of chains (segments + loops)
+	int nloops;					// number of closed chains
+	int nbranches;				// number of ON lines outside chains
+	guint nloop_events;			// loops closed or opened so far
+};
+
+
+/* loop-tracker.c */
+struct loop_tracker* loop_tracker_new(const struct geometry *geo);
+void loop_tracker_destroy(struct loop_tracker *tracker);
+void loop_tracker_clear(struct loop_tracker *tracker);
+void loop_tracker_set_line(struct loop_tracker *tracker, int id, gboolean on);
+gboolean loop_tracker_line_in_loop(struct loop_tracker *tracker, int id);
+gboolean loop_tracker_is_single_loop(const struct loop_tracker *tracker);
+gboolean loop_tracker_has_premature_loop(const struct loop_tracker *tracker);
+
+#endif
@@ -27,6 +27,12 @@
 #include "i18n.h"
 #include "gamedata.h"
 #include "gui.h"
+#include "animation.h"
+#include "history.h"
+#include "draw.h"
+#include "checker.h"
+#include "solve-profile.h"
+#include "benchmark.h"
 
 
 
@@ -41,8 +47,20 @@
 static void
 fences_exit_cleanup(struct board *board)
 {
+	/* window is gone: nothing to redraw */
+	board->drawarea= NULL;
 	gamedata_destroy_current_game(board);
-	g_free(board->history);
+	checker_destroy(board->checker);
+#ifdef SOLVE_PROFILE
+	/* rules run since last game was built (hints, move checker) */
+	solve_profile_write_json(stderr, "session");
+#endif
+	geometry_cache_clear();
+	history_destroy(board->history);
+	animation_destroy(board->animation);
+	g_array_free(board->stroke.lines, TRUE);
+	g_free(board->stroke.changed);
+	draw_free_metrics(&board->metrics);
 }
 
 
@@ -68,8 +86,12 @@ main (int argc, char *argv[])
 	/* gtk_main must be between gdk_threads_enter and gdk_threads_leave */
 	gdk_threads_enter();
 
-	/* Init board */
+	/* time scopes if FENCES_BENCHMARK is set (report written on exit) */
+	fences_benchmark_init();
+
+	/* Init board, resume last game (if any) */
 	board= initialize_board();
+	gamedata_resume_game(board);
 
 	gtk_set_locale ();
 	gtk_init (&argc, &argv);
@@ -81,9 +103,6 @@ main (int argc, char *argv[])
 	/* initialize gui */
 	gui_initialize(board);
 
-	/* start draw thread */
-	//start_draw_thread(g_object_get_data(G_OBJECT(window), "drawarea"));
-
 	gtk_main ();
 	gdk_threads_leave();
 
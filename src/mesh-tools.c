@@ -20,80 +20,104 @@
 
 #include "geometry.h"
 
-#define NUM_TILES_PER_SIDE	10
-#define NUM_TILES			NUM_TILES_PER_SIDE*NUM_TILES_PER_SIDE
-
 
 
 /*
- * Is shape (given by 4 points) 'area' inside box (given by two corners) 'box'.
- * All 8 sides of box + area must be projected along all 8 directions defined
- * by the 8 sides. If just one of the 8 projections, shoes no overlap then
- * the shapes don't intersect.
- * Since box is a square, total number of projections is 6.
+ * Prepare area of influence (given by 4 points) for hit tests: outward
+ * normals of its sides, projections on them and bounding box.
+ * Tests are then done with dot products only.
  *	area: struct point[4]
- *	box:  struct point[2]
  */
-gboolean
-is_area_inside_box(struct point *area, struct point *box)
+void
+mesh_prepare_area(struct infarea *infarea, const struct point *area)
 {
-	int i, j;
-	double box_s[2];		// box shadow
-	struct point area_s[2];		// area shadow
+	int i, j, k;
+	double orient=0.;	// twice the signed area of quad
+	double cross;
 	double p;
-	double angle;
-	double sin_angle, cos_angle;
+	int nneg=0, npos=0;
 
-	/*
-	 * project on the two directions defined by box (i.e. x and y axis)
-	 */
-	area_s[0].x= area_s[1].x= area[0].x;
-	area_s[0].y= area_s[1].y= area[0].y;
-	for (i=1; i < 4; ++i) {
-		if (area[i].x < area_s[0].x) area_s[0].x= area[i].x;
-		if (area[i].x > area_s[1].x) area_s[1].x= area[i].x;
-		if (area[i].y < area_s[0].y) area_s[0].y= area[i].y;
-		if (area[i].y > area_s[1].y) area_s[1].y= area[i].y;
+	for(i=0; i < 4; ++i) {
+		j= (i + 1) % 4;
+		orient+= area[i].x*area[j].y - area[j].x*area[i].y;
+	}
+
+	infarea->tl= infarea->br= area[0];
+	for(i=0; i < 4; ++i) {
+		j= (i + 1) % 4;
+		/* normal pointing out of area */
+		infarea->normal[i].x= area[j].y - area[i].y;
+		infarea->normal[i].y= area[i].x - area[j].x;
+		if (orient < 0.) {
+			infarea->normal[i].x= -infarea->normal[i].x;
+			infarea->normal[i].y= -infarea->normal[i].y;
+		}
+		/* projection of area on normal */
+		infarea->min[i]= infarea->max[i]=
+			infarea->normal[i].x*area[0].x + infarea->normal[i].y*area[0].y;
+		for(k=1; k < 4; ++k) {
+			p= infarea->normal[i].x*area[k].x + infarea->normal[i].y*area[k].y;
+			if (p < infarea->min[i]) infarea->min[i]= p;
+			if (p > infarea->max[i]) infarea->max[i]= p;
+		}
+		/* convex if all corners turn the same way */
+		k= (j + 1) % 4;
+		cross= (area[j].x - area[i].x)*(area[k].y - area[j].y) -
+			(area[j].y - area[i].y)*(area[k].x - area[j].x);
+		if (cross < 0.) ++nneg;
+		else if (cross > 0.) ++npos;
+		/* bounding box */
+		if (area[i].x < infarea->tl.x) infarea->tl.x= area[i].x;
+		if (area[i].y < infarea->tl.y) infarea->tl.y= area[i].y;
+		if (area[i].x > infarea->br.x) infarea->br.x= area[i].x;
+		if (area[i].y > infarea->br.y) infarea->br.y= area[i].y;
 	}
-	if (area_s[1].x < box[0].x || area_s[0].x > box[1].x)
+	infarea->convex= (nneg == 0 || npos == 0);
+}
+
+
+/*
+ * Is area of influence inside box (given by two corners) 'box'.
+ * Area and box are projected along the directions defined by their sides
+ * (separating axis test): if just one of the projections shows no
+ * overlap, the shapes don't intersect.
+ * Box sides give the x & y axis (bounding box of area), area sides
+ * give the precomputed normals.
+ * If area is not convex, its convex hull is tested instead.
+ *	box:  struct point[2]
+ */
+gboolean
+is_area_inside_box(const struct infarea *infarea, const struct point *box)
+{
+	const struct point *n;
+	double lo, hi;
+	int i;
+
+	/* project on x and y axis */
+	if (infarea->br.x < box[0].x || infarea->tl.x > box[1].x)
 		return FALSE;
-	if (area_s[1].y < box[0].y || area_s[0].y > box[1].y)
+	if (infarea->br.y < box[0].y || infarea->tl.y > box[1].y)
 		return FALSE;
 
-	/*
-	 * project on 4 directions defined by area
-	 */
+	/* project box on the 4 normals of area */
 	for(i=0; i < 4; ++i) {
-		j= (i + 1) % 4;
-		/* angle between side and x axis
-		 * All points will be rotated by -angle so side (i..j) aligns
-		 * with x axis.
-		 * The projection on y axis will give. */
-		angle= -atan2(area[j].y - area[i].y, area[j].x - area[i].x);
-		sin_angle= sin(angle);
-		cos_angle= cos(angle);
-
-		/* Apply rotation to all points in box (just want y coord) */
-		box_s[0]= box_s[1]= box[0].y*cos_angle + box[0].x*sin_angle;
-		p= box[0].y*cos_angle + box[1].x*sin_angle;
-		if (p < box_s[0]) box_s[0]= p;
-		if (p > box_s[1]) box_s[1]= p;
-		p= box[1].y*cos_angle + box[1].x*sin_angle;
-		if (p < box_s[0]) box_s[0]= p;
-		if (p > box_s[1]) box_s[1]= p;
-		p= box[1].y*cos_angle + box[0].x*sin_angle;
-		if (p < box_s[0]) box_s[0]= p;
-		if (p > box_s[1]) box_s[1]= p;
-
-		/* Apply rotation to all points in area (just want x coord) */
-		area_s[0].y= area_s[1].y=
-			area[0].y*cos_angle + area[0].x*sin_angle;
-		for(j=1; j < 4; ++j) {
-			p= area[j].y*cos_angle + area[j].x*sin_angle;
-			if (p < area_s[0].y) area_s[0].y= p;
-			if (p > area_s[1].y) area_s[1].y= p;
+		n= infarea->normal + i;
+		lo= hi= 0.;
+		if (n->x > 0.) {
+			lo+= n->x*box[0].x;
+			hi+= n->x*box[1].x;
+		} else {
+			lo+= n->x*box[1].x;
+			hi+= n->x*box[0].x;
 		}
-		if (area_s[1].y < box_s[0] || area_s[0].y > box_s[1])
+		if (n->y > 0.) {
+			lo+= n->y*box[0].y;
+			hi+= n->y*box[1].y;
+		} else {
+			lo+= n->y*box[1].y;
+			hi+= n->y*box[0].y;
+		}
+		if (hi < infarea->min[i] || lo > infarea->max[i])
 			return FALSE;
 	}
 	return TRUE;
@@ -101,10 +125,12 @@ is_area_inside_box(struct point *area, struct point *box)
 
 
 /*
- * Determine if 'point' is inside area defined by four points 'area[4]'
+ * Determine if 'point' is inside a non convex area defined by four points
+ * 'area[4]' (area must be star shaped around its central point)
  */
-gboolean
-is_point_inside_area(struct point *point, struct point *area)
+static gboolean
+is_point_inside_concave_area(const struct point *point,
+							 const struct point *area)
 {
 	struct point center;
 	int i, i2;
@@ -143,3 +169,30 @@ is_point_inside_area(struct point *point, struct point *area)
 	}
 	return TRUE;
 }
+
+
+/*
+ * Determine if 'point' is inside area of influence.
+ * Convex areas: point must be behind every side (dot product with side
+ * normal). Other areas fall back to intersecting sides with the segment
+ * joining point and center of area (needs area points 'area[4]').
+ */
+gboolean
+is_point_inside_area(const struct point *point, const struct infarea *infarea,
+					 const struct point *area)
+{
+	int i;
+
+	if (point->x < infarea->tl.x || point->x > infarea->br.x ||
+		point->y < infarea->tl.y || point->y > infarea->br.y)
+		return FALSE;
+	if (!infarea->convex)
+		return is_point_inside_concave_area(point, area);
+
+	for(i=0; i < 4; ++i) {
+		if (infarea->normal[i].x*point->x + infarea->normal[i].y*point->y >
+			infarea->max[i])
+			return FALSE;
+	}
+	return TRUE;
+}
@@ -158,7 +158,7 @@ static void
 draw_preview_image(struct dialog_data *dialog_data)
 {
 	cairo_t *cr;
-	struct geometry *geo_skel;
+	struct skeleton *skel;
 	struct gameinfo gameinfo;
 
 	/* create geometry for current tile type */
@@ -166,21 +166,18 @@ draw_preview_image(struct dialog_data *dialog_data)
 	gameinfo.size= tilesize_get_size(dialog_data);
 
 	/* build preview geometry */
-	fences_benchmark_start();
-	geo_skel= build_tile_skeleton(&gameinfo);
-	g_message("tile creation time (preview): %lf", fences_benchmark_stop());
+	fences_benchmark_enter("preview");
+	skel= build_tile_skeleton(&gameinfo);
+	g_message("tile creation time (preview): %lf ms", fences_benchmark_leave());
 
 	cr= gdk_cairo_create(dialog_data->preview);
     /* set scale so we draw in board_size space */
 	cairo_scale (cr,
-				 PREVIEW_IMAGE_SIZE/(double)geo_skel->board_size,
-				 PREVIEW_IMAGE_SIZE/(double)geo_skel->board_size);
+				 PREVIEW_IMAGE_SIZE/(double)skel->board_size,
+				 PREVIEW_IMAGE_SIZE/(double)skel->board_size);
 	/* draw board preview */
-	draw_board_skeleton(cr, geo_skel);
+	draw_board_skeleton(cr, skel);
 	cairo_destroy (cr);
-
-	/* destroy geometry */
-	geometry_destroy(geo_skel);
 }
 
 
@@ -22,6 +22,7 @@
 
 #include "geometry.h"
 #include "tiles.h"
+#include "cyclotomic.h"
 
 
 /* prefered board dimensions for penrose tile */
@@ -39,27 +40,44 @@ enum {
 // angle increases clockwise
 struct romb {
 	int type;
-	struct point pos;	// coords of romb vertex
-	double side;		// length of side
-	double angle;		// angle of romb (0=horizontal/right; pi/2: down)
-	struct point center;
+	struct cyclo pos;	// exact coords of romb vertex
+	int scale;			// length of side is RATIO^scale (in units of final side)
+	int angle;			// angle of romb in 18 degree steps (0=horizontal/right; 5: down)
+	struct cyclo key;	// sum of the 4 vertices (identifies romb)
 };
 
 
 #define RATIO		1.6180339887
 #define D2R(x)		((x)/180.0*M_PI)
-#define WRAP(x)		x= ((x) > 2.*M_PI) ? (x) -  2.*M_PI : (x)
 
+/* all romb sides point to odd multiples of 18 degrees */
+#define PENROSE_PARITY	1
 
 
-static void draw_penrose_tile(GSList *penrose);
-static void get_romb_vertices(struct romb *romb, struct point *vertex);
 
+static void draw_penrose_tile(GSList *penrose, struct cyclo_frame *frame);
+static void get_romb_vertices(struct romb *romb, struct cyclo_frame *frame,
+							  struct point *vertex);
 
-/* contains minimum distance required to consider two vertices different */
-static double separate_distance=0.;
 
 
+/*
+ * Add new romb to list and return list
+ */
+static GSList*
+penrose_add_romb(GSList *newpenrose, int type, struct cyclo *pos,
+				 int scale, int angle)
+{
+	struct romb *nromb;
+
+	nromb= (struct romb *)g_malloc(sizeof(struct romb));
+	nromb->type= type;
+	nromb->pos= *pos;
+	nromb->scale= scale;
+	nromb->angle= angle % CYCLO_NUM_DIRS;
+	return g_slist_prepend(newpenrose, nromb);
+}
+
 
 /*
  * Unfold a fat romb
@@ -68,72 +86,39 @@ static double separate_distance=0.;
 static GSList*
 penrose_unfold_fatromb(GSList *newpenrose, struct romb *romb)
 {
-	struct romb *nromb;
-	double nside=romb->side/RATIO;
+	struct cyclo pos;
+	int a=romb->angle;
+	int s=romb->scale;
 
 	g_assert(romb->type == FAT_ROMB);
 
 	/* create new romb 1/5 (I'm going clockwise) */
-	nromb= (struct romb *)g_malloc(sizeof(struct romb));
-	nromb->type= FAT_ROMB;
-	nromb->pos.x= romb->pos.x + romb->side * cos(romb->angle - D2R(36));
-	nromb->pos.y= romb->pos.y + romb->side * sin(romb->angle - D2R(36));
-	nromb->side= nside;
-	nromb->angle= romb->angle + D2R(180 - 36);
-	WRAP(nromb->angle);
-	nromb->center.x= nromb->pos.x + nromb->side*RATIO/2.0*cos(nromb->angle);
-	nromb->center.y= nromb->pos.y + nromb->side*RATIO/2.0*sin(nromb->angle);
-	newpenrose= g_slist_prepend(newpenrose, nromb);
+	pos= romb->pos;
+	cyclo_step(&pos, a - 2, PENROSE_PARITY, s);
+	newpenrose= penrose_add_romb(newpenrose, FAT_ROMB, &pos, s - 1, a + 8);
 
 	/* next romb 2/5 */
-	nromb= (struct romb *)g_malloc(sizeof(struct romb));
-	nromb->type= THIN_ROMB;
-	nromb->pos.x= romb->pos.x + nside * cos(romb->angle);
-	nromb->pos.y= romb->pos.y + nside * sin(romb->angle);
-	nromb->side= nside;
-	nromb->angle= romb->angle + D2R(360 - (36 + 18));
-	WRAP(nromb->angle);
-	nromb->center.x= nromb->pos.x + nromb->side*cos(D2R(18))*cos(nromb->angle);
-	nromb->center.y= nromb->pos.y + nromb->side*cos(D2R(18))*sin(nromb->angle);
-	newpenrose= g_slist_prepend(newpenrose, nromb);
+	pos= romb->pos;
+	cyclo_step(&pos, a, PENROSE_PARITY, s - 1);
+	newpenrose= penrose_add_romb(newpenrose, THIN_ROMB, &pos, s - 1, a + 17);
 
 	/* next romb 3/5 */
-	nromb= (struct romb *)g_malloc(sizeof(struct romb));
-	nromb->type= FAT_ROMB;
-	nromb->pos.x= romb->pos.x + (nside + romb->side) * cos(romb->angle);
-	nromb->pos.y= romb->pos.y + (nside + romb->side) * sin(romb->angle);
-	nromb->side= nside;
-	nromb->angle= romb->angle + D2R(180);
-	WRAP(nromb->angle);
-	nromb->center.x= nromb->pos.x + nromb->side*RATIO/2.0*cos(nromb->angle);
-	nromb->center.y= nromb->pos.y + nromb->side*RATIO/2.0*sin(nromb->angle);
-	newpenrose= g_slist_prepend(newpenrose, nromb);
-
-	/* next romb 4/5 */
-	nromb= (struct romb *)g_malloc(sizeof(struct romb));
-	nromb->type= THIN_ROMB;
-	nromb->pos.x= romb->pos.x + nside * cos(romb->angle);
-	nromb->pos.x+= 2.*nside*cos(D2R(18)) * cos(romb->angle + D2R(36 + 18));
-	nromb->pos.y= romb->pos.y + nside * sin(romb->angle);
-	nromb->pos.y+= 2.*nside*cos(D2R(18)) * sin(romb->angle + D2R(36 + 18));
-	nromb->side= nside;
-	nromb->angle= romb->angle + D2R(180 + 36 + 18);
-	WRAP(nromb->angle);
-	nromb->center.x= nromb->pos.x + nromb->side*cos(D2R(18))*cos(nromb->angle);
-	nromb->center.y= nromb->pos.y + nromb->side*cos(D2R(18))*sin(nromb->angle);
-	newpenrose= g_slist_prepend(newpenrose, nromb);
+	pos= romb->pos;
+	cyclo_step(&pos, a, PENROSE_PARITY, s - 1);
+	cyclo_step(&pos, a, PENROSE_PARITY, s);
+	newpenrose= penrose_add_romb(newpenrose, FAT_ROMB, &pos, s - 1, a + 10);
+
+	/* next romb 4/5 (2*cos(18) at angle+54 is the sum of two steps) */
+	pos= romb->pos;
+	cyclo_step(&pos, a, PENROSE_PARITY, s - 1);
+	cyclo_step(&pos, a + 2, PENROSE_PARITY, s - 1);
+	cyclo_step(&pos, a + 4, PENROSE_PARITY, s - 1);
+	newpenrose= penrose_add_romb(newpenrose, THIN_ROMB, &pos, s - 1, a + 13);
 
 	/* next romb 5/5 */
-	nromb= (struct romb *)g_malloc(sizeof(struct romb));
-	nromb->type= FAT_ROMB;
-	nromb->pos.x= romb->pos.x + romb->side * cos(romb->angle + D2R(36));
-	nromb->pos.y= romb->pos.y + romb->side * sin(romb->angle + D2R(36));
-	nromb->side= nside;
-	nromb->angle= romb->angle + D2R(180 + 36);
-	WRAP(nromb->angle);
-	nromb->center.x= nromb->pos.x + nromb->side*RATIO/2.0*cos(nromb->angle);
-	nromb->center.y= nromb->pos.y + nromb->side*RATIO/2.0*sin(nromb->angle);
-	newpenrose= g_slist_prepend(newpenrose, nromb);
+	pos= romb->pos;
+	cyclo_step(&pos, a + 2, PENROSE_PARITY, s);
+	newpenrose= penrose_add_romb(newpenrose, FAT_ROMB, &pos, s - 1, a + 12);
 
 	return newpenrose;
 }
@@ -146,141 +131,128 @@ penrose_unfold_fatromb(GSList *newpenrose, struct romb *romb)
 static GSList*
 penrose_unfold_thinromb(GSList *newpenrose, struct romb *romb)
 {
-	struct romb *nromb;
-	double nside=romb->side/RATIO;
+	struct cyclo pos;
+	int a=romb->angle;
+	int s=romb->scale;
 
 	g_assert(romb->type == THIN_ROMB);
 
 	/* create new romb 1/4 (I'm going clockwise) */
-	nromb= (struct romb *)g_malloc(sizeof(struct romb));
-	nromb->type= FAT_ROMB;
-	nromb->pos.x= romb->pos.x;
-	nromb->pos.y= romb->pos.y;
-	nromb->side= nside;
-	nromb->angle= romb->angle + D2R(270 + (90 - 18));
-	WRAP(nromb->angle);
-	nromb->center.x= nromb->pos.x + nromb->side*RATIO/2.0*cos(nromb->angle);
-	nromb->center.y= nromb->pos.y + nromb->side*RATIO/2.0*sin(nromb->angle);
-	newpenrose= g_slist_prepend(newpenrose, nromb);
-
-	/* next romb 2/4 */
-	nromb= (struct romb *)g_malloc(sizeof(struct romb));
-	nromb->type= FAT_ROMB;
-	nromb->pos.x= romb->pos.x + (2 * romb->side * cos(D2R(18))) * cos(romb->angle);
-	nromb->pos.y= romb->pos.y + (2 * romb->side * cos(D2R(18))) * sin(romb->angle);
-	nromb->side= nside;
-	nromb->angle= romb->angle + D2R(180 + 18);
-	WRAP(nromb->angle);
-	nromb->center.x= nromb->pos.x + nromb->side*RATIO/2.0*cos(nromb->angle);
-	nromb->center.y= nromb->pos.y + nromb->side*RATIO/2.0*sin(nromb->angle);
-	newpenrose= g_slist_prepend(newpenrose, nromb);
+	pos= romb->pos;
+	newpenrose= penrose_add_romb(newpenrose, FAT_ROMB, &pos, s - 1, a + 19);
+
+	/* next romb 2/4 (2*cos(18) along angle is the sum of two steps) */
+	pos= romb->pos;
+	cyclo_step(&pos, a - 1, PENROSE_PARITY, s);
+	cyclo_step(&pos, a + 1, PENROSE_PARITY, s);
+	newpenrose= penrose_add_romb(newpenrose, FAT_ROMB, &pos, s - 1, a + 11);
 
 	/* next romb 3/4 */
-	nromb= (struct romb *)g_malloc(sizeof(struct romb));
-	nromb->type= THIN_ROMB;
-	nromb->pos.x= romb->pos.x + romb->side * cos(romb->angle + D2R(18));
-	nromb->pos.x+= nside * cos(romb->angle + D2R(90 - 36));
-	nromb->pos.y= romb->pos.y + romb->side * sin(romb->angle + D2R(18));
-	nromb->pos.y+= nside * sin(romb->angle + D2R(90 - 36));
-	nromb->side= nside;
-	nromb->angle= romb->angle + D2R(270 - 18);
-	WRAP(nromb->angle);
-	nromb->center.x= nromb->pos.x + nromb->side*cos(D2R(18))*cos(nromb->angle);
-	nromb->center.y= nromb->pos.y + nromb->side*cos(D2R(18))*sin(nromb->angle);
-	newpenrose= g_slist_prepend(newpenrose, nromb);
+	pos= romb->pos;
+	cyclo_step(&pos, a + 1, PENROSE_PARITY, s);
+	cyclo_step(&pos, a + 3, PENROSE_PARITY, s - 1);
+	newpenrose= penrose_add_romb(newpenrose, THIN_ROMB, &pos, s - 1, a + 14);
 
 	/* next romb 4/4 */
-	nromb= (struct romb *)g_malloc(sizeof(struct romb));
-	nromb->type= THIN_ROMB;
-	nromb->pos.x= romb->pos.x + romb->side * cos(romb->angle - D2R(18));
-	nromb->pos.y= romb->pos.y + romb->side * sin(romb->angle - D2R(18));
-	nromb->side= nside;
-	nromb->angle= romb->angle + D2R(90 + 18);
-	WRAP(nromb->angle);
-	nromb->center.x= nromb->pos.x + nromb->side*cos(D2R(18))*cos(nromb->angle);
-	nromb->center.y= nromb->pos.y + nromb->side*cos(D2R(18))*sin(nromb->angle);
-	newpenrose= g_slist_prepend(newpenrose, nromb);
+	pos= romb->pos;
+	cyclo_step(&pos, a - 1, PENROSE_PARITY, s);
+	newpenrose= penrose_add_romb(newpenrose, THIN_ROMB, &pos, s - 1, a + 6);
 
 	return newpenrose;
 }
 
 
 /*
- * Check if two rombs are the same
- * Finds center of both rombs and see if they're within side/10.
- * **NOTE** unused
+ * Return exact coordinates of vertices of romb
  */
+static void
+get_romb_exact_vertices(struct romb *romb, struct cyclo *vertex)
+{
+	int a=romb->angle;
+	int w;		/* half the angle at romb vertex (in 18 degree steps) */
+
+	w= (romb->type == FAT_ROMB) ? 2 : 1;
+	vertex[0]= romb->pos;
+	vertex[1]= romb->pos;
+	cyclo_step(vertex + 1, a - w, PENROSE_PARITY, romb->scale);
+	vertex[3]= romb->pos;
+	cyclo_step(vertex + 3, a + w, PENROSE_PARITY, romb->scale);
+	vertex[2]= vertex[1];
+	cyclo_step(vertex + 2, a + w, PENROSE_PARITY, romb->scale);
+}
+
+
+/*
+ * Hash and compare functions for rombs: two rombs of the same type are
+ * the same if the sum of their vertices is the same.
+ */
+static guint
+romb_hash(gconstpointer romb)
+{
+	const struct romb *r=(const struct romb*)romb;
+
+	return cyclo_hash(&r->key)*2 + r->type;
+}
+
 static gboolean
-are_rombs_same(struct romb *r1, struct romb *r2)
+romb_equal(gconstpointer romb1, gconstpointer romb2)
 {
-	double x, y;
-
-	if (r1->type != r2->type) return FALSE;
-	if (r1->type == FAT_ROMB) {
-		x= r1->pos.x + r1->side*RATIO/2.0*cos(r1->angle);
-		y= r1->pos.y + r1->side*RATIO/2.0*sin(r1->angle);
-		x-= r2->pos.x + r2->side*RATIO/2.0*cos(r2->angle);
-		y-= r2->pos.y + r2->side*RATIO/2.0*sin(r2->angle);
-	} else {
-		x= r1->pos.x + r1->side*cos(D2R(18))*cos(r1->angle);
-		y= r1->pos.y + r1->side*cos(D2R(18))*sin(r1->angle);
-		x-= r2->pos.x + r2->side*cos(D2R(18))*cos(r2->angle);
-		y-= r2->pos.y + r2->side*cos(D2R(18))*sin(r2->angle);
-	}
-	if ( sqrt(x*x + y*y) < r1->side/10. ) return TRUE;
-	return FALSE;
+	const struct romb *r1=(const struct romb*)romb1;
+	const struct romb *r2=(const struct romb*)romb2;
+
+	return r1->type == r2->type && cyclo_equal(&r1->key, &r2->key);
 }
 
 
 /*
  * Eliminate repeated rombs in the list
+ * Rombs are identified exactly by the sum of their vertices, so a hash
+ * table finds repetitions in one pass.
  * Returns new trimmed list
  */
-GSList *
+static GSList *
 trim_repeated_rombs(GSList *penrose)
 {
+	GHashTable *table;
 	GSList *current;
 	GSList *next;
-	GSList *p;
-	struct romb *r1, *r2;
-	struct point c;
+	struct romb *romb;
+	struct cyclo vertex[4];
+	int i;
 
+	table= g_hash_table_new(romb_hash, romb_equal);
 	current= penrose;
 	while(current != NULL) {
-		p= g_slist_next(current);
-		r1= (struct romb*)current->data;
-		/* iterate over rest of rombs */
-		while(p != NULL) {
-			r2= (struct romb*)p->data;
-			if (r1->type != r2->type) { // not same type, next
-				p= g_slist_next(p);
-				continue;
-			}
-			/* calculate dist between centers of both rombs */
-			c.x= r2->center.x - r1->center.x;
-			c.y= r2->center.y - r1->center.y;
-			if ((c.x*c.x + c.y*c.y) < separate_distance ) { // same romb
-				//g_debug("delete romb, dist: %lf < %lf", dist, r1->side/10.);
-				g_free(p->data);
-				next= g_slist_next(p);
-				penrose= g_slist_delete_link(penrose, p);
-				p= next;
-			} else {
-				p= g_slist_next(p);
-			}
+		romb= (struct romb*)current->data;
+		next= g_slist_next(current);
+
+		get_romb_exact_vertices(romb, vertex);
+		romb->key= vertex[0];
+		for(i=1; i < 4; ++i)
+			cyclo_add(&romb->key, vertex + i);
+
+		if (g_hash_table_lookup(table, romb) != NULL) { // same romb
+			g_free(romb);
+			penrose= g_slist_delete_link(penrose, current);
+		} else {
+			g_hash_table_insert(table, romb, romb);
 		}
-		current= g_slist_next(current);
+		current= next;
 	}
+	g_hash_table_destroy(table);
+
 	return penrose;
 }
 
 
 /*
  * Eliminate rombs outside a certain radius
+ * Vertices are placed exactly on the radius by design, so allow for the
+ * rounding of converting exact points to board coordinates.
  * Returns new trimmed list
  */
 static GSList *
-trim_outside_rombs(GSList *penrose, double radius)
+trim_outside_rombs(GSList *penrose, struct cyclo_frame *frame, double radius)
 {
 	GSList *current;
 	GSList *next;
@@ -294,13 +266,13 @@ trim_outside_rombs(GSList *penrose, double radius)
 	while(current != NULL) {
 		romb= (struct romb*) current->data;
 
-		get_romb_vertices(romb, vertex);
+		get_romb_vertices(romb, frame, vertex);
 		next= g_slist_next(current);
 		for(i=0; i < 4; ++i) {
 			vertex[i].x-= center;
 			vertex[i].y-= center;
 			dist= sqrt(vertex[i].x*vertex[i].x + vertex[i].y*vertex[i].y);
-			if (dist > radius) {
+			if (dist > radius + frame->unit/1000.) {
 				g_free(current->data);
 				penrose= g_slist_delete_link(penrose, current);
 				break;
@@ -316,7 +288,7 @@ trim_outside_rombs(GSList *penrose, double radius)
  * Unfold current list of rombs
  */
 static GSList*
-penrose_unfold(GSList* penrose, double edge)
+penrose_unfold(GSList* penrose, struct cyclo_frame *frame, double edge)
 {
 	GSList *newpenrose=NULL;
 	struct romb *romb;
@@ -338,13 +310,11 @@ penrose_unfold(GSList* penrose, double edge)
 	}
 
 	/* get rid of repeated rombs */
-	separate_distance= ((struct romb*)newpenrose->data)->side/10.;
-	separate_distance*= separate_distance;
 	newpenrose= trim_repeated_rombs(newpenrose);
 
 	/* get rid of rombs outside a certain radius */
 	if (edge > 0)
-		newpenrose= trim_outside_rombs(newpenrose, edge);
+		newpenrose= trim_outside_rombs(newpenrose, frame, edge);
 
 	/* debug: count number of rombs in list */
 	g_debug("rombs in list: %d", g_slist_length(newpenrose));
@@ -357,25 +327,15 @@ penrose_unfold(GSList* penrose, double edge)
  * Return coordinates of vertices of romb
  */
 static void
-get_romb_vertices(struct romb *romb, struct point *vertex)
+get_romb_vertices(struct romb *romb, struct cyclo_frame *frame,
+				  struct point *vertex)
 {
-	vertex[0].x= romb->pos.x;
-	vertex[0].y= romb->pos.y;
-	if (romb->type == FAT_ROMB) {
-		vertex[1].x= romb->pos.x + romb->side*cos(romb->angle - D2R(36));
-		vertex[1].y= romb->pos.y + romb->side*sin(romb->angle - D2R(36));
-		vertex[2].x= romb->pos.x + romb->side*RATIO*cos(romb->angle);
-		vertex[2].y= romb->pos.y + romb->side*RATIO*sin(romb->angle);
-		vertex[3].x= romb->pos.x + romb->side*cos(romb->angle + D2R(36));
-		vertex[3].y= romb->pos.y + romb->side*sin(romb->angle + D2R(36));
-	} else {
-		vertex[1].x= romb->pos.x + romb->side*cos(romb->angle - D2R(18));
-		vertex[1].y= romb->pos.y + romb->side*sin(romb->angle - D2R(18));
-		vertex[2].x= romb->pos.x + 2*romb->side*cos(D2R(18))*cos(romb->angle);
-		vertex[2].y= romb->pos.y + 2*romb->side*cos(D2R(18))*sin(romb->angle);
-		vertex[3].x= romb->pos.x + romb->side*cos(romb->angle + D2R(18));
-		vertex[3].y= romb->pos.y + romb->side*sin(romb->angle + D2R(18));
-	}
+	struct cyclo exact[4];
+	int i;
+
+	get_romb_exact_vertices(romb, exact);
+	for(i=0; i < 4; ++i)
+		cyclo_to_point(frame, exact + i, vertex + i);
 }
 
 
@@ -395,60 +355,95 @@ penrose_calculate_sizes(struct geometry *geo, int size_index)
 }
 
 
+/*
+ * Hash and compare functions for exact vertex positions
+ */
+static guint
+vertex_hash(gconstpointer pos)
+{
+	return cyclo_hash((const struct cyclo*)pos);
+}
+
+static gboolean
+vertex_equal(gconstpointer pos1, gconstpointer pos2)
+{
+	return cyclo_equal((const struct cyclo*)pos1, (const struct cyclo*)pos2);
+}
+
+
 /*
  * Transform list of rombs to tile skeleton (no connections)
+ * Shared vertices are found by exact position, so the number of vertices
+ * is known before the geometry is created.
  */
 static struct geometry*
-penrose_tile_to_skeleton(GSList *penrose, double side)
+penrose_tile_to_skeleton(GSList *penrose, struct cyclo_frame *frame)
 {
 	struct geometry *geo;
 	GSList *list;
-	struct point pts[4];
-	int i;
+	GHashTable *table;
+	struct cyclo *cvertex;
+	struct cyclo exact[4];
+	int *vids;
+	gpointer id;
+	struct point pos;
+	int i, j;
 	int ntiles;
-	int nvertex;
+	int nvertex=0;
 	int nlines;
 
-	/* create new geometry (ntiles, nvertex, nlines) */
-	/* NOTE: oversize nvertex and nlines. Will adjust below
-	   Oversize factors determined by trial and error. */
+	/* find unique vertices (exact positions) */
 	ntiles= g_slist_length(penrose);
-	nvertex= (int)(ntiles*1.5);
-	nlines= (int)(ntiles*2.5);
+	cvertex= (struct cyclo*)g_malloc(4*ntiles*sizeof(struct cyclo));
+	vids= (int*)g_malloc(4*ntiles*sizeof(int));
+	table= g_hash_table_new(vertex_hash, vertex_equal);
+	list= penrose;
+	for(i=0; i < ntiles; ++i) {
+		get_romb_exact_vertices((struct romb*)list->data, exact);
+		for(j=0; j < 4; ++j) {
+			if (g_hash_table_lookup_extended(table, exact + j, NULL, &id)) {
+				vids[4*i + j]= GPOINTER_TO_INT(id);
+			} else {
+				cvertex[nvertex]= exact[j];
+				vids[4*i + j]= nvertex;
+				g_hash_table_insert(table, cvertex + nvertex,
+									GINT_TO_POINTER(nvertex));
+				++nvertex;
+			}
+		}
+		list= g_slist_next(list);
+	}
+	g_hash_table_destroy(table);
+
+	/* create new geometry (ntiles, nvertex, nlines) */
+	/* NOTE: oversize nlines (each line touches at least one tile).
+	   Will adjust below */
+	nlines= ntiles*4;
 	geo= geometry_create_new(ntiles, nvertex, nlines, 4);
 	geo->board_size= PENROSE_BOARD_SIZE;
 	geo->board_margin= PENROSE_BOARD_MARGIN;
 	geo->game_size= geo->board_size - 2*geo->board_margin;
-	geometry_set_distance_resolution(side/10.0);
-
 
 	/* iterate through tiles creating skeleton geometry
 	   (skeleton geometry: lines hold all the topology info) */
 	geo->ntiles= 0;
 	geo->nlines= 0;
 	geo->nvertex= 0;
-	list= penrose;
-	for(i=0; i < ntiles; ++i) {
-		/* get vertices of tile (rhomb) and add it to skeleton geometry */
-		get_romb_vertices((struct romb*)list->data, pts);
-		geometry_add_tile(geo, pts, 4, NULL);
-
-		list= g_slist_next(list);
+	for(i=0; i < nvertex; ++i) {
+		cyclo_to_point(frame, cvertex + i, &pos);
+		geometry_new_vertex(geo, &pos);
 	}
+	for(i=0; i < ntiles; ++i)
+		geometry_add_tile_indexed(geo, vids + 4*i, 4, NULL);
+	g_free(cvertex);
+	g_free(vids);
 
 	/* make sure we didn't underestimate max numbers */
-	g_assert(geo->ntiles <= ntiles);
-	g_assert(geo->nvertex <= nvertex);
 	g_assert(geo->nlines <= nlines);
 
-	/* realloc to actual number of vertices and lines */
-	geo->vertex= g_realloc(geo->vertex, geo->nvertex*sizeof(struct vertex));
+	/* realloc to actual number of lines */
 	geo->lines= g_realloc(geo->lines, geo->nlines*sizeof(struct line));
 
-	/*printf("ntiles: %d (%d) %d\n", geo->ntiles, ntiles);
-	printf("nvertex: %d (%d) %d\n", geo->nvertex, nvertex);
-	printf("nlines: %d (%d) %d\n", geo->nlines, nlines);*/
-
 	return geo;
 }
 
@@ -457,25 +452,20 @@ penrose_tile_to_skeleton(GSList *penrose, double side)
  * Define seed to generate penrose tile
  * We use seed that generates krazydad's tile with 4 unfoldings:
  *	5 fat rombs forming a star, with star tip pointing down
- * Input 'side' is size of initial rombs size
+ * Seed rombs have side RATIO^nfolds so the final rombs have side 1.
  */
 static GSList*
-create_tile_seed(double side)
+create_tile_seed(int nfolds)
 {
 	GSList *penrose=NULL;
-	struct romb *romb;
+	struct cyclo pos;
 	int i;
-	int angle=90;	// angle of star tip romb
+	int angle=5;	// angle of star tip romb (90 degrees)
 
+	cyclo_zero(&pos);
 	for(i=0; i < 5; ++i) {
-		romb= (struct romb*)g_malloc(sizeof(struct romb));
-		romb->type= FAT_ROMB;
-		romb->side= side;
-		romb->angle= D2R(angle);
-		romb->pos.x= PENROSE_BOARD_SIZE/2.;
-		romb->pos.y= PENROSE_BOARD_SIZE/2.;
-		penrose= g_slist_prepend(penrose, romb);
-		angle= (angle + 72)%360;
+		penrose= penrose_add_romb(penrose, FAT_ROMB, &pos, nfolds, angle);
+		angle+= 4;	// 72 degrees
 	}
 
 	return penrose;
@@ -539,6 +529,8 @@ build_penrose_tile_skeleton(const struct gameinfo *info)
 {
 	GSList *penrose=NULL;
 	struct geometry *geo;
+	struct cyclo_frame frame;
+	struct point origin;
 	double side;
 	int nfolds;
 	int i;
@@ -548,25 +540,27 @@ build_penrose_tile_skeleton(const struct gameinfo *info)
 	/* get side size and number of folds */
 	nfolds= penrose_calculate_params(size_index, &side);
 
+	/* exact coordinates are measured in units of final side from center */
+	origin.x= PENROSE_BOARD_SIZE/2.;
+	origin.y= PENROSE_BOARD_SIZE/2.;
+	cyclo_frame_init(&frame, PENROSE_PARITY, side, &origin);
+
 	/* Create the seed (increase size to account for foldings) */
-	penrose= create_tile_seed(side*pow(RATIO, nfolds));
+	penrose= create_tile_seed(nfolds);
 
 	/* unfold list of shapes */
 	for(i=0; i < nfolds; ++i) {
 		if (i == nfolds - 1) edge= PENROSE_GAME_SIZE/2.0;
 		else if (i > 1 && i == nfolds - 2) edge= PENROSE_GAME_SIZE/1.5;
 		else edge= PENROSE_GAME_SIZE;
-		penrose= penrose_unfold(penrose, edge);
+		penrose= penrose_unfold(penrose, &frame, edge);
 	}
 
 	/* draw to file */
-	//draw_penrose_tile(penrose);
+	//draw_penrose_tile(penrose, &frame);
 
 	/* transform tile into geometry data (points, lines & tiles) */
-	geo= penrose_tile_to_skeleton(penrose, side);
-
-	/* debug: draw to file */
-	//draw_penrose_tile(penrose);
+	geo= penrose_tile_to_skeleton(penrose, &frame);
 
 	/* free penrose rhombs data */
 	while (penrose != NULL) {
@@ -603,15 +597,15 @@ build_penrose_tile_geometry(const struct gameinfo *info)
  * Draw tile to png file (for debug purposes only)
  */
 static void
-draw_penrose_tile(GSList *penrose)
+draw_penrose_tile(GSList *penrose, struct cyclo_frame *frame)
 {
 	const char filename[]="/home/jos/Desktop/penrose.png";
 	const int width=500;
 	const int height=500;
 	cairo_surface_t *surf;
 	cairo_t *cr;
-	struct romb *romb;
-	double x, y;
+	struct point pts[4];
+	int i;
 
 	surf= cairo_image_surface_create(CAIRO_FORMAT_RGB24, width, height);
 	cr= cairo_create(surf);
@@ -624,31 +618,12 @@ draw_penrose_tile(GSList *penrose)
 	cairo_set_source_rgb(cr, 0, 0, 0);
 
 	while(penrose != NULL) {
-		romb= (struct romb*)penrose->data;
-		cairo_move_to(cr, romb->pos.x, romb->pos.y);
-		if (romb->type == FAT_ROMB) {
-			x= romb->pos.x + romb->side * cos(romb->angle - D2R(36));
-			y= romb->pos.y + romb->side * sin(romb->angle - D2R(36));
-			cairo_line_to(cr, x, y);
-			x= romb->pos.x + romb->side*RATIO * cos(romb->angle);
-			y= romb->pos.y + romb->side*RATIO * sin(romb->angle);
-			cairo_line_to(cr, x, y);
-			x= romb->pos.x + romb->side * cos(romb->angle + D2R(36));
-			y= romb->pos.y + romb->side * sin(romb->angle + D2R(36));
-			cairo_line_to(cr, x, y);
-			cairo_line_to(cr, romb->pos.x, romb->pos.y);
-		} else {
-			x= romb->pos.x + romb->side * cos(romb->angle - D2R(18));
-			y= romb->pos.y + romb->side * sin(romb->angle - D2R(18));
-			cairo_line_to(cr, x, y);
-			x= romb->pos.x + 2*romb->side*cos(D2R(18)) * cos(romb->angle);
-			y= romb->pos.y + 2*romb->side*cos(D2R(18)) * sin(romb->angle);
-			cairo_line_to(cr, x, y);
-			x= romb->pos.x + romb->side * cos(romb->angle + D2R(18));
-			y= romb->pos.y + romb->side * sin(romb->angle + D2R(18));
-			cairo_line_to(cr, x, y);
-			cairo_line_to(cr, romb->pos.x, romb->pos.y);
+		get_romb_vertices((struct romb*)penrose->data, frame, pts);
+		cairo_move_to(cr, pts[0].x, pts[0].y);
+		for(i= 1; i < 4 ; ++i) {
+			cairo_line_to(cr, pts[i].x, pts[i].y);
 		}
+		cairo_line_to(cr, pts[0].x, pts[0].y);
 		cairo_stroke(cr);
 		penrose= g_slist_next(penrose);
 	}
@@ -19,6 +19,7 @@
 
 #include "geometry.h"
 #include "tiles.h"
+#include "lattice.h"
 
 
 /* prefered board dimensions for penrose tile */
@@ -36,7 +37,7 @@
  * TRUE: rhomb is fully inside game area
  */
 static gboolean
-qbert_is_rhomb_inside(struct point *vertex)
+qbert_is_rhomb_inside(const struct point *vertex)
 {
 	int i;
 
@@ -50,54 +51,66 @@ qbert_is_rhomb_inside(struct point *vertex)
 
 
 /*
- * Set vertex coordinates of rhombs in a unit
+ * Set vertex coordinates of rhombs in a unit (relative to unit center)
  */
 static void
-qbert_fill_unit_with_rhombs(struct geometry *geo, struct point *pos, double side)
+qbert_fill_unit_with_rhombs(struct lattice_face *rhombs, double side)
 {
-	struct point pts[4];
+	struct point *pts;
 
 	/* rhomb top right (vertex clockwise starting in the center) */
-	pts[0].x= pos->x;
-	pts[0].y= pos->y;
-	pts[1].x= pos->x;
-	pts[1].y= pos->y - side;
-	pts[2].x= pos->x + side * sqrt(3.0) / 2.0;
-	pts[2].y= pos->y - side / 2.0;
-	pts[3].x= pos->x + side * sqrt(3.0) / 2.0;
-	pts[3].y= pos->y + side / 2.0;
-	if (qbert_is_rhomb_inside(pts)) {
-		//g_message("  rhomb 1");
-		geometry_add_tile(geo, pts, 4, NULL);
-	}
+	rhombs[0].nsides= 4;
+	pts= rhombs[0].pts;
+	pts[0].x= 0.;
+	pts[0].y= 0.;
+	pts[1].x= 0.;
+	pts[1].y= -side;
+	pts[2].x= side * sqrt(3.0) / 2.0;
+	pts[2].y= -side / 2.0;
+	pts[3].x= side * sqrt(3.0) / 2.0;
+	pts[3].y= side / 2.0;
 
 	/* bottom (vertex clockwise starting in the center) */
-	pts[0].x= pos->x;
-	pts[0].y= pos->y;
-	pts[1].x= pos->x + side * sqrt(3.0) / 2.0;
-	pts[1].y= pos->y + side / 2.0;
-	pts[2].x= pos->x;
-	pts[2].y= pos->y + side;
-	pts[3].x= pos->x - side * sqrt(3.0) / 2.0;
-	pts[3].y= pos->y + side / 2.0;
-	if (qbert_is_rhomb_inside(pts)) {
-		//g_message("  rhomb 2");
-		geometry_add_tile(geo, pts, 4, NULL);
-	}
+	rhombs[1].nsides= 4;
+	pts= rhombs[1].pts;
+	pts[0].x= 0.;
+	pts[0].y= 0.;
+	pts[1].x= side * sqrt(3.0) / 2.0;
+	pts[1].y= side / 2.0;
+	pts[2].x= 0.;
+	pts[2].y= side;
+	pts[3].x= -side * sqrt(3.0) / 2.0;
+	pts[3].y= side / 2.0;
 
 	/* rhomb top left (vertex clockwise starting in the center) */
-	pts[0].x= pos->x;
-	pts[0].y= pos->y;
-	pts[1].x= pos->x - side * sqrt(3.0) / 2.0;
-	pts[1].y= pos->y + side / 2.0;
-	pts[2].x= pos->x - side * sqrt(3.0) / 2.0;
-	pts[2].y= pos->y - side / 2.0;
-	pts[3].x= pos->x;
-	pts[3].y= pos->y - side;
-	if (qbert_is_rhomb_inside(pts)) {
-		//g_message("  rhomb 3");
-		geometry_add_tile(geo, pts, 4, NULL);
-	}
+	rhombs[2].nsides= 4;
+	pts= rhombs[2].pts;
+	pts[0].x= 0.;
+	pts[0].y= 0.;
+	pts[1].x= -side * sqrt(3.0) / 2.0;
+	pts[1].y= side / 2.0;
+	pts[2].x= -side * sqrt(3.0) / 2.0;
+	pts[2].y= -side / 2.0;
+	pts[3].x= 0.;
+	pts[3].y= -side;
+}
+
+
+/*
+ * Keep rhombs of units in the board that are inside game area.
+ * Unit (i,j) is unit i - j/2 of row j.
+ */
+static gboolean
+qbert_clip(int i, int j, int face, const struct point *pts, int npts,
+		   gpointer data)
+{
+	int *dim=(int*)data;
+	int col;
+
+	if (j < 0 || j >= dim[1]) return FALSE;
+	col= i - j/2;
+	if (col < 0 || col >= dim[0] + (j%2)) return FALSE;
+	return qbert_is_rhomb_inside(pts);
 }
 
 
@@ -124,19 +137,14 @@ struct geometry*
 build_qbert_tile_skeleton(const struct gameinfo *info)
 {
 	struct geometry *geo;
-	int i, j;
-	int dimx;
-	int dimy;
+	struct lattice lat;
+	struct lattice_face rhombs[3];
+	int dim[2];
 	int num_x=info->size;
 	int num_y;
 	double side;
-	int nrhomb_max;
-	int nvertex_max;
-	int nlines_max;
 	double x0;
-	double xoffset;
 	double y0;
-	struct point pos;
 
 	/* size of rhomb size: fit dimx vert rhombs wide */
 	side= QBERT_GAME_SIZE/((double)num_x * sqrt(3.0)/2.0);
@@ -151,8 +159,8 @@ build_qbert_tile_skeleton(const struct gameinfo *info)
 	}
 
 	/* number of units that fit wide and tall */
-	dimx= (int)ceil(num_x / 2.0);
-	dimy= (int)( QBERT_GAME_SIZE / (side*3.0/2.0) + 1.0 );
+	dim[0]= (int)ceil(num_x / 2.0);
+	dim[1]= (int)( QBERT_GAME_SIZE / (side*3.0/2.0) + 1.0 );
 
 	/* coordinates of unit on top left (center of unit coords) */
 	x0= QBERT_BOARD_MARGIN + sqrt(3.0) * side / 2.0;
@@ -162,40 +170,28 @@ build_qbert_tile_skeleton(const struct gameinfo *info)
 	/* found by trial-and-error, makes the game look better */
 	if (num_y % 3 == 1) y0-= side;
 
-	/* estimate max number of rhombs from game area */
-	/* Area of one rhomb: sqrt(3)/2*side^2 */
-	nrhomb_max= (int) (QBERT_GAME_SIZE * QBERT_GAME_SIZE /
-					   (sqrt(3.0)* side * side / 2.0));
-
-	/* create geometry with plenty of space for lines and vertex */
-	nvertex_max= (int)(nrhomb_max*1.3);	/* found by trial-and-error (size 5>) */
-	nlines_max= (int)(nrhomb_max*2.2);	/* found by trial-and-error (size 5>) */
-	geo= geometry_create_new(nrhomb_max, nvertex_max, nlines_max, 4);
+	/* 3 rhombs in each unit, odd rows shifted half a unit left */
+	qbert_fill_unit_with_rhombs(rhombs, side);
+	lat.origin.x= x0;
+	lat.origin.y= y0;
+	lat.a.x= sqrt(3.0)*side;
+	lat.a.y= 0.;
+	lat.b.x= -sqrt(3.0)*side/2.0;
+	lat.b.y= side + side/2.0;
+	lat.nfaces= 3;
+	lat.faces= rhombs;
+	lat.imin= 0;
+	lat.imax= dim[0] + dim[1]/2;
+	lat.jmin= 0;
+	lat.jmax= dim[1] - 1;
+	lat.clip= qbert_clip;
+	lat.clip_data= dim;
+	lat.max_numlines= 4;
+
+	geo= lattice_build_skeleton(&lat);
 	geo->board_size= QBERT_BOARD_SIZE;
 	geo->board_margin= QBERT_BOARD_MARGIN;
 	geo->game_size= QBERT_BOARD_SIZE - 2*QBERT_BOARD_MARGIN;
-	geometry_set_distance_resolution(side/10.0);
-
-	/* create rhombs (3 rhombs in each unit) */
-	geo->ntiles= geo->nlines= geo->nvertex= 0;
-	for(j=0; j < dimy; ++j) {
-		pos.y= y0 + j * (side + side/2.0);
-		xoffset= x0 - (j % 2)*( sqrt(3.0)*side/2.0 );
-		for(i=0; i < dimx + (j%2); ++i) {
-			pos.x= xoffset + i*( sqrt(3.0)*side );
-			qbert_fill_unit_with_rhombs(geo, &pos, side);
-		}
-	}
-
-	/* make sure we didn't underestimate max numbers */
-	g_assert(geo->ntiles <= nrhomb_max);
-	g_assert(geo->nvertex <= nvertex_max);
-	g_assert(geo->nlines <= nlines_max);
-
-	/* realloc to actual number of tiles, vertices and lines */
-	geo->tiles= g_realloc(geo->tiles, geo->ntiles*sizeof(struct tile));
-	geo->vertex= g_realloc(geo->vertex, geo->nvertex*sizeof(struct vertex));
-	geo->lines= g_realloc(geo->lines, geo->nlines*sizeof(struct line));
 
 	return geo;
 }
@@ -0,0 +1,325 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+/*
+ * Headless rendering benchmark.
+ * Draws boards of every tile type and size to cairo image surfaces (no
+ * display needed) and prints per-frame timings as one JSON object per line:
+ *   full:   whole board drawn from scratch (draw_board)
+ *   cached: whole board exposed, static layer from offscreen surface
+ *   line:   a line changes and only its clip box is redrawn
+ *   zoom:   board zoomed in and panned every frame
+ *   export: puzzle and solution exported to PNG files
+ * With FENCES_BENCHMARK set, the fences timers are also reported on exit.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <gtk/gtk.h>
+#include <glib/gstdio.h>
+
+#include "gamedata.h"
+#include "draw.h"
+#include "spatial-index.h"
+#include "export.h"
+#include "view.h"
+#include "benchmark.h"
+
+
+/* number of sizes tried for each tile type */
+#define NUM_SIZES		5
+
+/* zoom factor in zoom test */
+#define BENCHMARK_ZOOM	8.
+
+/* seed for random loops, so runs are comparable */
+#define BENCHMARK_SEED	12345
+
+
+/* tile names as printed in results */
+static const char *tile_name[NUMBER_TILE_TYPE]={
+	"square",
+	"penrose",
+	"triangular",
+	"qbert",
+	"hex",
+	"snub",
+	"cairo",
+	"cartwheel",
+	"trihex"
+};
+
+/* tile types whose size is a number of tiles (as in New Game dialog) */
+static gboolean size_is_dimension[NUMBER_TILE_TYPE]={
+	TRUE, FALSE, TRUE, TRUE, TRUE, FALSE, FALSE, FALSE, FALSE
+};
+static int index2size[NUM_SIZES]={5, 10, 15, 20, 25};
+
+
+/* command line options */
+static gint nframes=50;
+static gint image_size=800;
+static gint only_type=-1;
+
+
+static GOptionEntry entries[]={
+	{"frames", 'n', 0, G_OPTION_ARG_INT, &nframes,
+	 "Frames measured in each test (default 50)", "N"},
+	{"image-size", 's', 0, G_OPTION_ARG_INT, &image_size,
+	 "Width and height of image in pixels (default 800)", "PIXELS"},
+	{"type", 't', 0, G_OPTION_ARG_INT, &only_type,
+	 "Only benchmark this tile type (0..8)", "TYPE"},
+	{NULL}
+};
+
+
+
+/*
+ * Compare doubles (for qsort)
+ */
+static int
+benchmark_double_cmp(const void *a, const void *b)
+{
+	double x=*(const double*)a;
+	double y=*(const double*)b;
+
+	return (x > y) - (x < y);
+}
+
+
+/*
+ * Print statistics of frame times (ms) as a JSON object
+ */
+static void
+benchmark_report(const struct gameinfo *info, struct geometry *geo,
+				 const char *test, double *times, int n)
+{
+	double total=0.;
+	int i;
+
+	qsort(times, n, sizeof(double), benchmark_double_cmp);
+	for(i=0; i < n; ++i)
+		total+= times[i];
+	printf("{\"tile\": \"%s\", \"size\": %d, \"lines\": %d, \"tiles\": %d, "
+		   "\"test\": \"%s\", \"frames\": %d, \"mean_ms\": %.4f, "
+		   "\"p50_ms\": %.4f, \"p90_ms\": %.4f, \"p99_ms\": %.4f, "
+		   "\"max_ms\": %.4f}\n",
+		   tile_name[info->type], info->size, geo->nlines, geo->ntiles,
+		   test, n, total/n, times[n/2], times[(n*9)/10], times[(n*99)/100],
+		   times[n - 1]);
+	fflush(stdout);
+}
+
+
+/*
+ * Build game to draw: a random loop, with every tile numbered
+ * (worst case for drawing)
+ */
+static struct game*
+benchmark_game(struct geometry *geo)
+{
+	struct game *game;
+	struct tile *tile;
+	int i, j;
+
+	game= create_empty_gamedata(geo);
+	build_new_loop(geo, game, FALSE);
+	tile= geo->tiles;
+	for(i=0; i < geo->ntiles; ++i) {
+		game->numbers[i]= 0;
+		for(j=0; j < tile->nsides; ++j)
+			if (game->states[tile->sides[j]->id] == LINE_ON)
+				++game->numbers[i];
+		++tile;
+	}
+	memcpy(game->solution, game->states, geo->nlines*sizeof(int));
+	game->solution_nlines_on= game->nlines_on;
+	game->nmismatch= 0;
+	/* a few crosses */
+	for(i=0; i < geo->nlines; i+= 7)
+		if (game->states[i] == LINE_OFF) game->states[i]= LINE_CROSSED;
+	return game;
+}
+
+
+/*
+ * Benchmark one geometry
+ */
+static void
+benchmark_geometry(const struct gameinfo *info, double *times)
+{
+	struct geometry *geo;
+	struct game *game;
+	struct spatial_index *index;
+	struct export_item item;
+	struct export_options options;
+	struct view view;
+	struct number_metrics metrics={NULL, 0, 0, 0., 0, NULL};
+	cairo_surface_t *surf;
+	cairo_t *cr;
+	GTimer *timer;
+	struct line *lin;
+	gchar *filename, *solution_filename;
+	double scale;
+	int i;
+
+	geo= build_geometry_tile((struct gameinfo*)info);
+	game= benchmark_game(geo);
+	index= spatial_index_new(geo);
+	timer= g_timer_new();
+	scale= image_size/geo->board_size;
+
+	surf= cairo_image_surface_create(CAIRO_FORMAT_RGB24, image_size,
+									 image_size);
+	cr= cairo_create(surf);
+	draw_measure_numbers(cr, image_size, image_size, geo, &metrics);
+	cairo_destroy(cr);
+	draw_invalidate_background();
+	view_reset(&view);
+
+	/* full redraw from scratch */
+	for(i=0; i < nframes; ++i) {
+		g_timer_start(timer);
+		cr= cairo_create(surf);
+		cairo_scale(cr, scale, scale);
+		draw_board(cr, geo, game, index, &metrics);
+		cairo_destroy(cr);
+		cairo_surface_flush(surf);
+		times[i]= g_timer_elapsed(timer, NULL)*1000.;
+	}
+	benchmark_report(info, geo, "full", times, nframes);
+
+	/* whole board exposed (first frame builds static layer) */
+	for(i=0; i < nframes; ++i) {
+		g_timer_start(timer);
+		cr= cairo_create(surf);
+		draw_board_cached(cr, image_size, image_size, geo, game, index,
+						  &metrics, &view);
+		cairo_destroy(cr);
+		cairo_surface_flush(surf);
+		times[i]= g_timer_elapsed(timer, NULL)*1000.;
+	}
+	benchmark_report(info, geo, "cached", times, nframes);
+
+	/* a line changes, its clip box is redrawn (as after a mouse click) */
+	for(i=0; i < nframes; ++i) {
+		lin= geo->lines + (int)((i*7919L) % geo->nlines);
+		game->states[lin->id]= (game->states[lin->id] == LINE_ON) ?
+			LINE_OFF : LINE_ON;
+		g_timer_start(timer);
+		cr= cairo_create(surf);
+		cairo_rectangle(cr, (int)(lin->clip.x*scale), (int)(lin->clip.y*scale),
+						(int)(lin->clip.w*scale), (int)(lin->clip.h*scale));
+		cairo_clip(cr);
+		draw_board_cached(cr, image_size, image_size, geo, game, index,
+						  &metrics, &view);
+		cairo_destroy(cr);
+		cairo_surface_flush(surf);
+		times[i]= g_timer_elapsed(timer, NULL)*1000.;
+	}
+	benchmark_report(info, geo, "line", times, nframes);
+
+	/* zoomed in, view moves diagonally across board (static layer is
+	   drawn again every frame, just the part in view) */
+	view.zoom= BENCHMARK_ZOOM;
+	for(i=0; i < nframes; ++i) {
+		view.x= view.y= geo->board_size*(1. - 1./BENCHMARK_ZOOM)*i/nframes;
+		g_timer_start(timer);
+		cr= cairo_create(surf);
+		draw_board_cached(cr, image_size, image_size, geo, game, index,
+						  &metrics, &view);
+		cairo_destroy(cr);
+		cairo_surface_flush(surf);
+		times[i]= g_timer_elapsed(timer, NULL)*1000.;
+	}
+	benchmark_report(info, geo, "zoom", times, nframes);
+
+	/* export to file */
+	filename= g_build_filename(g_get_tmp_dir(), "fences-benchmark.png", NULL);
+	solution_filename= g_build_filename(g_get_tmp_dir(),
+										"fences-benchmark-solution.png", NULL);
+	item.geo= geo;
+	item.game= game;
+	item.filename= filename;
+	item.solution_filename= solution_filename;
+	options.format= EXPORT_PNG;
+	options.size= image_size;
+	options.nthreads= 0;
+	for(i=0; i < nframes; ++i) {
+		g_timer_start(timer);
+		export_boards(&item, 1, &options);
+		times[i]= g_timer_elapsed(timer, NULL)*1000.;
+	}
+	benchmark_report(info, geo, "export", times, nframes);
+	g_unlink(filename);
+	g_unlink(solution_filename);
+	g_free(filename);
+	g_free(solution_filename);
+
+	cairo_surface_destroy(surf);
+	g_timer_destroy(timer);
+	draw_free_metrics(&metrics);
+	draw_invalidate_background();
+	spatial_index_destroy(index);
+	free_gamedata(game);
+	geometry_cache_release(geo);
+}
+
+
+int
+main(int argc, char *argv[])
+{
+	GOptionContext *context;
+	GError *error=NULL;
+	struct gameinfo info;
+	double *times;
+	int type, i;
+
+	context= g_option_context_new("- benchmark board rendering");
+	g_option_context_add_main_entries(context, entries, NULL);
+	if (!g_option_context_parse(context, &argc, &argv, &error)) {
+		fprintf(stderr, "%s\n", error->message);
+		g_error_free(error);
+		return 1;
+	}
+	g_option_context_free(context);
+	if (!g_thread_supported()) g_thread_init(NULL);
+	fences_benchmark_init();
+	if (nframes < 1 || image_size < 1) {
+		fprintf(stderr, "frames and image size must be positive\n");
+		return 1;
+	}
+
+	g_random_set_seed(BENCHMARK_SEED);
+	times= (double*)g_malloc(nframes*sizeof(double));
+
+	for(type=0; type < NUMBER_TILE_TYPE; ++type) {
+		if (only_type != -1 && type != only_type) continue;
+		for(i=0; i < NUM_SIZES; ++i) {
+			info.type= type;
+			info.size= size_is_dimension[type] ? index2size[i] : i;
+			info.diff_index= 0;
+			info.difficulty= 0.;
+			benchmark_geometry(&info, times);
+		}
+	}
+
+	g_free(times);
+	geometry_cache_clear();
+	return 0;
+}
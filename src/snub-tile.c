@@ -19,6 +19,7 @@
 
 #include "geometry.h"
 #include "tiles.h"
+#include "lattice.h"
 
 
 
@@ -40,7 +41,7 @@
  * TRUE: rhomb is fully inside game area
  */
 static gboolean
-snub_is_tile_inside(struct point *vertex, int nvertex)
+snub_is_tile_inside(const struct point *vertex, int nvertex)
 {
 	int i;
 
@@ -54,136 +55,124 @@ snub_is_tile_inside(struct point *vertex, int nvertex)
 
 
 /*
- * Set vertex coordinates of rhombs in a unit
+ * Translate face by (dx,dy) into next face of unit
  */
 static void
-snub_fill_unit_with_tiles(struct geometry *geo, struct point *pos, double side)
+snub_translate_face(struct lattice_face *face, double dx, double dy)
 {
-	struct point pts[4];
+	int i;
+
+	face[1].nsides= face[0].nsides;
+	for(i=0; i < face[0].nsides; ++i) {
+		face[1].pts[i].x= face[0].pts[i].x + dx;
+		face[1].pts[i].y= face[0].pts[i].y + dy;
+	}
+}
+
+
+/*
+ * Set vertex coordinates of tiles in a unit (relative to unit position).
+ * Unit position is the point on the x left and y middle of eye unit.
+ */
+static void
+snub_fill_unit_with_tiles(struct lattice_face *faces, double side)
+{
+	struct point *pts;
 	double half_side;
 	double height;
 	double sq_wide;
-	int i;
 
-	/* pos is point on the x left and y middle of eye unit */
 	/* precalc some stuff */
 	half_side= side / 2.0;
 	height= side * sqrt(3.0)/2.0;
 	sq_wide= height + half_side;
 
 	/* triangle left (looking up) */
-	pts[0].x= pos->x;
-	pts[0].y= pos->y;
-	pts[1].x= pos->x + half_side;
-	pts[1].y= pos->y - height;
-	pts[2].x= pos->x + side;
-	pts[2].y= pos->y;
-	if (snub_is_tile_inside(pts, 3))
-		geometry_add_tile(geo, pts, 3, NULL);
-
+	faces[0].nsides= 3;
+	pts= faces[0].pts;
+	pts[0].x= 0.;
+	pts[0].y= 0.;
+	pts[1].x= half_side;
+	pts[1].y= -height;
+	pts[2].x= side;
+	pts[2].y= 0.;
 	/* triangle bottom middle (looking up) */
-	for(i=0; i < 3; ++i) {
-		pts[i].x+= sq_wide;
-		pts[i].y+= sq_wide;
-	}
-	if (snub_is_tile_inside(pts, 3))
-		geometry_add_tile(geo, pts, 3, NULL);
+	snub_translate_face(faces + 0, sq_wide, sq_wide);
 
 	/* triangle left (looking down) */
-	pts[0].x= pos->x;
-	pts[0].y= pos->y;
-	pts[1].x= pos->x + side;
-	pts[1].y= pos->y;
-	pts[2].x= pos->x + half_side;
-	pts[2].y= pos->y + height;
-	if (snub_is_tile_inside(pts, 3))
-		geometry_add_tile(geo, pts, 3, NULL);
-
+	faces[2].nsides= 3;
+	pts= faces[2].pts;
+	pts[0].x= 0.;
+	pts[0].y= 0.;
+	pts[1].x= side;
+	pts[1].y= 0.;
+	pts[2].x= half_side;
+	pts[2].y= height;
 	/* triangle top center (looking down) */
-	for(i=0; i < 3; ++i) {
-		pts[i].x+= sq_wide;
-		pts[i].y-= sq_wide;
-	}
-	if (snub_is_tile_inside(pts, 3))
-		geometry_add_tile(geo, pts, 3, NULL);
+	snub_translate_face(faces + 2, sq_wide, -sq_wide);
 
 	/* triangle center (looking left) */
-	pts[0].x= pos->x + side;
-	pts[0].y= pos->y;
-	pts[1].x= pos->x + (height + side);
-	pts[1].y= pos->y - half_side;
-	pts[2].x= pos->x + (height + side);
-	pts[2].y= pos->y + half_side;
-	/* point 2 in the same as before */
-	if (snub_is_tile_inside(pts, 3))
-		geometry_add_tile(geo, pts, 3, NULL);
-
+	faces[4].nsides= 3;
+	pts= faces[4].pts;
+	pts[0].x= side;
+	pts[0].y= 0.;
+	pts[1].x= height + side;
+	pts[1].y= -half_side;
+	pts[2].x= height + side;
+	pts[2].y= half_side;
 	/* triangle bottom right (looking left) */
-	for(i=0; i < 3; ++i) {
-		pts[i].x+= sq_wide;
-		pts[i].y+= sq_wide;
-	}
-	if (snub_is_tile_inside(pts, 3))
-		geometry_add_tile(geo, pts, 3, NULL);
+	snub_translate_face(faces + 4, sq_wide, sq_wide);
 
 	/* triangle bottom left (looking right) */
-	pts[0].x= pos->x + half_side;
-	pts[0].y= pos->y + height;
-	pts[1].x= pos->x + sq_wide;
-	pts[1].y= pos->y + sq_wide;
-	pts[2].x= pos->x + half_side;
-	pts[2].y= pos->y + (height + side);
-	if (snub_is_tile_inside(pts, 3))
-		geometry_add_tile(geo, pts, 3, NULL);
-
+	faces[6].nsides= 3;
+	pts= faces[6].pts;
+	pts[0].x= half_side;
+	pts[0].y= height;
+	pts[1].x= sq_wide;
+	pts[1].y= sq_wide;
+	pts[2].x= half_side;
+	pts[2].y= height + side;
 	/* triangle center (looking right) */
-	for(i=0; i < 3; ++i) {
-		pts[i].x+= sq_wide;
-		pts[i].y-= sq_wide;
-	}
-	if (snub_is_tile_inside(pts, 3))
-		geometry_add_tile(geo, pts, 3, NULL);
+	snub_translate_face(faces + 6, sq_wide, -sq_wide);
 
 	/* square top left */
-	pts[0].x= pos->x + half_side;
-	pts[0].y= pos->y - height;
-	pts[1].x= pos->x + sq_wide;
-	pts[1].y= pos->y - sq_wide;
-	pts[2].x= pos->x + (sq_wide + half_side);
-	pts[2].y= pos->y - half_side;
-	pts[3].x= pos->x + side;
-	pts[3].y= pos->y;
-	if (snub_is_tile_inside(pts, 4)) {
-		geometry_add_tile(geo, pts, 4, NULL);
-	}
-
+	faces[8].nsides= 4;
+	pts= faces[8].pts;
+	pts[0].x= half_side;
+	pts[0].y= -height;
+	pts[1].x= sq_wide;
+	pts[1].y= -sq_wide;
+	pts[2].x= sq_wide + half_side;
+	pts[2].y= -half_side;
+	pts[3].x= side;
+	pts[3].y= 0.;
 	/* square bot right */
-	for(i=0; i < 4; ++i) {
-		pts[i].x+= sq_wide;
-		pts[i].y+= sq_wide;
-	}
-	if (snub_is_tile_inside(pts, 4))
-		geometry_add_tile(geo, pts, 4, NULL);
+	snub_translate_face(faces + 8, sq_wide, sq_wide);
 
 	/* square bottom left */
-	pts[0].x= pos->x + side;
-	pts[0].y= pos->y;
-	pts[1].x= pos->x + (sq_wide + half_side);
-	pts[1].y= pos->y + half_side;
-	pts[2].x= pos->x + sq_wide;
-	pts[2].y= pos->y + sq_wide;
-	pts[3].x= pos->x + half_side;
-	pts[3].y= pos->y + height;
-	if (snub_is_tile_inside(pts, 4))
-		geometry_add_tile(geo, pts, 4, NULL);
-
+	faces[10].nsides= 4;
+	pts= faces[10].pts;
+	pts[0].x= side;
+	pts[0].y= 0.;
+	pts[1].x= sq_wide + half_side;
+	pts[1].y= half_side;
+	pts[2].x= sq_wide;
+	pts[2].y= sq_wide;
+	pts[3].x= half_side;
+	pts[3].y= height;
 	/* square top right */
-	for(i=0; i < 4; ++i) {
-		pts[i].x+= sq_wide;
-		pts[i].y-= sq_wide;
-	}
-	if (snub_is_tile_inside(pts, 4))
-		geometry_add_tile(geo, pts, 4, NULL);
+	snub_translate_face(faces + 10, sq_wide, -sq_wide);
+}
+
+
+/*
+ * Keep tiles that are inside game area
+ */
+static gboolean
+snub_clip(int i, int j, int face, const struct point *pts, int npts,
+		  gpointer data)
+{
+	return snub_is_tile_inside(pts, npts);
 }
 
 
@@ -210,15 +199,11 @@ struct geometry*
 build_snub_tile_skeleton(const struct gameinfo *info)
 {
 	struct geometry *geo;
-	int i, j;
+	struct lattice lat;
+	struct lattice_face faces[12];
 	int num_eyes;
 	double side;
-	int ntiles;
-	int nvertex;
-	int nlines;
-	double x0;
 	double y0;
-	struct point pos;
 	const int geo_params[5][3]= {	/* num of tiles, vertex, lines for all sizes */
 		{ 48,  44,  91},
 		{108,  90, 197},
@@ -234,36 +219,36 @@ build_snub_tile_skeleton(const struct gameinfo *info)
 	side= SNUB_GAME_SIZE/((double)(num_eyes + 1) + num_eyes*sqrt(3.0));
 
 	/* coordinates of unit on top left (center of unit coords) */
-	x0= SNUB_BOARD_MARGIN;
 	y0= (SNUB_GAME_SIZE - (sqrt(3.0) + 1.0)*side*num_eyes) / 2.0;
 	y0= SNUB_BOARD_MARGIN + y0 + (sqrt(3.0) + 1.0)*side/2.0;
 
-	/* create geometry with plenty of space for lines and vertex */
-	ntiles= geo_params[info->size][0];
-	nvertex= geo_params[info->size][1];
-	nlines= geo_params[info->size][2];
-	geo= geometry_create_new(ntiles, nvertex, nlines, 4);
+	/* 8 triangles and 4 squares in each unit */
+	snub_fill_unit_with_tiles(faces, side);
+	lat.origin.x= SNUB_BOARD_MARGIN;
+	lat.origin.y= y0;
+	lat.a.x= (sqrt(3) + 1.0)*side;
+	lat.a.y= 0.;
+	lat.b.x= 0.;
+	lat.b.y= (sqrt(3) + 1.0)*side;
+	lat.nfaces= 12;
+	lat.faces= faces;
+	lat.imin= 0;
+	lat.imax= num_eyes;
+	lat.jmin= 0;
+	lat.jmax= num_eyes - 1;
+	lat.clip= snub_clip;
+	lat.clip_data= NULL;
+	lat.max_numlines= 4;
+
+	geo= lattice_build_skeleton(&lat);
 	geo->board_size= SNUB_BOARD_SIZE;
 	geo->board_margin= SNUB_BOARD_MARGIN;
 	geo->game_size= SNUB_BOARD_SIZE - 2*SNUB_BOARD_MARGIN;
-	geometry_set_distance_resolution(side/10.0);
-
-	/* create rhombs (3 rhombs in each unit) */
-	geo->ntiles= 0;
-	geo->nlines= 0;
-	geo->nvertex= 0;
-	for(j=0; j < num_eyes; ++j) {
-		pos.y= y0 + j * (sqrt(3) + 1.0)*side;
-		for(i=0; i <= num_eyes; ++i) {
-			pos.x= x0 + i * (sqrt(3) + 1.0)*side;
-			snub_fill_unit_with_tiles(geo, &pos, side);
-		}
-	}
 
-	/* make sure we didn't underestimate max numbers */
-	g_assert(geo->ntiles == ntiles);
-	g_assert(geo->nvertex == nvertex);
-	g_assert(geo->nlines == nlines);
+	/* sanity check: see if we got the numbers we expected */
+	g_assert(geo->ntiles == geo_params[info->size][0]);
+	g_assert(geo->nvertex == geo_params[info->size][1]);
+	g_assert(geo->nlines == geo_params[info->size][2]);
 
 	return geo;
 }
@@ -14,12 +14,17 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
  */
 
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
 #include <glib.h>
 #include <string.h>
 #include <stdio.h>
 
 #include "gamedata.h"
 #include "game-solver.h"
+#include "solve-profile.h"
 
 
 
@@ -253,6 +258,7 @@ test_tile_combinations(struct solution *sol, struct solution *sol_bak,
 		/* restore initial solution state */
 		solve_copy_solution(sol, sol_bak);
 	}
+	SOLVE_PROFILE_SCAN(ncomb);
 	/* normalize mask of lines that are always ON in all invalid cases */
 	bad_lines&= all_lines;
 
@@ -286,6 +292,7 @@ solve_try_combinations(struct solution *sol, int level)
 	struct solution *sol_bak;	// backup solution
 	struct geometry *geo=sol->geo;
 
+	SOLVE_PROFILE_ENTER(SOLVE_RULE_COMBINATIONS + level);
 	/* make a backup of current solution state */
 	sol_bak= solve_duplicate_solution(sol);
 
@@ -303,7 +310,9 @@ solve_try_combinations(struct solution *sol, int level)
 		if (sol->nchanges > 0)
 			break;
 	}
+	SOLVE_PROFILE_SCAN(MIN(i + 1, geo->ntiles));
 
 	/* free solution backup */
 	solve_free_solution_data(sol_bak);
+	SOLVE_PROFILE_LEAVE(sol);
 }
@@ -0,0 +1,261 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "solve-profile.h"
+
+
+/*
+ * Solver profiler.
+ * Counts, for every solver rule, how many times it ran, how many elements
+ * it looked at, how many lines it changed and how long it took. Rules run
+ * in several threads (game building, hints, move checker), so every
+ * thread keeps its own counters; they're added together when written out.
+ * Time is kept both in total (including rules called by the rule, e.g.
+ * the look-ahead of combinations) and self (excluding them).
+ * Only built with --enable-solver-profile.
+ */
+
+#ifdef SOLVE_PROFILE
+
+/* maximum depth of nested rules */
+#define SOLVE_PROFILE_DEPTH		8
+
+
+/*
+ * Counters of one rule
+ */
+struct solve_profile_count {
+	guint64 calls;			// times rule ran
+	guint64 scanned;		// elements looked at
+	guint64 changes;		// lines changed
+	gint64 total_ns;		// time in rule (and rules it called)
+	gint64 self_ns;			// time in rule alone
+};
+
+
+/*
+ * Rule running in a thread
+ */
+struct solve_profile_frame {
+	int rule;				// rule running
+	gint64 start;			// time rule started (ns)
+	gint64 child_ns;		// time spent in rules it called
+};
+
+
+/*
+ * Counters of a thread
+ */
+struct solve_profile_thread {
+	struct solve_profile_count count[NUM_SOLVE_RULES];
+	struct solve_profile_frame stack[SOLVE_PROFILE_DEPTH];
+	int depth;				// number of rules running
+};
+
+
+/* rule names and solver levels, as written out */
+static const char *rule_name[NUM_SOLVE_RULES]={
+	"zero_tiles",
+	"maxnumber_tiles",
+	"cross_lines",
+	"trivial_vertex",
+	"trivial_tiles",
+	"bottleneck",
+	"corner",
+	"maxnumber_incoming_line",
+	"maxnumber_exit_line",
+	"tiles_net_1",
+	"combinations0",
+	"combinations1",
+	"combinations2"
+};
+static const int rule_level[NUM_SOLVE_RULES]={
+	0, 0, 0, 0, 1, 2, 3, 4, 4, 5, 6, 7, 8
+};
+
+/* counters of current thread, and list of all of them */
+static GStaticPrivate profile_key=G_STATIC_PRIVATE_INIT;
+static GStaticMutex profile_mutex=G_STATIC_MUTEX_INIT;
+static GSList *profile_threads=NULL;
+
+
+
+/*
+ * Current time in nanoseconds
+ */
+static inline gint64
+solve_profile_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (gint64)ts.tv_sec*1000000000 + ts.tv_nsec;
+}
+
+
+/*
+ * Counters of current thread (created on first use). They're kept
+ * after the thread finishes, so its work still shows up.
+ */
+static struct solve_profile_thread*
+solve_profile_get_thread(void)
+{
+	struct solve_profile_thread *prof;
+
+	prof= (struct solve_profile_thread*)g_static_private_get(&profile_key);
+	if (prof != NULL) return prof;
+
+	prof= (struct solve_profile_thread*)
+		g_malloc0(sizeof(struct solve_profile_thread));
+	g_static_private_set(&profile_key, prof, NULL);
+	g_static_mutex_lock(&profile_mutex);
+	profile_threads= g_slist_prepend(profile_threads, prof);
+	g_static_mutex_unlock(&profile_mutex);
+	return prof;
+}
+
+
+/*
+ * Rule starts
+ */
+void
+solve_profile_enter(int rule)
+{
+	struct solve_profile_thread *prof=solve_profile_get_thread();
+	struct solve_profile_frame *frame;
+
+	++prof->depth;
+	if (prof->depth > SOLVE_PROFILE_DEPTH) return;
+	frame= prof->stack + prof->depth - 1;
+	frame->rule= rule;
+	frame->child_ns= 0;
+	frame->start= solve_profile_now();
+}
+
+
+/*
+ * Rule finished, after changing 'nchanges' lines
+ */
+void
+solve_profile_leave(int nchanges)
+{
+	struct solve_profile_thread *prof=solve_profile_get_thread();
+	struct solve_profile_frame *frame;
+	struct solve_profile_count *count;
+	gint64 elapsed;
+
+	--prof->depth;
+	if (prof->depth >= SOLVE_PROFILE_DEPTH) return;
+	frame= prof->stack + prof->depth;
+	elapsed= solve_profile_now() - frame->start;
+	count= prof->count + frame->rule;
+	++count->calls;
+	count->changes+= nchanges;
+	count->total_ns+= elapsed;
+	count->self_ns+= elapsed - frame->child_ns;
+	if (prof->depth > 0)
+		frame[-1].child_ns+= elapsed;
+}
+
+
+/*
+ * Running rule looked at 'n' more elements
+ */
+void
+solve_profile_scan(int n)
+{
+	struct solve_profile_thread *prof=solve_profile_get_thread();
+
+	if (prof->depth < 1 || prof->depth > SOLVE_PROFILE_DEPTH) return;
+	prof->count[prof->stack[prof->depth - 1].rule].scanned+= n;
+}
+
+
+/*
+ * Zero counters of every thread.
+ * Rules running in other threads at the same time may lose a few counts.
+ */
+void
+solve_profile_reset(void)
+{
+	struct solve_profile_thread *prof;
+	GSList *item;
+
+	g_static_mutex_lock(&profile_mutex);
+	for(item=profile_threads; item != NULL; item=item->next) {
+		prof= (struct solve_profile_thread*)item->data;
+		memset(prof->count, 0, sizeof(prof->count));
+	}
+	g_static_mutex_unlock(&profile_mutex);
+}
+
+
+/*
+ * Write counters of all threads as one JSON object (one line):
+ * {"label": ..., "rules": [{"rule": ..., "level": ..., "calls": ...,
+ *  "scanned": ..., "changes": ..., "total_ms": ..., "self_ms": ...}, ...]}
+ * Rules that never ran are left out.
+ */
+void
+solve_profile_write_json(FILE *file, const char *label)
+{
+	struct solve_profile_count sum[NUM_SOLVE_RULES];
+	struct solve_profile_thread *prof;
+	GSList *item;
+	gboolean first=TRUE;
+	int i;
+
+	memset(sum, 0, sizeof(sum));
+	g_static_mutex_lock(&profile_mutex);
+	for(item=profile_threads; item != NULL; item=item->next) {
+		prof= (struct solve_profile_thread*)item->data;
+		for(i=0; i < NUM_SOLVE_RULES; ++i) {
+			sum[i].calls+= prof->count[i].calls;
+			sum[i].scanned+= prof->count[i].scanned;
+			sum[i].changes+= prof->count[i].changes;
+			sum[i].total_ns+= prof->count[i].total_ns;
+			sum[i].self_ns+= prof->count[i].self_ns;
+		}
+	}
+	g_static_mutex_unlock(&profile_mutex);
+
+	fprintf(file, "{\"label\": \"%s\", \"rules\": [", label);
+	for(i=0; i < NUM_SOLVE_RULES; ++i) {
+		if (sum[i].calls == 0) continue;
+		fprintf(file, "%s{\"rule\": \"%s\", \"level\": %d, "
+				"\"calls\": %" G_GUINT64_FORMAT ", "
+				"\"scanned\": %" G_GUINT64_FORMAT ", "
+				"\"changes\": %" G_GUINT64_FORMAT ", "
+				"\"total_ms\": %.4f, \"self_ms\": %.4f}",
+				first ? "" : ", ", rule_name[i], rule_level[i],
+				sum[i].calls, sum[i].scanned, sum[i].changes,
+				sum[i].total_ns/1e6, sum[i].self_ns/1e6);
+		first= FALSE;
+	}
+	fprintf(file, "]}\n");
+	fflush(file);
+}
+
+#endif
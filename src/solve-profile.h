@@ -0,0 +1,71 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+#ifndef __INCLUDED_SOLVE_PROFILE_H__
+#define __INCLUDED_SOLVE_PROFILE_H__
+
+#include <stdio.h>
+
+
+/* Solver rules counted by profiler */
+enum {
+	SOLVE_RULE_ZERO_TILES,
+	SOLVE_RULE_MAXNUMBER_TILES,
+	SOLVE_RULE_CROSS_LINES,
+	SOLVE_RULE_TRIVIAL_VERTEX,
+	SOLVE_RULE_TRIVIAL_TILES,
+	SOLVE_RULE_BOTTLENECK,
+	SOLVE_RULE_CORNER,
+	SOLVE_RULE_MAXNUMBER_INCOMING,
+	SOLVE_RULE_MAXNUMBER_EXIT,
+	SOLVE_RULE_TILES_NET_1,
+	SOLVE_RULE_COMBINATIONS,	/* + look-ahead level (0..2) */
+	NUM_SOLVE_RULES= SOLVE_RULE_COMBINATIONS + 3
+};
+
+
+/*
+ * Profiling macros, placed in the solver rules (after declarations).
+ * ENTER starts timing a rule, LEAVE stops it and adds the lines the rule
+ * changed (sol->nchanges), SCAN adds to the number of elements (tiles,
+ * vertices, lines, combinations) looked at.
+ * Unless fences is configured with --enable-solver-profile they expand to
+ * nothing.
+ */
+#ifdef SOLVE_PROFILE
+#define SOLVE_PROFILE_ENTER(rule)	solve_profile_enter(rule)
+#define SOLVE_PROFILE_LEAVE(sol)	solve_profile_leave((sol)->nchanges)
+#define SOLVE_PROFILE_SCAN(n)		solve_profile_scan(n)
+#else
+#define SOLVE_PROFILE_ENTER(rule)
+#define SOLVE_PROFILE_LEAVE(sol)
+#define SOLVE_PROFILE_SCAN(n)
+#endif
+
+
+/*
+ * Functions
+ */
+#ifdef SOLVE_PROFILE
+void solve_profile_enter(int rule);
+void solve_profile_leave(int nchanges);
+void solve_profile_scan(int n);
+void solve_profile_reset(void);
+void solve_profile_write_json(FILE *file, const char *label);
+#endif
+
+
+#endif
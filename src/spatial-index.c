@@ -0,0 +1,292 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+#include <stdlib.h>
+#include <math.h>
+#include <glib.h>
+
+#include "geometry.h"
+#include "spatial-index.h"
+
+
+/*
+ * Spatial index.
+ * Lines, tiles and vertices are located in a uniform grid by the area
+ * they cover when drawn, so the elements touching a region of the board
+ * (e.g. the area exposed after a line change) can be listed without
+ * going through the whole geometry.
+ */
+
+
+
+/*
+ * Box containing a line and everything drawn on it (ON line with round
+ * caps, OFF line, cross at middle point)
+ */
+static void
+spatial_line_box(const struct geometry *geo, const struct line *lin,
+				 struct clipbox *box)
+{
+	const struct point *p1=&lin->ends[0]->pos;
+	const struct point *p2=&lin->ends[1]->pos;
+	double pad;
+
+	pad= geo->on_line_width/2.;
+	if (geo->off_line_width/2. > pad) pad= geo->off_line_width/2.;
+	if (geo->cross_radius + geo->cross_line_width/2. > pad)
+		pad= geo->cross_radius + geo->cross_line_width/2.;
+
+	box->x= ((p1->x < p2->x) ? p1->x : p2->x) - pad;
+	box->y= ((p1->y < p2->y) ? p1->y : p2->y) - pad;
+	box->w= fabs(p2->x - p1->x) + 2*pad;
+	box->h= fabs(p2->y - p1->y) + 2*pad;
+}
+
+
+/*
+ * Box containing a tile (tile number is drawn inside it)
+ */
+static void
+spatial_tile_box(const struct tile *tile, struct clipbox *box)
+{
+	struct point tl, br;
+	int i;
+
+	tl= br= tile->vertex[0]->pos;
+	for(i=1; i < tile->nvertex; ++i) {
+		if (tile->vertex[i]->pos.x < tl.x) tl.x= tile->vertex[i]->pos.x;
+		if (tile->vertex[i]->pos.y < tl.y) tl.y= tile->vertex[i]->pos.y;
+		if (tile->vertex[i]->pos.x > br.x) br.x= tile->vertex[i]->pos.x;
+		if (tile->vertex[i]->pos.y > br.y) br.y= tile->vertex[i]->pos.y;
+	}
+	box->x= tl.x;
+	box->y= tl.y;
+	box->w= br.x - tl.x;
+	box->h= br.y - tl.y;
+}
+
+
+/*
+ * Box containing vertex error mark
+ */
+static void
+spatial_vertex_box(const struct geometry *geo, const struct vertex *vertex,
+				   struct clipbox *box)
+{
+	double radius=geo->tile_width/5.;
+
+	box->x= vertex->pos.x - radius;
+	box->y= vertex->pos.y - radius;
+	box->w= 2*radius;
+	box->h= 2*radius;
+}
+
+
+/*
+ * Range of grid cells (columns c0..c1, rows r0..r1) touched by box
+ */
+static void
+spatial_cell_range(const struct spatial_index *index, const struct clipbox *box,
+				   int *c0, int *r0, int *c1, int *r1)
+{
+	*c0= (int)floor((box->x - index->x0)/index->cell_size);
+	*r0= (int)floor((box->y - index->y0)/index->cell_size);
+	*c1= (int)floor((box->x + box->w - index->x0)/index->cell_size);
+	*r1= (int)floor((box->y + box->h - index->y0)/index->cell_size);
+	*c0= CLAMP(*c0, 0, index->ncols - 1);
+	*r0= CLAMP(*r0, 0, index->nrows - 1);
+	*c1= CLAMP(*c1, 0, index->ncols - 1);
+	*r1= CLAMP(*r1, 0, index->nrows - 1);
+}
+
+
+/*
+ * Fill grid cells with element boxes already set in grid
+ */
+static void
+spatial_grid_fill(const struct spatial_index *index, struct spatial_grid *grid)
+{
+	int ncells=index->ncols*index->nrows;
+	int *pos;
+	int c0, r0, c1, r1;
+	int i, c, r;
+
+	/* count elements in each cell (shifted by one, see prefix sum) */
+	grid->start= (int*)g_malloc0((ncells + 1)*sizeof(int));
+	for(i=0; i < grid->nitems; ++i) {
+		spatial_cell_range(index, grid->box + i, &c0, &r0, &c1, &r1);
+		for(r=r0; r <= r1; ++r)
+			for(c=c0; c <= c1; ++c)
+				++grid->start[r*index->ncols + c + 1];
+	}
+	for(i=0; i < ncells; ++i)
+		grid->start[i + 1]+= grid->start[i];
+
+	/* store elements */
+	grid->items= (int*)g_malloc(grid->start[ncells]*sizeof(int));
+	pos= (int*)g_malloc(ncells*sizeof(int));
+	for(i=0; i < ncells; ++i)
+		pos[i]= grid->start[i];
+	for(i=0; i < grid->nitems; ++i) {
+		spatial_cell_range(index, grid->box + i, &c0, &r0, &c1, &r1);
+		for(r=r0; r <= r1; ++r)
+			for(c=c0; c <= c1; ++c)
+				grid->items[pos[r*index->ncols + c]++]= i;
+	}
+	g_free(pos);
+
+	grid->found= (int*)g_malloc(grid->nitems*sizeof(int));
+}
+
+
+/*
+ * Build spatial index of a connected geometry.
+ * Cell size is chosen so there's roughly one line per cell.
+ */
+struct spatial_index*
+spatial_index_new(const struct geometry *geo)
+{
+	struct spatial_index *index;
+	struct spatial_grid *grid;
+	struct point tl, br;
+	struct clipbox *box;
+	int i;
+
+	index= (struct spatial_index*)g_malloc(sizeof(struct spatial_index));
+
+	/* element boxes */
+	grid= index->grid + SPATIAL_LINES;
+	grid->nitems= geo->nlines;
+	grid->box= (struct clipbox*)g_malloc(geo->nlines*sizeof(struct clipbox));
+	for(i=0; i < geo->nlines; ++i)
+		spatial_line_box(geo, geo->lines + i, grid->box + i);
+
+	grid= index->grid + SPATIAL_TILES;
+	grid->nitems= geo->ntiles;
+	grid->box= (struct clipbox*)g_malloc(geo->ntiles*sizeof(struct clipbox));
+	for(i=0; i < geo->ntiles; ++i)
+		spatial_tile_box(geo->tiles + i, grid->box + i);
+
+	grid= index->grid + SPATIAL_VERTEX;
+	grid->nitems= geo->nvertex;
+	grid->box= (struct clipbox*)g_malloc(geo->nvertex*sizeof(struct clipbox));
+	for(i=0; i < geo->nvertex; ++i)
+		spatial_vertex_box(geo, geo->vertex + i, grid->box + i);
+
+	/* grid covers the board (and anything sticking out of it) */
+	tl.x= tl.y= 0.;
+	br.x= br.y= geo->board_size;
+	box= index->grid[SPATIAL_LINES].box;
+	for(i=0; i < geo->nlines; ++i) {
+		if (box[i].x < tl.x) tl.x= box[i].x;
+		if (box[i].y < tl.y) tl.y= box[i].y;
+		if (box[i].x + box[i].w > br.x) br.x= box[i].x + box[i].w;
+		if (box[i].y + box[i].h > br.y) br.y= box[i].y + box[i].h;
+	}
+	index->x0= tl.x;
+	index->y0= tl.y;
+	index->cell_size= sqrt((br.x - tl.x)*(br.y - tl.y)/(geo->nlines + 1));
+	index->ncols= (int)ceil((br.x - tl.x)/index->cell_size);
+	index->nrows= (int)ceil((br.y - tl.y)/index->cell_size);
+	if (index->ncols < 1) index->ncols= 1;
+	if (index->nrows < 1) index->nrows= 1;
+
+	for(i=0; i < NUM_SPATIAL_KINDS; ++i)
+		spatial_grid_fill(index, index->grid + i);
+
+	return index;
+}
+
+
+/*
+ * Free spatial index
+ */
+void
+spatial_index_destroy(struct spatial_index *index)
+{
+	int i;
+
+	for(i=0; i < NUM_SPATIAL_KINDS; ++i) {
+		g_free(index->grid[i].box);
+		g_free(index->grid[i].start);
+		g_free(index->grid[i].items);
+		g_free(index->grid[i].found);
+	}
+	g_free(index);
+}
+
+
+/*
+ * Compare ints (for qsort)
+ */
+static int
+spatial_id_cmp(const void *a, const void *b)
+{
+	return *(const int*)a - *(const int*)b;
+}
+
+
+/*
+ * Find elements of given kind whose boxes intersect area.
+ * Returns number of elements found. Ids (sorted) are returned in 'ids',
+ * which belongs to index and is valid until next query of same kind.
+ * If area covers the whole grid, 'ids' is set to NULL: all elements
+ * (0 .. return value - 1) are in area.
+ */
+int
+spatial_index_find(struct spatial_index *index, int kind,
+				   const struct clipbox *area, const int **ids)
+{
+	struct spatial_grid *grid=index->grid + kind;
+	const struct clipbox *box;
+	int c0, r0, c1, r1;
+	int ec0, er0, ec1, er1;
+	int c, r, k, id;
+	int cell;
+	int nfound=0;
+
+	/* whole grid requested */
+	if (area->x <= index->x0 && area->y <= index->y0 &&
+		area->x + area->w >= index->x0 + index->ncols*index->cell_size &&
+		area->y + area->h >= index->y0 + index->nrows*index->cell_size) {
+		*ids= NULL;
+		return grid->nitems;
+	}
+
+	spatial_cell_range(index, area, &c0, &r0, &c1, &r1);
+	for(r=r0; r <= r1; ++r) {
+		for(c=c0; c <= c1; ++c) {
+			cell= r*index->ncols + c;
+			for(k=grid->start[cell]; k < grid->start[cell + 1]; ++k) {
+				id= grid->items[k];
+				box= grid->box + id;
+				if (box->x > area->x + area->w || box->x + box->w < area->x ||
+					box->y > area->y + area->h || box->y + box->h < area->y)
+					continue;
+				/* element may be in several cells: only report it from
+				   the first of them inside area */
+				spatial_cell_range(index, box, &ec0, &er0, &ec1, &er1);
+				if (MAX(ec0, c0) != c || MAX(er0, r0) != r) continue;
+				grid->found[nfound++]= id;
+			}
+		}
+	}
+
+	/* keep drawing order */
+	qsort(grid->found, nfound, sizeof(int), spatial_id_cmp);
+	*ids= grid->found;
+	return nfound;
+}
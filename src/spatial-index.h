@@ -0,0 +1,63 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+#ifndef __INCLUDED_SPATIAL_INDEX_H__
+#define __INCLUDED_SPATIAL_INDEX_H__
+
+#include "geometry.h"
+
+
+/* Kinds of elements in spatial index */
+enum {
+	SPATIAL_LINES,
+	SPATIAL_TILES,
+	SPATIAL_VERTEX,
+	NUM_SPATIAL_KINDS
+};
+
+
+/*
+ * Elements of one kind sorted by grid cell (compressed rows: elements in
+ * cell c are items[start[c]] ... items[start[c + 1] - 1]).
+ * An element is listed in every cell its box touches.
+ */
+struct spatial_grid {
+	int nitems;				// number of elements
+	struct clipbox *box;	// area covered by each element when drawn
+	int *start;				// start of each cell in items (ncells + 1)
+	int *items;				// element ids
+	int *found;				// result of last query
+};
+
+
+/*
+ * Uniform grid over the board, locating lines, tiles and vertices
+ */
+struct spatial_index {
+	double x0, y0;			// top left corner of grid
+	double cell_size;		// size of grid cells
+	int ncols, nrows;		// number of cells in each direction
+	struct spatial_grid grid[NUM_SPATIAL_KINDS];
+};
+
+
+/* spatial-index.c */
+struct spatial_index* spatial_index_new(const struct geometry *geo);
+void spatial_index_destroy(struct spatial_index *index);
+int spatial_index_find(struct spatial_index *index, int kind,
+					   const struct clipbox *area, const int **ids);
+
+#endif
@@ -18,6 +18,7 @@
 
 #include "geometry.h"
 #include "tiles.h"
+#include "lattice.h"
 
 
 /* prefered board dimensions for square tile */
@@ -51,57 +52,49 @@ struct geometry*
 build_square_tile_skeleton(const struct gameinfo *info)
 {
 	struct geometry *geo;
-	int i, j;
-	double xpos;
-	double ypos;
+	struct lattice lat;
+	struct lattice_face square;
 	int dim=info->size;		/** HACK ** FIXME: allow rectangular games */
 	double side;
-	int ntiles;
-	int nvertex;
-	int nlines;
-	struct point pts[4];
 
 	/* calculate length of tile side */
 	side= ((double)SQUARE_GAME_SIZE)/dim;
 
-	/* create new geometry (ntiles, nvertex, nlines) */
-	ntiles= dim*dim;
-	nvertex= (dim + 1)*(dim + 1);
-	nlines= 2*dim*(dim + 1);
-	geo= geometry_create_new(ntiles, nvertex, nlines, 4);
+	/* one square per unit (vertices clockwise from top left) */
+	square.nsides= 4;
+	square.pts[0].x= 0.;
+	square.pts[0].y= 0.;
+	square.pts[1].x= side;
+	square.pts[1].y= 0.;
+	square.pts[2].x= side;
+	square.pts[2].y= side;
+	square.pts[3].x= 0.;
+	square.pts[3].y= side;
+
+	/* dim x dim grid (row by row) */
+	lat.origin.x= SQUARE_BOARD_MARGIN;
+	lat.origin.y= SQUARE_BOARD_MARGIN;
+	lat.a.x= 0.;
+	lat.a.y= side;
+	lat.b.x= side;
+	lat.b.y= 0.;
+	lat.nfaces= 1;
+	lat.faces= &square;
+	lat.imin= lat.jmin= 0;
+	lat.imax= lat.jmax= dim - 1;
+	lat.clip= NULL;
+	lat.clip_data= NULL;
+	lat.max_numlines= 4;
+
+	geo= lattice_build_skeleton(&lat);
 	geo->board_size= SQUARE_BOARD_SIZE;
 	geo->board_margin= SQUARE_BOARD_MARGIN;
 	geo->game_size= SQUARE_GAME_SIZE;
-	geometry_set_distance_resolution(side/10.0);
-
-	/* iterate through tiles creating skeleton geometry
-	   (skeleton geometry: lines hold all the topology info) */
-	geo->ntiles= 0;
-	geo->nlines= 0;
-	geo->nvertex= 0;
-	for(j=0; j < dim; ++j) {
-		ypos= SQUARE_BOARD_MARGIN + side*j;
-		for(i=0; i < dim; ++i) {
-			xpos= SQUARE_BOARD_MARGIN + side*i;
-			/* xpos,ypos -> coord of top left vertex */
-			pts[0].x= xpos;					/* top left*/
-			pts[0].y= ypos;
-			pts[1].x= xpos + side;			/* top right */
-			pts[1].y= ypos;
-			pts[2].x= xpos + side;			/* bot right */
-			pts[2].y= ypos + side;
-			pts[3].x= xpos;					/* bot left */
-			pts[3].y= ypos + side;
-
-			/* add tile to skeleton geometry */
-			geometry_add_tile(geo, pts, 4, NULL);
-		}
-	}
 
 	/* sanity check: see if we got the numbers we expected */
-	g_assert(geo->ntiles == ntiles);
-	g_assert(geo->nvertex == nvertex);
-	g_assert(geo->nlines == nlines);
+	g_assert(geo->ntiles == dim*dim);
+	g_assert(geo->nvertex == (dim + 1)*(dim + 1));
+	g_assert(geo->nlines == 2*dim*(dim + 1));
 
 	return geo;
 }
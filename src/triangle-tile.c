@@ -19,6 +19,7 @@
 
 #include "geometry.h"
 #include "tiles.h"
+#include "lattice.h"
 
 
 /* prefered board dimensions for triangle tile */
@@ -45,6 +46,23 @@ triangular_calculate_sizes(struct geometry *geo, int dim)
 }
 
 
+/*
+ * Keep triangles inside the dimx x dimy grid.
+ * Unit (i,j) holds the upright (face 0) and upside down (face 1) triangles
+ * at positions 2*i + j and 2*i + j + 1 of row j.
+ */
+static gboolean
+triangular_clip(int i, int j, int face, const struct point *pts, int npts,
+				gpointer data)
+{
+	int dimx=*(int*)data;
+	int x;
+
+	x= 2*i + j + face;
+	return x >= 0 && x < dimx;
+}
+
+
 /*
  * Build triangular tile geometry skeleton: no connections between elements
  * Triangular grid of dim x dim tiles
@@ -53,74 +71,65 @@ struct geometry*
 build_triangular_tile_skeleton(const struct gameinfo *info)
 {
 	struct geometry *geo;
-	int i, j;
-	int ntiles;
-	int nvertex;
-	int nlines;
-	double xpos;
-	double ypos;
-	double xoffset;
-	double yoffset;
+	struct lattice lat;
+	struct lattice_face triangles[2];
 	int dimx=info->size;
 	int dimy=info->size;
 	double height;		// y distance between two points
 	double side;
-	struct point pts[3];
 
 	/* see how many triangles fit wide */
 	side= ((double)TRIANGULAR_GAME_SIZE)/(dimx + 1.0/2.0);
 	height= side * sqrt(3.0)/2.0;
-	yoffset= TRIANGULAR_GAME_SIZE - (dimy * height);
-	yoffset= yoffset/2.0 + TRIANGULAR_BOARD_MARGIN;
-	xoffset= TRIANGULAR_BOARD_MARGIN + side/2.0;
 
 	/* dimx until now is number of sides wide,
 	   now we turn it into number of triangles*/
 	dimx= 2 * dimx;
 
-	/* create new geometry (ntriangles, nvertex, nlines) */
-	ntiles= dimx*dimy;
-	nvertex= (dimx/2 + 1)*(dimy + 1);
-	nlines= dimx/2*(dimy + 1) + (dimx + 1)*dimy;
-	geo= geometry_create_new(ntiles, nvertex, nlines, 3);
+	/* upright triangle */
+	triangles[0].nsides= 3;
+	triangles[0].pts[0].x= 0.;					/* top */
+	triangles[0].pts[0].y= 0.;
+	triangles[0].pts[1].x= side/2.0;			/* bot right */
+	triangles[0].pts[1].y= height;
+	triangles[0].pts[2].x= -side/2.0;			/* bot left */
+	triangles[0].pts[2].y= height;
+	/* upside down triangle (next to it) */
+	triangles[1].nsides= 3;
+	triangles[1].pts[0].x= 0.;					/* top left */
+	triangles[1].pts[0].y= 0.;
+	triangles[1].pts[1].x= side;				/* top right */
+	triangles[1].pts[1].y= 0.;
+	triangles[1].pts[2].x= side/2.0;			/* bottom */
+	triangles[1].pts[2].y= height;
+
+	/* rows are shifted half a side with respect to the previous one */
+	lat.origin.x= TRIANGULAR_BOARD_MARGIN + side/2.0;
+	lat.origin.y= (TRIANGULAR_GAME_SIZE - (dimy * height))/2.0 +
+		TRIANGULAR_BOARD_MARGIN;
+	lat.a.x= side;
+	lat.a.y= 0.;
+	lat.b.x= side/2.0;
+	lat.b.y= height;
+	lat.nfaces= 2;
+	lat.faces= triangles;
+	lat.imin= -dimy/2 - 1;
+	lat.imax= dimx/2;
+	lat.jmin= 0;
+	lat.jmax= dimy - 1;
+	lat.clip= triangular_clip;
+	lat.clip_data= &dimx;
+	lat.max_numlines= 3;
+
+	geo= lattice_build_skeleton(&lat);
 	geo->board_size= TRIANGULAR_BOARD_SIZE;
 	geo->board_margin= TRIANGULAR_BOARD_MARGIN;
 	geo->game_size= TRIANGULAR_GAME_SIZE;
-	geometry_set_distance_resolution(side/10.0);
-
-	/* iterate through triangles creating skeleton geometry
-	   (skeleton geometry: lines hold all the topology info) */
-	geo->ntiles= 0;
-	geo->nlines= 0;
-	geo->nvertex= 0;
-	for(j=0; j < dimy; ++j) {
-		ypos= yoffset + height*j;
-		for(i=0; i < dimx; ++i) {
-			xpos= xoffset + (side/2.0)*i;
-			if ((i+j)%2 == 0) {			/* upright triangle */
-				pts[0].x= xpos;					/* top */
-				pts[0].y= ypos;
-				pts[1].x= xpos + side/2.0;		/* bot right */
-				pts[1].y= ypos + height;
-				pts[2].x= xpos - side/2.0;		/* bot left */
-				pts[2].y= ypos + height;
-			} else {					/* upside down triangle */
-				pts[0].x= xpos - side/2.0;		/* top left */
-				pts[0].y= ypos;
-				pts[1].x= xpos + side/2.0;		/* top right */
-				pts[1].y= ypos;
-				pts[2].x= xpos;					/* bottom */
-				pts[2].y= ypos + height;
-			}
-			/* add tile to skeleton geometry */
-			geometry_add_tile(geo, pts, 3, NULL);
-		}
-	}
 
 	/* sanity check: see if we got the numbers we expected */
-	g_assert(geo->ntiles == ntiles);
-	g_assert(geo->nvertex == nvertex);
-	g_assert(geo->nlines == nlines);
+	g_assert(geo->ntiles == dimx*dimy);
+	g_assert(geo->nvertex == (dimx/2 + 1)*(dimy + 1));
+	g_assert(geo->nlines == dimx/2*(dimy + 1) + (dimx + 1)*dimy);
 
 	return geo;
 }
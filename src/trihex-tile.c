@@ -19,6 +19,7 @@
 
 #include "geometry.h"
 #include "tiles.h"
+#include "lattice.h"
 
 
 
@@ -36,82 +37,77 @@
 /* convert degrees to radians */
 #define D2R(x)		((x)*M_PI/180.0)
 
-/* possible neighbors of repeated symmetry unit */
-#define NEIGHBOR_NW		0x0001
-#define NEIGHBOR_NE		0x0002
-#define NEIGHBOR_W		0x0004
-
-
 /*
- * Draw 12 sided round structure that repeats to form tile board
+ * Set vertex coordinates of 12 sided round structure that repeats to form
+ * tile board (relative to its center).
+ * Outer ring of squares and triangles is shared with neighbouring units.
  */
 static void
-trihex_symmetry_unit(struct geometry *geo, struct point *pos, double side,
-					 int neighbor)
+trihex_symmetry_unit(struct lattice_face *faces, double side)
 {
-	struct point pts[4];
-	double half_side;
-	double height;
+	struct point *pts;
 	double angle;
 	double angle30;
 	int i;
-	int ringmask;		/* mask with ring shapes to draw */
-
-	/* set mask of ring shapes that are allowed to be drawn (according to neighbor).
-	   First shape is right square and we go clockwise. */
-	ringmask= ~0;
-	if (neighbor & NEIGHBOR_W) ringmask&= ~(0x00E0); // 0000 1110 0000
-	if (neighbor & NEIGHBOR_NW) ringmask&= ~(0x0380);	// 0011 1000 0000
-	if (neighbor & NEIGHBOR_NE) ringmask&= ~(0x0E00);	// 1110 0000 0000
-
-	/* pos is central point of 12 sided structure */
-	height= side * sqrt(3.0)/2.0;
-	half_side= side / 2.0;
+
 	angle30= 30 * (M_PI/180.0);
 
 	/* internal "trivial pursuit" pie region (inner triangles) */
-	pts[0].x= pos->x;
-	pts[0].y= pos->y;
 	for(i=0; i < 6; ++i) {
 		angle= i * D2R(60);
-		pts[1].x= pos->x + side*cos(angle - D2R(30));
-		pts[1].y= pos->y + side*sin(angle - D2R(30));
-		pts[2].x= pos->x + side*cos(angle + D2R(30));
-		pts[2].y= pos->y + side*sin(angle + D2R(30));
-		geometry_add_tile(geo, pts, 3, NULL);
+		faces[i].nsides= 3;
+		pts= faces[i].pts;
+		pts[0].x= 0.;
+		pts[0].y= 0.;
+		pts[1].x= side*cos(angle - D2R(30));
+		pts[1].y= side*sin(angle - D2R(30));
+		pts[2].x= side*cos(angle + D2R(30));
+		pts[2].y= side*sin(angle + D2R(30));
 	}
 
 	/* Outer ring of alternating squares and triangles */
-	/* We need to pay attention to elements that may overlap with previously
-	   drawn ones. We use ringmask to decide what we draw. */
 	for(i=0; i < 6; ++i) {
 		angle= D2R(i * 60);
 		/* square */
-		if (ringmask & 1) {
-			pts[0].x= pos->x + side*cos(angle + angle30);
-			pts[0].y= pos->y + side*sin(angle + angle30);
-			pts[1].x= pts[0].x + side*cos(angle - D2R(90));
-			pts[1].y= pts[0].y + side*sin(angle - D2R(90));
-			pts[2].x= pts[0].x + side*sqrt(2.0)*cos(angle - D2R(45));
-			pts[2].y= pts[0].y + side*sqrt(2.0)*sin(angle - D2R(45));
-			pts[3].x= pts[0].x + side*cos(angle);
-			pts[3].y= pts[0].y + side*sin(angle);
-			geometry_add_tile(geo, pts, 4, NULL);
-		}
+		faces[6 + 2*i].nsides= 4;
+		pts= faces[6 + 2*i].pts;
+		pts[0].x= side*cos(angle + angle30);
+		pts[0].y= side*sin(angle + angle30);
+		pts[1].x= pts[0].x + side*cos(angle - D2R(90));
+		pts[1].y= pts[0].y + side*sin(angle - D2R(90));
+		pts[2].x= pts[0].x + side*sqrt(2.0)*cos(angle - D2R(45));
+		pts[2].y= pts[0].y + side*sqrt(2.0)*sin(angle - D2R(45));
+		pts[3].x= pts[0].x + side*cos(angle);
+		pts[3].y= pts[0].y + side*sin(angle);
 		/* triangle */
-		if (ringmask & 2) {
-			/* pts[0]= square's pts[0] */
-			pts[1].x= pts[0].x + side*cos(angle);
-			pts[1].y= pts[0].y + side*sin(angle);
-			pts[2].x= pts[0].x + side*cos(angle + D2R(60));
-			pts[2].y= pts[0].y + side*sin(angle + D2R(60));
-			geometry_add_tile(geo, pts, 3, NULL);
-		}
-		ringmask>>= 2;
+		faces[7 + 2*i].nsides= 3;
+		faces[7 + 2*i].pts[0]= pts[0];	/* square's pts[0] */
+		faces[7 + 2*i].pts[1].x= pts[0].x + side*cos(angle);
+		faces[7 + 2*i].pts[1].y= pts[0].y + side*sin(angle);
+		faces[7 + 2*i].pts[2].x= pts[0].x + side*cos(angle + D2R(60));
+		faces[7 + 2*i].pts[2].y= pts[0].y + side*sin(angle + D2R(60));
 	}
 }
 
 
+/*
+ * Keep units in the board.
+ * Unit (i,j) is unit i - j/2 of row j.
+ */
+static gboolean
+trihex_clip(int i, int j, int face, const struct point *pts, int npts,
+			gpointer data)
+{
+	int *dim=(int*)data;
+	int col;
+
+	if (j < 0 || j >= dim[1]) return FALSE;
+	col= i - j/2;
+	if (col < 0 || col >= dim[0]) return FALSE;
+	return !(col == dim[0] - 1 && (j%2) == 0);
+}
+
+
 /*
  * Calculate sizes of drawing details
  */
@@ -135,17 +131,13 @@ struct geometry*
 build_trihex_tile_skeleton(const struct gameinfo *info)
 {
 	struct geometry *geo;
-	int i, j;
-	int dimx, dimy;
+	struct lattice lat;
+	struct lattice_face faces[18];
+	int dim[2];
 	double side;
 	double xshift, yshift;
-	double xoffset;
-	int ntiles;
-	int nvertex;
-	int nlines;
 	double x0;
 	double y0;
-	struct point pos;
 	const int geo_params[5][3]= {	/* num of tiles, vertex, lines for all sizes */
 		{ 46,  42,  87},
 		{ 96,  79, 174},
@@ -153,19 +145,18 @@ build_trihex_tile_skeleton(const struct gameinfo *info)
 		{277, 208, 484},
 		{465, 338, 802}
 	};
-	int neighbor=0;
 
 	/* size parameter determines number of symmetry units */
 	g_assert(info->size >= 0 && info->size < 5);
-	dimx= info->size + 2;
-	dimy= dimx;
-	if (info->size == 4) ++dimy;
+	dim[0]= info->size + 2;
+	dim[1]= dim[0];
+	if (info->size == 4) ++dim[1];
 
 	/* num of sides wide: info->size*(1 + sqrt(3)) + 1 */
-	side= TRIHEX_GAME_SIZE/(dimx*(1.0 + sqrt(3.0)) + 1.0);
+	side= TRIHEX_GAME_SIZE/(dim[0]*(1.0 + sqrt(3.0)) + 1.0);
 	/* num of sides tall: info->size*(sqrt(3)/2 + 1 + 1/2) + sqrt(3)/2 + 1/2 */
 	/* NOTE: shameless reuse of variable yshift */
-	yshift= TRIHEX_GAME_SIZE/(dimy*(sqrt(3.0) + 3.0)/2.0 + (sqrt(3.0) + 1.0)/2.0);
+	yshift= TRIHEX_GAME_SIZE/(dim[1]*(sqrt(3.0) + 3.0)/2.0 + (sqrt(3.0) + 1.0)/2.0);
 	/* choose xfit or yfit (see which produces smaller side -> more limiting) */
 	if (yshift < side) side= yshift;
 
@@ -173,49 +164,38 @@ build_trihex_tile_skeleton(const struct gameinfo *info)
 	yshift= side*(sqrt(3.0) + 1.0)/2.0 + side;
 
 	/* coordinates of unit on top left (center of unit coords) */
-	x0= (dimx*(1.0 + sqrt(3.0)) + 1.0)*side;
+	x0= (dim[0]*(1.0 + sqrt(3.0)) + 1.0)*side;
 	x0= (TRIHEX_BOARD_SIZE - x0)/2.0 + side*(1.0 + sqrt(3.0)/2.0);
-	y0= (dimy*(3.0 + sqrt(3.0))/2.0 + (sqrt(3.0) + 1.0)/2.0)*side;
+	y0= (dim[1]*(3.0 + sqrt(3.0))/2.0 + (sqrt(3.0) + 1.0)/2.0)*side;
 	y0= (TRIHEX_BOARD_SIZE - y0)/2.0 + (sqrt(3.0)/2.0 + 1.0)*side;
 
-	/* create geometry with plenty of space for lines and vertex */
-	ntiles= geo_params[info->size][0];
-	nvertex= geo_params[info->size][1];
-	nlines= geo_params[info->size][2];
-	geo= geometry_create_new(ntiles, nvertex, nlines, 5);
+	/* units in rows, even rows shifted half a unit right */
+	trihex_symmetry_unit(faces, side);
+	lat.origin.x= x0 + xshift/2.0;
+	lat.origin.y= y0;
+	lat.a.x= xshift;
+	lat.a.y= 0.;
+	lat.b.x= -xshift/2.0;
+	lat.b.y= yshift;
+	lat.nfaces= 18;
+	lat.faces= faces;
+	lat.imin= 0;
+	lat.imax= dim[0] + dim[1]/2;
+	lat.jmin= 0;
+	lat.jmax= dim[1] - 1;
+	lat.clip= trihex_clip;
+	lat.clip_data= dim;
+	lat.max_numlines= 5;
+
+	geo= lattice_build_skeleton(&lat);
 	geo->board_size= TRIHEX_BOARD_SIZE;
 	geo->board_margin= TRIHEX_BOARD_MARGIN;
 	geo->game_size= TRIHEX_BOARD_SIZE - 2*TRIHEX_BOARD_MARGIN;
-	geometry_set_distance_resolution(side/10.0);
-
-	/* create units */
-	geo->ntiles= 0;
-	geo->nlines= 0;
-	geo->nvertex= 0;
-	for(j=0; j < dimy; ++j) {
-		pos.y= y0 + j*yshift;
-		xoffset= ((j+1) % 2) * xshift/2.0;
-		if (j > 0) neighbor= NEIGHBOR_NE;
-		for(i=0; i < dimx; ++i) {
-			if (i == dimx - 1 && (j%2) == 0) break;
-			if (j > 0) {
-				if (i == 0) {
-					if ((j%2) == 0) neighbor|= NEIGHBOR_NW;
-				} else {
-					if ((j%2) == 1) neighbor|= NEIGHBOR_NW;
-				}
-				if (i == dimx - 1 && ((j%2) == 1)) neighbor&= ~(NEIGHBOR_NE);
-			}
-			if (i > 0) neighbor|= NEIGHBOR_W;
-			pos.x= x0 + xoffset + i * xshift;
-			trihex_symmetry_unit(geo, &pos, side, neighbor);
-		}
-	}
 
-	/* make sure we didn't underestimate max numbers */
-	g_assert(geo->ntiles == ntiles);
-	g_assert(geo->nvertex == nvertex);
-	g_assert(geo->nlines == nlines);
+	/* sanity check: see if we got the numbers we expected */
+	g_assert(geo->ntiles == geo_params[info->size][0]);
+	g_assert(geo->nvertex == geo_params[info->size][1]);
+	g_assert(geo->nlines == geo_params[info->size][2]);
 
 	return geo;
 }
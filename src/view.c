@@ -0,0 +1,143 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+#include <math.h>
+#include <gtk/gtk.h>
+
+#include "gamedata.h"
+#include "view.h"
+
+
+/*
+ * View transform of board in drawing area.
+ * At zoom 1 the whole board is scaled to fit the drawing area (with
+ * width_pxscale & height_pxscale). Zooming in shows board_size/zoom board
+ * units across, starting at (view.x, view.y). View is kept inside the
+ * board.
+ */
+
+/* maximum zoom factor */
+#define VIEW_MAX_ZOOM		64.
+
+
+/*
+ * Reset view: whole board shown
+ */
+void
+view_reset(struct view *view)
+{
+	view->zoom= 1.;
+	view->x= view->y= 0.;
+	view->dragging= FALSE;
+}
+
+
+/*
+ * Keep view inside board
+ */
+static void
+view_clamp(struct board *board)
+{
+	struct view *view=&board->view;
+	double max;
+
+	view->zoom= CLAMP(view->zoom, 1., VIEW_MAX_ZOOM);
+	max= board->geo->board_size*(1. - 1./view->zoom);
+	view->x= CLAMP(view->x, 0., max);
+	view->y= CLAMP(view->y, 0., max);
+}
+
+
+/*
+ * Translate pixel coords (in drawing area) to board coords
+ */
+void
+view_pixel_to_board(struct board *board, double px, double py,
+					struct point *point)
+{
+	point->x= board->view.x + px/(board->width_pxscale*board->view.zoom);
+	point->y= board->view.y + py/(board->height_pxscale*board->view.zoom);
+}
+
+
+/*
+ * Pixel rectangle (in drawing area) covering clip box given in board units
+ */
+static void
+view_clip_to_pixels(struct board *board, const struct clipbox *clip,
+					GdkRectangle *rect)
+{
+	double sx=board->width_pxscale*board->view.zoom;
+	double sy=board->height_pxscale*board->view.zoom;
+	double x0, y0, x1, y1;
+
+	x0= floor((clip->x - board->view.x)*sx);
+	y0= floor((clip->y - board->view.y)*sy);
+	x1= ceil((clip->x + clip->w - board->view.x)*sx);
+	y1= ceil((clip->y + clip->h - board->view.y)*sy);
+	rect->x= (gint)x0;
+	rect->y= (gint)y0;
+	rect->width= (gint)(x1 - x0);
+	rect->height= (gint)(y1 - y0);
+}
+
+
+/*
+ * Schedule redraw of area of drawing area showing clip box (board units)
+ */
+void
+view_queue_draw_clip(struct board *board, const struct clipbox *clip)
+{
+	GdkRectangle rect;
+
+	if (board->drawarea == NULL) return;
+	view_clip_to_pixels(board, clip, &rect);
+	gtk_widget_queue_draw_area(GTK_WIDGET(board->drawarea), rect.x, rect.y,
+							   rect.width, rect.height);
+}
+
+
+/*
+ * Multiply zoom by 'factor' keeping board point under pixel (px, py) fixed
+ */
+void
+view_zoom_at(struct board *board, double factor, double px, double py)
+{
+	struct point point;
+
+	view_pixel_to_board(board, px, py, &point);
+	board->view.zoom*= factor;
+	view_clamp(board);
+	board->view.x= point.x - px/(board->width_pxscale*board->view.zoom);
+	board->view.y= point.y - py/(board->height_pxscale*board->view.zoom);
+	view_clamp(board);
+	if (board->drawarea != NULL)
+		gtk_widget_queue_draw(GTK_WIDGET(board->drawarea));
+}
+
+
+/*
+ * Move view by (dx, dy) pixels
+ */
+void
+view_pan(struct board *board, double dx, double dy)
+{
+	board->view.x-= dx/(board->width_pxscale*board->view.zoom);
+	board->view.y-= dy/(board->height_pxscale*board->view.zoom);
+	view_clamp(board);
+	if (board->drawarea != NULL)
+		gtk_widget_queue_draw(GTK_WIDGET(board->drawarea));
+}
@@ -0,0 +1,36 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+#ifndef __INCLUDED_VIEW_H__
+#define __INCLUDED_VIEW_H__
+
+
+/* zoom factor of one zoom in step (mouse wheel, '+' key) */
+#define VIEW_ZOOM_STEP		1.25
+
+
+/*
+ * Functions
+ */
+void view_reset(struct view *view);
+void view_pixel_to_board(struct board *board, double px, double py,
+						 struct point *point);
+void view_queue_draw_clip(struct board *board, const struct clipbox *clip);
+void view_zoom_at(struct board *board, double factor, double px, double py);
+void view_pan(struct board *board, double dx, double dy);
+
+
+#endif